@@ -2,21 +2,29 @@
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <controller_interface/multi_interface_controller.h>
 #include <franka_hw/franka_state_interface.h>
+#include <franka_hw/publisher_group.h>
+#include <franka_hw/state_channel.h>
 #include <franka_hw/trigger_rate.h>
+#include <franka_msgs/Errors.h>
 #include <franka_msgs/FrankaState.h>
+#include <franka_msgs/FrankaStateBatch.h>
+#include <franka_msgs/FrankaStateCompact.h>
 #include <geometry_msgs/WrenchStamped.h>
-#include <realtime_tools/realtime_publisher.h>
 #include <sensor_msgs/JointState.h>
 #include <tf2_msgs/TFMessage.h>
 
 namespace franka_control {
 
+class StaticTransformSender;
+
 /**
  * Controller to publish the robot state as ROS topics.
  */
@@ -48,9 +56,33 @@ class FrankaStateController
   void update(const ros::Time& time, const ros::Duration& period) override;
 
  private:
+  // Rate, on/off switch and sequence number of a published topic.
+  struct TopicRate {
+    bool enabled{true};
+    franka_hw::TriggerRate trigger;
+    uint64_t sequence_number{0};
+
+    bool operator()(const ros::Duration& period) { return enabled && trigger(period); }
+  };
+
+  // Latched error topic, only published when the errors change.
+  struct ErrorsTopic {
+    std::shared_ptr<franka_hw::RingPublisher<franka_msgs::Errors>> publisher;
+    franka_msgs::Errors latched;
+    // Spares converting the errors as long as there are none.
+    bool latched_no_errors{true};
+  };
+
   void publishFrankaStates(const ros::Time& time);
+  void publishFrankaStatesCompact(const ros::Time& time);
+  void batchFrankaState(const ros::Time& time);
+  void copyCompactState(const franka::RobotState& robot_state,
+                        const ros::Time& time,
+                        uint64_t sequence_number,
+                        franka_msgs::FrankaStateCompact* message) const;
   void publishJointStates(const ros::Time& time);
   void publishTransforms(const ros::Time& time);
+  static void publishErrors(const franka::Errors& errors, ErrorsTopic* topic);
   void publishExternalWrench(const ros::Time& time);
 
   std::string arm_id_;
@@ -58,14 +90,52 @@ class FrankaStateController
   franka_hw::FrankaStateInterface* franka_state_interface_{};
   std::unique_ptr<franka_hw::FrankaStateHandle> franka_state_handle_{};
 
-  realtime_tools::RealtimePublisher<tf2_msgs::TFMessage> publisher_transforms_;
-  realtime_tools::RealtimePublisher<franka_msgs::FrankaState> publisher_franka_states_;
-  realtime_tools::RealtimePublisher<sensor_msgs::JointState> publisher_joint_states_;
-  realtime_tools::RealtimePublisher<sensor_msgs::JointState> publisher_joint_states_desired_;
-  realtime_tools::RealtimePublisher<geometry_msgs::WrenchStamped> publisher_external_wrench_;
-  franka_hw::TriggerRate trigger_publish_;
+  // Shared by all FrankaStateControllers of the process, null if transforms are disabled.
+  std::shared_ptr<StaticTransformSender> static_transform_sender_;
+  // Publishes all topics from one thread. Publishers of disabled topics are null.
+  std::unique_ptr<franka_hw::PublisherGroup> publisher_group_;
+  size_t message_pool_size_ = 4;
+  std::shared_ptr<franka_hw::RingPublisher<tf2_msgs::TFMessage>> publisher_static_transforms_;
+  ErrorsTopic current_errors_;
+  ErrorsTopic last_motion_errors_;
+  std::shared_ptr<franka_hw::RingPublisher<franka_msgs::FrankaState>> publisher_franka_states_;
+  std::shared_ptr<franka_hw::RingPublisher<franka_msgs::FrankaStateCompact>>
+      publisher_franka_states_compact_;
+  std::shared_ptr<franka_hw::RingPublisher<franka_msgs::FrankaStateBatch>>
+      publisher_franka_states_batch_;
+  std::shared_ptr<franka_hw::RingPublisher<sensor_msgs::JointState>> publisher_joint_states_;
+  std::shared_ptr<franka_hw::RingPublisher<sensor_msgs::JointState>>
+      publisher_joint_states_desired_;
+  std::shared_ptr<franka_hw::RingPublisher<geometry_msgs::WrenchStamped>>
+      publisher_external_wrench_;
+  TopicRate franka_states_rate_;
+  TopicRate joint_states_rate_;
+  TopicRate transforms_rate_;
+  TopicRate external_wrench_rate_;
+  // Shares the robot state of every update with processes on the same computer, if configured.
+  std::unique_ptr<franka_hw::StateChannelWriter> state_channel_;
   franka::RobotState robot_state_;
-  uint64_t sequence_number_ = 0;
+  // Copies the fields selected by franka_state_fields into the compact message. Empty if the
+  // full franka_msgs::FrankaState is published.
+  std::vector<void (*)(const franka::RobotState&, franka_msgs::FrankaStateCompact*)>
+      compact_fields_;
+  // Number of states per franka_msgs::FrankaStateBatch, 0 if batching is disabled.
+  size_t batch_size_ = 0;
+  // Holds the states of the batch being filled and swaps them with the published message.
+  std::vector<franka_msgs::FrankaStateCompact> batch_;
+  size_t batched_states_ = 0;
+  uint64_t batch_sequence_number_ = 0;
+  uint64_t state_sequence_number_ = 0;
+  uint32_t dropped_states_ = 0;
+  // Number of pooled franka_msgs::FrankaState messages that may still hold errors. The errors are
+  // only converted while there are any or some of these messages still hold errors.
+  size_t current_errors_messages_ = 0;
+  size_t last_motion_errors_messages_ = 0;
+  // Frames last published on /tf_static, the transforms are only published again on a change.
+  bool static_transforms_published_ = false;
+  std::array<double, 16> published_F_T_NE_{};
+  std::array<double, 16> published_NE_T_EE_{};
+  std::array<double, 16> published_EE_T_K_{};
   std::vector<std::string> joint_names_;
 };
 
@@ -0,0 +1,284 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <controller_interface/controller_base.h>
+#include <franka/robot_state.h>
+#include <franka_hw/franka_cartesian_command_interface.h>
+#include <franka_hw/franka_model_interface.h>
+#include <franka_hw/franka_state_interface.h>
+#include <franka_hw/model_base.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <pluginlib/class_loader.h>
+#include <ros/node_handle.h>
+#include <ros/time.h>
+
+namespace franka_control {
+
+/**
+ * Controller to run another controller at an integer fraction of the control rate.
+ *
+ * controller_manager updates all running controllers in every control cycle. This controller
+ * wraps a controller loaded from the "controller" namespace and only updates it in every
+ * "divisor"-th cycle, optionally on a separate thread. The wrapped controller works on a snapshot
+ * of the robot state taken in its cycle and on its own command buffers. In the cycles in between,
+ * its last commands are either held or linearly interpolated (poses with slerp) on the joint and
+ * Cartesian command interfaces, so the commands sent to the robot stay continuous.
+ *
+ * The claims of the wrapped controller are reported as the claims of this controller, so
+ * controller_manager and FrankaHW see the same control mode as if it was loaded directly.
+ *
+ * This controller implements ControllerBase directly instead of MultiInterfaceController, which
+ * supports at most four interfaces on melodic. All interfaces are optional, the wrapped controller
+ * decides which ones are required.
+ */
+class MultiRateController : public controller_interface::ControllerBase {
+ public:
+  /**
+   * Creates an instance of a MultiRateController.
+   */
+  MultiRateController() = default;
+
+  /**
+   * Stops the update thread, if any.
+   */
+  ~MultiRateController() override;
+
+  /**
+   * Loads and initializes the wrapped controller. Called by controller_manager.
+   *
+   * @param[in] robot_hw RobotHW instance to get the interfaces for the wrapped controller from.
+   * @param[in] root_node_handle Node handle in the controller_manager namespace.
+   * @param[in] controller_node_handle Node handle in the controller namespace.
+   * @param[out] claimed_resources The resources claimed by the wrapped controller.
+   *
+   * @return True if successful, false otherwise.
+   */
+  bool initRequest(hardware_interface::RobotHW* robot_hw,
+                   ros::NodeHandle& root_node_handle,
+                   ros::NodeHandle& controller_node_handle,
+                   ClaimedResources& claimed_resources) override;
+
+  /**
+   * Initializes the commands from the current robot state and starts the wrapped controller.
+   *
+   * @param[in] time Current ROS time.
+   */
+  void starting(const ros::Time& time) override;
+
+  /**
+   * Updates the wrapped controller in its cycles and writes interpolated commands in every cycle.
+   *
+   * @param[in] time Current ROS time.
+   * @param[in] period Time since the last update.
+   */
+  void update(const ros::Time& time, const ros::Duration& period) override;
+
+  /**
+   * Stops the wrapped controller. If the update thread is still busy, the stop is handed to it
+   * instead of waiting, and a following start is deferred until the thread is idle. The robot
+   * is held at its current state meanwhile.
+   *
+   * @param[in] time Current ROS time.
+   */
+  void stopping(const ros::Time& time) override;
+
+ protected:
+  /**
+   * Creates the wrapped controller with pluginlib.
+   *
+   * @param[in] type Type of the wrapped controller.
+   *
+   * @return The uninitialized controller.
+   *
+   * @throw pluginlib::PluginlibException if the controller cannot be loaded.
+   */
+  virtual std::unique_ptr<controller_interface::ControllerBase> loadController(
+      const std::string& type);
+
+ private:
+  enum class Interpolation { kHold, kLinear };
+
+  struct JointSlot {
+    explicit JointSlot(const hardware_interface::JointHandle& real_handle) : handle(real_handle) {}
+    hardware_interface::JointHandle handle;
+    bool claimed{false};
+    double position{0.0};
+    double velocity{0.0};
+    double effort{0.0};
+    double command{0.0};
+    double previous{0.0};
+    double target{0.0};
+    double output{0.0};
+  };
+
+  struct JointStateSlot {
+    explicit JointStateSlot(const hardware_interface::JointStateHandle& real_handle)
+        : handle(real_handle) {}
+    hardware_interface::JointStateHandle handle;
+    double position{0.0};
+    double velocity{0.0};
+    double effort{0.0};
+  };
+
+  struct RobotStateSlot {
+    explicit RobotStateSlot(const franka_hw::FrankaStateHandle& real_handle)
+        : handle(real_handle) {}
+    franka_hw::FrankaStateHandle handle;
+    franka::RobotState robot_state;
+  };
+
+  template <typename Handle, size_t N>
+  struct CartesianSlot {
+    using HandleType = Handle;
+    explicit CartesianSlot(const Handle& real_handle) : handle(real_handle) {}
+    Handle handle;
+    bool claimed{false};
+    std::array<double, N> command{};
+    std::array<double, 2> elbow{};
+    std::array<double, N> previous{};
+    std::array<double, 2> previous_elbow{};
+    std::array<double, N> target{};
+    std::array<double, 2> target_elbow{};
+    std::array<double, N> output{};
+    std::array<double, 2> output_elbow{};
+  };
+
+  using PoseSlot = CartesianSlot<franka_hw::FrankaCartesianPoseHandle, 16>;
+  using VelocitySlot = CartesianSlot<franka_hw::FrankaCartesianVelocityHandle, 6>;
+
+  /**
+   * Forwards model calls with explicit arguments to the model of a real FrankaModelHandle, so the
+   * wrapped controller evaluates the model on its snapshot of the robot state.
+   */
+  class HandleModel : public franka_hw::ModelBase {
+   public:
+    explicit HandleModel(const franka_hw::FrankaModelHandle& handle) : handle_(handle) {}
+
+    std::array<double, 16> pose(
+        franka::Frame frame,
+        const std::array<double, 7>& q,
+        const std::array<double, 16>& F_T_EE,  // NOLINT(readability-identifier-naming)
+        const std::array<double, 16>& EE_T_K)  // NOLINT(readability-identifier-naming)
+        const override;
+    std::array<double, 42> bodyJacobian(
+        franka::Frame frame,
+        const std::array<double, 7>& q,
+        const std::array<double, 16>& F_T_EE,  // NOLINT(readability-identifier-naming)
+        const std::array<double, 16>& EE_T_K)  // NOLINT(readability-identifier-naming)
+        const override;
+    std::array<double, 42> zeroJacobian(
+        franka::Frame frame,
+        const std::array<double, 7>& q,
+        const std::array<double, 16>& F_T_EE,  // NOLINT(readability-identifier-naming)
+        const std::array<double, 16>& EE_T_K)  // NOLINT(readability-identifier-naming)
+        const override;
+    std::array<double, 49> mass(
+        const std::array<double, 7>& q,
+        const std::array<double, 9>& I_total,  // NOLINT(readability-identifier-naming)
+        double m_total,
+        const std::array<double, 3>& F_x_Ctotal)  // NOLINT(readability-identifier-naming)
+        const override;
+    std::array<double, 7> coriolis(
+        const std::array<double, 7>& q,
+        const std::array<double, 7>& dq,
+        const std::array<double, 9>& I_total,  // NOLINT(readability-identifier-naming)
+        double m_total,
+        const std::array<double, 3>& F_x_Ctotal)  // NOLINT(readability-identifier-naming)
+        const override;
+    std::array<double, 7> gravity(
+        const std::array<double, 7>& q,
+        double m_total,
+        const std::array<double, 3>& F_x_Ctotal,  // NOLINT(readability-identifier-naming)
+        const std::array<double, 3>& gravity_earth) const override;
+
+   private:
+    franka_hw::FrankaModelHandle handle_;
+  };
+
+  template <typename Interface>
+  void proxyJointInterface(hardware_interface::RobotHW* robot_hw,
+                           Interface* proxy_interface,
+                           std::deque<JointSlot>* slots);
+  template <typename Interface, typename Slot>
+  void proxyCartesianInterface(hardware_interface::RobotHW* robot_hw,
+                               Interface* proxy_interface,
+                               std::deque<Slot>* slots);
+  void proxyStateInterfaces(hardware_interface::RobotHW* robot_hw);
+  template <typename Slot>
+  bool claimSlots(const hardware_interface::InterfaceResources& claim, std::deque<Slot>* slots);
+  bool claimResources(const ClaimedResources& claims);
+
+  void start(const ros::Time& time);
+  void holdRobot();
+  void takeSnapshot();
+  void retarget();
+  void interpolate(double alpha);
+  template <typename Slot>
+  void setCartesianCommand(double alpha, Slot* slot);
+  void runUpdates();
+
+  uint32_t divisor_{1};
+  Interpolation interpolation_{Interpolation::kLinear};
+  bool threaded_{false};
+
+  // Declared before the wrapped controller, which has to be destroyed first.
+  std::unique_ptr<pluginlib::ClassLoader<controller_interface::ControllerBase>> loader_;
+  hardware_interface::RobotHW proxy_hw_;
+  hardware_interface::EffortJointInterface proxy_effort_interface_;
+  hardware_interface::PositionJointInterface proxy_position_interface_;
+  hardware_interface::VelocityJointInterface proxy_velocity_interface_;
+  hardware_interface::JointStateInterface proxy_joint_state_interface_;
+  franka_hw::FrankaPoseCartesianInterface proxy_pose_interface_;
+  franka_hw::FrankaVelocityCartesianInterface proxy_velocity_cartesian_interface_;
+  franka_hw::FrankaStateInterface proxy_state_interface_;
+  franka_hw::FrankaModelInterface proxy_model_interface_;
+
+  std::deque<JointSlot> effort_slots_;
+  std::deque<JointSlot> position_slots_;
+  std::deque<JointSlot> velocity_slots_;
+  std::deque<JointStateSlot> joint_state_slots_;
+  std::deque<PoseSlot> pose_slots_;
+  std::deque<VelocitySlot> velocity_cartesian_slots_;
+  std::map<std::string, RobotStateSlot> robot_state_slots_;
+  std::deque<HandleModel> models_;
+
+  std::unique_ptr<controller_interface::ControllerBase> controller_;
+
+  uint32_t tick_{0};
+  uint32_t step_{0};
+  ros::Duration accumulated_period_;
+  size_t overruns_{0};
+
+  std::thread worker_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // Requests to the update thread, guarded by mutex_.
+  bool update_pending_{false};
+  bool stop_pending_{false};
+  bool shutdown_{false};
+  ros::Time update_time_;
+  ros::Duration update_period_;
+  ros::Time stop_time_;
+  // True while the update thread has an update or stop to process.
+  std::atomic_bool worker_busy_{false};
+  // Start deferred until the update thread is idle, only accessed by the control thread.
+  bool start_pending_{false};
+  ros::Time start_time_;
+};
+
+}  // namespace franka_control
@@ -5,28 +5,49 @@
 #include <franka_hw/franka_combined_hw.h>
 #include <ros/ros.h>
 
-#include <franka/control_tools.h>
+#include <franka_hw/thread_config.h>
 #include <sched.h>
-#include <string>
 
 int main(int argc, char** argv) {
   ros::init(argc, argv, "franka_combined_control_node");
 
+  ros::NodeHandle private_node_handle("~");
+  if (private_node_handle.param("threads/lock_memory", false) && !franka_hw::lockMemory()) {
+    ROS_ERROR("franka_combined_control_node: Failed to lock memory. Shutting down!");
+    return 1;
+  }
+  // Run the control loop at the highest priority unless configured otherwise.
+  franka_hw::ThreadConfig control_loop_thread_config;
+  control_loop_thread_config.policy = franka_hw::ThreadConfig::Policy::kFifo;
+  control_loop_thread_config.priority = sched_get_priority_max(SCHED_FIFO);
+  franka_hw::ThreadConfig spinner_thread_config;
+  if (!franka_hw::readThreadConfig(private_node_handle, "control_loop",
+                                   &control_loop_thread_config) ||
+      !franka_hw::readThreadConfig(private_node_handle, "spinner", &spinner_thread_config)) {
+    ROS_ERROR("franka_combined_control_node: Invalid thread configuration. Shutting down!");
+    return 1;
+  }
+
+  // Start background threads for message handling. They inherit the scheduling of this thread, as
+  // do the publisher threads of controllers loaded through them.
+  const franka_hw::ThreadConfig initial_thread_config = franka_hw::currentThreadConfig();
+  if (!franka_hw::configureCurrentThread("spinner", spinner_thread_config)) {
+    return 1;
+  }
   ros::AsyncSpinner spinner(4);
   spinner.start();
+  if (!franka_hw::configureCurrentThread("main", initial_thread_config)) {
+    return 1;
+  }
 
-  ros::NodeHandle private_node_handle("~");
   franka_hw::FrankaCombinedHW franka_control;
   if (!franka_control.init(private_node_handle, private_node_handle)) {
     ROS_ERROR("franka_combined_control_node:: Initialization of FrankaCombinedHW failed!");
     return 1;
   }
 
-  // set current thread to real-time priority
-  std::string error_message;
-  if (!franka::setCurrentThreadToHighestSchedulerPriority(&error_message)) {
-    ROS_ERROR("franka_combined_control_node: Failed to set thread priority to real-time. Error: %s",
-              error_message.c_str());
+  if (!franka_hw::configureCurrentThread("control_loop", control_loop_thread_config)) {
+    ROS_ERROR("franka_combined_control_node: Failed to configure the control loop thread.");
     return 1;
   }
 
@@ -35,12 +56,17 @@ int main(int argc, char** argv) {
   ros::Rate rate(period);
 
   while (ros::ok()) {
-    rate.sleep();
+    // Update the controllers when every arm has a new state, measuring the period on the robot
+    // clock. Fall back to the wall clock while not all arms are controlled.
+    ros::Duration cycle_period = period;
+    if (!franka_control.waitForStates(&cycle_period)) {
+      rate.sleep();
+    }
     ros::Time now = ros::Time::now();
-    franka_control.read(now, period);
-    cm.update(now, period, franka_control.controllerNeedsReset());
+    franka_control.read(now, cycle_period);
+    cm.update(now, cycle_period, franka_control.controllerNeedsReset());
     if (!franka_control.hasError()) {
-      franka_control.write(now, period);
+      franka_control.write(now, cycle_period);
     } else {
       ROS_DEBUG_THROTTLE(5,
                          "franka_combined_control_node: The HW is in error state."
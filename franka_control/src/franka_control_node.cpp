@@ -2,21 +2,23 @@
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #include <algorithm>
 #include <atomic>
-#include <chrono>
-#include <thread>
+#include <memory>
+#include <string>
 
 #include <actionlib/server/simple_action_server.h>
 #include <controller_manager/controller_manager.h>
 #include <franka/exception.h>
 #include <franka/robot.h>
 #include <franka_hw/franka_hw.h>
+#include <franka_hw/franka_mock_hw.h>
+#include <franka_hw/idle_loop.h>
 #include <franka_hw/services.h>
+#include <franka_hw/thread_config.h>
 #include <franka_msgs/ErrorRecoveryAction.h>
 #include <ros/ros.h>
 #include <std_srvs/Trigger.h>
 
 using franka_hw::ServiceContainer;
-using namespace std::chrono_literals;
 
 int main(int argc, char** argv) {
   ros::init(argc, argv, "franka_control_node");
@@ -24,46 +26,38 @@ int main(int argc, char** argv) {
   ros::NodeHandle public_node_handle;
   ros::NodeHandle node_handle("~");
 
-  franka_hw::FrankaHW franka_control;
+  if (node_handle.param("threads/lock_memory", false) && !franka_hw::lockMemory()) {
+    ROS_ERROR("franka_control_node: Failed to lock memory. Shutting down!");
+    return 1;
+  }
+  franka_hw::ThreadConfig control_loop_thread_config;
+  franka_hw::ThreadConfig spinner_thread_config;
+  if (!franka_hw::readThreadConfig(node_handle, "control_loop", &control_loop_thread_config) ||
+      !franka_hw::readThreadConfig(node_handle, "spinner", &spinner_thread_config)) {
+    ROS_ERROR("franka_control_node: Invalid thread configuration. Shutting down!");
+    return 1;
+  }
+
+  // With mock_robot, the node runs the emulated control loop of FrankaMockHW instead of a robot.
+  std::unique_ptr<franka_hw::FrankaHW> robot_hw;
+  if (node_handle.param("mock_robot", false)) {
+    robot_hw = std::make_unique<franka_hw::FrankaMockHW>();
+  } else {
+    robot_hw = std::make_unique<franka_hw::FrankaHW>();
+  }
+  franka_hw::FrankaHW& franka_control = *robot_hw;
   if (!franka_control.init(public_node_handle, node_handle)) {
     ROS_ERROR("franka_control_node: Failed to initialize FrankaHW class. Shutting down!");
     return 1;
   }
 
-  auto services = std::make_unique<ServiceContainer>();
-  std::unique_ptr<actionlib::SimpleActionServer<franka_msgs::ErrorRecoveryAction>>
-      recovery_action_server;
-
   std::atomic_bool has_error(false);
 
   auto connect = [&]() {
     franka_control.connect();
     std::lock_guard<std::mutex> lock(franka_control.robotMutex());
-    auto& robot = franka_control.robot();
-
-    services = std::make_unique<ServiceContainer>();
-    franka_hw::setupServices(robot, franka_control.robotMutex(), node_handle, *services);
-
-    recovery_action_server =
-        std::make_unique<actionlib::SimpleActionServer<franka_msgs::ErrorRecoveryAction>>(
-            node_handle, "error_recovery",
-            [&](const franka_msgs::ErrorRecoveryGoalConstPtr&) {
-              try {
-                std::lock_guard<std::mutex> lock(franka_control.robotMutex());
-                robot.automaticErrorRecovery();
-                has_error = false;
-                recovery_action_server->setSucceeded();
-                ROS_INFO("Recovered from error");
-              } catch (const franka::Exception& ex) {
-                recovery_action_server->setAborted(franka_msgs::ErrorRecoveryResult(), ex.what());
-              }
-            },
-            false);
-
-    recovery_action_server->start();
-
     // Initialize robot state before loading any controller
-    franka_control.update(robot.readOnce());
+    franka_control.update(franka_control.readRobotState());
   };
 
   auto disconnect_handler = [&](std_srvs::Trigger::Request& request,
@@ -73,8 +67,6 @@ int main(int argc, char** argv) {
       response.message = "Controller is active. Cannot disconnect while a controller is running.";
       return true;
     }
-    services.reset();
-    recovery_action_server.reset();
     auto result = franka_control.disconnect();
     response.success = result ? 1u : 0u;
     response.message = result ? "" : "Failed to disconnect robot.";
@@ -89,15 +81,55 @@ int main(int argc, char** argv) {
       return true;
     }
 
-    connect();
+    const ros::WallTime start = ros::WallTime::now();
+    try {
+      connect();
+    } catch (const franka::Exception& ex) {
+      response.success = 0u;
+      response.message = std::string("Failed to connect to robot: ") + ex.what();
+      return true;
+    }
+    franka_control.idleLoop().wakeUp();
 
     response.success = 1u;
-    response.message = "";
+    response.message =
+        "Reconnected in " + std::to_string((ros::WallTime::now() - start).toSec()) + " s.";
+    ROS_INFO_STREAM("franka_control_node: " << response.message);
     return true;
   };
 
   connect();
 
+  // The services and the recovery action server get the robot when they are called, so they are
+  // kept across disconnects and reconnects.
+  ServiceContainer services;
+  franka_control.setupRobotServices(node_handle, services);
+
+  std::unique_ptr<actionlib::SimpleActionServer<franka_msgs::ErrorRecoveryAction>>
+      recovery_action_server;
+  recovery_action_server =
+      std::make_unique<actionlib::SimpleActionServer<franka_msgs::ErrorRecoveryAction>>(
+          node_handle, "error_recovery",
+          [&](const franka_msgs::ErrorRecoveryGoalConstPtr&) {
+            try {
+              std::lock_guard<std::mutex> lock(franka_control.robotMutex());
+              if (!franka_control.connected()) {
+                recovery_action_server->setAborted(franka_msgs::ErrorRecoveryResult(),
+                                                   "Cannot recover robot while disconnected.");
+                return;
+              }
+              franka_control.automaticErrorRecovery();
+              has_error = false;
+              franka_control.idleLoop().wakeUp();
+              recovery_action_server->setSucceeded();
+              ROS_INFO("Recovered from error");
+            } catch (const franka::Exception& ex) {
+              recovery_action_server->setAborted(franka_msgs::ErrorRecoveryResult(), ex.what());
+            }
+          },
+          false);
+  recovery_action_server->start();
+
   ros::ServiceServer connect_server =
       node_handle.advertiseService<std_srvs::Trigger::Request, std_srvs::Trigger::Response>(
           "connect", connect_handler);
@@ -107,33 +139,51 @@ int main(int argc, char** argv) {
 
   controller_manager::ControllerManager control_manager(&franka_control, public_node_handle);
 
-  // Start background threads for message handling
+  // Start background threads for message handling. They inherit the scheduling of this thread, as
+  // do the publisher threads of controllers loaded through them.
+  const franka_hw::ThreadConfig initial_thread_config = franka_hw::currentThreadConfig();
+  if (!franka_hw::configureCurrentThread("spinner", spinner_thread_config)) {
+    return 1;
+  }
   ros::AsyncSpinner spinner(4);
   spinner.start();
+  if (!franka_hw::configureCurrentThread("main", initial_thread_config) ||
+      !franka_hw::configureCurrentThread("control_loop", control_loop_thread_config)) {
+    return 1;
+  }
 
   while (ros::ok()) {
     ros::Time last_time = ros::Time::now();
 
-    // Wait until controller has been activated or error has been recovered
+    // Wait until controller has been activated or error has been recovered. Reads the robot state
+    // and updates the controllers at idle_rate only, controller switches, recovery requests and
+    // queued robot commands wake the loop up early. Queued robot commands only run here, between
+    // motions.
+    franka_hw::IdleLoop& idle_loop = franka_control.idleLoop();
+    idle_loop.enter();
     while (!franka_control.controllerActive() || has_error) {
       if (franka_control.connected()) {
         try {
           std::lock_guard<std::mutex> lock(franka_control.robotMutex());
-          franka_control.update(franka_control.robot().readOnce());
+          franka_control.readIdleState();
           ros::Time now = ros::Time::now();
           control_manager.update(now, now - last_time);
           franka_control.checkJointLimits();
           last_time = now;
         } catch (const std::logic_error& e) {
         }
-      } else {
-        std::this_thread::sleep_for(1ms);
       }
 
       if (!ros::ok()) {
         return 0;
       }
+      idle_loop.wait();
     }
+    const franka_hw::IdleLoop::Statistics idle_statistics = idle_loop.leave();
+    ROS_INFO("franka_control_node: Was idle for %.1f s at %.0f Hz with %.1f %% CPU usage and %lu "
+             "state reads.",
+             idle_statistics.duration, idle_loop.rate(), idle_statistics.cpu_usage * 100.0,
+             static_cast<unsigned long>(idle_statistics.reads));
 
     if (franka_control.connected()) {
       try {
@@ -0,0 +1,112 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <controller_manager/controller_manager.h>
+#include <franka/duration.h>
+#include <franka_hw/franka_replay_hw.h>
+#include <ros/ros.h>
+
+using namespace std::chrono_literals;
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "franka_replay_node");
+
+  ros::NodeHandle public_node_handle;
+  ros::NodeHandle node_handle("~");
+
+  franka_hw::FrankaReplayHW franka_replay;
+  if (!franka_replay.init(public_node_handle, node_handle)) {
+    ROS_ERROR("franka_replay_node: Failed to initialize FrankaReplayHW class. Shutting down!");
+    return 1;
+  }
+
+  // Replay speed relative to the recording. 0 replays as fast as possible.
+  double replay_rate = node_handle.param("replay_rate", 1.0);
+  // Time to hold the first recorded state before starting the replay, e.g. to spawn controllers.
+  double start_delay = node_handle.param("start_delay", 2.0);
+  if (replay_rate < 0.0) {
+    ROS_ERROR("franka_replay_node: Invalid replay_rate parameter. Shutting down!");
+    return 1;
+  }
+
+  controller_manager::ControllerManager control_manager(&franka_replay, public_node_handle);
+
+  // Start background threads for message handling
+  ros::AsyncSpinner spinner(4);
+  spinner.start();
+
+  ros::Time last_time = ros::Time::now();
+  ros::Time hold_until = last_time + ros::Duration(start_delay);
+  while (ros::ok() && ros::Time::now() < hold_until) {
+    ros::Time now = ros::Time::now();
+    franka_replay.read(now, now - last_time);
+    control_manager.update(now, now - last_time);
+    franka_replay.write(now, now - last_time);
+    last_time = now;
+    std::this_thread::sleep_for(1ms);
+  }
+
+  ROS_INFO("franka_replay_node: Starting replay with replay_rate %f", replay_rate);
+
+  size_t updates = 0;
+  std::chrono::nanoseconds total_update_time{0};
+  std::chrono::nanoseconds max_update_time{0};
+  size_t slow_updates = 0;
+
+  const franka::Duration first_recorded_time = franka_replay.recordedTime();
+  franka::Duration last_recorded_time = first_recorded_time;
+  const auto start = std::chrono::steady_clock::now();
+  bool reset = true;
+
+  do {
+    franka::Duration recorded_time = franka_replay.recordedTime();
+    if (replay_rate > 0.0) {
+      std::chrono::duration<double> elapsed_recorded_time(
+          (recorded_time - first_recorded_time).toSec() / replay_rate);
+      std::this_thread::sleep_until(
+          start + std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed_recorded_time));
+    }
+
+    ros::Time now = ros::Time::now();
+    ros::Duration period((recorded_time - last_recorded_time).toSec());
+    last_recorded_time = recorded_time;
+
+    const auto update_start = std::chrono::steady_clock::now();
+    franka_replay.read(now, period);
+    if (reset) {
+      // Reset controllers before starting the replay, as before starting a motion
+      control_manager.update(now, ros::Duration(0.0), true);
+      franka_replay.reset();
+      reset = false;
+    } else {
+      control_manager.update(now, period);
+      franka_replay.enforceLimits(period);
+    }
+    franka_replay.write(now, period);
+    franka_replay.captureCommands();
+    const auto update_time = std::chrono::steady_clock::now() - update_start;
+
+    updates++;
+    total_update_time += update_time;
+    max_update_time = std::max<std::chrono::nanoseconds>(max_update_time, update_time);
+    if (update_time > 1ms) {
+      slow_updates++;
+    }
+  } while (ros::ok() && franka_replay.nextState());
+
+  const std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start;
+  const double mean_update_time =
+      updates > 0 ? std::chrono::duration<double, std::micro>(total_update_time).count() / updates
+                  : 0.0;
+  ROS_INFO_STREAM("franka_replay_node: Replayed "
+                  << updates << " states (" << (last_recorded_time - first_recorded_time).toSec()
+                  << " s recorded) in " << wall_time.count() << " s. Update time mean: "
+                  << mean_update_time << " us, max: "
+                  << std::chrono::duration<double, std::micro>(max_update_time).count()
+                  << " us, updates exceeding 1 ms: " << slow_updates);
+
+  return 0;
+}
@@ -3,8 +3,10 @@
 #include <franka_control/franka_state_controller.h>
 
 #include <cmath>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
 #include <string>
 
 #include <franka/errors.h>
@@ -15,9 +17,43 @@
 #include <ros/ros.h>
 #include <tf/tf.h>
 #include <tf/transform_datatypes.h>
+#include <tf2_ros/static_transform_broadcaster.h>
+
+namespace franka_control {
+
+// Sends the /tf_static messages of all FrankaStateControllers of a process.
+class StaticTransformSender {
+ public:
+  void send(const tf2_msgs::TFMessage& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    broadcaster_.sendTransform(message.transforms);
+  }
+
+ private:
+  std::mutex mutex_;
+  tf2_ros::StaticTransformBroadcaster broadcaster_;
+};
+
+}  // namespace franka_control
 
 namespace {
 
+// roscpp latches only the last message of a topic per process, but the combined control node runs
+// one FrankaStateController per arm. Like tf2_ros::StaticTransformBroadcaster, all controllers of
+// a process therefore share one broadcaster, whose messages hold the frames of all arms. The
+// controllers own it, so it is destroyed with the last of them and not after roscpp shut down.
+std::shared_ptr<franka_control::StaticTransformSender> sharedStaticTransformSender() {
+  static std::mutex mutex;
+  static std::weak_ptr<franka_control::StaticTransformSender> shared;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<franka_control::StaticTransformSender> sender = shared.lock();
+  if (!sender) {
+    sender = std::make_shared<franka_control::StaticTransformSender>();
+    shared = sender;
+  }
+  return sender;
+}
+
 tf::Transform convertArrayToTf(const std::array<double, 16>& transform) {
   tf::Matrix3x3 rotation(transform[0], transform[4], transform[8], transform[1], transform[5],
                          transform[9], transform[2], transform[6], transform[10]);
@@ -148,12 +184,94 @@ franka_msgs::Errors errorsToMessage(const franka::Errors& error) {
   return message;
 }
 
+uint8_t robotModeToMessage(franka::RobotMode robot_mode) {
+  switch (robot_mode) {
+    case franka::RobotMode::kOther:
+      return franka_msgs::FrankaState::ROBOT_MODE_OTHER;
+    case franka::RobotMode::kIdle:
+      return franka_msgs::FrankaState::ROBOT_MODE_IDLE;
+    case franka::RobotMode::kMove:
+      return franka_msgs::FrankaState::ROBOT_MODE_MOVE;
+    case franka::RobotMode::kGuiding:
+      return franka_msgs::FrankaState::ROBOT_MODE_GUIDING;
+    case franka::RobotMode::kReflex:
+      return franka_msgs::FrankaState::ROBOT_MODE_REFLEX;
+    case franka::RobotMode::kUserStopped:
+      return franka_msgs::FrankaState::ROBOT_MODE_USER_STOPPED;
+    case franka::RobotMode::kAutomaticErrorRecovery:
+      return franka_msgs::FrankaState::ROBOT_MODE_AUTOMATIC_ERROR_RECOVERY;
+  }
+  return franka_msgs::FrankaState::ROBOT_MODE_OTHER;
+}
+
+// Copies a field of the robot state into the compact message. The arrays of the message keep
+// their capacity, so copying does not allocate after the first message.
+using CompactFieldCopy = void (*)(const franka::RobotState&, franka_msgs::FrankaStateCompact*);
+
+#define FRANKA_STATE_COMPACT_FIELD(field)                                                   \
+  {                                                                                         \
+    #field, [](const franka::RobotState& state, franka_msgs::FrankaStateCompact* message) { \
+      message->field.assign(state.field.cbegin(), state.field.cend());                      \
+    }                                                                                       \
+  }
+
+const std::map<std::string, CompactFieldCopy> kCompactFields = {
+    FRANKA_STATE_COMPACT_FIELD(cartesian_collision),
+    FRANKA_STATE_COMPACT_FIELD(cartesian_contact),
+    FRANKA_STATE_COMPACT_FIELD(q),
+    FRANKA_STATE_COMPACT_FIELD(q_d),
+    FRANKA_STATE_COMPACT_FIELD(dq),
+    FRANKA_STATE_COMPACT_FIELD(dq_d),
+    FRANKA_STATE_COMPACT_FIELD(ddq_d),
+    FRANKA_STATE_COMPACT_FIELD(theta),
+    FRANKA_STATE_COMPACT_FIELD(dtheta),
+    FRANKA_STATE_COMPACT_FIELD(tau_J),
+    FRANKA_STATE_COMPACT_FIELD(dtau_J),
+    FRANKA_STATE_COMPACT_FIELD(tau_J_d),
+    FRANKA_STATE_COMPACT_FIELD(K_F_ext_hat_K),
+    FRANKA_STATE_COMPACT_FIELD(elbow),
+    FRANKA_STATE_COMPACT_FIELD(elbow_d),
+    FRANKA_STATE_COMPACT_FIELD(elbow_c),
+    FRANKA_STATE_COMPACT_FIELD(delbow_c),
+    FRANKA_STATE_COMPACT_FIELD(ddelbow_c),
+    FRANKA_STATE_COMPACT_FIELD(joint_collision),
+    FRANKA_STATE_COMPACT_FIELD(joint_contact),
+    FRANKA_STATE_COMPACT_FIELD(O_F_ext_hat_K),
+    FRANKA_STATE_COMPACT_FIELD(O_dP_EE_d),
+#ifdef ENABLE_BASE_ACCELERATION
+    FRANKA_STATE_COMPACT_FIELD(O_ddP_O),
+#else
+    {"O_ddP_O",
+     [](const franka::RobotState& /*state*/, franka_msgs::FrankaStateCompact* message) {
+       message->O_ddP_O.assign({0.0, 0.0, -9.81});
+     }},
+#endif
+    FRANKA_STATE_COMPACT_FIELD(O_dP_EE_c),
+    FRANKA_STATE_COMPACT_FIELD(O_ddP_EE_c),
+    FRANKA_STATE_COMPACT_FIELD(tau_ext_hat_filtered),
+    FRANKA_STATE_COMPACT_FIELD(F_x_Cee),
+    FRANKA_STATE_COMPACT_FIELD(I_ee),
+    FRANKA_STATE_COMPACT_FIELD(F_x_Cload),
+    FRANKA_STATE_COMPACT_FIELD(I_load),
+    FRANKA_STATE_COMPACT_FIELD(F_x_Ctotal),
+    FRANKA_STATE_COMPACT_FIELD(I_total),
+    FRANKA_STATE_COMPACT_FIELD(O_T_EE),
+    FRANKA_STATE_COMPACT_FIELD(O_T_EE_d),
+    FRANKA_STATE_COMPACT_FIELD(O_T_EE_c),
+    FRANKA_STATE_COMPACT_FIELD(F_T_EE),
+    FRANKA_STATE_COMPACT_FIELD(F_T_NE),
+    FRANKA_STATE_COMPACT_FIELD(NE_T_EE),
+    FRANKA_STATE_COMPACT_FIELD(EE_T_K),
+};
+
+#undef FRANKA_STATE_COMPACT_FIELD
+
 }  // anonymous namespace
 
 namespace franka_control {
 
 bool FrankaStateController::init(hardware_interface::RobotHW* robot_hardware,
-                                 ros::NodeHandle& root_node_handle,
+                                 ros::NodeHandle& /*root_node_handle*/,
                                  ros::NodeHandle& controller_node_handle) {
   franka_state_interface_ = robot_hardware->get<franka_hw::FrankaStateInterface>();
   if (franka_state_interface_ == nullptr) {
@@ -169,7 +287,25 @@ bool FrankaStateController::init(hardware_interface::RobotHW* robot_hardware,
     ROS_INFO_STREAM("FrankaStateController: Did not find publish_rate. Using default "
                     << publish_rate << " [Hz].");
   }
-  trigger_publish_ = franka_hw::TriggerRate(publish_rate);
+  // Every topic is published at publish_rate unless it has its own rate. A rate of 0 disables it.
+  auto init_topic_rate = [&](const std::string& topic, TopicRate* topic_rate) {
+    double rate(publish_rate);
+    controller_node_handle.param(topic + "_rate", rate, publish_rate);
+    if (rate < 0.0) {
+      ROS_ERROR("FrankaStateController: Invalid %s_rate %f", topic.c_str(), rate);
+      return false;
+    }
+    topic_rate->enabled = rate > 0.0;
+    topic_rate->trigger = franka_hw::TriggerRate(topic_rate->enabled ? rate : 1.0);
+    topic_rate->sequence_number = 0;
+    return true;
+  };
+  if (!init_topic_rate("franka_states", &franka_states_rate_) ||
+      !init_topic_rate("joint_states", &joint_states_rate_) ||
+      !init_topic_rate("transforms", &transforms_rate_) ||
+      !init_topic_rate("F_ext", &external_wrench_rate_)) {
+    return false;
+  }
 
   if (!controller_node_handle.getParam("joint_names", joint_names_) ||
       joint_names_.size() != robot_state_.q.size()) {
@@ -187,80 +323,191 @@ bool FrankaStateController::init(hardware_interface::RobotHW* robot_hardware,
     return false;
   }
 
-  publisher_transforms_.init(root_node_handle, "/tf", 1);
-  publisher_franka_states_.init(controller_node_handle, "franka_states", 1);
-  publisher_joint_states_.init(controller_node_handle, "joint_states", 1);
-  publisher_joint_states_desired_.init(controller_node_handle, "joint_states_desired", 1);
-  publisher_external_wrench_.init(controller_node_handle, "F_ext", 1);
-
-  {
-    std::lock_guard<realtime_tools::RealtimePublisher<sensor_msgs::JointState>> lock(
-        publisher_joint_states_);
-    publisher_joint_states_.msg_.name.resize(joint_names_.size());
-    publisher_joint_states_.msg_.position.resize(robot_state_.q.size());
-    publisher_joint_states_.msg_.velocity.resize(robot_state_.dq.size());
-    publisher_joint_states_.msg_.effort.resize(robot_state_.tau_J.size());
-  }
-  {
-    std::lock_guard<realtime_tools::RealtimePublisher<sensor_msgs::JointState>> lock(
-        publisher_joint_states_desired_);
-    publisher_joint_states_desired_.msg_.name.resize(joint_names_.size());
-    publisher_joint_states_desired_.msg_.position.resize(robot_state_.q_d.size());
-    publisher_joint_states_desired_.msg_.velocity.resize(robot_state_.dq_d.size());
-    publisher_joint_states_desired_.msg_.effort.resize(robot_state_.tau_J_d.size());
-  }
-  {
-    std::lock_guard<realtime_tools::RealtimePublisher<tf2_msgs::TFMessage>> lock(
-        publisher_transforms_);
-    publisher_transforms_.msg_.transforms.resize(3);
-    tf::Quaternion quaternion(0.0, 0.0, 0.0, 1.0);
-    tf::Vector3 translation(0.0, 0.0, 0.05);
-    tf::Transform transform(quaternion, translation);
-    tf::StampedTransform stamped_transform(transform, ros::Time::now(), arm_id_ + "_link8",
-                                           arm_id_ + "_NE");
-    geometry_msgs::TransformStamped transform_message;
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[0] = transform_message;
-
-    translation = tf::Vector3(0.0, 0.0, 0.0);
-    transform = tf::Transform(quaternion, translation);
-    stamped_transform =
-        tf::StampedTransform(transform, ros::Time::now(), arm_id_ + "_NE", arm_id_ + "_EE");
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[1] = transform_message;
-
-    stamped_transform =
-        tf::StampedTransform(transform, ros::Time::now(), arm_id_ + "_EE", arm_id_ + "_K");
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[2] = transform_message;
-  }
-  {
-    std::lock_guard<realtime_tools::RealtimePublisher<geometry_msgs::WrenchStamped>> lock(
-        publisher_external_wrench_);
-    publisher_external_wrench_.msg_.header.frame_id = arm_id_ + "_K";
-    publisher_external_wrench_.msg_.wrench.force.x = 0.0;
-    publisher_external_wrench_.msg_.wrench.force.y = 0.0;
-    publisher_external_wrench_.msg_.wrench.force.z = 0.0;
-    publisher_external_wrench_.msg_.wrench.torque.x = 0.0;
-    publisher_external_wrench_.msg_.wrench.torque.y = 0.0;
-    publisher_external_wrench_.msg_.wrench.torque.z = 0.0;
+  std::string state_channel;
+  controller_node_handle.param<std::string>("state_channel", state_channel, "");
+  int state_channel_capacity(1024);
+  controller_node_handle.param("state_channel_capacity", state_channel_capacity, 1024);
+  state_channel_.reset();
+  if (!state_channel.empty()) {
+    if (state_channel_capacity <= 0) {
+      ROS_ERROR("FrankaStateController: Invalid state_channel_capacity %d",
+                state_channel_capacity);
+      return false;
+    }
+    try {
+      state_channel_ = std::make_unique<franka_hw::StateChannelWriter>(
+          state_channel, static_cast<size_t>(state_channel_capacity));
+    } catch (const std::runtime_error& ex) {
+      ROS_ERROR_STREAM("FrankaStateController: " << ex.what());
+      return false;
+    }
+  }
+
+  int batch_size(0);
+  controller_node_handle.param("batch_size", batch_size, 0);
+  if (batch_size < 0) {
+    ROS_ERROR("FrankaStateController: Invalid batch_size %d", batch_size);
+    return false;
+  }
+  batch_size_ = static_cast<size_t>(batch_size);
+
+  std::vector<std::string> franka_state_fields;
+  controller_node_handle.param("franka_state_fields", franka_state_fields, {});
+  compact_fields_.clear();
+  for (const auto& field : franka_state_fields) {
+    auto compact_field = kCompactFields.find(field);
+    if (compact_field == kCompactFields.end()) {
+      ROS_ERROR_STREAM("FrankaStateController: Unknown field " << field
+                                                               << " in franka_state_fields");
+      return false;
+    }
+    compact_fields_.push_back(compact_field->second);
+  }
+
+  if (batch_size_ > 0 && compact_fields_.empty()) {
+    for (const auto& compact_field : kCompactFields) {
+      compact_fields_.push_back(compact_field.second);
+    }
+  }
+
+  int message_pool_size(4);
+  controller_node_handle.param("message_pool_size", message_pool_size, 4);
+  if (message_pool_size <= 0) {
+    ROS_ERROR("FrankaStateController: Invalid message_pool_size %d", message_pool_size);
+    return false;
+  }
+  message_pool_size_ = static_cast<size_t>(message_pool_size);
+
+  if (batch_size_ > 0) {
+    // Filling the batch once reserves all arrays. It is swapped with the states of the pooled
+    // messages, which are copies of it, so update does not allocate.
+    batch_.resize(batch_size_);
+    for (auto& state : batch_) {
+      copyCompactState(robot_state_, ros::Time(0), 0, &state);
+    }
+    batched_states_ = 0;
+    dropped_states_ = 0;
+  }
+
+  publisher_group_ = std::make_unique<franka_hw::PublisherGroup>();
+  publisher_static_transforms_.reset();
+  static_transform_sender_.reset();
+  current_errors_ = ErrorsTopic();
+  last_motion_errors_ = ErrorsTopic();
+  publisher_franka_states_.reset();
+  publisher_franka_states_compact_.reset();
+  publisher_franka_states_batch_.reset();
+  publisher_joint_states_.reset();
+  publisher_joint_states_desired_.reset();
+  publisher_external_wrench_.reset();
+  current_errors_messages_ = 0;
+  last_motion_errors_messages_ = 0;
+  static_transforms_published_ = false;
+
+  if (transforms_rate_.enabled) {
+    static_transform_sender_ = sharedStaticTransformSender();
+    tf2_msgs::TFMessage transforms;
+    transforms.transforms.resize(3);
+    transforms.transforms[0].header.frame_id = arm_id_ + "_link8";
+    transforms.transforms[0].child_frame_id = arm_id_ + "_NE";
+    transforms.transforms[1].header.frame_id = arm_id_ + "_NE";
+    transforms.transforms[1].child_frame_id = arm_id_ + "_EE";
+    transforms.transforms[2].header.frame_id = arm_id_ + "_EE";
+    transforms.transforms[2].child_frame_id = arm_id_ + "_K";
+    publisher_static_transforms_ = publisher_group_->add<tf2_msgs::TFMessage>(
+        "/tf_static",
+        [sender = static_transform_sender_](const tf2_msgs::TFMessage& message) {
+          sender->send(message);
+        },
+        message_pool_size_, transforms);
+  }
+  if (franka_states_rate_.enabled) {
+    current_errors_.publisher = publisher_group_->advertise<franka_msgs::Errors>(
+        controller_node_handle, "current_errors", message_pool_size_, true);
+    last_motion_errors_.publisher = publisher_group_->advertise<franka_msgs::Errors>(
+        controller_node_handle, "last_motion_errors", message_pool_size_, true);
+    // Latch that there are no errors, update publishes the errors once there are any.
+    for (ErrorsTopic* topic : {&current_errors_, &last_motion_errors_}) {
+      if (topic->publisher->next() != nullptr) {
+        topic->publisher->publish();
+      }
+    }
+  }
+  if (batch_size_ > 0) {
+    franka_msgs::FrankaStateBatch batch;
+    batch.states = batch_;
+    publisher_franka_states_batch_ = publisher_group_->advertise(
+        controller_node_handle, "franka_states_batch", message_pool_size_, false, batch);
+  } else if (franka_states_rate_.enabled && compact_fields_.empty()) {
+    publisher_franka_states_ = publisher_group_->advertise<franka_msgs::FrankaState>(
+        controller_node_handle, "franka_states", message_pool_size_);
+  } else if (franka_states_rate_.enabled) {
+    publisher_franka_states_compact_ = publisher_group_->advertise<franka_msgs::FrankaStateCompact>(
+        controller_node_handle, "franka_states_compact", message_pool_size_);
+  }
+  if (joint_states_rate_.enabled) {
+    sensor_msgs::JointState joint_states;
+    joint_states.name = joint_names_;
+    joint_states.position.resize(robot_state_.q.size());
+    joint_states.velocity.resize(robot_state_.dq.size());
+    joint_states.effort.resize(robot_state_.tau_J.size());
+    publisher_joint_states_ = publisher_group_->advertise(
+        controller_node_handle, "joint_states", message_pool_size_, false, joint_states);
+    publisher_joint_states_desired_ = publisher_group_->advertise(
+        controller_node_handle, "joint_states_desired", message_pool_size_, false, joint_states);
+  }
+  if (external_wrench_rate_.enabled) {
+    geometry_msgs::WrenchStamped external_wrench;
+    external_wrench.header.frame_id = arm_id_ + "_K";
+    publisher_external_wrench_ = publisher_group_->advertise(
+        controller_node_handle, "F_ext", message_pool_size_, false, external_wrench);
   }
   return true;
 }
 
-void FrankaStateController::update(const ros::Time& time, const ros::Duration& /* period */) {
-  if (trigger_publish_()) {
-    robot_state_ = franka_state_handle_->getRobotState();
-    publishFrankaStates(time);
+void FrankaStateController::update(const ros::Time& time, const ros::Duration& period) {
+  if (state_channel_) {
+    state_channel_->write(franka_state_handle_->getRobotState());
+  }
+  if (batch_size_ > 0) {
+    batchFrankaState(time);
+  }
+  const bool publish_franka_states = franka_states_rate_(period);
+  const bool publish_joint_states = joint_states_rate_(period);
+  const bool publish_transforms = transforms_rate_(period);
+  const bool publish_external_wrench = external_wrench_rate_(period);
+  if (!publish_franka_states && !publish_joint_states && !publish_transforms &&
+      !publish_external_wrench) {
+    return;
+  }
+
+  robot_state_ = franka_state_handle_->getRobotState();
+  if (publish_franka_states) {
+    if (batch_size_ == 0 && compact_fields_.empty()) {
+      publishFrankaStates(time);
+    } else if (batch_size_ == 0) {
+      publishFrankaStatesCompact(time);
+    }
+    publishErrors(robot_state_.current_errors, &current_errors_);
+    publishErrors(robot_state_.last_motion_errors, &last_motion_errors_);
+    franka_states_rate_.sequence_number++;
+  }
+  if (publish_joint_states) {
+    publishJointStates(time);
+    joint_states_rate_.sequence_number++;
+  }
+  if (publish_transforms) {
     publishTransforms(time);
+    transforms_rate_.sequence_number++;
+  }
+  if (publish_external_wrench) {
     publishExternalWrench(time);
-    publishJointStates(time);
-    sequence_number_++;
+    external_wrench_rate_.sequence_number++;
   }
 }
 
 void FrankaStateController::publishFrankaStates(const ros::Time& time) {
-  if (publisher_franka_states_.trylock()) {
+  if (franka_msgs::FrankaState* message = publisher_franka_states_->next()) {
     static_assert(
         sizeof(robot_state_.cartesian_collision) == sizeof(robot_state_.cartesian_contact),
         "Robot state Cartesian members do not have same size");
@@ -275,13 +522,13 @@ void FrankaStateController::publishFrankaStates(const ros::Time& time) {
     static_assert(sizeof(robot_state_.cartesian_collision) == sizeof(robot_state_.O_ddP_EE_c),
                   "Robot state Cartesian members do not have same size");
     for (size_t i = 0; i < robot_state_.cartesian_collision.size(); i++) {
-      publisher_franka_states_.msg_.cartesian_collision[i] = robot_state_.cartesian_collision[i];
-      publisher_franka_states_.msg_.cartesian_contact[i] = robot_state_.cartesian_contact[i];
-      publisher_franka_states_.msg_.K_F_ext_hat_K[i] = robot_state_.K_F_ext_hat_K[i];
-      publisher_franka_states_.msg_.O_F_ext_hat_K[i] = robot_state_.O_F_ext_hat_K[i];
-      publisher_franka_states_.msg_.O_dP_EE_d[i] = robot_state_.O_dP_EE_d[i];
-      publisher_franka_states_.msg_.O_dP_EE_c[i] = robot_state_.O_dP_EE_c[i];
-      publisher_franka_states_.msg_.O_ddP_EE_c[i] = robot_state_.O_ddP_EE_c[i];
+      message->cartesian_collision[i] = robot_state_.cartesian_collision[i];
+      message->cartesian_contact[i] = robot_state_.cartesian_contact[i];
+      message->K_F_ext_hat_K[i] = robot_state_.K_F_ext_hat_K[i];
+      message->O_F_ext_hat_K[i] = robot_state_.O_F_ext_hat_K[i];
+      message->O_dP_EE_d[i] = robot_state_.O_dP_EE_d[i];
+      message->O_dP_EE_c[i] = robot_state_.O_dP_EE_c[i];
+      message->O_ddP_EE_c[i] = robot_state_.O_ddP_EE_c[i];
     }
 
     static_assert(sizeof(robot_state_.q) == sizeof(robot_state_.q_d),
@@ -309,19 +556,19 @@ void FrankaStateController::publishFrankaStates(const ros::Time& time) {
     static_assert(sizeof(robot_state_.q) == sizeof(robot_state_.tau_ext_hat_filtered),
                   "Robot state joint members do not have same size");
     for (size_t i = 0; i < robot_state_.q.size(); i++) {
-      publisher_franka_states_.msg_.q[i] = robot_state_.q[i];
-      publisher_franka_states_.msg_.q_d[i] = robot_state_.q_d[i];
-      publisher_franka_states_.msg_.dq[i] = robot_state_.dq[i];
-      publisher_franka_states_.msg_.dq_d[i] = robot_state_.dq_d[i];
-      publisher_franka_states_.msg_.ddq_d[i] = robot_state_.ddq_d[i];
-      publisher_franka_states_.msg_.tau_J[i] = robot_state_.tau_J[i];
-      publisher_franka_states_.msg_.dtau_J[i] = robot_state_.dtau_J[i];
-      publisher_franka_states_.msg_.tau_J_d[i] = robot_state_.tau_J_d[i];
-      publisher_franka_states_.msg_.theta[i] = robot_state_.theta[i];
-      publisher_franka_states_.msg_.dtheta[i] = robot_state_.dtheta[i];
-      publisher_franka_states_.msg_.joint_collision[i] = robot_state_.joint_collision[i];
-      publisher_franka_states_.msg_.joint_contact[i] = robot_state_.joint_contact[i];
-      publisher_franka_states_.msg_.tau_ext_hat_filtered[i] = robot_state_.tau_ext_hat_filtered[i];
+      message->q[i] = robot_state_.q[i];
+      message->q_d[i] = robot_state_.q_d[i];
+      message->dq[i] = robot_state_.dq[i];
+      message->dq_d[i] = robot_state_.dq_d[i];
+      message->ddq_d[i] = robot_state_.ddq_d[i];
+      message->tau_J[i] = robot_state_.tau_J[i];
+      message->dtau_J[i] = robot_state_.dtau_J[i];
+      message->tau_J_d[i] = robot_state_.tau_J_d[i];
+      message->theta[i] = robot_state_.theta[i];
+      message->dtheta[i] = robot_state_.dtheta[i];
+      message->joint_collision[i] = robot_state_.joint_collision[i];
+      message->joint_contact[i] = robot_state_.joint_contact[i];
+      message->tau_ext_hat_filtered[i] = robot_state_.tau_ext_hat_filtered[i];
     }
 
     static_assert(sizeof(robot_state_.elbow) == sizeof(robot_state_.elbow_d),
@@ -334,11 +581,11 @@ void FrankaStateController::publishFrankaStates(const ros::Time& time) {
                   "Robot state elbow configuration members do not have same size");
 
     for (size_t i = 0; i < robot_state_.elbow.size(); i++) {
-      publisher_franka_states_.msg_.elbow[i] = robot_state_.elbow[i];
-      publisher_franka_states_.msg_.elbow_d[i] = robot_state_.elbow_d[i];
-      publisher_franka_states_.msg_.elbow_c[i] = robot_state_.elbow_c[i];
-      publisher_franka_states_.msg_.delbow_c[i] = robot_state_.delbow_c[i];
-      publisher_franka_states_.msg_.ddelbow_c[i] = robot_state_.ddelbow_c[i];
+      message->elbow[i] = robot_state_.elbow[i];
+      message->elbow_d[i] = robot_state_.elbow_d[i];
+      message->elbow_c[i] = robot_state_.elbow_c[i];
+      message->delbow_c[i] = robot_state_.delbow_c[i];
+      message->ddelbow_c[i] = robot_state_.ddelbow_c[i];
     }
 
     static_assert(sizeof(robot_state_.O_T_EE) == sizeof(robot_state_.F_T_EE),
@@ -354,147 +601,187 @@ void FrankaStateController::publishFrankaStates(const ros::Time& time) {
     static_assert(sizeof(robot_state_.O_T_EE) == sizeof(robot_state_.O_T_EE_c),
                   "Robot state transforms do not have same size");
     for (size_t i = 0; i < robot_state_.O_T_EE.size(); i++) {
-      publisher_franka_states_.msg_.O_T_EE[i] = robot_state_.O_T_EE[i];
-      publisher_franka_states_.msg_.F_T_EE[i] = robot_state_.F_T_EE[i];
-      publisher_franka_states_.msg_.F_T_NE[i] = robot_state_.F_T_NE[i];
-      publisher_franka_states_.msg_.NE_T_EE[i] = robot_state_.NE_T_EE[i];
-      publisher_franka_states_.msg_.EE_T_K[i] = robot_state_.EE_T_K[i];
-      publisher_franka_states_.msg_.O_T_EE_d[i] = robot_state_.O_T_EE_d[i];
-      publisher_franka_states_.msg_.O_T_EE_c[i] = robot_state_.O_T_EE_c[i];
+      message->O_T_EE[i] = robot_state_.O_T_EE[i];
+      message->F_T_EE[i] = robot_state_.F_T_EE[i];
+      message->F_T_NE[i] = robot_state_.F_T_NE[i];
+      message->NE_T_EE[i] = robot_state_.NE_T_EE[i];
+      message->EE_T_K[i] = robot_state_.EE_T_K[i];
+      message->O_T_EE_d[i] = robot_state_.O_T_EE_d[i];
+      message->O_T_EE_c[i] = robot_state_.O_T_EE_c[i];
     }
-    publisher_franka_states_.msg_.m_ee = robot_state_.m_ee;
-    publisher_franka_states_.msg_.m_load = robot_state_.m_load;
-    publisher_franka_states_.msg_.m_total = robot_state_.m_total;
+    message->m_ee = robot_state_.m_ee;
+    message->m_load = robot_state_.m_load;
+    message->m_total = robot_state_.m_total;
 
     for (size_t i = 0; i < robot_state_.I_load.size(); i++) {
-      publisher_franka_states_.msg_.I_ee[i] = robot_state_.I_ee[i];
-      publisher_franka_states_.msg_.I_load[i] = robot_state_.I_load[i];
-      publisher_franka_states_.msg_.I_total[i] = robot_state_.I_total[i];
+      message->I_ee[i] = robot_state_.I_ee[i];
+      message->I_load[i] = robot_state_.I_load[i];
+      message->I_total[i] = robot_state_.I_total[i];
     }
 
     for (size_t i = 0; i < robot_state_.F_x_Cload.size(); i++) {
-      publisher_franka_states_.msg_.F_x_Cee[i] = robot_state_.F_x_Cee[i];
-      publisher_franka_states_.msg_.F_x_Cload[i] = robot_state_.F_x_Cload[i];
-      publisher_franka_states_.msg_.F_x_Ctotal[i] = robot_state_.F_x_Ctotal[i];
+      message->F_x_Cee[i] = robot_state_.F_x_Cee[i];
+      message->F_x_Cload[i] = robot_state_.F_x_Cload[i];
+      message->F_x_Ctotal[i] = robot_state_.F_x_Ctotal[i];
     }
 #ifdef ENABLE_BASE_ACCELERATION
     for (size_t i = 0; i < robot_state_.O_ddP_O.size(); i++) {
-      publisher_franka_states_.msg_.O_ddP_O[i] = robot_state_.O_ddP_O[i];
+      message->O_ddP_O[i] = robot_state_.O_ddP_O[i];
     }
 #else
-    publisher_franka_states_.msg_.O_ddP_O[2] = -9.81;
+    message->O_ddP_O[2] = -9.81;
 #endif
 
-    publisher_franka_states_.msg_.time = robot_state_.time.toSec();
-    publisher_franka_states_.msg_.control_command_success_rate =
+    message->time = robot_state_.time.toSec();
+    message->control_command_success_rate =
         robot_state_.control_command_success_rate;
-    publisher_franka_states_.msg_.current_errors = errorsToMessage(robot_state_.current_errors);
-    publisher_franka_states_.msg_.last_motion_errors =
-        errorsToMessage(robot_state_.last_motion_errors);
-
-    switch (robot_state_.robot_mode) {
-      case franka::RobotMode::kOther:
-        publisher_franka_states_.msg_.robot_mode = franka_msgs::FrankaState::ROBOT_MODE_OTHER;
-        break;
-
-      case franka::RobotMode::kIdle:
-        publisher_franka_states_.msg_.robot_mode = franka_msgs::FrankaState::ROBOT_MODE_IDLE;
-        break;
-
-      case franka::RobotMode::kMove:
-        publisher_franka_states_.msg_.robot_mode = franka_msgs::FrankaState::ROBOT_MODE_MOVE;
-        break;
-
-      case franka::RobotMode::kGuiding:
-        publisher_franka_states_.msg_.robot_mode = franka_msgs::FrankaState::ROBOT_MODE_GUIDING;
-        break;
-
-      case franka::RobotMode::kReflex:
-        publisher_franka_states_.msg_.robot_mode = franka_msgs::FrankaState::ROBOT_MODE_REFLEX;
-        break;
-
-      case franka::RobotMode::kUserStopped:
-        publisher_franka_states_.msg_.robot_mode =
-            franka_msgs::FrankaState::ROBOT_MODE_USER_STOPPED;
-        break;
-
-      case franka::RobotMode::kAutomaticErrorRecovery:
-        publisher_franka_states_.msg_.robot_mode =
-            franka_msgs::FrankaState::ROBOT_MODE_AUTOMATIC_ERROR_RECOVERY;
-        break;
+    // The pooled message already holds no errors if there were none in the last messages either,
+    // which is the common case.
+    const bool current_errors = static_cast<bool>(robot_state_.current_errors);
+    if (current_errors || current_errors_messages_ > 0) {
+      message->current_errors = errorsToMessage(robot_state_.current_errors);
+      current_errors_messages_ = current_errors ? message_pool_size_ : current_errors_messages_ - 1;
     }
+    const bool last_motion_errors = static_cast<bool>(robot_state_.last_motion_errors);
+    if (last_motion_errors || last_motion_errors_messages_ > 0) {
+      message->last_motion_errors = errorsToMessage(robot_state_.last_motion_errors);
+      last_motion_errors_messages_ =
+          last_motion_errors ? message_pool_size_ : last_motion_errors_messages_ - 1;
+    }
+
+    message->robot_mode = robotModeToMessage(robot_state_.robot_mode);
 
-    publisher_franka_states_.msg_.header.seq = sequence_number_;
-    publisher_franka_states_.msg_.header.stamp = time;
-    publisher_franka_states_.unlockAndPublish();
+    message->header.seq = franka_states_rate_.sequence_number;
+    message->header.stamp = time;
+    publisher_franka_states_->publish();
   }
 }
 
+void FrankaStateController::publishFrankaStatesCompact(const ros::Time& time) {
+  if (franka_msgs::FrankaStateCompact* message = publisher_franka_states_compact_->next()) {
+    copyCompactState(robot_state_, time, franka_states_rate_.sequence_number, message);
+    publisher_franka_states_compact_->publish();
+  }
+}
+
+void FrankaStateController::batchFrankaState(const ros::Time& time) {
+  copyCompactState(franka_state_handle_->getRobotState(), time, state_sequence_number_++,
+                   &batch_[batched_states_]);
+  batched_states_++;
+  if (batched_states_ < batch_size_) {
+    return;
+  }
+  batched_states_ = 0;
+
+  franka_msgs::FrankaStateBatch* message = publisher_franka_states_batch_->next();
+  if (message == nullptr) {
+    dropped_states_ += batch_size_;
+    return;
+  }
+  message->states.swap(batch_);
+  message->dropped_states = dropped_states_;
+  message->header.seq = batch_sequence_number_++;
+  message->header.stamp = time;
+  publisher_franka_states_batch_->publish();
+  dropped_states_ = 0;
+}
+
+void FrankaStateController::copyCompactState(const franka::RobotState& robot_state,
+                                             const ros::Time& time,
+                                             uint64_t sequence_number,
+                                             franka_msgs::FrankaStateCompact* message) const {
+  for (CompactFieldCopy copy : compact_fields_) {
+    copy(robot_state, message);
+  }
+  message->time = robot_state.time.toSec();
+  message->control_command_success_rate = robot_state.control_command_success_rate;
+  message->robot_mode = robotModeToMessage(robot_state.robot_mode);
+  message->has_errors = static_cast<bool>(robot_state.current_errors);
+  message->header.seq = sequence_number;
+  message->header.stamp = time;
+}
+
 void FrankaStateController::publishJointStates(const ros::Time& time) {
-  if (publisher_joint_states_.trylock()) {
+  if (sensor_msgs::JointState* message = publisher_joint_states_->next()) {
     static_assert(sizeof(robot_state_.q) == sizeof(robot_state_.dq),
                   "Robot state joint members do not have same size");
     static_assert(sizeof(robot_state_.q) == sizeof(robot_state_.tau_J),
                   "Robot state joint members do not have same size");
     for (size_t i = 0; i < robot_state_.q.size(); i++) {
-      publisher_joint_states_.msg_.name[i] = joint_names_[i];
-      publisher_joint_states_.msg_.position[i] = robot_state_.q[i];
-      publisher_joint_states_.msg_.velocity[i] = robot_state_.dq[i];
-      publisher_joint_states_.msg_.effort[i] = robot_state_.tau_J[i];
+      message->position[i] = robot_state_.q[i];
+      message->velocity[i] = robot_state_.dq[i];
+      message->effort[i] = robot_state_.tau_J[i];
     }
-    publisher_joint_states_.msg_.header.stamp = time;
-    publisher_joint_states_.msg_.header.seq = sequence_number_;
-    publisher_joint_states_.unlockAndPublish();
+    message->header.stamp = time;
+    message->header.seq = joint_states_rate_.sequence_number;
+    publisher_joint_states_->publish();
   }
-  if (publisher_joint_states_desired_.trylock()) {
+  if (sensor_msgs::JointState* message = publisher_joint_states_desired_->next()) {
     static_assert(sizeof(robot_state_.q_d) == sizeof(robot_state_.dq_d),
                   "Robot state joint members do not have same size");
     static_assert(sizeof(robot_state_.q_d) == sizeof(robot_state_.tau_J_d),
                   "Robot state joint members do not have same size");
     for (size_t i = 0; i < robot_state_.q_d.size(); i++) {
-      publisher_joint_states_desired_.msg_.name[i] = joint_names_[i];
-      publisher_joint_states_desired_.msg_.position[i] = robot_state_.q_d[i];
-      publisher_joint_states_desired_.msg_.velocity[i] = robot_state_.dq_d[i];
-      publisher_joint_states_desired_.msg_.effort[i] = robot_state_.tau_J_d[i];
+      message->position[i] = robot_state_.q_d[i];
+      message->velocity[i] = robot_state_.dq_d[i];
+      message->effort[i] = robot_state_.tau_J_d[i];
     }
-    publisher_joint_states_desired_.msg_.header.stamp = time;
-    publisher_joint_states_desired_.msg_.header.seq = sequence_number_;
-    publisher_joint_states_desired_.unlockAndPublish();
+    message->header.stamp = time;
+    message->header.seq = joint_states_rate_.sequence_number;
+    publisher_joint_states_desired_->publish();
   }
 }
 
 void FrankaStateController::publishTransforms(const ros::Time& time) {
-  if (publisher_transforms_.trylock()) {
-    tf::StampedTransform stamped_transform(convertArrayToTf(robot_state_.F_T_NE), time,
-                                           arm_id_ + "_link8", arm_id_ + "_NE");
-    geometry_msgs::TransformStamped transform_message;
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[0] = transform_message;
-
-    stamped_transform = tf::StampedTransform(convertArrayToTf(robot_state_.NE_T_EE), time,
-                                             arm_id_ + "_NE", arm_id_ + "_EE");
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[1] = transform_message;
-
-    stamped_transform = tf::StampedTransform(convertArrayToTf(robot_state_.EE_T_K), time,
-                                             arm_id_ + "_EE", arm_id_ + "_K");
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[2] = transform_message;
-    publisher_transforms_.unlockAndPublish();
+  // The frames only change with set_EE_frame or set_K_frame, and /tf_static keeps the last
+  // frames of every arm.
+  if (static_transforms_published_ && robot_state_.F_T_NE == published_F_T_NE_ &&
+      robot_state_.NE_T_EE == published_NE_T_EE_ && robot_state_.EE_T_K == published_EE_T_K_) {
+    return;
+  }
+  if (tf2_msgs::TFMessage* message = publisher_static_transforms_->next()) {
+    auto& transforms = message->transforms;
+    tf::transformTFToMsg(convertArrayToTf(robot_state_.F_T_NE), transforms[0].transform);
+    tf::transformTFToMsg(convertArrayToTf(robot_state_.NE_T_EE), transforms[1].transform);
+    tf::transformTFToMsg(convertArrayToTf(robot_state_.EE_T_K), transforms[2].transform);
+    for (auto& transform : transforms) {
+      transform.header.stamp = time;
+    }
+    publisher_static_transforms_->publish();
+    published_F_T_NE_ = robot_state_.F_T_NE;
+    published_NE_T_EE_ = robot_state_.NE_T_EE;
+    published_EE_T_K_ = robot_state_.EE_T_K;
+    static_transforms_published_ = true;
+  }
+}
+
+void FrankaStateController::publishErrors(const franka::Errors& errors, ErrorsTopic* topic) {
+  const bool has_errors = static_cast<bool>(errors);
+  if (!has_errors && topic->latched_no_errors) {
+    return;
+  }
+  const franka_msgs::Errors message = errorsToMessage(errors);
+  if (message == topic->latched) {
+    return;
+  }
+  if (franka_msgs::Errors* latched = topic->publisher->next()) {
+    *latched = message;
+    topic->publisher->publish();
+    topic->latched = message;
+    topic->latched_no_errors = !has_errors;
   }
 }
 
 void FrankaStateController::publishExternalWrench(const ros::Time& time) {
-  if (publisher_external_wrench_.trylock()) {
-    publisher_external_wrench_.msg_.header.frame_id = arm_id_ + "_K";
-    publisher_external_wrench_.msg_.header.stamp = time;
-    publisher_external_wrench_.msg_.wrench.force.x = robot_state_.K_F_ext_hat_K[0];
-    publisher_external_wrench_.msg_.wrench.force.y = robot_state_.K_F_ext_hat_K[1];
-    publisher_external_wrench_.msg_.wrench.force.z = robot_state_.K_F_ext_hat_K[2];
-    publisher_external_wrench_.msg_.wrench.torque.x = robot_state_.K_F_ext_hat_K[3];
-    publisher_external_wrench_.msg_.wrench.torque.y = robot_state_.K_F_ext_hat_K[4];
-    publisher_external_wrench_.msg_.wrench.torque.z = robot_state_.K_F_ext_hat_K[5];
-    publisher_external_wrench_.unlockAndPublish();
+  if (geometry_msgs::WrenchStamped* message = publisher_external_wrench_->next()) {
+    message->header.stamp = time;
+    message->wrench.force.x = robot_state_.K_F_ext_hat_K[0];
+    message->wrench.force.y = robot_state_.K_F_ext_hat_K[1];
+    message->wrench.force.z = robot_state_.K_F_ext_hat_K[2];
+    message->wrench.torque.x = robot_state_.K_F_ext_hat_K[3];
+    message->wrench.torque.y = robot_state_.K_F_ext_hat_K[4];
+    message->wrench.torque.z = robot_state_.K_F_ext_hat_K[5];
+    publisher_external_wrench_->publish();
   }
 }
 
@@ -0,0 +1,616 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_control/multi_rate_controller.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include <Eigen/Geometry>
+#include <hardware_interface/internal/demangle_symbol.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/console.h>
+
+namespace franka_control {
+
+namespace {
+
+template <size_t N>
+void interpolateLinear(const std::array<double, N>& from,
+                       const std::array<double, N>& to,
+                       double alpha,
+                       std::array<double, N>* result) {
+  for (size_t i = 0; i < N; i++) {
+    (*result)[i] = from[i] + alpha * (to[i] - from[i]);
+  }
+}
+
+void interpolatePose(const std::array<double, 16>& from,
+                     const std::array<double, 16>& to,
+                     double alpha,
+                     std::array<double, 16>* result) {
+  Eigen::Map<const Eigen::Matrix4d> from_transform(from.data());
+  Eigen::Map<const Eigen::Matrix4d> to_transform(to.data());
+  Eigen::Quaterniond from_rotation(from_transform.topLeftCorner<3, 3>());
+  Eigen::Quaterniond to_rotation(to_transform.topLeftCorner<3, 3>());
+
+  Eigen::Map<Eigen::Matrix4d> transform(result->data());
+  transform.setIdentity();
+  transform.topLeftCorner<3, 3>() = from_rotation.slerp(alpha, to_rotation).toRotationMatrix();
+  transform.topRightCorner<3, 1>() =
+      from_transform.topRightCorner<3, 1>() +
+      alpha * (to_transform.topRightCorner<3, 1>() - from_transform.topRightCorner<3, 1>());
+}
+
+// Cartesian handles reset the elbow to zeros if a command is set without one, which libfranka does
+// not treat as an elbow command.
+bool hasElbow(const std::array<double, 2>& elbow) {
+  return elbow[1] != 0.0;
+}
+
+void interpolateElbow(const std::array<double, 2>& from,
+                      const std::array<double, 2>& to,
+                      double alpha,
+                      std::array<double, 2>* result) {
+  // The second element is the sign of the flange joint and cannot be interpolated.
+  (*result)[0] = from[0] + alpha * (to[0] - from[0]);
+  (*result)[1] = to[1];
+}
+
+}  // anonymous namespace
+
+std::array<double, 16> MultiRateController::HandleModel::pose(
+    franka::Frame frame,
+    const std::array<double, 7>& q,
+    const std::array<double, 16>& F_T_EE,  // NOLINT(readability-identifier-naming)
+    const std::array<double, 16>& EE_T_K)  // NOLINT(readability-identifier-naming)
+    const {
+  return handle_.getPose(frame, q, F_T_EE, EE_T_K);
+}
+
+std::array<double, 42> MultiRateController::HandleModel::bodyJacobian(
+    franka::Frame frame,
+    const std::array<double, 7>& q,
+    const std::array<double, 16>& F_T_EE,  // NOLINT(readability-identifier-naming)
+    const std::array<double, 16>& EE_T_K)  // NOLINT(readability-identifier-naming)
+    const {
+  return handle_.getBodyJacobian(frame, q, F_T_EE, EE_T_K);
+}
+
+std::array<double, 42> MultiRateController::HandleModel::zeroJacobian(
+    franka::Frame frame,
+    const std::array<double, 7>& q,
+    const std::array<double, 16>& F_T_EE,  // NOLINT(readability-identifier-naming)
+    const std::array<double, 16>& EE_T_K)  // NOLINT(readability-identifier-naming)
+    const {
+  return handle_.getZeroJacobian(frame, q, F_T_EE, EE_T_K);
+}
+
+std::array<double, 49> MultiRateController::HandleModel::mass(
+    const std::array<double, 7>& q,
+    const std::array<double, 9>& I_total,  // NOLINT(readability-identifier-naming)
+    double m_total,
+    const std::array<double, 3>& F_x_Ctotal)  // NOLINT(readability-identifier-naming)
+    const {
+  return handle_.getMass(q, I_total, m_total, F_x_Ctotal);
+}
+
+std::array<double, 7> MultiRateController::HandleModel::coriolis(
+    const std::array<double, 7>& q,
+    const std::array<double, 7>& dq,
+    const std::array<double, 9>& I_total,  // NOLINT(readability-identifier-naming)
+    double m_total,
+    const std::array<double, 3>& F_x_Ctotal)  // NOLINT(readability-identifier-naming)
+    const {
+  return handle_.getCoriolis(q, dq, I_total, m_total, F_x_Ctotal);
+}
+
+std::array<double, 7> MultiRateController::HandleModel::gravity(
+    const std::array<double, 7>& q,
+    double m_total,
+    const std::array<double, 3>& F_x_Ctotal,  // NOLINT(readability-identifier-naming)
+    const std::array<double, 3>& gravity_earth) const {
+  return handle_.getGravity(q, m_total, F_x_Ctotal, gravity_earth);
+}
+
+MultiRateController::~MultiRateController() {
+  if (worker_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shutdown_ = true;
+    }
+    condition_.notify_one();
+    worker_.join();
+  }
+}
+
+bool MultiRateController::initRequest(hardware_interface::RobotHW* robot_hw,
+                                      ros::NodeHandle& root_node_handle,
+                                      ros::NodeHandle& controller_node_handle,
+                                      ClaimedResources& claimed_resources) {
+  if (state_ != CONSTRUCTED) {
+    ROS_ERROR("MultiRateController: Cannot initialize controller that is not in CONSTRUCTED state");
+    return false;
+  }
+  claimed_resources.clear();
+
+  int divisor = 1;
+  if (!controller_node_handle.getParam("divisor", divisor) || divisor < 1) {
+    ROS_ERROR("MultiRateController: Invalid or no divisor parameter provided, aborting "
+              "controller init!");
+    return false;
+  }
+  divisor_ = static_cast<uint32_t>(divisor);
+
+  std::string interpolation;
+  controller_node_handle.param<std::string>("interpolation", interpolation, "linear");
+  if (interpolation == "linear") {
+    interpolation_ = Interpolation::kLinear;
+  } else if (interpolation == "hold") {
+    interpolation_ = Interpolation::kHold;
+  } else {
+    ROS_ERROR_STREAM("MultiRateController: Invalid interpolation " << interpolation
+                                                                   << ", expected linear or hold.");
+    return false;
+  }
+  controller_node_handle.param<bool>("threaded", threaded_, false);
+
+  ros::NodeHandle node_handle(controller_node_handle, "controller");
+  std::string type;
+  if (!node_handle.getParam("type", type)) {
+    ROS_ERROR_STREAM("MultiRateController: Could not get parameter "
+                     << node_handle.getNamespace() << "/type");
+    return false;
+  }
+  try {
+    controller_ = loadController(type);
+  } catch (const pluginlib::PluginlibException& ex) {
+    ROS_ERROR_STREAM("MultiRateController: Could not load controller of type " << type << ": "
+                                                                               << ex.what());
+    return false;
+  }
+
+  proxyStateInterfaces(robot_hw);
+  proxyJointInterface(robot_hw, &proxy_effort_interface_, &effort_slots_);
+  proxyJointInterface(robot_hw, &proxy_position_interface_, &position_slots_);
+  proxyJointInterface(robot_hw, &proxy_velocity_interface_, &velocity_slots_);
+  proxyCartesianInterface(robot_hw, &proxy_pose_interface_, &pose_slots_);
+  proxyCartesianInterface(robot_hw, &proxy_velocity_cartesian_interface_,
+                          &velocity_cartesian_slots_);
+
+  ClaimedResources wrapped_claimed_resources;
+  if (!controller_->initRequest(&proxy_hw_, root_node_handle, node_handle,
+                                wrapped_claimed_resources)) {
+    ROS_ERROR_STREAM("MultiRateController: Failed to initialize controller of type " << type);
+    return false;
+  }
+  if (!claimResources(wrapped_claimed_resources)) {
+    return false;
+  }
+  claimed_resources = wrapped_claimed_resources;
+
+  if (threaded_) {
+    worker_ = std::thread(&MultiRateController::runUpdates, this);
+  }
+  ROS_INFO_STREAM("MultiRateController: Running " << type << " in every " << divisor_
+                                                  << ". control cycle"
+                                                  << (threaded_ ? " on a separate thread." : "."));
+  state_ = INITIALIZED;
+  return true;
+}
+
+std::unique_ptr<controller_interface::ControllerBase> MultiRateController::loadController(
+    const std::string& type) {
+  loader_ = std::make_unique<pluginlib::ClassLoader<controller_interface::ControllerBase>>(
+      "controller_interface", "controller_interface::ControllerBase");
+  return std::unique_ptr<controller_interface::ControllerBase>(
+      loader_->createUnmanagedInstance(type));
+}
+
+void MultiRateController::starting(const ros::Time& time) {
+  // The update thread may still be busy with the last update or stop and use the buffers of the
+  // wrapped controller, so the start is deferred until it is idle.
+  if (threaded_ && worker_busy_) {
+    start_pending_ = true;
+    start_time_ = time;
+    holdRobot();
+    return;
+  }
+  start(time);
+}
+
+void MultiRateController::start(const ros::Time& time) {
+  tick_ = 0;
+  accumulated_period_ = ros::Duration(0.0);
+  overruns_ = 0;
+  takeSnapshot();
+
+  // Start from commands that keep the robot where it is.
+  for (JointSlot& slot : position_slots_) {
+    slot.command = slot.handle.getPosition();
+  }
+  for (JointSlot& slot : velocity_slots_) {
+    slot.command = 0.0;
+  }
+  for (JointSlot& slot : effort_slots_) {
+    slot.command = 0.0;
+  }
+  // The elbow is only commanded once the wrapped controller sets one.
+  for (PoseSlot& slot : pose_slots_) {
+    slot.command = slot.handle.getRobotState().O_T_EE_d;
+    slot.elbow.fill(0.0);
+  }
+  for (VelocitySlot& slot : velocity_cartesian_slots_) {
+    slot.command.fill(0.0);
+    slot.elbow.fill(0.0);
+  }
+  for (std::deque<JointSlot>* slots : {&effort_slots_, &position_slots_, &velocity_slots_}) {
+    for (JointSlot& slot : *slots) {
+      slot.output = slot.command;
+    }
+  }
+  for (PoseSlot& slot : pose_slots_) {
+    slot.output = slot.command;
+    slot.output_elbow = slot.elbow;
+  }
+  for (VelocitySlot& slot : velocity_cartesian_slots_) {
+    slot.output = slot.command;
+    slot.output_elbow = slot.elbow;
+  }
+  retarget();
+
+  controller_->startRequest(time);
+}
+
+void MultiRateController::update(const ros::Time& time, const ros::Duration& period) {
+  if (start_pending_) {
+    if (worker_busy_) {
+      holdRobot();
+      return;
+    }
+    start_pending_ = false;
+    start(start_time_);
+  }
+  accumulated_period_ += period;
+  if (tick_ == 0) {
+    if (!threaded_) {
+      takeSnapshot();
+      controller_->update(time, accumulated_period_);
+      accumulated_period_ = ros::Duration(0.0);
+      retarget();
+    } else if (worker_busy_) {
+      // Keep the last commands and retry in the next cycle.
+      overruns_++;
+      ROS_WARN_THROTTLE(1.0,
+                        "MultiRateController: Controller update took longer than %u control "
+                        "cycles (%zu times since start).",
+                        divisor_, overruns_);
+      interpolate(1.0);
+      return;
+    } else {
+      // Commands computed by the last update become the new target, one update period late.
+      retarget();
+      takeSnapshot();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        update_time_ = time;
+        update_period_ = accumulated_period_;
+        update_pending_ = true;
+        worker_busy_ = true;
+      }
+      condition_.notify_one();
+      accumulated_period_ = ros::Duration(0.0);
+    }
+  }
+  tick_ = (tick_ + 1) % divisor_;
+
+  step_ = std::min(step_ + 1, divisor_);
+  interpolate(interpolation_ == Interpolation::kHold ? 1.0
+                                                     : static_cast<double>(step_) / divisor_);
+}
+
+void MultiRateController::stopping(const ros::Time& time) {
+  if (start_pending_) {
+    // The wrapped controller was never started.
+    start_pending_ = false;
+    return;
+  }
+  // The wrapped controller must not be stopped during an update, so the stop is handed to the
+  // update thread instead of waiting for the update in the control loop.
+  bool handed_over = false;
+  if (threaded_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (worker_busy_) {
+      stop_pending_ = true;
+      stop_time_ = time;
+      handed_over = true;
+    }
+  }
+  if (handed_over) {
+    condition_.notify_one();
+  } else {
+    controller_->stopRequest(time);
+  }
+  if (overruns_ > 0) {
+    ROS_WARN("MultiRateController: Controller update took longer than %u control cycles %zu "
+             "times.",
+             divisor_, overruns_);
+  }
+}
+
+void MultiRateController::holdRobot() {
+  for (JointSlot& slot : position_slots_) {
+    if (slot.claimed) {
+      slot.handle.setCommand(slot.handle.getPosition());
+    }
+  }
+  for (std::deque<JointSlot>* slots : {&velocity_slots_, &effort_slots_}) {
+    for (JointSlot& slot : *slots) {
+      if (slot.claimed) {
+        slot.handle.setCommand(0.0);
+      }
+    }
+  }
+  for (PoseSlot& slot : pose_slots_) {
+    if (slot.claimed) {
+      slot.handle.setCommand(slot.handle.getRobotState().O_T_EE_d);
+    }
+  }
+  for (VelocitySlot& slot : velocity_cartesian_slots_) {
+    if (slot.claimed) {
+      std::array<double, 6> zero{};
+      slot.handle.setCommand(zero);
+    }
+  }
+}
+
+template <typename Interface>
+void MultiRateController::proxyJointInterface(hardware_interface::RobotHW* robot_hw,
+                                              Interface* proxy_interface,
+                                              std::deque<JointSlot>* slots) {
+  auto* interface = robot_hw->get<Interface>();
+  if (interface == nullptr) {
+    return;
+  }
+  for (const std::string& name : interface->getNames()) {
+    // Look up the handle without claiming it. Only the resources the wrapped controller claims
+    // are claimed in claimResources().
+    slots->emplace_back(
+        interface->hardware_interface::ResourceManager<hardware_interface::JointHandle>::getHandle(
+            name));
+    JointSlot& slot = slots->back();
+    proxy_interface->registerHandle(hardware_interface::JointHandle(
+        hardware_interface::JointStateHandle(name, &slot.position, &slot.velocity, &slot.effort),
+        &slot.command));
+  }
+  proxy_hw_.registerInterface(proxy_interface);
+}
+
+template <typename Interface, typename Slot>
+void MultiRateController::proxyCartesianInterface(hardware_interface::RobotHW* robot_hw,
+                                                  Interface* proxy_interface,
+                                                  std::deque<Slot>* slots) {
+  auto* interface = robot_hw->get<Interface>();
+  if (interface == nullptr) {
+    return;
+  }
+  for (const std::string& name : interface->getNames()) {
+    slots->emplace_back(
+        interface
+            ->hardware_interface::ResourceManager<typename Slot::HandleType>::getHandle(name));
+    Slot& slot = slots->back();
+    // Cartesian handles share the robot state with the state handle of the same name.
+    RobotStateSlot& robot_state_slot =
+        robot_state_slots_.emplace(name, RobotStateSlot(slot.handle)).first->second;
+    proxy_interface->registerHandle(typename Slot::HandleType(
+        franka_hw::FrankaStateHandle(name, robot_state_slot.robot_state), slot.command,
+        slot.elbow));
+  }
+  proxy_hw_.registerInterface(proxy_interface);
+}
+
+void MultiRateController::proxyStateInterfaces(hardware_interface::RobotHW* robot_hw) {
+  auto* joint_state_interface = robot_hw->get<hardware_interface::JointStateInterface>();
+  if (joint_state_interface != nullptr) {
+    for (const std::string& name : joint_state_interface->getNames()) {
+      joint_state_slots_.emplace_back(joint_state_interface->getHandle(name));
+      JointStateSlot& slot = joint_state_slots_.back();
+      proxy_joint_state_interface_.registerHandle(
+          hardware_interface::JointStateHandle(name, &slot.position, &slot.velocity, &slot.effort));
+    }
+    proxy_hw_.registerInterface(&proxy_joint_state_interface_);
+  }
+
+  auto* state_interface = robot_hw->get<franka_hw::FrankaStateInterface>();
+  if (state_interface != nullptr) {
+    for (const std::string& name : state_interface->getNames()) {
+      RobotStateSlot& slot =
+          robot_state_slots_.emplace(name, RobotStateSlot(state_interface->getHandle(name)))
+              .first->second;
+      proxy_state_interface_.registerHandle(franka_hw::FrankaStateHandle(name, slot.robot_state));
+    }
+    proxy_hw_.registerInterface(&proxy_state_interface_);
+  }
+
+  auto* model_interface = robot_hw->get<franka_hw::FrankaModelInterface>();
+  if (model_interface != nullptr) {
+    const std::string suffix = "_model";
+    for (const std::string& name : model_interface->getNames()) {
+      // FrankaHW names the model handle of an arm <arm_id>_model and its state <arm_id>_robot.
+      auto robot_state_slot = robot_state_slots_.end();
+      if (name.size() > suffix.size() &&
+          name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        robot_state_slot =
+            robot_state_slots_.find(name.substr(0, name.size() - suffix.size()) + "_robot");
+      }
+      if (robot_state_slot == robot_state_slots_.end()) {
+        ROS_WARN_STREAM("MultiRateController: No robot state found for model handle " << name
+                                                                                      << ".");
+        continue;
+      }
+      models_.emplace_back(model_interface->getHandle(name));
+      proxy_model_interface_.registerHandle(
+          franka_hw::FrankaModelHandle(name, models_.back(), robot_state_slot->second.robot_state));
+    }
+    proxy_hw_.registerInterface(&proxy_model_interface_);
+  }
+}
+
+template <typename Slot>
+bool MultiRateController::claimSlots(const hardware_interface::InterfaceResources& claim,
+                                     std::deque<Slot>* slots) {
+  for (const std::string& resource : claim.resources) {
+    auto slot = std::find_if(slots->begin(), slots->end(), [&resource](const Slot& candidate) {
+      return candidate.handle.getName() == resource;
+    });
+    if (slot == slots->end()) {
+      ROS_ERROR_STREAM("MultiRateController: Wrapped controller claims unknown resource "
+                       << resource << " of interface " << claim.hardware_interface);
+      return false;
+    }
+    slot->claimed = true;
+  }
+  return true;
+}
+
+bool MultiRateController::claimResources(const ClaimedResources& claims) {
+  using hardware_interface::internal::demangledTypeName;
+  for (const hardware_interface::InterfaceResources& claim : claims) {
+    if (claim.resources.empty()) {
+      continue;
+    }
+    const std::string& interface = claim.hardware_interface;
+    bool claimed = false;
+    if (interface == demangledTypeName<hardware_interface::EffortJointInterface>()) {
+      claimed = claimSlots(claim, &effort_slots_);
+    } else if (interface == demangledTypeName<hardware_interface::PositionJointInterface>()) {
+      claimed = claimSlots(claim, &position_slots_);
+    } else if (interface == demangledTypeName<hardware_interface::VelocityJointInterface>()) {
+      claimed = claimSlots(claim, &velocity_slots_);
+    } else if (interface == demangledTypeName<franka_hw::FrankaPoseCartesianInterface>()) {
+      claimed = claimSlots(claim, &pose_slots_);
+    } else if (interface == demangledTypeName<franka_hw::FrankaVelocityCartesianInterface>()) {
+      claimed = claimSlots(claim, &velocity_cartesian_slots_);
+    } else {
+      ROS_ERROR_STREAM("MultiRateController: Wrapped controller claims resources of unsupported "
+                       "interface "
+                       << interface);
+    }
+    if (!claimed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void MultiRateController::takeSnapshot() {
+  for (JointStateSlot& slot : joint_state_slots_) {
+    slot.position = slot.handle.getPosition();
+    slot.velocity = slot.handle.getVelocity();
+    slot.effort = slot.handle.getEffort();
+  }
+  for (std::deque<JointSlot>* slots : {&effort_slots_, &position_slots_, &velocity_slots_}) {
+    for (JointSlot& slot : *slots) {
+      slot.position = slot.handle.getPosition();
+      slot.velocity = slot.handle.getVelocity();
+      slot.effort = slot.handle.getEffort();
+    }
+  }
+  for (auto& robot_state_slot : robot_state_slots_) {
+    robot_state_slot.second.robot_state = robot_state_slot.second.handle.getRobotState();
+  }
+}
+
+void MultiRateController::retarget() {
+  for (std::deque<JointSlot>* slots : {&effort_slots_, &position_slots_, &velocity_slots_}) {
+    for (JointSlot& slot : *slots) {
+      slot.previous = slot.output;
+      slot.target = slot.command;
+    }
+  }
+  for (PoseSlot& slot : pose_slots_) {
+    slot.previous = slot.output;
+    slot.previous_elbow = slot.output_elbow;
+    slot.target = slot.command;
+    slot.target_elbow = slot.elbow;
+  }
+  for (VelocitySlot& slot : velocity_cartesian_slots_) {
+    slot.previous = slot.output;
+    slot.previous_elbow = slot.output_elbow;
+    slot.target = slot.command;
+    slot.target_elbow = slot.elbow;
+  }
+  step_ = 0;
+}
+
+void MultiRateController::interpolate(double alpha) {
+  for (std::deque<JointSlot>* slots : {&effort_slots_, &position_slots_, &velocity_slots_}) {
+    for (JointSlot& slot : *slots) {
+      if (slot.claimed) {
+        slot.output = slot.previous + alpha * (slot.target - slot.previous);
+        slot.handle.setCommand(slot.output);
+      }
+    }
+  }
+  for (PoseSlot& slot : pose_slots_) {
+    if (!slot.claimed) {
+      continue;
+    }
+    if (alpha >= 1.0) {
+      slot.output = slot.target;
+    } else {
+      interpolatePose(slot.previous, slot.target, alpha, &slot.output);
+    }
+    setCartesianCommand(alpha, &slot);
+  }
+  for (VelocitySlot& slot : velocity_cartesian_slots_) {
+    if (slot.claimed) {
+      interpolateLinear(slot.previous, slot.target, alpha, &slot.output);
+      setCartesianCommand(alpha, &slot);
+    }
+  }
+}
+
+template <typename Slot>
+void MultiRateController::setCartesianCommand(double alpha, Slot* slot) {
+  if (!hasElbow(slot->target_elbow)) {
+    slot->output_elbow.fill(0.0);
+    slot->handle.setCommand(slot->output);
+    return;
+  }
+  if (hasElbow(slot->previous_elbow)) {
+    interpolateElbow(slot->previous_elbow, slot->target_elbow, alpha, &slot->output_elbow);
+  } else {
+    slot->output_elbow = slot->target_elbow;
+  }
+  slot->handle.setCommand(slot->output, slot->output_elbow);
+}
+
+void MultiRateController::runUpdates() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this] { return update_pending_ || stop_pending_ || shutdown_; });
+    if (update_pending_) {
+      update_pending_ = false;
+      const ros::Time time = update_time_;
+      const ros::Duration period = update_period_;
+      lock.unlock();
+      controller_->update(time, period);
+      lock.lock();
+    } else if (stop_pending_) {
+      // A stop is only handed over while an update is pending or running, so it follows it.
+      stop_pending_ = false;
+      const ros::Time time = stop_time_;
+      lock.unlock();
+      controller_->stopRequest(time);
+      lock.lock();
+    } else {
+      return;
+    }
+    worker_busy_ = update_pending_ || stop_pending_;
+  }
+}
+
+}  // namespace franka_control
+
+PLUGINLIB_EXPORT_CLASS(franka_control::MultiRateController, controller_interface::ControllerBase)
@@ -0,0 +1,413 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <controller_interface/controller.h>
+#include <franka/robot_state.h>
+#include <franka_hw/franka_cartesian_command_interface.h>
+#include <franka_hw/franka_state_interface.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <ros/ros.h>
+
+#include <franka_control/multi_rate_controller.h>
+
+namespace franka_control {
+
+namespace {
+
+const ros::Duration kPeriod(0.001);
+const std::string kRobotName("panda_robot");
+
+/**
+ * Stands in for FrankaHW with the joint state, joint position, robot state and Cartesian pose
+ * interfaces of one arm.
+ */
+class FakeRobotHW : public hardware_interface::RobotHW {
+ public:
+  FakeRobotHW() {
+    for (size_t i = 0; i < position.size(); i++) {
+      hardware_interface::JointStateHandle joint_state_handle(
+          "panda_joint" + std::to_string(i + 1), &position[i], &velocity[i], &effort[i]);
+      joint_state_interface_.registerHandle(joint_state_handle);
+      position_joint_interface_.registerHandle(
+          hardware_interface::JointHandle(joint_state_handle, &position_command[i]));
+    }
+    franka_hw::FrankaStateHandle state_handle(kRobotName, robot_state);
+    state_interface_.registerHandle(state_handle);
+    pose_cartesian_interface_.registerHandle(
+        franka_hw::FrankaCartesianPoseHandle(state_handle, pose_command, elbow));
+
+    registerInterface(&joint_state_interface_);
+    registerInterface(&position_joint_interface_);
+    registerInterface(&state_interface_);
+    registerInterface(&pose_cartesian_interface_);
+  }
+
+  std::array<double, 7> position{};
+  std::array<double, 7> velocity{};
+  std::array<double, 7> effort{};
+  std::array<double, 7> position_command{};
+  franka::RobotState robot_state;
+  std::array<double, 16> pose_command{};
+  std::array<double, 2> elbow{};
+
+ private:
+  hardware_interface::JointStateInterface joint_state_interface_;
+  hardware_interface::PositionJointInterface position_joint_interface_;
+  franka_hw::FrankaStateInterface state_interface_;
+  franka_hw::FrankaPoseCartesianInterface pose_cartesian_interface_;
+};
+
+/**
+ * Blocks the updates of a wrapped controller while closed, to keep the update thread busy.
+ */
+class Gate {
+ public:
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_ = false;
+  }
+
+  void open() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      open_ = true;
+    }
+    condition_.notify_all();
+  }
+
+  void pass() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return open_; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool open_{true};
+};
+
+/**
+ * Wrapped joint position controller which commands kStep times the number of its updates.
+ */
+class FakeJointController
+    : public controller_interface::Controller<hardware_interface::PositionJointInterface> {
+ public:
+  static constexpr double kStep = 0.4;
+
+  bool init(hardware_interface::PositionJointInterface* interface,
+            ros::NodeHandle& /* node_handle */) override {
+    for (const std::string& name : interface->getNames()) {
+      handles_.push_back(interface->getHandle(name));
+    }
+    return true;
+  }
+
+  void starting(const ros::Time& /* time */) override {
+    stops_before_last_start = stops.load();
+    starts++;
+  }
+
+  void update(const ros::Time& /* time */, const ros::Duration& period) override {
+    updating = true;
+    last_period = period.toSec();
+    const size_t count = ++updates;
+    gate.pass();
+    for (hardware_interface::JointHandle& handle : handles_) {
+      handle.setCommand(kStep * count);
+    }
+    updating = false;
+  }
+
+  void stopping(const ros::Time& /* time */) override {
+    if (updating) {
+      stopped_during_update = true;
+    }
+    stops++;
+  }
+
+  Gate gate;
+  std::atomic<size_t> updates{0};
+  std::atomic<size_t> starts{0};
+  std::atomic<size_t> stops{0};
+  std::atomic<size_t> stops_before_last_start{0};
+  std::atomic<double> last_period{0.0};
+  std::atomic_bool updating{false};
+  std::atomic_bool stopped_during_update{false};
+
+ private:
+  std::vector<hardware_interface::JointHandle> handles_;
+};
+
+constexpr double FakeJointController::kStep;
+
+/**
+ * Wrapped Cartesian pose controller which commands the given poses and elbows in its updates and
+ * keeps the last ones. No elbow is commanded if elbows is empty.
+ */
+class FakePoseController
+    : public controller_interface::Controller<franka_hw::FrankaPoseCartesianInterface> {
+ public:
+  bool init(franka_hw::FrankaPoseCartesianInterface* interface,
+            ros::NodeHandle& /* node_handle */) override {
+    handles_.push_back(interface->getHandle(kRobotName));
+    return true;
+  }
+
+  void update(const ros::Time& /* time */, const ros::Duration& /* period */) override {
+    const size_t pose = std::min(updates_, poses.size() - 1);
+    if (elbows.empty()) {
+      handles_.front().setCommand(poses[pose]);
+    } else {
+      handles_.front().setCommand(poses[pose], elbows[std::min(updates_, elbows.size() - 1)]);
+    }
+    updates_++;
+  }
+
+  std::vector<std::array<double, 16>> poses;
+  std::vector<std::array<double, 2>> elbows;
+
+ private:
+  std::vector<franka_hw::FrankaCartesianPoseHandle> handles_;
+  size_t updates_{0};
+};
+
+/**
+ * MultiRateController wrapping a fake controller instead of loading one with pluginlib.
+ */
+template <typename Controller>
+class TestMultiRateController : public MultiRateController {
+ public:
+  Controller* controller{nullptr};
+
+ protected:
+  std::unique_ptr<controller_interface::ControllerBase> loadController(
+      const std::string& /* type */) override {
+    auto loaded = std::make_unique<Controller>();
+    controller = loaded.get();
+    return loaded;
+  }
+};
+
+std::array<double, 16> translation(double x, double y, double z) {
+  return {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1};
+}
+
+std::array<double, 16> rotationZ(double angle, double x, double y, double z) {
+  const double c = std::cos(angle);
+  const double s = std::sin(angle);
+  return {c, s, 0, 0, -s, c, 0, 0, 0, 0, 1, 0, x, y, z, 1};
+}
+
+}  // anonymous namespace
+
+class MultiRateControllerTest : public ::testing::Test {
+ protected:
+  void TearDown() override { private_nh_.deleteParam("multi_rate_controller"); }
+
+  template <typename Controller>
+  std::unique_ptr<TestMultiRateController<Controller>> makeController(
+      int divisor,
+      const std::string& interpolation,
+      bool threaded) {
+    controller_nh_.setParam("divisor", divisor);
+    controller_nh_.setParam("interpolation", interpolation);
+    controller_nh_.setParam("threaded", threaded);
+    controller_nh_.setParam("controller/type", "FakeController");
+
+    auto multi_rate_controller = std::make_unique<TestMultiRateController<Controller>>();
+    controller_interface::ControllerBase::ClaimedResources claimed_resources;
+    EXPECT_TRUE(multi_rate_controller->initRequest(&robot_hw_, root_nh_, controller_nh_,
+                                                   claimed_resources));
+    return multi_rate_controller;
+  }
+
+  FakeRobotHW robot_hw_;
+  ros::Time time_{1.0};
+  ros::NodeHandle root_nh_;
+  ros::NodeHandle private_nh_{"~"};
+  ros::NodeHandle controller_nh_{private_nh_, "multi_rate_controller"};
+};
+
+TEST_F(MultiRateControllerTest, ReportsClaimsOfWrappedController) {
+  controller_nh_.setParam("divisor", 2);
+  controller_nh_.setParam("controller/type", "FakeController");
+  TestMultiRateController<FakeJointController> multi_rate_controller;
+  controller_interface::ControllerBase::ClaimedResources claimed_resources;
+
+  ASSERT_TRUE(
+      multi_rate_controller.initRequest(&robot_hw_, root_nh_, controller_nh_, claimed_resources));
+
+  ASSERT_EQ(1u, claimed_resources.size());
+  EXPECT_EQ("hardware_interface::PositionJointInterface",
+            claimed_resources.front().hardware_interface);
+  EXPECT_EQ(7u, claimed_resources.front().resources.size());
+}
+
+TEST_F(MultiRateControllerTest, InterpolatesJointCommandsLinearly) {
+  auto multi_rate_controller = makeController<FakeJointController>(4, "linear", false);
+  FakeJointController* controller = multi_rate_controller->controller;
+  ASSERT_TRUE(multi_rate_controller->startRequest(time_));
+
+  for (size_t step = 1; step <= 4; step++) {
+    multi_rate_controller->update(time_, kPeriod);
+    EXPECT_EQ(1u, controller->updates);
+    for (double command : robot_hw_.position_command) {
+      EXPECT_NEAR(FakeJointController::kStep * step / 4, command, 1e-9);
+    }
+  }
+  EXPECT_NEAR(kPeriod.toSec(), controller->last_period, 1e-9);
+
+  multi_rate_controller->update(time_, kPeriod);
+  EXPECT_EQ(2u, controller->updates);
+  EXPECT_NEAR(4 * kPeriod.toSec(), controller->last_period, 1e-9);
+  EXPECT_NEAR(1.25 * FakeJointController::kStep, robot_hw_.position_command[0], 1e-9);
+}
+
+TEST_F(MultiRateControllerTest, InterpolatesPosesWithSlerp) {
+  robot_hw_.robot_state.O_T_EE_d = translation(0.3, 0.0, 0.5);
+  const std::array<double, 16> target = rotationZ(M_PI / 2, 0.5, 0.2, 0.5);
+  auto multi_rate_controller = makeController<FakePoseController>(4, "linear", false);
+  multi_rate_controller->controller->poses = {target};
+  ASSERT_TRUE(multi_rate_controller->startRequest(time_));
+
+  multi_rate_controller->update(time_, kPeriod);
+  multi_rate_controller->update(time_, kPeriod);
+
+  // Halfway, the orientation is rotated by 45 degrees instead of a blend of both matrices.
+  const std::array<double, 16> halfway = rotationZ(M_PI / 4, 0.4, 0.1, 0.5);
+  for (size_t i = 0; i < halfway.size(); i++) {
+    EXPECT_NEAR(halfway[i], robot_hw_.pose_command[i], 1e-9) << "at index " << i;
+  }
+
+  multi_rate_controller->update(time_, kPeriod);
+  multi_rate_controller->update(time_, kPeriod);
+  EXPECT_EQ(target, robot_hw_.pose_command);
+}
+
+TEST_F(MultiRateControllerTest, HoldsCommandsInHoldMode) {
+  auto multi_rate_controller = makeController<FakeJointController>(4, "hold", false);
+  FakeJointController* controller = multi_rate_controller->controller;
+  ASSERT_TRUE(multi_rate_controller->startRequest(time_));
+
+  for (size_t step = 1; step <= 4; step++) {
+    multi_rate_controller->update(time_, kPeriod);
+    EXPECT_EQ(1u, controller->updates);
+    for (double command : robot_hw_.position_command) {
+      EXPECT_DOUBLE_EQ(FakeJointController::kStep, command);
+    }
+  }
+
+  multi_rate_controller->update(time_, kPeriod);
+  EXPECT_EQ(2u, controller->updates);
+  EXPECT_DOUBLE_EQ(2 * FakeJointController::kStep, robot_hw_.position_command[0]);
+}
+
+TEST_F(MultiRateControllerTest, RetriesUpdateAfterOverrun) {
+  auto multi_rate_controller = makeController<FakeJointController>(2, "linear", true);
+  FakeJointController* controller = multi_rate_controller->controller;
+  ASSERT_TRUE(multi_rate_controller->startRequest(time_));
+  controller->gate.close();
+
+  // The first update is handed to the update thread, which is still busy with it two cycles
+  // later.
+  multi_rate_controller->update(time_, kPeriod);
+  multi_rate_controller->update(time_, kPeriod);
+  multi_rate_controller->update(time_, kPeriod);
+  EXPECT_EQ(0.0, robot_hw_.position_command[0]);
+
+  controller->gate.open();
+  while (controller->updates < 2) {
+    multi_rate_controller->update(time_, kPeriod);
+    std::this_thread::yield();
+  }
+
+  // The retried update covers all cycles since the first one, including the overrun.
+  EXPECT_GE(controller->last_period, 3 * kPeriod.toSec() - 1e-9);
+  // The commands of the first update are interpolated from the retry on.
+  EXPECT_GT(robot_hw_.position_command[0], 0.0);
+  EXPECT_LE(robot_hw_.position_command[0], FakeJointController::kStep);
+
+  multi_rate_controller->stopRequest(time_);
+}
+
+TEST_F(MultiRateControllerTest, DefersStartUntilHandedOverStopIsDone) {
+  auto multi_rate_controller = makeController<FakeJointController>(2, "linear", true);
+  FakeJointController* controller = multi_rate_controller->controller;
+  ASSERT_TRUE(multi_rate_controller->startRequest(time_));
+  EXPECT_EQ(1u, controller->starts);
+  controller->gate.close();
+  multi_rate_controller->update(time_, kPeriod);
+
+  // Stopping does not wait for the busy update thread, which stops the controller afterwards.
+  ASSERT_TRUE(multi_rate_controller->stopRequest(time_));
+  EXPECT_EQ(0u, controller->stops);
+
+  // The restart is deferred and the robot is held where it is meanwhile.
+  robot_hw_.position.fill(0.3);
+  ASSERT_TRUE(multi_rate_controller->startRequest(time_));
+  EXPECT_EQ(1u, controller->starts);
+  for (double command : robot_hw_.position_command) {
+    EXPECT_DOUBLE_EQ(0.3, command);
+  }
+  multi_rate_controller->update(time_, kPeriod);
+  EXPECT_EQ(1u, controller->starts);
+
+  controller->gate.open();
+  while (controller->starts < 2) {
+    multi_rate_controller->update(time_, kPeriod);
+    std::this_thread::yield();
+  }
+
+  EXPECT_EQ(1u, controller->stops_before_last_start);
+  EXPECT_FALSE(controller->stopped_during_update);
+
+  multi_rate_controller->stopRequest(time_);
+}
+
+TEST_F(MultiRateControllerTest, CommandsNoElbowUnlessControllerSetsOne) {
+  robot_hw_.robot_state.O_T_EE_d = translation(0.3, 0.0, 0.5);
+  robot_hw_.robot_state.elbow_d = {0.5, 1.0};
+  auto multi_rate_controller = makeController<FakePoseController>(2, "linear", false);
+  multi_rate_controller->controller->poses = {translation(0.4, 0.0, 0.5)};
+  ASSERT_TRUE(multi_rate_controller->startRequest(time_));
+
+  for (size_t cycle = 0; cycle < 4; cycle++) {
+    robot_hw_.elbow = {0.5, 1.0};
+    multi_rate_controller->update(time_, kPeriod);
+    EXPECT_EQ((std::array<double, 2>{}), robot_hw_.elbow);
+  }
+}
+
+TEST_F(MultiRateControllerTest, InterpolatesElbowSetByController) {
+  robot_hw_.robot_state.O_T_EE_d = translation(0.3, 0.0, 0.5);
+  auto multi_rate_controller = makeController<FakePoseController>(2, "linear", false);
+  multi_rate_controller->controller->poses = {translation(0.3, 0.0, 0.5)};
+  multi_rate_controller->controller->elbows = {{0.5, -1.0}, {0.7, -1.0}};
+  ASSERT_TRUE(multi_rate_controller->startRequest(time_));
+
+  // Without a previous elbow, the first one is commanded right away.
+  multi_rate_controller->update(time_, kPeriod);
+  EXPECT_EQ((std::array<double, 2>{0.5, -1.0}), robot_hw_.elbow);
+  multi_rate_controller->update(time_, kPeriod);
+  EXPECT_EQ((std::array<double, 2>{0.5, -1.0}), robot_hw_.elbow);
+
+  multi_rate_controller->update(time_, kPeriod);
+  EXPECT_NEAR(0.6, robot_hw_.elbow[0], 1e-9);
+  EXPECT_EQ(-1.0, robot_hw_.elbow[1]);
+}
+
+}  // namespace franka_control
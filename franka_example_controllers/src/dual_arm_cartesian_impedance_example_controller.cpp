@@ -217,11 +217,11 @@ void DualArmCartesianImpedanceExampleController::starting(const ros::Time& /*tim
 }
 
 void DualArmCartesianImpedanceExampleController::update(const ros::Time& /*time*/,
-                                                        const ros::Duration& /*period*/) {
+                                                        const ros::Duration& period) {
   for (auto& arm_data : arms_data_) {
     updateArm(arm_data.second);
   }
-  if (publish_rate_()) {
+  if (publish_rate_(period)) {
     publishCenteringPose();
   }
 }
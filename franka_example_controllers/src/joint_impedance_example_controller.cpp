@@ -175,7 +175,7 @@ void JointImpedanceExampleController::update(const ros::Time& /*time*/,
     joint_handles_[i].setCommand(tau_d_saturated[i]);
   }
 
-  if (rate_trigger_() && torques_publisher_.trylock()) {
+  if (rate_trigger_(period) && torques_publisher_.trylock()) {
     std::array<double, 7> tau_j = robot_state.tau_J;
     std::array<double, 7> tau_error;
     double error_rms(0.0);
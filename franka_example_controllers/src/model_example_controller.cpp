@@ -68,8 +68,8 @@ bool ModelExampleController::init(hardware_interface::RobotHW* robot_hw,
   return true;
 }
 
-void ModelExampleController::update(const ros::Time& /*time*/, const ros::Duration& /*period*/) {
-  if (rate_trigger_()) {
+void ModelExampleController::update(const ros::Time& /*time*/, const ros::Duration& period) {
+  if (rate_trigger_(period)) {
     std::array<double, 49> mass = model_handle_->getMass();
     std::array<double, 7> coriolis = model_handle_->getCoriolis();
     std::array<double, 7> gravity = model_handle_->getGravity();
@@ -294,7 +294,7 @@ void TeleopJointPDExampleController::update(const ros::Time& /*time*/,
   updateArm(leader_data_);
   updateArm(follower_data_);
 
-  if (debug_ && publish_rate_()) {
+  if (debug_ && publish_rate_(period)) {
     publishLeaderTarget();
     publishFollowerTarget();
     publishLeaderContact();
@@ -101,7 +101,7 @@ void FrankaGripperSim::starting(const ros::Time& /*unused*/) {
 }
 
 void FrankaGripperSim::update(const ros::Time& now, const ros::Duration& period) {
-  if (rate_trigger_() and pub_.trylock()) {
+  if (rate_trigger_(period) and pub_.trylock()) {
     pub_.msg_.header.stamp = now;
     pub_.msg_.position = {this->finger1_.getPosition(), this->finger2_.getPosition()};
     pub_.msg_.velocity = {this->finger1_.getVelocity(), this->finger2_.getVelocity()};
@@ -1,7 +1,7 @@
 // Copyright (c) 2017 Franka Emika GmbH
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #include <functional>
-#include <mutex>
+#include <memory>
 #include <string>
 #include <thread>
 #include <vector>
@@ -13,6 +13,7 @@
 #include <sensor_msgs/JointState.h>
 
 #include <franka/gripper_state.h>
+#include <franka_gripper/GripperState.h>
 #include <franka_gripper/franka_gripper.h>
 
 namespace {
@@ -33,6 +34,26 @@ void handleErrors(actionlib::SimpleActionServer<T_action>* server,
   }
 }
 
+// Time to wait before reading the gripper state again after a failed read [s].
+constexpr double kReadRetryPeriod = 0.1;
+
+// Returns whether a gripper state of the given time is published at publish_rate, publishes every
+// state if publish_rate is not positive. Keeps the phase unless it falls behind by a whole period.
+bool publishDue(double time, double publish_rate, double* next_publish_time) {
+  if (publish_rate <= 0.0) {
+    return true;
+  }
+  if (time < *next_publish_time) {
+    return false;
+  }
+  const double period = 1.0 / publish_rate;
+  *next_publish_time += period;
+  if (*next_publish_time <= time) {
+    *next_publish_time = time + period;
+  }
+  return true;
+}
+
 }  // anonymous namespace
 
 using actionlib::SimpleActionServer;
@@ -142,6 +163,12 @@ int main(int argc, char** argv) {
                     << publish_rate);
   }
 
+  double read_rate(0.0);
+  if (!node_handle.getParam("read_rate", read_rate)) {
+    ROS_INFO_STREAM("franka_gripper_node: Could not find parameter read_rate. Defaulting to "
+                    << read_rate);
+  }
+
   std::vector<std::string> joint_names;
   if (!node_handle.getParam("joint_names", joint_names)) {
     ROS_ERROR("franka_gripper_node: Could not parse joint_names!");
@@ -158,41 +185,78 @@ int main(int argc, char** argv) {
                     << std::boolalpha << stop_at_shutdown);
   }
 
-  franka::GripperState gripper_state;
-  std::mutex gripper_state_mutex;
-  std::thread read_thread([&gripper_state, &gripper, &gripper_state_mutex]() {
-    ros::Rate read_rate(10);
+  ros::Publisher joint_states_publisher =
+      node_handle.advertise<sensor_msgs::JointState>("joint_states", 10);
+  ros::Publisher gripper_state_publisher =
+      node_handle.advertise<franka_gripper::GripperState>("gripper_state", 10);
+
+  // The thread publishes new gripper states right after reading them, at most at publish_rate, so
+  // the messages are only as old as the read itself. Both messages are allocated once.
+  std::thread read_thread([&]() {
+    sensor_msgs::JointState joint_states;
+    joint_states.name = joint_names;
+    joint_states.position.resize(joint_names.size(), 0.0);
+    joint_states.velocity.resize(joint_names.size(), 0.0);
+    // The gripper does not report its force, so the effort stays zero.
+    joint_states.effort.resize(joint_names.size(), 0.0);
+    franka_gripper::GripperState gripper_state_message;
+
+    franka::GripperState gripper_state;
+    franka::GripperState last_gripper_state;
+    bool has_last_gripper_state = false;
+    double next_publish_time = 0.0;
+    std::unique_ptr<ros::Rate> rate;
+    if (read_rate > 0.0) {
+      rate = std::make_unique<ros::Rate>(read_rate);
+    }
+
     while (ros::ok()) {
-      {
-        std::lock_guard<std::mutex> _(gripper_state_mutex);
-        updateGripperState(gripper, &gripper_state);
+      // Without read_rate, readOnce() blocks until the gripper sends its next state.
+      if (rate) {
+        rate->sleep();
+      }
+      if (!updateGripperState(gripper, &gripper_state)) {
+        has_last_gripper_state = false;
+        ros::Duration(kReadRetryPeriod).sleep();
+        continue;
+      }
+      if (has_last_gripper_state && gripper_state.time == last_gripper_state.time) {
+        continue;
       }
-      read_rate.sleep();
+
+      const double width_velocity =
+          has_last_gripper_state && gripper_state.time > last_gripper_state.time
+              ? (gripper_state.width - last_gripper_state.width) /
+                    (gripper_state.time - last_gripper_state.time).toSec()
+              : 0.0;
+      last_gripper_state = gripper_state;
+      has_last_gripper_state = true;
+      if (!publishDue(gripper_state.time.toSec(), publish_rate, &next_publish_time)) {
+        continue;
+      }
+
+      const ros::Time now = ros::Time::now();
+      for (size_t i = 0; i < joint_names.size(); i++) {
+        joint_states.position[i] = gripper_state.width * 0.5;
+        joint_states.velocity[i] = width_velocity * 0.5;
+      }
+      joint_states.header.stamp = now;
+      joint_states_publisher.publish(joint_states);
+
+      gripper_state_message.header.stamp = now;
+      gripper_state_message.width = gripper_state.width;
+      gripper_state_message.max_width = gripper_state.max_width;
+      gripper_state_message.width_velocity = width_velocity;
+      gripper_state_message.is_grasped = static_cast<uint8_t>(gripper_state.is_grasped);
+      gripper_state_message.temperature = gripper_state.temperature;
+      gripper_state_message.time = gripper_state.time.toSec();
+      gripper_state_publisher.publish(gripper_state_message);
     }
   });
 
-  ros::Publisher gripper_state_publisher =
-      node_handle.advertise<sensor_msgs::JointState>("joint_states", 1);
   ros::AsyncSpinner spinner(2);
   spinner.start();
-  ros::Rate rate(publish_rate);
-  while (ros::ok()) {
-    if (gripper_state_mutex.try_lock()) {
-      sensor_msgs::JointState joint_states;
-      joint_states.header.stamp = ros::Time::now();
-      joint_states.name.push_back(joint_names[0]);
-      joint_states.name.push_back(joint_names[1]);
-      joint_states.position.push_back(gripper_state.width * 0.5);
-      joint_states.position.push_back(gripper_state.width * 0.5);
-      joint_states.velocity.push_back(0.0);
-      joint_states.velocity.push_back(0.0);
-      joint_states.effort.push_back(0.0);
-      joint_states.effort.push_back(0.0);
-      gripper_state_publisher.publish(joint_states);
-      gripper_state_mutex.unlock();
-    }
-    rate.sleep();
-  }
+  ros::waitForShutdown();
   read_thread.join();
   if (stop_at_shutdown) {
     gripper.stop();
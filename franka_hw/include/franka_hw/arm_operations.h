@@ -0,0 +1,127 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace franka_hw {
+
+/**
+ * Result of an operation on one arm.
+ */
+struct ArmOperationResult {
+  /** The arm id. */
+  std::string arm_id;
+  /** True if the operation finished without exception in time. */
+  bool success{false};
+  /** True if the operation did not finish in time. */
+  bool timed_out{false};
+  /** True if the operation was not started because the arm was still busy with a previous one. */
+  bool busy{false};
+  /** Error message if the operation failed. */
+  std::string error;
+  /** Time the operation took, the timeout if it did not finish in time [s]. */
+  double duration{0.0};
+};
+
+/**
+ * Runs operations on several arms concurrently, one thread per arm, and waits for all of them.
+ *
+ * An operation that does not finish in time is reported as timed out and keeps running, so a
+ * stalled arm cannot block the results of the others. The arm stays busy until the operation
+ * really finishes, and no other operation is started on it until then. The threads are owned by
+ * this class and joined on destruction, so operations never outlive the objects they use if those
+ * outlive the ArmOperations instance.
+ */
+class ArmOperations {
+ public:
+  /**
+   * Creates an instance of ArmOperations. Threads are only started with run().
+   *
+   * @param[in] arm_ids The ids of the arms, only used for the results.
+   */
+  explicit ArmOperations(std::vector<std::string> arm_ids);
+
+  /**
+   * Waits for all running operations to finish, including timed out ones.
+   */
+  ~ArmOperations();
+
+  ArmOperations(const ArmOperations&) = delete;
+  ArmOperations& operator=(const ArmOperations&) = delete;
+
+  /**
+   * Runs an operation on the given arms and waits for them. Calls are serialized. Failures are
+   * reported by throwing std::exception from the operation.
+   *
+   * @param[in] arms The indices of the arms to run the operation on.
+   * @param[in] operation The operation, called with the index of the arm.
+   * @param[in] timeout Time to wait for all operations to finish [s].
+   *
+   * @return The results, in the order of arms.
+   */
+  std::vector<ArmOperationResult> run(const std::vector<size_t>& arms,
+                                      const std::function<void(size_t)>& operation,
+                                      double timeout);
+
+  /**
+   * Checks whether an operation is still running on an arm, e.g. after it timed out.
+   *
+   * @param[in] arm The index of the arm.
+   *
+   * @return True if busy, false otherwise.
+   */
+  bool busy(size_t arm) const noexcept;
+
+  /**
+   * Checks whether an operation is still running on any arm.
+   *
+   * @return True if busy, false otherwise.
+   */
+  bool anyBusy() const noexcept;
+
+ private:
+  struct Worker {
+    std::thread thread;
+    std::atomic_bool busy{false};
+    // Guarded by mutex_.
+    bool finished{false};
+    bool success{false};
+    std::string error;
+    double duration{0.0};
+  };
+
+  const std::vector<std::string> arm_ids_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable finished_condition_;
+};
+
+/**
+ * Checks whether an operation succeeded on all arms.
+ *
+ * @param[in] results The results of ArmOperations::run().
+ *
+ * @return True if all operations succeeded, false otherwise.
+ */
+bool allSucceeded(const std::vector<ArmOperationResult>& results);
+
+/**
+ * Summarizes the results of an operation for log and service messages, e.g.
+ * "panda_1: ok (0.12 s), panda_2: timed out after 5.00 s".
+ *
+ * @param[in] results The results of ArmOperations::run().
+ *
+ * @return The summary.
+ */
+std::string summarize(const std::vector<ArmOperationResult>& results);
+
+}  // namespace franka_hw
@@ -0,0 +1,77 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace franka_hw {
+
+/**
+ * Flags of up to 64 combined arms, one bit per arm and flag.
+ *
+ * Every arm sets its own bits from its own threads, so checking whether any arm has a flag set is
+ * a single atomic load, independent of the number of arms.
+ */
+class CombinedFlags {
+ public:
+  /**
+   * Maximum number of arms.
+   */
+  static constexpr size_t kMaxArms = 64;
+
+  /**
+   * Flags of an arm.
+   */
+  enum Flag : size_t {
+    /** The arm is in error state. */
+    kError = 0,
+    /** The controllers of the arm need to be reset, e.g. after error recovery. */
+    kNeedsReset,
+    kFlagCount
+  };
+
+  /**
+   * Sets or clears a flag of an arm. Can be called from any thread.
+   *
+   * @param[in] flag The flag.
+   * @param[in] arm Index of the arm, less than kMaxArms.
+   * @param[in] value True to set the flag, false to clear it.
+   */
+  void set(Flag flag, size_t arm, bool value) noexcept;
+
+  /**
+   * Checks whether a flag is set for an arm.
+   *
+   * @param[in] flag The flag.
+   * @param[in] arm Index of the arm, less than kMaxArms.
+   *
+   * @return True if the flag is set, false otherwise.
+   */
+  bool test(Flag flag, size_t arm) const noexcept;
+
+  /**
+   * Checks whether a flag is set for any arm.
+   *
+   * @param[in] flag The flag.
+   *
+   * @return True if the flag is set for at least one arm, false otherwise.
+   */
+  bool any(Flag flag) const noexcept;
+
+  /**
+   * Gets the arms which have a flag set.
+   *
+   * @param[in] flag The flag.
+   *
+   * @return Bitmask of the arms which have the flag set.
+   */
+  uint64_t mask(Flag flag) const noexcept;
+
+ private:
+  std::array<std::atomic<uint64_t>, kFlagCount> masks_{};
+};
+
+}  // namespace franka_hw
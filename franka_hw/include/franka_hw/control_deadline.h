@@ -0,0 +1,261 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <sched.h>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include <franka/control_types.h>
+#include <franka/duration.h>
+#include <franka/robot_state.h>
+
+#include <franka_hw/thread_config.h>
+
+namespace franka_hw {
+
+/**
+ * Enforces a deadline on the ROS-side update of a libfranka control loop.
+ *
+ * The update (reading the robot state, updating the controllers and writing their commands) runs
+ * on a worker thread. In every control cycle, the libfranka callback hands the current robot state
+ * to the worker with cycle() and waits at most for the configured budget. If the update is late,
+ * the callback sends a command derived from the last one instead (see overrunCommand()) while the
+ * update keeps running in the background. A new update is only started once the previous one has
+ * finished, with the period accumulated since the previous update.
+ */
+class ControlDeadline {
+ public:
+  /**
+   * Describes how to derive a command if the update missed its deadline.
+   */
+  enum class OverrunPolicy {
+    /** Repeat the last command. */
+    kHold,
+    /** Continue positions and poses with the last commanded velocity, repeat other commands. */
+    kExtrapolate
+  };
+
+  /**
+   * Parameterization of the deadline.
+   */
+  struct Config {
+    /** Time the control callback waits for the update in every cycle [s]. */
+    double budget{0.0005};
+    /** How to derive a command if the update missed its deadline. */
+    OverrunPolicy overrun_policy{OverrunPolicy::kExtrapolate};
+    /** Number of missed deadlines in a row after which the motion is aborted. */
+    size_t max_consecutive_overruns{20};
+    /** Scheduling of the update thread, by default just below the libfranka control thread. */
+    ThreadConfig thread{{}, ThreadConfig::Policy::kFifo, sched_get_priority_max(SCHED_FIFO) - 1, 0};
+  };
+
+  /**
+   * Outcome of a control cycle.
+   */
+  enum class Result {
+    /** The update finished in time, the commands are up to date. */
+    kUpdated,
+    /** The update missed its deadline, an overrun command has to be sent. */
+    kOverrun,
+    /** The update requested to stop the motion. */
+    kFinished,
+    /** The update missed too many deadlines in a row, the motion has to be aborted. */
+    kAborted
+  };
+
+  /**
+   * Statistics about missed deadlines.
+   */
+  struct Statistics {
+    /** Number of control cycles. */
+    uint64_t cycles{0};
+    /** Number of control cycles in which the update missed its deadline. */
+    uint64_t overruns{0};
+    /** Maximum number of missed deadlines in a row. */
+    uint64_t max_consecutive_overruns{0};
+    /** Maximum duration of an update [s]. */
+    double max_update_duration{0.0};
+  };
+
+  /**
+   * The update to run on the worker thread. Receives the robot state and the time since the last
+   * update and returns false to stop the motion.
+   */
+  using Update = std::function<bool(const franka::RobotState&, franka::Duration)>;
+
+  /**
+   * Creates an instance of ControlDeadline. The worker thread is only started with start().
+   *
+   * @param[in] config The parameterization of the deadline.
+   */
+  explicit ControlDeadline(const Config& config);
+
+  /**
+   * Waits for a running update to finish and stops the worker thread.
+   */
+  ~ControlDeadline();
+
+  ControlDeadline(const ControlDeadline&) = delete;
+  ControlDeadline& operator=(const ControlDeadline&) = delete;
+
+  /**
+   * Starts the worker thread for a new motion.
+   *
+   * @param[in] update The update to run in every control cycle.
+   *
+   * @return False if the worker thread could not be configured as requested. It is not running
+   * then.
+   */
+  bool start(Update update);
+
+  /**
+   * Waits for a running update to finish and stops the worker thread.
+   */
+  void stop();
+
+  /**
+   * Checks whether the worker thread is running.
+   *
+   * @return True if started, false otherwise.
+   */
+  bool running() const noexcept;
+
+  /**
+   * Starts an update for the given robot state if the previous one has finished and waits until
+   * it is done or the budget is exhausted. Repeated calls with the same robot state, as happens
+   * when libfranka calls a control and a motion generator callback in the same cycle, return the
+   * result of the first call without waiting again.
+   *
+   * @param[in] robot_state The robot state received in the current control cycle.
+   * @param[in] time_step Time since the last control cycle.
+   *
+   * @return The outcome of the control cycle.
+   */
+  Result cycle(const franka::RobotState& robot_state, franka::Duration time_step);
+
+  /**
+   * Gets the parameterization of the deadline.
+   *
+   * @return The parameterization.
+   */
+  const Config& config() const noexcept;
+
+  /**
+   * Gets the statistics about missed deadlines.
+   *
+   * @return The statistics since the last call to resetStatistics().
+   */
+  Statistics statistics();
+
+  /**
+   * Resets the statistics about missed deadlines.
+   */
+  void resetStatistics();
+
+ private:
+  void run(std::promise<bool> configured);
+
+  const Config config_;
+  Update update_;
+  std::thread worker_;
+
+  std::mutex mutex_;
+  std::condition_variable update_requested_;
+  std::condition_variable update_finished_;
+  bool stopping_{false};
+  bool busy_{false};
+  bool continue_motion_{true};
+  franka::RobotState robot_state_;
+  franka::Duration update_period_;
+
+  // Only accessed by the control thread.
+  bool first_cycle_{true};
+  franka::Duration last_cycle_time_;
+  franka::Duration accumulated_period_;
+  Result last_result_{Result::kUpdated};
+  size_t consecutive_overruns_{0};
+
+  Statistics statistics_;
+};
+
+/**
+ * Reconstructs the last command the robot received from its state. Used before the first update
+ * of a motion has finished. Cartesian poses are reconstructed without elbow.
+ *
+ * @param[in] robot_state The current robot state.
+ *
+ * @return The last command of type T.
+ */
+template <typename T>
+T commandFromState(const franka::RobotState& robot_state);
+
+template <>
+franka::Torques commandFromState<franka::Torques>(const franka::RobotState& robot_state);
+template <>
+franka::JointPositions commandFromState<franka::JointPositions>(
+    const franka::RobotState& robot_state);
+template <>
+franka::JointVelocities commandFromState<franka::JointVelocities>(
+    const franka::RobotState& robot_state);
+template <>
+franka::CartesianPose commandFromState<franka::CartesianPose>(
+    const franka::RobotState& robot_state);
+template <>
+franka::CartesianVelocities commandFromState<franka::CartesianVelocities>(
+    const franka::RobotState& robot_state);
+
+/**
+ * Derives the command to send if the update missed its deadline. Velocity commands and torques
+ * are always held. Joint positions and Cartesian poses are held or continued with the commanded
+ * velocity reported in the robot state, depending on the policy. The resulting jump in
+ * acceleration is smoothed by the libfranka rate limiter, so keep rate_limiting enabled.
+ *
+ * @param[in] last_command The command sent in the previous control cycle.
+ * @param[in] robot_state The current robot state.
+ * @param[in] policy How to derive the command.
+ *
+ * @return The command to send in the current control cycle.
+ */
+franka::Torques overrunCommand(const franka::Torques& last_command,
+                               const franka::RobotState& robot_state,
+                               ControlDeadline::OverrunPolicy policy);
+
+/**
+ * @copydoc overrunCommand(const franka::Torques&, const franka::RobotState&,
+ * ControlDeadline::OverrunPolicy)
+ */
+franka::JointPositions overrunCommand(const franka::JointPositions& last_command,
+                                      const franka::RobotState& robot_state,
+                                      ControlDeadline::OverrunPolicy policy);
+
+/**
+ * @copydoc overrunCommand(const franka::Torques&, const franka::RobotState&,
+ * ControlDeadline::OverrunPolicy)
+ */
+franka::JointVelocities overrunCommand(const franka::JointVelocities& last_command,
+                                       const franka::RobotState& robot_state,
+                                       ControlDeadline::OverrunPolicy policy);
+
+/**
+ * @copydoc overrunCommand(const franka::Torques&, const franka::RobotState&,
+ * ControlDeadline::OverrunPolicy)
+ */
+franka::CartesianPose overrunCommand(const franka::CartesianPose& last_command,
+                                     const franka::RobotState& robot_state,
+                                     ControlDeadline::OverrunPolicy policy);
+
+/**
+ * @copydoc overrunCommand(const franka::Torques&, const franka::RobotState&,
+ * ControlDeadline::OverrunPolicy)
+ */
+franka::CartesianVelocities overrunCommand(const franka::CartesianVelocities& last_command,
+                                           const franka::RobotState& robot_state,
+                                           ControlDeadline::OverrunPolicy policy);
+
+}  // namespace franka_hw
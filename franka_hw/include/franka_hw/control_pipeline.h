@@ -0,0 +1,198 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <sched.h>
+#include <semaphore.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <thread>
+#include <tuple>
+
+#include <franka/control_types.h>
+#include <franka/duration.h>
+#include <franka/robot_state.h>
+
+#include <franka_hw/control_deadline.h>
+#include <franka_hw/thread_config.h>
+#include <franka_hw/triple_buffer.h>
+
+namespace franka_hw {
+
+/**
+ * Runs the ROS-side update of a libfranka control loop on a separate thread, pipelined one cycle
+ * ahead of the control callback.
+ *
+ * In every control cycle, the libfranka callback fetches the commands that the update computed
+ * from the robot state of the previous cycle and publishes the current robot state for the next
+ * update with cycle(). Both directions use a TripleBuffer, so the callback never waits for the
+ * update. Heavy updates can therefore take up to a full cycle at the cost of one cycle of latency.
+ * If no new commands are available, the pipeline stalls and the callback sends a command derived
+ * from the last one (see overrunCommand()).
+ *
+ * The update thread sleeps on a semaphore until the callback publishes a new robot state, so it
+ * does not take CPU time from other threads between updates. Posting the semaphore never blocks
+ * the callback.
+ */
+class ControlPipeline {
+ public:
+  /**
+   * The commands of all control modes computed by an update.
+   */
+  using Commands = std::tuple<franka::Torques,
+                              franka::JointPositions,
+                              franka::JointVelocities,
+                              franka::CartesianPose,
+                              franka::CartesianVelocities>;
+
+  /**
+   * Parameterization of the pipeline.
+   */
+  struct Config {
+    /** How to derive a command if the pipeline stalls. */
+    ControlDeadline::OverrunPolicy stall_policy{ControlDeadline::OverrunPolicy::kExtrapolate};
+    /** Number of stalls in a row after which the motion is aborted. */
+    size_t max_consecutive_stalls{20};
+    /** Scheduling of the update thread, by default just below the libfranka control thread. */
+    ThreadConfig thread{{}, ThreadConfig::Policy::kFifo, sched_get_priority_max(SCHED_FIFO) - 1, 0};
+  };
+
+  /**
+   * Outcome of a control cycle.
+   */
+  enum class Result {
+    /** New commands are available. */
+    kUpdated,
+    /** No new commands are available, a stall command has to be sent. */
+    kStalled,
+    /** The update requested to stop the motion. */
+    kFinished,
+    /** The pipeline stalled too many times in a row, the motion has to be aborted. */
+    kAborted
+  };
+
+  /**
+   * Statistics about the pipeline.
+   */
+  struct Statistics {
+    /** Number of control cycles. */
+    uint64_t cycles{0};
+    /** Number of control cycles without new commands. */
+    uint64_t stalls{0};
+    /** Maximum number of stalls in a row. */
+    uint64_t max_consecutive_stalls{0};
+    /** Maximum duration of an update [s]. */
+    double max_update_duration{0.0};
+  };
+
+  /**
+   * The update to run on the pipeline thread. Receives the robot state and the time since the
+   * last update, writes its commands and returns false to stop the motion.
+   */
+  using Update =
+      std::function<bool(const franka::RobotState&, franka::Duration, Commands* commands)>;
+
+  /**
+   * Creates an instance of ControlPipeline. The update thread is only started with start().
+   *
+   * @param[in] config The parameterization of the pipeline.
+   * @param[in] initial_commands Commands to fill the buffers with.
+   */
+  ControlPipeline(const Config& config, const Commands& initial_commands);
+
+  /**
+   * Waits for a running update to finish and stops the update thread.
+   */
+  ~ControlPipeline();
+
+  ControlPipeline(const ControlPipeline&) = delete;
+  ControlPipeline& operator=(const ControlPipeline&) = delete;
+
+  /**
+   * Starts the update thread for a new motion.
+   *
+   * @param[in] update The update to run in every control cycle.
+   *
+   * @return False if the update thread could not be configured as requested. It is not running
+   * then.
+   */
+  bool start(Update update);
+
+  /**
+   * Waits for a running update to finish and stops the update thread.
+   */
+  void stop();
+
+  /**
+   * Checks whether the update thread is running.
+   *
+   * @return True if started, false otherwise.
+   */
+  bool running() const noexcept;
+
+  /**
+   * Fetches the latest commands and publishes the given robot state for the next update. Repeated
+   * calls with the same robot state, as happens when libfranka calls a control and a motion
+   * generator callback in the same cycle, return the result of the first call.
+   *
+   * @param[in] robot_state The robot state received in the current control cycle.
+   * @param[out] commands The latest commands, valid until the next call.
+   *
+   * @return The outcome of the control cycle.
+   */
+  Result cycle(const franka::RobotState& robot_state, const Commands** commands);
+
+  /**
+   * Gets the parameterization of the pipeline.
+   *
+   * @return The parameterization.
+   */
+  const Config& config() const noexcept;
+
+  /**
+   * Gets the statistics about the pipeline.
+   *
+   * @return The statistics since the last call to resetStatistics().
+   */
+  Statistics statistics() const noexcept;
+
+  /**
+   * Resets the statistics about the pipeline.
+   */
+  void resetStatistics() noexcept;
+
+ private:
+  struct CommandSlot {
+    Commands commands;
+    bool continue_motion;
+  };
+
+  void run(std::promise<bool> configured);
+
+  const Config config_;
+  Update update_;
+  std::thread worker_;
+  std::atomic_bool stopping_{false};
+  // Posted for every published robot state and to stop the update thread.
+  sem_t wakeup_;
+
+  TripleBuffer<franka::RobotState> states_;
+  TripleBuffer<CommandSlot> commands_;
+
+  // Only accessed by the control thread.
+  bool first_cycle_{true};
+  franka::Duration last_cycle_time_;
+  bool finished_{false};
+  Result last_result_{Result::kStalled};
+  size_t consecutive_stalls_{0};
+
+  std::atomic<uint64_t> cycles_{0};
+  std::atomic<uint64_t> stalls_{0};
+  std::atomic<uint64_t> max_consecutive_stalls_{0};
+  std::atomic<uint64_t> max_update_duration_ns_{0};
+};
+
+}  // namespace franka_hw
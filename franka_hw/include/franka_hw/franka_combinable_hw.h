@@ -4,6 +4,7 @@
 
 #include <atomic>
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
 #include <thread>
@@ -12,8 +13,11 @@
 #include <franka/robot_state.h>
 
 #include <actionlib/server/simple_action_server.h>
+#include <franka_hw/combined_flags.h>
 #include <franka_hw/franka_hw.h>
+#include <franka_hw/state_barrier.h>
 #include <franka_hw/services.h>
+#include <franka_hw/thread_config.h>
 #include <franka_msgs/ErrorRecoveryAction.h>
 #include <ros/ros.h>
 
@@ -110,6 +114,14 @@ class FrankaCombinableHW : public FrankaHW {
    */
   void write(const ros::Time& /*time*/, const ros::Duration& period) override;
 
+  /**
+   * Updates the controller interfaces and the state seen by libfranka callbacks from the given
+   * robot state, and signals it to the state barrier of the combined arms.
+   *
+   * @param[in] robot_state Current robot state.
+   */
+  void update(const franka::RobotState& robot_state) override;
+
   /**
    * Getter method for the arm_id which is used to distinguish between multiple
    * instances of FrankaCombinableHW.
@@ -143,7 +155,33 @@ class FrankaCombinableHW : public FrankaHW {
    */
   bool controllerNeedsReset() const noexcept;
 
- private:
+  /**
+   * Mirrors the error and controller reset flags of this arm into flags shared with other arms.
+   *
+   * @param[in] flags The shared flags, nullptr to detach. Must stay valid until detached.
+   * @param[in] arm Index of this arm in the shared flags.
+   */
+  void attachCombinedFlags(CombinedFlags* flags, size_t arm);
+
+  /**
+   * Signals every new robot state of this arm to a barrier shared with other arms.
+   *
+   * @param[in] barrier The barrier, nullptr to detach. Must stay valid until detached.
+   * @param[in] arm Index of this arm in the barrier.
+   */
+  void attachStateBarrier(StateBarrier* barrier, size_t arm);
+
+ protected:
+  /**
+   * Callback for the libfranka control loop, sending the last command written by the controllers.
+   *
+   * @param[in] command The datafield containing the command to send to the robot.
+   * @param[in] robot_state The current robot state.
+   * @param[in] time_step Time since last call to the callback.
+   * @throw std::invalid_argument When a command contains NaN values.
+   *
+   * @return The command to be sent to the robot via libfranka.
+   */
   template <typename T>
   T libfrankaUpdateCallback(const T& command,
                             const franka::RobotState& robot_state,
@@ -158,8 +196,10 @@ class FrankaCombinableHW : public FrankaHW {
       std::lock_guard<std::mutex> state_lock(libfranka_state_mutex_);
       robot_state_libfranka_ = robot_state;
     }
+    signalState(robot_state);
 
     std::lock_guard<std::mutex> command_lock(libfranka_cmd_mutex_);
+    logState(robot_state);
     T current_cmd = command;
     if (has_error_ || !controller_active_) {
       return franka::MotionFinished(current_cmd);
@@ -167,20 +207,44 @@ class FrankaCombinableHW : public FrankaHW {
     return current_cmd;
   }
 
-  void publishErrorState(bool error);
-
+  /**
+   * Sets up the robot configuration services and the error recovery action server once.
+   *
+   * @param[in] node_handle The NodeHandle in the namespace at which to advertise them.
+   */
   void setupServicesAndActionServers(ros::NodeHandle& node_handle);
 
+  /**
+   * Connects to the robot and starts the control loop thread.
+   *
+   * @throw std::runtime_error if the control loop thread cannot be configured.
+   */
   void initRobot() override;
 
-  bool setRunFunction(const ControlMode& requested_control_mode,
-                      bool limit_rate,
-                      double cutoff_frequency,
-                      franka::ControllerMode internal_controller) override;
+  /**
+   * Starts the thread running the idle and control loops of this arm.
+   *
+   * @throw std::runtime_error if the thread cannot be configured.
+   */
+  void startControlLoop();
 
-  void controlLoop();
+  ros::NodeHandle robot_hw_nh_;
+
+ private:
+  void publishErrorState(bool error);
+
+  void setError(bool error);
+
+  void setControllerNeedsReset(bool needs_reset);
+
+  void signalState(const franka::RobotState& robot_state);
+
+  void initRunFunctions() override;
+
+  void controlLoop(std::promise<bool> configured);
 
   std::unique_ptr<std::thread> control_loop_thread_;
+  ThreadConfig control_loop_thread_config_;
   std::unique_ptr<ServiceContainer> services_;
   std::unique_ptr<actionlib::SimpleActionServer<franka_msgs::ErrorRecoveryAction>>
       recovery_action_server_;
@@ -188,7 +252,10 @@ class FrankaCombinableHW : public FrankaHW {
   ros::Publisher has_error_pub_;
   std::atomic_bool error_recovered_{false};
   std::atomic_bool controller_needs_reset_{false};
-  ros::NodeHandle robot_hw_nh_;
+  std::atomic<CombinedFlags*> combined_flags_{nullptr};
+  size_t combined_arm_{0};
+  std::atomic<StateBarrier*> state_barrier_{nullptr};
+  size_t state_barrier_arm_{0};
 };
 
 }  // namespace franka_hw
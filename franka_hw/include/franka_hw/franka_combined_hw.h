@@ -3,14 +3,24 @@
 #pragma once
 
 #include <combined_robot_hw/combined_robot_hw.h>
+#include <franka_hw/arm_operations.h>
+#include <franka_hw/combined_flags.h>
 #include <franka_hw/franka_combinable_hw.h>
+#include <franka_hw/state_barrier.h>
 #include <franka_msgs/ErrorRecoveryAction.h>
 
 #include <actionlib/server/simple_action_server.h>
 #include <ros/node_handle.h>
+#include <ros/publisher.h>
 #include <ros/time.h>
+#include <ros/timer.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace franka_hw {
 
@@ -21,7 +31,7 @@ class FrankaCombinedHW : public combined_robot_hw::CombinedRobotHW {
    */
   FrankaCombinedHW();
 
-  ~FrankaCombinedHW() override = default;  // NOLINT (clang-analyzer-optin.cplusplus.VirtualCall)
+  ~FrankaCombinedHW() override;  // NOLINT (clang-analyzer-optin.cplusplus.VirtualCall)
 
   /**
    * The init function is called to initialize the CombinedFrankaHW from a
@@ -43,29 +53,51 @@ class FrankaCombinedHW : public combined_robot_hw::CombinedRobotHW {
   void read(const ros::Time& time, const ros::Duration& period) override;
 
   /**
-   * Checks whether the controller needs to be reset.
+   * Checks whether the controller needs to be reset. Constant time in the number of arms.
    *
    * @return True if the controllers needs to be reset, false otherwise.
    */
   bool controllerNeedsReset();
 
   /**
-   * Calls connect on all hardware classes that are of type `FrankaCombinableHW`.
+   * Connects all disconnected robots concurrently.
+   *
+   * @throw std::runtime_error if a robot cannot be connected within arm_operation_timeout or is
+   * still busy with an operation that timed out before.
    */
   void connect();
 
   /**
-   * Tries to disconnect on all hardware classes that are of type `FrankaCombinableHW`.
+   * Tries to disconnect all robots concurrently. Fails right away if a controller is running.
    * @return true if successful, false otherwise.
    */
   bool disconnect();
 
   /**
-   * Checks whether the robots are in error or reflex mode.
+   * Checks whether the robots are in error or reflex mode. Constant time in the number of arms.
    * @return true if in error state, false otherwise.
    */
   bool hasError();
 
+  /**
+   * Waits until every arm received a new robot state since the last call, so the controllers are
+   * updated in phase with the robots instead of with the wall clock. Only waits while controllers
+   * are running on all arms and synchronize_arms is enabled.
+   *
+   * @param[out] period Robot time passed since the last call. Unchanged if it is not known.
+   *
+   * @return True if the call waited for the robot states, even if it timed out after
+   * synchronization_timeout. False if the caller has to pace the control loop itself.
+   */
+  bool waitForStates(ros::Duration* period);
+
+  /**
+   * Gets the statistics of the synchronization with the robot states.
+   *
+   * @return The statistics, empty if synchronize_arms is disabled.
+   */
+  StateBarrier::Statistics synchronizationStatistics() const;
+
  protected:
   std::unique_ptr<actionlib::SimpleActionServer<franka_msgs::ErrorRecoveryAction>>
       combined_recovery_action_server_;
@@ -75,7 +107,22 @@ class FrankaCombinedHW : public combined_robot_hw::CombinedRobotHW {
  private:
   void handleError();
   void triggerError();
-  bool is_recovering_{false};
+  void recoverErrors();
+  std::vector<size_t> allArms() const;
+  // Number of arms whose error recovery is still running, possibly after it timed out.
+  std::atomic<size_t> recovering_arms_{0};
+  // Resolved once in init, in the order of robot_hw_list_.
+  std::vector<FrankaCombinableHW*> franka_hws_;
+  std::vector<std::string> arm_ids_;
+  double arm_operation_timeout_{10.0};
+  // Uses franka_hws_, so it is destroyed, i.e. joined, first.
+  std::unique_ptr<ArmOperations> arm_operations_;
+  CombinedFlags flags_;
+  uint64_t all_arms_{0};
+  std::unique_ptr<StateBarrier> state_barrier_;
+  std::chrono::steady_clock::duration synchronization_timeout_{std::chrono::microseconds(2000)};
+  ros::Publisher synchronization_publisher_;
+  ros::Timer synchronization_timer_;
 };
 
 }  // namespace franka_hw
@@ -4,13 +4,19 @@
 
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <exception>
 #include <functional>
+#include <limits>
 #include <list>
+#include <map>
+#include <memory>
 #include <string>
+#include <tuple>
 
 #include <franka/control_types.h>
 #include <franka/duration.h>
+#include <franka/exception.h>
 #include <franka/rate_limiting.h>
 #include <franka/robot.h>
 #include <franka/robot_state.h>
@@ -19,15 +25,23 @@
 #include <hardware_interface/robot_hw.h>
 #include <joint_limits_interface/joint_limits_interface.h>
 #include <joint_limits_interface/joint_limits_urdf.h>
+#include <ros/publisher.h>
 #include <ros/time.h>
 #include <urdf/model.h>
 
+#include <franka_hw/control_deadline.h>
 #include <franka_hw/control_mode.h>
+#include <franka_hw/control_pipeline.h>
 #include <franka_hw/franka_cartesian_command_interface.h>
 #include <franka_hw/franka_model_interface.h>
 #include <franka_hw/franka_state_interface.h>
+#include <franka_hw/idle_loop.h>
 #include <franka_hw/model_base.h>
 #include <franka_hw/resource_helpers.h>
+#include <franka_hw/robot_command_queue.h>
+#include <franka_hw/robot_settings.h>
+#include <franka_hw/services.h>
+#include <franka_hw/state_log.h>
 
 namespace franka_hw {
 
@@ -89,6 +103,10 @@ class FrankaHW : public hardware_interface::RobotHW {
   /**
    * Create a libfranka robot, connecting the hardware class to the master controller.
    * Note: While the robot is connected, no DESK based tasks can be executed.
+   * Restores the collision behavior from the parameters and all settings recorded in
+   * robotSettings(). The model is only loaded once in initRobot() and kept across reconnects.
+   * @throw franka::InvalidOperationException if the robot reports a different server version
+   * than the one the model was loaded from, e.g. after a system update.
    */
   virtual void connect();
 
@@ -130,6 +148,24 @@ class FrankaHW : public hardware_interface::RobotHW {
    */
   virtual void update(const franka::RobotState& robot_state);
 
+  /**
+   * Reads the robot state once while no motion is running, updates the controller interfaces from
+   * it and executes the queued robot configuration commands. Has to be called with the robot mutex
+   * held. Used by the idle loops of all control nodes.
+   *
+   * @throw franka::Exception if the robot state cannot be read or a command fails.
+   */
+  virtual void readIdleState();
+
+  /**
+   * Reads the robot state once while no motion is running. Has to be called with the robot mutex
+   * held.
+   *
+   * @return The robot state.
+   * @throw franka::Exception if the robot state cannot be read.
+   */
+  virtual franka::RobotState readRobotState();
+
   /**
    * Indicates whether there is an active controller.
    *
@@ -228,6 +264,23 @@ class FrankaHW : public hardware_interface::RobotHW {
    */
   virtual franka::Robot& robot() const;
 
+  /**
+   * Recovers the robot from errors, see franka::Robot::automaticErrorRecovery(). Has to be called
+   * with the robot mutex held while the robot is connected.
+   *
+   * @throw franka::Exception if the recovery fails.
+   */
+  virtual void automaticErrorRecovery();
+
+  /**
+   * Sets up the robot configuration services of the hardware, see setupServices. The services
+   * get the robot when they are called, so they stay valid across disconnects and reconnects.
+   *
+   * @param[in] node_handle The NodeHandle in the namespace at which to advertise the services.
+   * @param[in] services The container to store the service servers.
+   */
+  virtual void setupRobotServices(ros::NodeHandle& node_handle, ServiceContainer& services);
+
   /**
    * Getter for the mutex protecting access to the libfranka::robot class. This enables thread-safe
    * access to robot().
@@ -235,6 +288,38 @@ class FrankaHW : public hardware_interface::RobotHW {
    */
   virtual std::mutex& robotMutex();
 
+  /**
+   * Getter for the loop pacing the robot state reads while no controller is running. Controller
+   * switches wake it up. Only valid after init().
+   *
+   * @return A reference to the idle loop.
+   */
+  virtual IdleLoop& idleLoop();
+
+  /**
+   * Getter for the settings applied to the robot through the services, which are restored on
+   * every connect.
+   *
+   * @return A reference to the recorded robot settings.
+   */
+  virtual RobotSettings& robotSettings();
+
+  /**
+   * Getter for the queue of robot configuration commands, see setupServices. Pushing a command
+   * wakes up the idle loop.
+   *
+   * @return A pointer to the command queue, or nullptr if robot_command_queue/enabled is false.
+   */
+  virtual RobotCommandQueue* commandQueue();
+
+  /**
+   * Executes all queued robot configuration commands. Has to be called with the robot mutex held
+   * while no motion is running. Does nothing if the command queue is disabled.
+   *
+   * @return Number of executed commands.
+   */
+  virtual size_t processCommandQueue();
+
   /**
    * Checks a command for NaN values.
    *
@@ -310,6 +395,20 @@ class FrankaHW : public hardware_interface::RobotHW {
 
   using Callback = std::function<bool(const franka::RobotState&, franka::Duration)>;
 
+  /**
+   * Parameters of a motion, passed to the run function when the motion is started.
+   */
+  struct RunParameters {
+    bool limit_rate{true};
+    double cutoff_frequency{franka::kDefaultCutoffFrequency};
+    franka::ControllerMode internal_controller{franka::ControllerMode::kJointImpedance};
+  };
+
+  /**
+   * Runs a motion with libfranka in one control mode until the callback finishes it.
+   */
+  using RunFunction = std::function<void(franka::Robot&, Callback, const RunParameters&)>;
+
   /**
    * Callback for the libfranka control loop. This method is designed to incorporate a
    * second callback named ros_callback that will be called on each iteration of the callback.
@@ -327,11 +426,19 @@ class FrankaHW : public hardware_interface::RobotHW {
                     Callback ros_callback,
                     const franka::RobotState& robot_state,
                     franka::Duration time_step) {
+    if (control_deadline_ && control_deadline_->running()) {
+      return deadlineControlCallback(command, robot_state, time_step);
+    }
+    if (control_pipeline_ && control_pipeline_->running()) {
+      return pipelineControlCallback(command, robot_state, time_step);
+    }
+
     robot_state_libfranka_ = robot_state;
     ros::Time now = ros::Time(0);
     read(now, ros::Duration(time_step.toSec()));
 
     if (!controller_active_ || (ros_callback && !ros_callback(robot_state, time_step))) {
+      logState(robot_state);
       return franka::MotionFinished(command);
     }
 
@@ -342,9 +449,167 @@ class FrankaHW : public hardware_interface::RobotHW {
       throw std::invalid_argument(error_message);
     }
 
+    logState(robot_state);
     return command;
   }
 
+  /**
+   * Callback for the libfranka control loop if the control deadline is enabled. The ROS-side
+   * update runs on the worker thread of the control deadline. If it misses its deadline, a command
+   * derived from the last one is sent instead.
+   *
+   * @param[in] command The datafield containing the command to send to the robot.
+   * @param[in] robot_state The current robot state to compute commands with.
+   * @param[in] time_step Time since last call to the callback.
+   * @throw std::invalid_argument When a command contains NaN values.
+   * @throw franka::ControlException When too many deadlines were missed in a row.
+   *
+   * @return The command to be sent to the robot via libfranka.
+   */
+  template <typename T>
+  T deadlineControlCallback(const T& command,
+                            const franka::RobotState& robot_state,
+                            franka::Duration time_step) {
+    T& last_command = std::get<T>(last_commands_);
+    if (time_step.toMSec() == 0) {
+      last_command = commandFromState<T>(robot_state);
+    }
+
+    switch (control_deadline_->cycle(robot_state, time_step)) {
+      case ControlDeadline::Result::kUpdated:
+        if (commandHasNaN(command)) {
+          std::string error_message = "FrankaHW::controlCallback: Got NaN command!";
+          ROS_FATAL("%s", error_message.c_str());
+          throw std::invalid_argument(error_message);
+        }
+        last_command = command;
+        logState(robot_state);
+        return command;
+      case ControlDeadline::Result::kOverrun:
+        last_command = overrunCommand(last_command, robot_state,
+                                      control_deadline_->config().overrun_policy);
+        // The worker thread may still write the libfranka commands.
+        logState(robot_state, last_commands_);
+        return last_command;
+      case ControlDeadline::Result::kAborted:
+        throw franka::ControlException(
+            "FrankaHW: Controller update missed its deadline too many times in a row.");
+      case ControlDeadline::Result::kFinished:
+      default:
+        logState(robot_state, last_commands_);
+        return franka::MotionFinished(last_command);
+    }
+  }
+
+  /**
+   * Callback for the libfranka control loop if the control pipeline is enabled. Sends the commands
+   * the pipeline computed from the previous robot state. If the pipeline stalls, a command derived
+   * from the last one is sent instead.
+   *
+   * @param[in] command The datafield containing the command to send to the robot.
+   * @param[in] robot_state The current robot state to compute commands with.
+   * @param[in] time_step Time since last call to the callback.
+   * @throw std::invalid_argument When a command contains NaN values.
+   * @throw franka::ControlException When the pipeline stalled too many times in a row.
+   *
+   * @return The command to be sent to the robot via libfranka.
+   */
+  template <typename T>
+  T pipelineControlCallback(const T& /*command*/,
+                            const franka::RobotState& robot_state,
+                            franka::Duration time_step) {
+    T& last_command = std::get<T>(last_commands_);
+    if (time_step.toMSec() == 0) {
+      last_command = commandFromState<T>(robot_state);
+    }
+
+    const ControlPipeline::Commands* commands = nullptr;
+    switch (control_pipeline_->cycle(robot_state, &commands)) {
+      case ControlPipeline::Result::kUpdated:
+        if (commandHasNaN(std::get<T>(*commands))) {
+          std::string error_message = "FrankaHW::controlCallback: Got NaN command!";
+          ROS_FATAL("%s", error_message.c_str());
+          throw std::invalid_argument(error_message);
+        }
+        last_command = std::get<T>(*commands);
+        setLibfrankaCommands(*commands);
+        logState(robot_state, *commands);
+        return last_command;
+      case ControlPipeline::Result::kStalled:
+        last_command =
+            overrunCommand(last_command, robot_state, control_pipeline_->config().stall_policy);
+        logState(robot_state, last_commands_);
+        return last_command;
+      case ControlPipeline::Result::kAborted:
+        throw franka::ControlException(
+            "FrankaHW: Controller update pipeline stalled too many times in a row.");
+      case ControlPipeline::Result::kFinished:
+      default:
+        logState(robot_state, last_commands_);
+        return franka::MotionFinished(last_command);
+    }
+  }
+
+  /**
+   * Sets the commands sent to libfranka, e.g. for logging, if they are computed by the control
+   * pipeline.
+   *
+   * @param[in] commands The commands of all control modes.
+   */
+  void setLibfrankaCommands(const ControlPipeline::Commands& commands);
+
+  /**
+   * Starts the worker threads of the control deadline and pipeline, if enabled, to run the
+   * ROS-side update of a motion. Has to be paired with stopControlThreads().
+   *
+   * @param[in] ros_callback The callback of control(), which must outlive the motion.
+   * @throw franka::ControlException if a worker thread cannot be configured.
+   */
+  void startControlThreads(
+      const std::function<bool(const ros::Time&, const ros::Duration&)>& ros_callback);
+
+  /**
+   * Stops the worker threads of the control deadline and pipeline, if enabled, and reports missed
+   * deadlines and pipeline stalls.
+   */
+  void stopControlThreads();
+
+  /**
+   * Appends the given robot state together with the current libfranka commands to the state log.
+   * Does nothing if the state log is disabled or the state was already logged, e.g. by the other
+   * callback of a control mode with a torque and a motion generator callback.
+   *
+   * @param[in] robot_state The robot state received in the current control cycle.
+   */
+  void logState(const franka::RobotState& robot_state) noexcept {
+    if (state_log_) {
+      logState(robot_state,
+               std::tie(effort_joint_command_libfranka_, position_joint_command_libfranka_,
+                        velocity_joint_command_libfranka_, pose_cartesian_command_libfranka_,
+                        velocity_cartesian_command_libfranka_));
+    }
+  }
+
+  /**
+   * Appends the given robot state together with the given commands to the state log, e.g. the
+   * commands derived from the last ones when the controller update missed its deadline.
+   *
+   * @param[in] robot_state The robot state received in the current control cycle.
+   * @param[in] commands The commands sent to libfranka in the current control cycle.
+   */
+  void logState(const franka::RobotState& robot_state,
+                const ControlPipeline::Commands& commands) noexcept {
+    if (state_log_ && (!state_logged_ || robot_state.time != last_logged_time_)) {
+      state_logged_ = true;
+      last_logged_time_ = robot_state.time;
+      state_log_->log(robot_state, current_control_mode_, std::get<franka::Torques>(commands),
+                      std::get<franka::JointPositions>(commands),
+                      std::get<franka::JointVelocities>(commands),
+                      std::get<franka::CartesianPose>(commands),
+                      std::get<franka::CartesianVelocities>(commands));
+    }
+  }
+
   /**
    * Configures a limit interface to enforce limits on effort, velocity or position level
    * on joint commands.
@@ -456,7 +721,19 @@ class FrankaHW : public hardware_interface::RobotHW {
   virtual void setupFrankaModelInterface(franka::RobotState& robot_state);
 
   /**
-   * Configures the run function which is used as libfranka control callback based on the requested
+   * Logs the time from preparing a controller switch until the motion is restarted, if the switch
+   * ended a running motion. Called right before starting a motion.
+   */
+  void logSwitchGap();
+
+  /**
+   * Builds the run functions of all supported control modes into run_functions_. Called once by
+   * init(), so switching controllers only selects one of them.
+   */
+  virtual void initRunFunctions();
+
+  /**
+   * Selects the run function which is used as libfranka control callback based on the requested
    * control mode.
    *
    * @param[in] requested_control_mode The control mode to configure (e.g. torque/position/velocity
@@ -523,9 +800,42 @@ class FrankaHW : public hardware_interface::RobotHW {
   std::mutex robot_mutex_;
   std::unique_ptr<franka::Robot> robot_;
   std::unique_ptr<franka_hw::ModelBase> model_;
+  // Server version of the robot the model was loaded from.
+  franka::Robot::ServerVersion model_server_version_{0};
+
+  bool state_log_enabled_{false};
+  StateLogWriter::Config state_log_config_;
+  std::unique_ptr<StateLogWriter> state_log_;
+  bool state_logged_{false};
+  franka::Duration last_logged_time_;
+
+  bool control_deadline_enabled_{false};
+  ControlDeadline::Config control_deadline_config_;
+  std::unique_ptr<ControlDeadline> control_deadline_;
+  bool control_pipeline_enabled_{false};
+  ControlPipeline::Config control_pipeline_config_;
+  std::unique_ptr<ControlPipeline> control_pipeline_;
+  // Commands sent in the last cycle with the control deadline or pipeline, only accessed by
+  // libfranka.
+  ControlPipeline::Commands last_commands_;
+
+  double idle_rate_{100.0};
+  std::unique_ptr<IdleLoop> idle_loop_;
+
+  RobotSettings robot_settings_;
+
+  bool command_queue_enabled_{false};
+  size_t command_queue_capacity_{16};
+  std::unique_ptr<RobotCommandQueue> command_queue_;
+  ros::Publisher command_result_publisher_;
 
   std::array<std::string, 7> joint_names_;
   std::string arm_id_;
+  // Interned resources and scratch claims for checkForConflict and prepareSwitch, which both run on
+  // the thread switching controllers.
+  mutable ResourceRegistry resource_registry_;
+  mutable ResourceRegistry::Claims claims_;
+  size_t arm_index_{std::numeric_limits<size_t>::max()};
   std::string robot_ip_;
   urdf::Model urdf_model_;
   double joint_limit_warning_threshold_{0.1};
@@ -538,7 +848,13 @@ class FrankaHW : public hardware_interface::RobotHW {
   std::function<franka::ControllerMode()> get_internal_controller_;
   std::function<bool()> get_limit_rate_;
   std::function<double()> get_cutoff_frequency_;
-  std::function<void(franka::Robot&, Callback)> run_function_;
+  std::map<ControlMode, RunFunction> run_functions_;
+  // Selected from run_functions_ in prepareSwitch, only while no motion is running.
+  const RunFunction* run_function_{nullptr};
+  RunParameters run_parameters_;
+  // Start of a switch which has to restart the motion, to measure the gap between the motions.
+  std::chrono::steady_clock::time_point switch_start_;
+  bool switch_gap_pending_{false};
 };
 
 }  // namespace franka_hw
@@ -0,0 +1,112 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <functional>
+
+#include <franka/robot_state.h>
+#include <ros/node_handle.h>
+
+#include <franka_hw/franka_combinable_hw.h>
+#include <franka_hw/mock_robot.h>
+#include <franka_hw/services.h>
+
+namespace franka_hw {
+
+/**
+ * A FrankaCombinableHW which stands in for an arm to load-test franka_combined_control_node and
+ * controllers without hardware. Select it with the type franka_hw/FrankaMockCombinableHW of an
+ * arm.
+ *
+ * Its control loop thread runs the same torque control callback as FrankaCombinableHW in the
+ * emulated control loop of a MockRobot. The injected faults are read from the mock namespace of
+ * the arm, see MockRobot::init().
+ *
+ * Since no franka::Robot exists, robot() must not be used. The robot configuration services only
+ * record the settings.
+ */
+class FrankaMockCombinableHW : public FrankaCombinableHW {
+ public:
+  /**
+   * Creates an instance of FrankaMockCombinableHW.
+   */
+  FrankaMockCombinableHW() = default;
+
+  /**
+   * Reads the parameterization of FrankaCombinableHW and the injected faults from the ROS
+   * parameter server.
+   *
+   * @param[in] root_nh A node handle in the root namespace of the control node.
+   * @param[in] robot_hw_nh A node handle in the namespace of the robot hardware.
+   *
+   * @return True if successful, false otherwise.
+   */
+  bool initParameters(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) override;
+
+  /**
+   * Marks the mock robot as connected and sets up the services.
+   */
+  void connect() override;
+
+  /**
+   * Marks the mock robot as disconnected if no controller is running.
+   *
+   * @return True if successfully disconnected, false otherwise.
+   */
+  bool disconnect() override;
+
+  /**
+   * Checks whether the mock robot is connected.
+   *
+   * @return True if connected, false otherwise.
+   */
+  bool connected() override;
+
+  /**
+   * Runs the currently active controller in the emulated 1 kHz control loop. Called by the control
+   * loop thread.
+   *
+   * @param[in] ros_callback Not used, as in FrankaCombinableHW.
+   *
+   * @throw franka::ControlException if a reflex was injected or too many packets were lost.
+   */
+  void control(const std::function<bool(const ros::Time&, const ros::Duration&)>&
+                   ros_callback =  // NOLINT (google-default-arguments)
+               [](const ros::Time&, const ros::Duration&) {
+                 return true;
+               }) override;  // NOLINT (google-default-arguments)
+
+  /**
+   * Waits for the next 1 ms cycle and returns the simulated robot state.
+   *
+   * @return The simulated robot state.
+   */
+  franka::RobotState readRobotState() override;
+
+  /**
+   * Clears an injected reflex.
+   */
+  void automaticErrorRecovery() override;
+
+  /**
+   * Sets up the robot configuration services, which only record the settings, see
+   * setupRecordingServices.
+   *
+   * @param[in] node_handle The NodeHandle in the namespace at which to advertise the services.
+   * @param[in] services The container to store the service servers.
+   */
+  void setupRobotServices(ros::NodeHandle& node_handle, ServiceContainer& services) override;
+
+ protected:
+  /**
+   * Connects the mock robot instead of a libfranka robot and starts the control loop thread.
+   *
+   * @throw std::runtime_error if the control loop thread cannot be configured.
+   */
+  void initRobot() override;
+
+ private:
+  MockRobot mock_robot_;
+};
+
+}  // namespace franka_hw
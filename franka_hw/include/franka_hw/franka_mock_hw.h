@@ -0,0 +1,133 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <functional>
+
+#include <franka/duration.h>
+#include <franka/robot_state.h>
+#include <ros/node_handle.h>
+
+#include <franka_hw/control_pipeline.h>
+#include <franka_hw/franka_hw.h>
+#include <franka_hw/mock_robot.h>
+#include <franka_hw/services.h>
+
+namespace franka_hw {
+
+/**
+ * A hardware class which stands in for a robot to load-test FrankaHW and controllers without
+ * hardware, e.g. in franka_control_node with the mock_robot parameter.
+ *
+ * Instead of connecting to a robot, control() runs the same control callbacks as FrankaHW,
+ * including the control deadline and pipeline, in the emulated control loop of a MockRobot.
+ * Communication latency, lost packets and reflexes can be injected through the parameters in the
+ * mock namespace, see MockRobot::init().
+ *
+ * Since no franka::Robot exists, robot() must not be used. The robot configuration services only
+ * record the settings.
+ */
+class FrankaMockHW : public FrankaHW {
+ public:
+  /**
+   * Creates an instance of FrankaMockHW.
+   */
+  FrankaMockHW() = default;
+
+  ~FrankaMockHW() override = default;
+
+  /**
+   * Reads the parameterization of FrankaHW and the injected faults from the ROS parameter server.
+   *
+   * @param[in] root_nh A node handle in the root namespace of the control node.
+   * @param[in] robot_hw_nh A node handle in the namespace of the robot hardware.
+   *
+   * @return True if successful, false otherwise.
+   */
+  bool initParameters(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) override;
+
+  /**
+   * Marks the mock robot as connected.
+   */
+  void connect() override;
+
+  /**
+   * Marks the mock robot as disconnected if no controller is running.
+   *
+   * @return True if successfully disconnected, false otherwise.
+   */
+  bool disconnect() override;
+
+  /**
+   * Checks whether the mock robot is connected.
+   *
+   * @return True if connected, false otherwise.
+   */
+  bool connected() override;
+
+  /**
+   * Runs the currently active controller in the emulated 1 kHz control loop.
+   *
+   * @param[in] ros_callback A callback function that is executed at each time step and runs
+   * all ROS-side functionality of the hardware. Execution is stopped if it returns false.
+   *
+   * @throw franka::ControlException if a reflex was injected or too many packets were lost.
+   */
+  void control(
+      const std::function<bool(const ros::Time&, const ros::Duration&)>& ros_callback) override;
+
+  /**
+   * Waits for the next 1 ms cycle and returns the simulated robot state.
+   *
+   * @return The simulated robot state.
+   */
+  franka::RobotState readRobotState() override;
+
+  /**
+   * Clears an injected reflex.
+   */
+  void automaticErrorRecovery() override;
+
+  /**
+   * Sets up the robot configuration services, which only record the settings, see
+   * setupRecordingServices.
+   *
+   * @param[in] node_handle The NodeHandle in the namespace at which to advertise the services.
+   * @param[in] services The container to store the service servers.
+   */
+  void setupRobotServices(ros::NodeHandle& node_handle, ServiceContainer& services) override;
+
+  /**
+   * Gets the timing statistics of the emulated control loop.
+   *
+   * @return The statistics since the last call to resetStatistics().
+   */
+  MockRobot::LoopStatistics statistics();
+
+  /**
+   * Resets the timing statistics of the emulated control loop.
+   */
+  void resetStatistics();
+
+ protected:
+  /**
+   * Connects the mock robot instead of a libfranka robot.
+   */
+  void initRobot() override;
+
+ private:
+  template <typename T>
+  bool callControlCallback(const T& command,
+                           const Callback& callback,
+                           const franka::RobotState& robot_state,
+                           franka::Duration time_step,
+                           ControlPipeline::Commands* commands) {
+    T result = controlCallback(command, callback, robot_state, time_step);
+    std::get<T>(*commands) = result;
+    return !result.motion_finished;
+  }
+
+  MockRobot mock_robot_;
+};
+
+}  // namespace franka_hw
@@ -0,0 +1,137 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <franka/duration.h>
+#include <franka/robot_state.h>
+#include <ros/node_handle.h>
+
+#include <franka_hw/franka_hw.h>
+#include <franka_hw/model_base.h>
+
+namespace franka_hw {
+
+/**
+ * A hardware class which replays previously recorded robot states instead of connecting to a
+ * robot. Recorded states can be read either from a binary state log (see StateLogWriter) or from
+ * franka_msgs/FrankaState messages in a rosbag.
+ *
+ * The class offers the same ros_control interfaces as FrankaHW, so controllers can be run
+ * unmodified against recorded data. The model interface is only available if a model has been
+ * set with setModel() or if a robot_ip is configured, from which the model is loaded once.
+ * Commands written by controllers are captured into the state log if it is enabled.
+ */
+class FrankaReplayHW : public FrankaHW {
+ public:
+  /**
+   * Creates an instance of FrankaReplayHW.
+   */
+  FrankaReplayHW();
+
+  ~FrankaReplayHW() override;
+
+  /**
+   * Reads the parameterization of FrankaHW and the replay source from the ROS parameter server.
+   * Uses replay/source ("state_log" or "bag"), replay/path and replay/topic.
+   *
+   * @param[in] root_nh A node handle in the root namespace of the control node.
+   * @param[in] robot_hw_nh A node handle in the namespace of the robot hardware.
+   *
+   * @return True if successful, false otherwise.
+   */
+  bool initParameters(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) override;
+
+  /**
+   * Does nothing, FrankaReplayHW never connects to a robot.
+   */
+  void connect() override;
+
+  /**
+   * Does nothing, FrankaReplayHW never connects to a robot.
+   *
+   * @return Always true.
+   */
+  bool disconnect() override;
+
+  /**
+   * Checks whether the hardware class is connected to a robot.
+   *
+   * @return Always false.
+   */
+  bool connected() override;
+
+  /**
+   * Not supported, use nextState(), read(), write() and captureCommands() instead.
+   *
+   * @param[in] ros_callback Unused.
+   */
+  void control(
+      const std::function<bool(const ros::Time&, const ros::Duration&)>& ros_callback) override;
+
+  /**
+   * Sets the model to offer through the model interface. Must be called before init().
+   *
+   * @param[in] model The model to use.
+   */
+  void setModel(std::unique_ptr<ModelBase> model);
+
+  /**
+   * Loads the next recorded robot state. It becomes visible to controllers with the next call to
+   * read().
+   *
+   * @return True if a state was loaded, false if the end of the recording has been reached.
+   *
+   * @throw std::runtime_error if the recording is corrupt.
+   */
+  bool nextState();
+
+  /**
+   * Gets the robot time of the state loaded last with nextState().
+   *
+   * @return The recorded robot time.
+   */
+  franka::Duration recordedTime() const noexcept;
+
+  /**
+   * Appends the state loaded last together with the commands written last to the state log.
+   * Does nothing if the state log is disabled.
+   */
+  void captureCommands() noexcept;
+
+  /**
+   * A source of recorded robot states.
+   */
+  class Source {
+   public:
+    virtual ~Source() = default;
+
+    /**
+     * Reads the next recorded robot state.
+     *
+     * @param[out] robot_state The robot state to fill.
+     *
+     * @return True if a state was read, false at the end of the recording.
+     */
+    virtual bool next(franka::RobotState* robot_state) = 0;
+  };
+
+ protected:
+  /**
+   * Opens the replay source, loads the model if a robot_ip is given and loads the first state.
+   *
+   * @throw std::runtime_error if the source cannot be opened or contains no states.
+   */
+  void initRobot() override;
+
+ private:
+  std::unique_ptr<Source> source_;
+  std::string source_type_;
+  std::string source_path_;
+  std::string source_topic_;
+};
+
+}  // namespace franka_hw
@@ -0,0 +1,106 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace franka_hw {
+
+/**
+ * Paces the loop that reads the robot state while no controller is running.
+ *
+ * Instead of reading as fast as the robot sends states, the loop runs at a fixed idle rate and
+ * sleeps in between. wakeUp() ends the sleep early, so a controller switch or an error recovery
+ * request is handled right away. The CPU time the calling thread spends while idle is measured.
+ */
+class IdleLoop {
+ public:
+  /**
+   * Statistics about an idle phase.
+   */
+  struct Statistics {
+    /** Wall time spent in the idle phase [s]. */
+    double duration{0.0};
+    /** CPU time of the idle thread divided by the wall time. */
+    double cpu_usage{0.0};
+    /** Number of idle cycles. */
+    uint64_t cycles{0};
+    /** Number of idle cycles which were started early by wakeUp(). */
+    uint64_t wakeups{0};
+    /** Number of robot states read from the robot, see countRead(). */
+    uint64_t reads{0};
+  };
+
+  /**
+   * Creates an instance of IdleLoop.
+   *
+   * @param[in] rate Rate of the idle loop [Hz].
+   */
+  explicit IdleLoop(double rate = 100.0);
+
+  IdleLoop(const IdleLoop&) = delete;
+  IdleLoop& operator=(const IdleLoop&) = delete;
+
+  /**
+   * Starts a new idle phase. Does nothing if already idle.
+   */
+  void enter();
+
+  /**
+   * Waits until the next idle cycle is due or wakeUp() was called.
+   *
+   * @return True if woken up early, false otherwise.
+   */
+  bool wait();
+
+  /**
+   * Ends the current sleep or the next one right away. Can be called from any thread.
+   */
+  void wakeUp();
+
+  /**
+   * Counts a robot state read from the robot in the current idle phase. Does nothing if not idle.
+   */
+  void countRead() noexcept;
+
+  /**
+   * Ends the idle phase.
+   *
+   * @return Statistics about the idle phase, empty if the loop was not idle.
+   */
+  Statistics leave();
+
+  /**
+   * Checks whether an idle phase was entered and not left yet.
+   *
+   * @return True if idle, false otherwise.
+   */
+  bool idle() const noexcept;
+
+  /**
+   * Gets the rate of the idle loop.
+   *
+   * @return Rate [Hz].
+   */
+  double rate() const noexcept;
+
+ private:
+  const double rate_;
+  const std::chrono::steady_clock::duration period_;
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  bool wakeup_requested_{false};
+
+  // Only accessed by the idle thread.
+  bool idle_{false};
+  std::chrono::steady_clock::time_point next_cycle_;
+  std::chrono::steady_clock::time_point start_time_;
+  std::chrono::nanoseconds start_cpu_time_{0};
+  Statistics statistics_;
+};
+
+}  // namespace franka_hw
@@ -0,0 +1,117 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace franka_hw {
+
+/**
+ * Wait-free queue of preallocated messages between a single producer and a single consumer
+ * thread.
+ *
+ * The producer fills the slot returned by acquire() in place and queues it with commit(), the
+ * consumer reads front() and releases it with pop(). Slots are reused in order, so messages keep
+ * the capacity of their arrays and filling them does not allocate. If the queue is full, acquire()
+ * fails and counts the message as dropped instead of overwriting a message the consumer may be
+ * reading.
+ */
+template <typename T>
+class MessageRing {
+ public:
+  /**
+   * Creates a queue with all slots initialized to the given message, e.g. with constant fields
+   * like frame IDs already set and arrays already sized.
+   *
+   * @param[in] capacity Number of slots.
+   * @param[in] prototype The initial value of all slots.
+   *
+   * @throw std::invalid_argument if the capacity is 0.
+   */
+  explicit MessageRing(size_t capacity, const T& prototype = T()) : slots_(capacity, prototype) {
+    if (capacity == 0) {
+      throw std::invalid_argument("MessageRing: Capacity must be positive");
+    }
+  }
+
+  MessageRing(const MessageRing&) = delete;
+  MessageRing& operator=(const MessageRing&) = delete;
+
+  /**
+   * Gets the next free slot to fill. Only to be used by the producer.
+   *
+   * @return The slot, or nullptr if the queue is full.
+   */
+  T* acquire() noexcept {
+    const uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= slots_.size()) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &slots_[tail % slots_.size()];
+  }
+
+  /**
+   * Queues the slot returned by the last successful call to acquire(). Only to be used by the
+   * producer.
+   */
+  void commit() noexcept {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /**
+   * Gets the oldest queued message. Only to be used by the consumer.
+   *
+   * @return The message, or nullptr if the queue is empty.
+   */
+  const T* front() const noexcept {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &slots_[head % slots_.size()];
+  }
+
+  /**
+   * Releases the message returned by front(). Only to be used by the consumer.
+   */
+  void pop() noexcept {
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /**
+   * Gets the number of slots.
+   *
+   * @return Number of slots.
+   */
+  size_t capacity() const noexcept { return slots_.size(); }
+
+  /**
+   * Gets the number of queued messages.
+   *
+   * @return Number of queued messages.
+   */
+  size_t size() const noexcept {
+    return static_cast<size_t>(tail_.load(std::memory_order_acquire) -
+                               head_.load(std::memory_order_acquire));
+  }
+
+  /**
+   * Gets the number of messages dropped because the queue was full.
+   *
+   * @return Number of dropped messages.
+   */
+  uint64_t droppedMessages() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  std::vector<T> slots_;
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  std::atomic<uint64_t> dropped_{0};
+};
+
+}  // namespace franka_hw
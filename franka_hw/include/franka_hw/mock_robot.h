@@ -0,0 +1,184 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include <franka/duration.h>
+#include <franka/robot_state.h>
+#include <ros/node_handle.h>
+#include <ros/wall_timer.h>
+
+#include <franka_hw/control_mode.h>
+#include <franka_hw/control_pipeline.h>
+
+namespace franka_hw {
+
+/**
+ * Stands in for a robot in FrankaMockHW and FrankaMockCombinableHW.
+ *
+ * control() emulates the 1 kHz libfranka control loop with a simple kinematic simulation of the
+ * robot. Communication latency, lost packets and reflexes can be injected through the parameters
+ * in the mock namespace. Lost packets are reflected in control_command_success_rate and lead to a
+ * communication_constraints_violation when too many are lost in a row, as on the real robot.
+ *
+ * Like franka::Robot, the methods must not be called concurrently.
+ */
+class MockRobot {
+ public:
+  /**
+   * Configuration of the injected faults.
+   */
+  struct Config {
+    /** Mean delay between receiving a robot state and calling the control callback [s]. */
+    double latency{0.0};
+    /** Maximum uniformly distributed deviation from the mean latency [s]. */
+    double latency_jitter{0.0};
+    /** Probability to lose a robot state or command packet in a control cycle. */
+    double packet_loss{0.0};
+    /** Probability to trigger a joint reflex in a control cycle. */
+    double reflex_probability{0.0};
+    /** Number of lost packets in a row that abort the motion. */
+    size_t max_lost_packets{20};
+    /** Seed of the random number generator used for injecting faults. */
+    uint32_t seed{0};
+  };
+
+  /**
+   * Timing statistics of the emulated control loop.
+   */
+  struct LoopStatistics {
+    /** Number of control cycles. */
+    uint64_t cycles{0};
+    /** Number of cycles in which the state or command was lost or late. */
+    uint64_t lost_packets{0};
+    /** Sum of the durations of all control callbacks [s]. */
+    double total_callback_duration{0.0};
+    /** Maximum duration of a control callback [s]. */
+    double max_callback_duration{0.0};
+    /** Maximum deviation of the cycle start from its 1 ms schedule [s]. */
+    double max_cycle_jitter{0.0};
+    /** Current success rate over the last 100 cycles. */
+    double control_command_success_rate{1.0};
+  };
+
+  /**
+   * Computes the commands of a control cycle. Only the commands of the running control mode are
+   * used. Returns false to finish the motion.
+   */
+  using Callback = std::function<
+      bool(const franka::RobotState&, franka::Duration, ControlPipeline::Commands* commands)>;
+
+  /**
+   * Creates a disconnected MockRobot in its start pose.
+   */
+  MockRobot();
+
+  /**
+   * Reads the injected faults (mock/latency, mock/latency_jitter, mock/packet_loss,
+   * mock/reflex_probability, mock/max_lost_packets, mock/seed) from the ROS parameter server. If
+   * mock/report_period is positive, the loop statistics are logged and reset periodically.
+   *
+   * @param[in] robot_hw_nh A node handle in the namespace of the robot hardware.
+   * @param[in] name Name of the robot in the reported statistics.
+   *
+   * @return True if successful, false otherwise.
+   */
+  bool init(ros::NodeHandle& robot_hw_nh, const std::string& name);
+
+  /**
+   * Marks the robot as connected.
+   */
+  void connect();
+
+  /**
+   * Marks the robot as disconnected.
+   */
+  void disconnect();
+
+  /**
+   * Checks whether the robot is connected.
+   *
+   * @return True if connected, false otherwise.
+   */
+  bool connected() const noexcept;
+
+  /**
+   * Waits for the next 1 ms cycle and returns the simulated robot state, like
+   * franka::Robot::readOnce().
+   *
+   * @return The simulated robot state.
+   */
+  franka::RobotState readOnce();
+
+  /**
+   * Gets the simulated robot state without waiting, e.g. after control() threw.
+   *
+   * @return The last simulated robot state.
+   */
+  const franka::RobotState& state() const noexcept;
+
+  /**
+   * Runs a motion in an emulated 1 kHz control loop until the callback finishes it, like
+   * franka::Robot::control(). As in libfranka, the callback is first called with a time step of
+   * zero, and lost or late commands are not applied.
+   *
+   * @param[in] control_mode Control mode of the motion, selecting the simulated commands.
+   * @param[in] callback Computes the commands of every control cycle.
+   *
+   * @throw franka::ControlException if a reflex was injected or too many packets were lost.
+   */
+  void control(ControlMode control_mode, const Callback& callback);
+
+  /**
+   * Clears an injected reflex, like franka::Robot::automaticErrorRecovery().
+   */
+  void automaticErrorRecovery();
+
+  /**
+   * Gets the timing statistics of the emulated control loop.
+   *
+   * @return The statistics since the last call to resetStatistics().
+   */
+  LoopStatistics statistics();
+
+  /**
+   * Resets the timing statistics of the emulated control loop.
+   */
+  void resetStatistics();
+
+ private:
+  size_t waitForNextCycle(std::chrono::steady_clock::time_point* next_cycle);
+  bool packetLost();
+  void updateSuccessRate(bool success);
+  void simulate(ControlMode control_mode, const ControlPipeline::Commands& commands, double period);
+  [[noreturn]] void throwReflex(const std::string& message, bool communication_error);
+  void reportStatistics();
+
+  Config config_;
+  std::string name_;
+  std::mt19937 random_engine_;
+  std::atomic_bool connected_{false};
+
+  franka::RobotState simulated_state_;
+  ControlPipeline::Commands commands_;
+  std::chrono::steady_clock::time_point next_read_;
+  std::array<bool, 100> success_history_;
+  size_t success_history_index_{0};
+  size_t success_count_{100};
+  size_t consecutive_lost_packets_{0};
+
+  std::mutex statistics_mutex_;
+  LoopStatistics statistics_;
+  // Destroyed first, as its callback uses the statistics.
+  ros::WallTimer report_timer_;
+};
+
+}  // namespace franka_hw
@@ -0,0 +1,237 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <semaphore.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ros/node_handle.h>
+#include <ros/publisher.h>
+
+#include <franka_hw/message_ring.h>
+
+namespace franka_hw {
+
+/**
+ * Topic of a PublisherGroup, see RingPublisher.
+ */
+class RingPublisherBase {
+ public:
+  virtual ~RingPublisherBase() = default;
+
+  /**
+   * Publishes all queued messages. Called by the thread of the PublisherGroup.
+   *
+   * @return Number of published messages.
+   */
+  virtual size_t publishQueued() = 0;
+
+  /**
+   * Gets the name of the topic.
+   *
+   * @return The resolved topic name.
+   */
+  virtual const std::string& topic() const noexcept = 0;
+
+  /**
+   * Gets the number of messages dropped because the queue was full.
+   *
+   * @return Number of dropped messages.
+   */
+  virtual uint64_t droppedMessages() const noexcept = 0;
+
+  /**
+   * Sets the semaphore to post when a message is queued. Called by the PublisherGroup.
+   *
+   * @param[in] wakeup The semaphore of the thread of the group, or nullptr to post none.
+   */
+  void setWakeup(sem_t* wakeup) noexcept { wakeup_ = wakeup; }
+
+ protected:
+  /**
+   * Wakes the thread of the PublisherGroup up. Posting a semaphore never blocks.
+   */
+  void wakeUp() noexcept {
+    if (wakeup_ != nullptr) {
+      sem_post(wakeup_);
+    }
+  }
+
+ private:
+  sem_t* wakeup_{nullptr};
+};
+
+/**
+ * Publishes messages filled in realtime code from the thread of a PublisherGroup.
+ *
+ * The realtime thread fills the message returned by next() and queues it with publish(). Messages
+ * are taken from a MessageRing, so neither side blocks the other, and messages are only dropped
+ * if all slots are still queued.
+ */
+template <typename Message>
+class RingPublisher : public RingPublisherBase {
+ public:
+  /**
+   * Creates a RingPublisher. Use PublisherGroup::advertise() instead.
+   *
+   * @param[in] publisher The publisher to publish queued messages with.
+   * @param[in] capacity Number of preallocated messages.
+   * @param[in] prototype The initial value of all messages.
+   */
+  RingPublisher(const ros::Publisher& publisher, size_t capacity, const Message& prototype)
+      : RingPublisher(
+            publisher.getTopic(),
+            [publisher](const Message& message) { publisher.publish(message); },
+            capacity,
+            prototype) {}
+
+  /**
+   * Creates a RingPublisher that hands queued messages to a function instead of a ros::Publisher.
+   * Use PublisherGroup::add() instead.
+   *
+   * @param[in] topic Name of the topic, only used for warnings.
+   * @param[in] publish Function to publish queued messages with.
+   * @param[in] capacity Number of preallocated messages.
+   * @param[in] prototype The initial value of all messages.
+   */
+  RingPublisher(std::string topic,
+                std::function<void(const Message&)> publish,
+                size_t capacity,
+                const Message& prototype)
+      : publish_(std::move(publish)), topic_(std::move(topic)), ring_(capacity, prototype) {}
+
+  /**
+   * Gets the next message to fill. The message still holds the values it was last published
+   * with. Only to be used by a single realtime thread.
+   *
+   * @return The message, or nullptr if the message is dropped since all messages are queued.
+   */
+  Message* next() noexcept { return ring_.acquire(); }
+
+  /**
+   * Queues the message returned by the last successful call to next() for publishing. Only to be
+   * used by the same thread as next().
+   */
+  void publish() noexcept {
+    ring_.commit();
+    wakeUp();
+  }
+
+  size_t publishQueued() override {
+    size_t published = 0;
+    while (const Message* message = ring_.front()) {
+      publish_(*message);
+      ring_.pop();
+      published++;
+    }
+    return published;
+  }
+
+  const std::string& topic() const noexcept override { return topic_; }
+
+  uint64_t droppedMessages() const noexcept override { return ring_.droppedMessages(); }
+
+ private:
+  std::function<void(const Message&)> publish_;
+  std::string topic_;
+  MessageRing<Message> ring_;
+};
+
+/**
+ * Publishes the messages of several RingPublishers from a single background thread, e.g. all
+ * topics of a controller, instead of one thread per topic.
+ *
+ * The thread sleeps on a semaphore which RingPublisher::publish() posts, so it only runs while
+ * messages are queued. Dropped messages are reported as warnings, at most once per second and
+ * topic.
+ */
+class PublisherGroup {
+ public:
+  /**
+   * Creates a PublisherGroup. The thread is started with the first advertised topic.
+   */
+  PublisherGroup();
+
+  /**
+   * Stops the thread after publishing all queued messages.
+   */
+  ~PublisherGroup();
+
+  PublisherGroup(const PublisherGroup&) = delete;
+  PublisherGroup& operator=(const PublisherGroup&) = delete;
+
+  /**
+   * Advertises a topic published by the thread of this group.
+   *
+   * @param[in] node_handle The node handle to advertise the topic with.
+   * @param[in] topic Name of the topic.
+   * @param[in] capacity Number of preallocated messages, also used as queue size of the topic.
+   * @param[in] latch True to send the last message to new subscribers.
+   * @param[in] prototype The initial value of all messages, e.g. with constant fields set.
+   *
+   * @return The publisher to queue messages with.
+   */
+  template <typename Message>
+  std::shared_ptr<RingPublisher<Message>> advertise(ros::NodeHandle& node_handle,
+                                                    const std::string& topic,
+                                                    size_t capacity,
+                                                    bool latch = false,
+                                                    const Message& prototype = Message()) {
+    auto publisher = std::make_shared<RingPublisher<Message>>(
+        node_handle.advertise<Message>(topic, static_cast<uint32_t>(capacity), latch), capacity,
+        prototype);
+    addTopic(publisher);
+    return publisher;
+  }
+
+  /**
+   * Adds a topic whose messages are handed to a function on the thread of this group, e.g. to
+   * merge them into a message shared with other publishers.
+   *
+   * @param[in] topic Name of the topic, only used for warnings.
+   * @param[in] publish Function to publish queued messages with.
+   * @param[in] capacity Number of preallocated messages.
+   * @param[in] prototype The initial value of all messages, e.g. with constant fields set.
+   *
+   * @return The publisher to queue messages with.
+   */
+  template <typename Message>
+  std::shared_ptr<RingPublisher<Message>> add(const std::string& topic,
+                                              std::function<void(const Message&)> publish,
+                                              size_t capacity,
+                                              const Message& prototype = Message()) {
+    auto publisher = std::make_shared<RingPublisher<Message>>(topic, std::move(publish),
+                                                              capacity, prototype);
+    addTopic(publisher);
+    return publisher;
+  }
+
+ private:
+  struct Topic {
+    std::shared_ptr<RingPublisherBase> publisher;
+    uint64_t reported_drops;
+    std::chrono::steady_clock::time_point last_report;
+  };
+
+  void addTopic(std::shared_ptr<RingPublisherBase> publisher);
+  void run();
+  void publishQueued();
+
+  sem_t wakeup_;
+  std::mutex mutex_;
+  std::vector<Topic> topics_;
+  std::atomic_bool running_{false};
+  std::thread thread_;
+};
+
+}  // namespace franka_hw
@@ -2,9 +2,13 @@
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <list>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <hardware_interface/controller_info.h>
@@ -42,4 +46,133 @@ bool partiallyClaimsArmJoints(const ArmClaimedMap& arm_claim_map, const std::str
 
 bool hasTrajectoryClaim(const ArmClaimedMap& arm_claim_map, const std::string& arm_id);
 
+/**
+ * Interns the resources, arms and command interfaces claimed by controllers to small integers, so
+ * claims are counted in flat arrays and control modes are looked up from interface bitmasks
+ * instead of comparing and parsing strings on every controller switch.
+ *
+ * Resources of registered arms are interned up front, unknown resources are interned when they
+ * are first claimed. Not thread-safe, controller_manager checks and prepares switches from a
+ * single thread.
+ */
+class ResourceRegistry {
+ public:
+  /**
+   * Claimable command interfaces, also used as bit positions in interface masks.
+   */
+  enum Interface : uint8_t {
+    kJointPosition = 0,
+    kJointVelocity,
+    kJointTorque,
+    kCartesianPose,
+    kCartesianVelocity,
+    kInterfaceCount
+  };
+
+  /**
+   * Claims on the resources of one arm.
+   */
+  struct ArmClaims {
+    /** Number of claimed resources per interface. */
+    std::array<uint8_t, kInterfaceCount> claims{};
+    /** Bitmask of the interfaces with at least one claim. */
+    uint8_t interfaces{0};
+  };
+
+  /**
+   * Claims of a list of controllers.
+   */
+  struct Claims {
+    /** Claims per arm, indexed by arm index. */
+    std::vector<ArmClaims> arms;
+    /** True if a resource is claimed by a combination of interfaces which is not supported. */
+    bool conflicting_multi_claim{false};
+  };
+
+  ResourceRegistry();
+
+  /**
+   * Registers the joints <arm_id>_joint* and the Cartesian resource <arm_id>_robot of an arm.
+   *
+   * @param[in] arm_id The arm id.
+   * @param[in] joint_names The names of the joints of the arm.
+   *
+   * @return The index of the arm.
+   */
+  size_t addArm(const std::string& arm_id, const std::array<std::string, 7>& joint_names);
+
+  /**
+   * Counts the claims of a list of controllers per arm and interface.
+   *
+   * @param[in] info The controllers.
+   * @param[out] claims The claims, reusing the memory of earlier calls.
+   *
+   * @return False if an unknown interface is claimed or an arm id cannot be found in a resource
+   * name, true otherwise.
+   */
+  bool evaluate(const std::list<hardware_interface::ControllerInfo>& info, Claims* claims);
+
+  /**
+   * Gets the claims on an arm.
+   *
+   * @param[in] claims Claims from evaluate().
+   * @param[in] arm The index of the arm.
+   *
+   * @return The claims on the arm, empty if it is not claimed at all.
+   */
+  static const ArmClaims& armClaims(const Claims& claims, size_t arm);
+
+  /**
+   * Looks up the control mode requested by the claims on an arm.
+   *
+   * @param[in] arm_claims The claims on the arm.
+   *
+   * @return The control mode, ControlMode::None for unsupported combinations.
+   */
+  static ControlMode controlMode(const ArmClaims& arm_claims);
+
+  /**
+   * Checks for claims on joint position or velocity together with Cartesian interfaces.
+   *
+   * @param[in] arm_claims The claims on the arm.
+   * @param[in] arm_id The arm id for error messages.
+   *
+   * @return True on conflict, false otherwise.
+   */
+  static bool hasConflictingJointAndCartesianClaim(const ArmClaims& arm_claims,
+                                                   const std::string& arm_id);
+
+  /**
+   * Checks for joint interfaces claimed for only some of the 7 joints.
+   *
+   * @param[in] arm_claims The claims on the arm.
+   * @param[in] arm_id The arm id for error messages.
+   *
+   * @return True on conflict, false otherwise.
+   */
+  static bool partiallyClaimsArmJoints(const ArmClaims& arm_claims, const std::string& arm_id);
+
+  /**
+   * Checks for claims on any interface other than joint torques.
+   *
+   * @param[in] arm_claims The claims on the arm.
+   *
+   * @return True if a trajectory interface is claimed, false otherwise.
+   */
+  static bool hasTrajectoryClaim(const ArmClaims& arm_claims);
+
+ private:
+  size_t internArm(const std::string& arm_id);
+  bool internResource(const std::string& resource, size_t* index);
+
+  std::unordered_map<std::string, Interface> interfaces_;
+  std::unordered_map<std::string, size_t> arms_;
+  std::unordered_map<std::string, size_t> resources_;
+  std::vector<std::string> resource_names_;
+  std::vector<size_t> resource_arms_;
+  // Claims per resource of the last evaluate() call.
+  std::vector<uint8_t> resource_claims_;
+  std::vector<uint8_t> resource_torque_claims_;
+};
+
 }  // namespace franka_hw
@@ -0,0 +1,115 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace franka_hw {
+
+/**
+ * Bounded queue of robot configuration commands, e.g. from the services set up by setupServices.
+ *
+ * Commands are pushed from any thread without waiting for the robot, and executed by the thread
+ * owning the robot whenever no motion is running. The result of every command is reported through
+ * a callback together with the request id returned by push().
+ */
+class RobotCommandQueue {
+ public:
+  /**
+   * A command accessing the robot. Failures are reported by throwing franka::Exception.
+   */
+  using Command = std::function<void()>;
+
+  /**
+   * Result of an executed or dropped command.
+   */
+  struct Result {
+    /** Request id returned by push(). */
+    uint64_t request_id{0};
+    /** Name given to push(). */
+    std::string name;
+    /** True if the command was executed without an exception. */
+    bool success{false};
+    /** Error message if the command failed. */
+    std::string error;
+  };
+
+  /**
+   * Creates an instance of RobotCommandQueue.
+   *
+   * @param[in] capacity Maximum number of pending commands.
+   * @param[in] result_callback Called with the result of every command, from the thread calling
+   * process() or clear().
+   * @param[in] push_callback Called after a command was pushed, e.g. to wake up the idle loop.
+   */
+  explicit RobotCommandQueue(size_t capacity = 16,
+                             std::function<void(const Result&)> result_callback = {},
+                             std::function<void()> push_callback = {});
+
+  RobotCommandQueue(const RobotCommandQueue&) = delete;
+  RobotCommandQueue& operator=(const RobotCommandQueue&) = delete;
+
+  /**
+   * Adds a command to the queue. Never blocks on the robot.
+   *
+   * @param[in] name Name of the command for its result, e.g. the service name.
+   * @param[in] command The command to execute.
+   *
+   * @return The request id of the command, or 0 if the queue is full.
+   */
+  uint64_t push(const std::string& name, Command command);
+
+  /**
+   * Executes all pending commands in the order they were pushed. The caller has to hold the robot
+   * mutex and make sure that no motion is running. Exceptions thrown by a command are reported as
+   * its failure.
+   *
+   * @return Number of executed commands.
+   */
+  size_t process();
+
+  /**
+   * Drops all pending commands and reports them as failed, e.g. before disconnecting the robot.
+   *
+   * @param[in] reason Error message for the results of the dropped commands.
+   *
+   * @return Number of dropped commands.
+   */
+  size_t clear(const std::string& reason);
+
+  /**
+   * Gets the number of pending commands.
+   *
+   * @return Number of pending commands.
+   */
+  size_t size() const;
+
+  /**
+   * Gets the maximum number of pending commands.
+   *
+   * @return Capacity of the queue.
+   */
+  size_t capacity() const noexcept;
+
+ private:
+  struct Entry {
+    uint64_t request_id;
+    std::string name;
+    Command command;
+  };
+
+  const size_t capacity_;
+  const std::function<void(const Result&)> result_callback_;
+  const std::function<void()> push_callback_;
+
+  mutable std::mutex mutex_;
+  std::deque<Entry> pending_;
+  uint64_t next_request_id_{1};
+};
+
+}  // namespace franka_hw
@@ -0,0 +1,79 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <franka/robot.h>
+
+namespace franka_hw {
+
+/**
+ * Records the settings applied to a robot, e.g. impedances, frames and loads set through the
+ * services, so they can be replayed after a reconnect.
+ *
+ * The robot loses all of these settings when the connection is closed or the robot is power
+ * cycled. Only the last applied value of every setting is kept.
+ */
+class RobotSettings {
+ public:
+  /**
+   * Applies a setting to a robot. Failures are reported by throwing franka::Exception.
+   */
+  using Setter = std::function<void(franka::Robot&)>;
+
+  /**
+   * Applies a setting and records it if it was applied successfully. Replaces a previously
+   * recorded setting with the same name.
+   *
+   * @param[in] robot The robot to apply the setting to.
+   * @param[in] name Name of the setting. Setters of the same robot parameter, e.g. the different
+   * collision behavior services, have to use the same name.
+   * @param[in] setter Applies the setting.
+   *
+   * @throw franka::Exception if the setting cannot be applied.
+   */
+  void apply(franka::Robot& robot, const std::string& name, Setter setter);
+
+  /**
+   * Records a setting without applying it, e.g. for hardware without a libfranka robot. Replaces a
+   * previously recorded setting with the same name.
+   *
+   * @param[in] name Name of the setting, see apply().
+   * @param[in] setter Applies the setting.
+   */
+  void record(const std::string& name, Setter setter);
+
+  /**
+   * Applies all recorded settings in the order they were first recorded.
+   *
+   * @param[in] robot The robot to apply the settings to.
+   *
+   * @return Number of replayed settings.
+   * @throw franka::Exception if a setting cannot be applied.
+   */
+  size_t replay(franka::Robot& robot) const;
+
+  /**
+   * Forgets all recorded settings.
+   */
+  void clear();
+
+  /**
+   * Gets the number of recorded settings.
+   *
+   * @return Number of recorded settings.
+   */
+  size_t size() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<std::pair<std::string, Setter>> settings_;
+};
+
+}  // namespace franka_hw
@@ -1,6 +1,7 @@
 // Copyright (c) 2019 Franka Emika GmbH
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #pragma once
+#include <functional>
 #include <mutex>
 #include <vector>
 
@@ -18,6 +19,9 @@
 #include <franka_msgs/SetKFrame.h>
 #include <franka_msgs/SetLoad.h>
 
+#include <franka_hw/robot_command_queue.h>
+#include <franka_hw/robot_settings.h>
+
 namespace franka_hw {
 
 /**
@@ -49,6 +53,38 @@ ros::ServiceServer advertiseService(
       });
 }
 
+/**
+ * Advertises a service that adds a command to a robot command queue instead of accessing the robot
+ * directly. The service returns as soon as the command is queued, with the request id of the
+ * command or an error if the queue is full.
+ *
+ * @param[in] node_handle The NodeHandle in the namespace at which to advertise the service.
+ * @param[in] name The name of the service.
+ * @param[in] queue The queue to add the commands to.
+ * @param[in] handler The method executing a request once it is taken from the queue.
+ * @return The service server.
+ */
+template <typename T>
+ros::ServiceServer advertiseQueuedService(
+    ros::NodeHandle& node_handle,
+    const std::string& name,
+    RobotCommandQueue& queue,
+    std::function<void(const typename T::Request&, typename T::Response&)> handler) {
+  return node_handle.advertiseService<typename T::Request, typename T::Response>(
+      name, [name, &queue, handler](typename T::Request& request, typename T::Response& response) {
+        response.request_id = queue.push(name, [handler, request]() {
+          typename T::Response unused;
+          handler(request, unused);
+        });
+        response.success = response.request_id != 0;
+        if (!response.success) {
+          response.error = "Command queue is full.";
+          ROS_ERROR_STREAM(name << " failed: " << response.error);
+        }
+        return true;
+      });
+}
+
 /**
  * This class serves as container that gathers all possible service interfaces to a libfranka robot
  * instance.
@@ -67,6 +103,19 @@ class ServiceContainer {
     return *this;
   }
 
+  /**
+   * Advertises and adds a queued service to the container class.
+   *
+   * @return A reference to the service container to allow a fluent API.
+   */
+  template <typename T, typename... TArgs>
+  ServiceContainer& advertiseQueuedService(TArgs&&... args) {
+    ros::ServiceServer server =
+        franka_hw::advertiseQueuedService<T>(std::forward<TArgs>(args)...);
+    services_.push_back(server);
+    return *this;
+  }
+
  private:
   std::vector<ros::ServiceServer> services_;
 };
@@ -84,6 +133,44 @@ void setupServices(franka::Robot& robot,
                    ros::NodeHandle& node_handle,
                    ServiceContainer& services);
 
+/**
+ * Sets up all services relevant for a libfranka robot inside a service container. The services get
+ * the robot when they are called, so they stay valid across disconnects and reconnects, and record
+ * every applied setting to replay it after a reconnect.
+ *
+ * @param[in] robot Getter for the connected robot, returning nullptr while disconnected.
+ * @param[in] robot_mutex A mutex to lock before accessing the robot, if queue is nullptr.
+ * @param[in] queue The queue to add the requests to, or nullptr to access the robot directly.
+ * @param[in] settings Records the applied settings.
+ * @param[in] node_handle The NodeHandle in the namespace at which to advertise the services.
+ * @param[in] services The container to store the service servers.
+ */
+void setupServices(const std::function<franka::Robot*()>& robot,
+                   std::mutex& robot_mutex,
+                   RobotCommandQueue* queue,
+                   RobotSettings& settings,
+                   ros::NodeHandle& node_handle,
+                   ServiceContainer& services);
+
+/**
+ * Sets up the same services as the getter-based setupServices for hardware without a libfranka
+ * robot, e.g. FrankaMockHW. While connected, the services accept every request and only record
+ * the settings instead of applying them.
+ *
+ * @param[in] connected Checks whether the hardware is connected.
+ * @param[in] robot_mutex A mutex to lock before recording a setting, if queue is nullptr.
+ * @param[in] queue The queue to add the requests to, or nullptr to record the settings directly.
+ * @param[in] settings Records the settings.
+ * @param[in] node_handle The NodeHandle in the namespace at which to advertise the services.
+ * @param[in] services The container to store the service servers.
+ */
+void setupRecordingServices(const std::function<bool()>& connected,
+                            std::mutex& robot_mutex,
+                            RobotCommandQueue* queue,
+                            RobotSettings& settings,
+                            ros::NodeHandle& node_handle,
+                            ServiceContainer& services);
+
 /**
  * Callback for the service interface to franka::robot::setCartesianImpedance.
  *
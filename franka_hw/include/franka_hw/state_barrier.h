@@ -0,0 +1,96 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace franka_hw {
+
+/**
+ * Synchronizes a control loop with the robot states of several arms.
+ *
+ * The control threads of the arms signal every new robot state, and the control loop waits until
+ * every arm has delivered a new state since its last cycle. The barrier measures the phase skew
+ * between the first and the last state of a cycle and counts the arms whose state was stale,
+ * i.e. which did not deliver a new state in time.
+ */
+class StateBarrier {
+ public:
+  /**
+   * Statistics of the synchronized cycles.
+   */
+  struct Statistics {
+    /** Number of cycles. */
+    uint64_t cycles{0};
+    /** Number of cycles in which not every arm delivered a new state in time. */
+    uint64_t timeouts{0};
+    /** Number of cycles without a new state, per arm. */
+    std::vector<uint64_t> stale_states;
+    /** Phase skew between the first and the last state of the last complete cycle [s]. */
+    double skew{0.0};
+    /** Mean phase skew of all complete cycles [s]. */
+    double mean_skew{0.0};
+    /** Maximum phase skew of all complete cycles [s]. */
+    double max_skew{0.0};
+  };
+
+  /**
+   * Creates an instance of StateBarrier.
+   *
+   * @param[in] arms Number of arms.
+   */
+  explicit StateBarrier(size_t arms);
+
+  StateBarrier(const StateBarrier&) = delete;
+  StateBarrier& operator=(const StateBarrier&) = delete;
+
+  /**
+   * Signals a new robot state of an arm. Called from the control thread of the arm.
+   *
+   * @param[in] arm Index of the arm.
+   * @param[in] robot_time Time of the robot state on the clock of the robot [s].
+   */
+  void signal(size_t arm, double robot_time);
+
+  /**
+   * Waits until every arm delivered a new robot state since the last call or the timeout passed.
+   *
+   * @param[in] timeout Maximum time to wait.
+   * @param[out] period Robot time of the first arm passed since the last cycle in which it
+   * delivered a state [s]. Unchanged if the first arm has no new state or no earlier state.
+   *
+   * @return True if every arm delivered a new state, false on timeout.
+   */
+  bool wait(std::chrono::steady_clock::duration timeout, double* period);
+
+  /**
+   * Forgets states delivered since the last call of wait(), e.g. while the control loop is not
+   * synchronized, so they do not count towards the next cycle. Keeps the statistics.
+   */
+  void reset();
+
+  /**
+   * Gets the statistics.
+   *
+   * @return A copy of the statistics.
+   */
+  Statistics statistics() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable arrived_condition_;
+  std::vector<uint8_t> arrived_;
+  size_t arrived_count_{0};
+  std::vector<std::chrono::steady_clock::time_point> arrival_times_;
+  std::vector<double> robot_times_;
+  double last_robot_time_{-1.0};
+  Statistics statistics_;
+  uint64_t complete_cycles_{0};
+  double skew_sum_{0.0};
+};
+
+}  // namespace franka_hw
@@ -0,0 +1,183 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <franka/robot_state.h>
+
+#include <franka_hw/state_log.h>
+
+namespace franka_hw {
+
+/**
+ * Magic number at the beginning of every state channel segment ("FRSC").
+ */
+constexpr uint32_t kStateChannelMagic = 0x43535246;
+
+/**
+ * Version of the layout of StateChannelHeader and StateChannelSlot.
+ */
+constexpr uint32_t kStateChannelVersion = 2;
+
+/**
+ * Offset of the first slot in a state channel segment. The header is padded to this size.
+ */
+constexpr size_t kStateChannelHeaderSize = 64;
+
+/**
+ * Header at the beginning of a state channel segment.
+ */
+struct StateChannelHeader {
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t capacity;
+  /** Number of states written so far. */
+  std::atomic<uint64_t> write_count;
+  /** Process id of the writer, used to detect segments left behind by a crashed writer. */
+  int32_t writer_pid;
+};
+
+static_assert(sizeof(StateChannelHeader) <= kStateChannelHeaderSize,
+              "State channel header exceeds its reserved size");
+
+/**
+ * A slot of the ring buffer of a state channel, protected by a sequence lock. The sequence is odd
+ * while the writer copies the record and 2 * (index + 1) once the state with the given write
+ * index is complete.
+ */
+struct StateChannelSlot {
+  std::atomic<uint64_t> sequence;
+  StateLogRecord record;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "State channels require lock-free 64 bit atomics");
+
+/**
+ * Publishes robot states in a named POSIX shared memory segment, so processes on the same
+ * computer can read them without serialization.
+ *
+ * The segment holds a ring buffer of StateLogRecord slots, each protected by a sequence lock.
+ * Writing never blocks on readers, readers retry if a slot was overwritten while they copied it.
+ */
+class StateChannelWriter {
+ public:
+  /**
+   * Creates the shared memory segment and prefaults it. An existing segment of the same name is
+   * only replaced if its writer process no longer exists.
+   *
+   * @param[in] name Name of the segment, e.g. "/franka_state_panda".
+   * @param[in] capacity Number of states kept in the ring buffer.
+   *
+   * @throw std::runtime_error if the segment cannot be created or is in use by another writer.
+   */
+  StateChannelWriter(const std::string& name, size_t capacity);
+
+  /**
+   * Unmaps and removes the shared memory segment. Readers keep their mapping.
+   */
+  ~StateChannelWriter();
+
+  StateChannelWriter(const StateChannelWriter&) = delete;
+  StateChannelWriter& operator=(const StateChannelWriter&) = delete;
+
+  /**
+   * Writes a robot state into the next slot. Must only be called from a single thread.
+   *
+   * @param[in] robot_state The robot state to write.
+   */
+  void write(const franka::RobotState& robot_state) noexcept;
+
+  /**
+   * Gets the number of states written so far.
+   *
+   * @return Number of written states.
+   */
+  uint64_t writtenStates() const noexcept;
+
+ private:
+  std::string name_;
+  size_t size_;
+  void* data_;
+  StateChannelHeader* header_;
+  StateChannelSlot* slots_;
+  uint64_t write_count_{0};
+};
+
+/**
+ * Reads robot states from a segment created by a StateChannelWriter.
+ *
+ * A reader has to be created again if the writer is restarted, since a restarted writer creates
+ * a new segment.
+ */
+class StateChannelReader {
+ public:
+  /**
+   * Maps an existing shared memory segment.
+   *
+   * @param[in] name Name of the segment.
+   *
+   * @throw std::runtime_error if the segment does not exist or has an incompatible layout.
+   */
+  explicit StateChannelReader(const std::string& name);
+
+  /**
+   * Unmaps the shared memory segment.
+   */
+  ~StateChannelReader();
+
+  StateChannelReader(const StateChannelReader&) = delete;
+  StateChannelReader& operator=(const StateChannelReader&) = delete;
+
+  /**
+   * Reads the latest state.
+   *
+   * @param[out] record The record to fill. Its sequence is the write index of the state.
+   *
+   * @return True if a state was read, false if no state has been written yet.
+   */
+  bool readLatest(StateLogRecord* record) noexcept;
+
+  /**
+   * Reads the latest state.
+   *
+   * @param[out] robot_state The robot state to fill.
+   *
+   * @return True if a state was read, false if no state has been written yet.
+   */
+  bool readLatest(franka::RobotState* robot_state);
+
+  /**
+   * Reads the oldest state written since the reader was created that has not been read with
+   * readNext() yet. States that were overwritten before they could be read are skipped and
+   * counted, see missedStates().
+   *
+   * @param[out] record The record to fill. Its sequence is the write index of the state.
+   *
+   * @return True if a state was read, false if there is no new state.
+   */
+  bool readNext(StateLogRecord* record) noexcept;
+
+  /**
+   * Gets the number of states skipped by readNext() because they were overwritten.
+   *
+   * @return Number of missed states.
+   */
+  uint64_t missedStates() const noexcept;
+
+ private:
+  bool read(uint64_t index, StateLogRecord* record) const noexcept;
+
+  size_t size_;
+  void* data_;
+  const StateChannelHeader* header_;
+  const StateChannelSlot* slots_;
+  uint64_t next_index_{0};
+  uint64_t missed_states_{0};
+};
+
+}  // namespace franka_hw
@@ -0,0 +1,348 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <franka/control_types.h>
+#include <franka/errors.h>
+#include <franka/robot_state.h>
+
+#include <franka_hw/control_mode.h>
+#include <franka_msgs/FrankaState.h>
+
+namespace franka_hw {
+
+/**
+ * Magic number at the beginning of every state log segment file ("FRSL").
+ */
+constexpr uint32_t kStateLogMagic = 0x4c535246;
+
+/**
+ * Version of the binary layout of StateLogSegmentHeader and StateLogRecord.
+ */
+constexpr uint32_t kStateLogVersion = 1;
+
+/**
+ * Offset of the first record in a segment file. The header is padded to this size.
+ */
+constexpr size_t kStateLogHeaderSize = 64;
+
+/**
+ * Header at the beginning of every state log segment file.
+ */
+struct StateLogSegmentHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t record_size;
+  uint64_t capacity;
+  uint64_t segment_index;
+  uint64_t record_count;
+};
+
+static_assert(sizeof(StateLogSegmentHeader) <= kStateLogHeaderSize,
+              "State log segment header exceeds its reserved size");
+
+/**
+ * A single sample of the state log. Contains all numeric fields of a franka::RobotState (with the
+ * same names and units) together with the commands that were sent to the robot in the same cycle.
+ *
+ * franka::RobotState itself is not trivially copyable (franka::Errors holds references into
+ * itself), therefore errors are stored as bitmasks, see errorsToBitmask().
+ */
+struct StateLogRecord {
+  uint64_t sequence;
+  double time;
+  double control_command_success_rate;
+  uint64_t current_errors;
+  uint64_t last_motion_errors;
+  uint32_t robot_mode;
+  uint32_t control_mode;
+
+  std::array<double, 16> O_T_EE;    // NOLINT(readability-identifier-naming)
+  std::array<double, 16> O_T_EE_d;  // NOLINT(readability-identifier-naming)
+  std::array<double, 16> F_T_EE;    // NOLINT(readability-identifier-naming)
+  std::array<double, 16> F_T_NE;    // NOLINT(readability-identifier-naming)
+  std::array<double, 16> NE_T_EE;   // NOLINT(readability-identifier-naming)
+  std::array<double, 16> EE_T_K;    // NOLINT(readability-identifier-naming)
+  double m_ee;
+  std::array<double, 9> I_ee;       // NOLINT(readability-identifier-naming)
+  std::array<double, 3> F_x_Cee;    // NOLINT(readability-identifier-naming)
+  double m_load;
+  std::array<double, 9> I_load;     // NOLINT(readability-identifier-naming)
+  std::array<double, 3> F_x_Cload;  // NOLINT(readability-identifier-naming)
+  double m_total;
+  std::array<double, 9> I_total;     // NOLINT(readability-identifier-naming)
+  std::array<double, 3> F_x_Ctotal;  // NOLINT(readability-identifier-naming)
+  std::array<double, 2> elbow;
+  std::array<double, 2> elbow_d;
+  std::array<double, 2> elbow_c;
+  std::array<double, 2> delbow_c;
+  std::array<double, 2> ddelbow_c;
+  std::array<double, 7> tau_J;    // NOLINT(readability-identifier-naming)
+  std::array<double, 7> tau_J_d;  // NOLINT(readability-identifier-naming)
+  std::array<double, 7> dtau_J;   // NOLINT(readability-identifier-naming)
+  std::array<double, 7> q;
+  std::array<double, 7> q_d;
+  std::array<double, 7> dq;
+  std::array<double, 7> dq_d;
+  std::array<double, 7> ddq_d;
+  std::array<double, 7> joint_contact;
+  std::array<double, 6> cartesian_contact;
+  std::array<double, 7> joint_collision;
+  std::array<double, 6> cartesian_collision;
+  std::array<double, 7> tau_ext_hat_filtered;
+  std::array<double, 6> O_F_ext_hat_K;  // NOLINT(readability-identifier-naming)
+  std::array<double, 6> K_F_ext_hat_K;  // NOLINT(readability-identifier-naming)
+  std::array<double, 6> O_dP_EE_d;      // NOLINT(readability-identifier-naming)
+  std::array<double, 3> O_ddP_O;        // NOLINT(readability-identifier-naming)
+  std::array<double, 16> O_T_EE_c;      // NOLINT(readability-identifier-naming)
+  std::array<double, 6> O_dP_EE_c;      // NOLINT(readability-identifier-naming)
+  std::array<double, 6> O_ddP_EE_c;     // NOLINT(readability-identifier-naming)
+  std::array<double, 7> theta;
+  std::array<double, 7> dtheta;
+
+  std::array<double, 7> tau_J_command;  // NOLINT(readability-identifier-naming)
+  std::array<double, 7> q_command;
+  std::array<double, 7> dq_command;
+  std::array<double, 16> O_T_EE_command;  // NOLINT(readability-identifier-naming)
+  std::array<double, 2> elbow_pose_command;
+  std::array<double, 6> O_dP_EE_command;  // NOLINT(readability-identifier-naming)
+  std::array<double, 2> elbow_velocity_command;
+};
+
+static_assert(std::is_trivially_copyable<StateLogRecord>::value,
+              "StateLogRecord must be trivially copyable");
+static_assert(std::is_standard_layout<StateLogRecord>::value,
+              "StateLogRecord must have standard layout");
+
+/**
+ * Describes a column of double values inside a StateLogRecord, e.g. for exporting logs.
+ */
+struct StateLogColumn {
+  const char* name;
+  size_t offset;
+  size_t size;
+};
+
+/**
+ * Gets all columns of double values of a StateLogRecord in the order of the record layout.
+ *
+ * @return The list of columns.
+ */
+const std::vector<StateLogColumn>& stateLogColumns();
+
+/**
+ * Packs the flags of a franka::Errors instance into a bitmask. Bit i is set if the i-th error
+ * in the order of franka_msgs/Errors is active.
+ *
+ * @param[in] errors The errors to pack.
+ *
+ * @return The bitmask.
+ */
+uint64_t errorsToBitmask(const franka::Errors& errors) noexcept;
+
+/**
+ * Copies all fields of a robot state into a record. The sequence number, control mode and
+ * commands are left untouched.
+ *
+ * @param[in] robot_state The robot state to copy.
+ * @param[out] record The record to fill.
+ */
+void toStateLogRecord(const franka::RobotState& robot_state, StateLogRecord* record) noexcept;
+
+/**
+ * Unpacks a bitmask created by errorsToBitmask().
+ *
+ * @param[in] bitmask The bitmask to unpack.
+ *
+ * @return The errors.
+ */
+franka::Errors bitmaskToErrors(uint64_t bitmask);
+
+/**
+ * Restores a robot state from a record.
+ *
+ * @param[in] record The record to copy.
+ * @param[out] robot_state The robot state to fill.
+ */
+void fromStateLogRecord(const StateLogRecord& record, franka::RobotState* robot_state);
+
+/**
+ * Converts a record into a FrankaState message. The header stamp is set to the robot time.
+ *
+ * @param[in] record The record to convert.
+ * @param[out] message The message to fill.
+ */
+void toFrankaStateMessage(const StateLogRecord& record, franka_msgs::FrankaState* message);
+
+/**
+ * Converts a FrankaState message into a record. Commands are set to zero.
+ *
+ * @param[in] message The message to convert.
+ * @param[out] record The record to fill.
+ */
+void fromFrankaStateMessage(const franka_msgs::FrankaState& message, StateLogRecord* record);
+
+/**
+ * Writes robot states and commands into preallocated, memory-mapped segment files.
+ *
+ * Writing a record does not allocate, lock or call into the file system, so log() can be called
+ * from the libfranka control callback. A background thread prepares the next segment file ahead
+ * of time and finalizes full segments. If no spare segment is ready when the active one is full,
+ * records are dropped and counted.
+ */
+class StateLogWriter {
+ public:
+  /**
+   * Configuration of a StateLogWriter.
+   */
+  struct Config {
+    /** Directory to store segment files in. Created if it does not exist. */
+    std::string directory{"/tmp/franka_state_log"};
+    /** File name prefix of segment files, e.g. the arm_id. */
+    std::string prefix{"state_log"};
+    /** Number of records per segment file. */
+    size_t segment_size{60000};
+    /** Number of full segment files to keep. Older files are deleted. 0 keeps all files. */
+    size_t max_segments{0};
+  };
+
+  /**
+   * Creates the log directory and the first segment file. Segments are numbered after the existing
+   * segments with the same prefix, so logs of earlier runs are never overwritten.
+   *
+   * @param[in] config The configuration of the writer.
+   *
+   * @throw std::runtime_error if the first segment cannot be created.
+   */
+  explicit StateLogWriter(const Config& config);
+
+  /**
+   * Stops the background thread and truncates the active segment to the written records.
+   */
+  ~StateLogWriter();
+
+  StateLogWriter(const StateLogWriter&) = delete;
+  StateLogWriter& operator=(const StateLogWriter&) = delete;
+
+  /**
+   * Appends a record to the log. Must only be called from a single thread.
+   *
+   * @param[in] robot_state The robot state received in the current cycle.
+   * @param[in] control_mode The active control mode.
+   * @param[in] torques The current joint torque command.
+   * @param[in] joint_positions The current joint position command.
+   * @param[in] joint_velocities The current joint velocity command.
+   * @param[in] cartesian_pose The current Cartesian pose command.
+   * @param[in] cartesian_velocities The current Cartesian velocity command.
+   *
+   * @return True if the record was written, false if it was dropped.
+   */
+  bool log(const franka::RobotState& robot_state,
+           ControlMode control_mode,
+           const franka::Torques& torques,
+           const franka::JointPositions& joint_positions,
+           const franka::JointVelocities& joint_velocities,
+           const franka::CartesianPose& cartesian_pose,
+           const franka::CartesianVelocities& cartesian_velocities) noexcept;
+
+  /**
+   * Gets the number of records written so far.
+   *
+   * @return Number of written records.
+   */
+  uint64_t writtenRecords() const noexcept;
+
+  /**
+   * Gets the number of records dropped because no segment was available.
+   *
+   * @return Number of dropped records.
+   */
+  uint64_t droppedRecords() const noexcept;
+
+  /**
+   * Checks whether the background thread finalized the last full segment and prepared the next
+   * one, so the active segment can be rotated without dropping records.
+   *
+   * @return True if a spare segment is ready.
+   */
+  bool spareSegmentReady() const noexcept;
+
+ private:
+  struct Segment;
+
+  bool rotate() noexcept;
+  void maintenanceLoop();
+  std::unique_ptr<Segment> createSegment();
+  void retireSegment(std::unique_ptr<Segment> segment);
+
+  Config config_;
+  uint64_t next_segment_index_{0};
+  uint64_t sequence_number_{0};
+  std::deque<std::string> finished_segments_;
+
+  std::unique_ptr<Segment> active_;
+  std::atomic<Segment*> spare_{nullptr};
+  std::atomic<Segment*> retired_{nullptr};
+  std::atomic<uint64_t> written_records_{0};
+  std::atomic<uint64_t> dropped_records_{0};
+
+  std::atomic_bool running_{true};
+  std::thread maintenance_thread_;
+};
+
+/**
+ * Reads the records of all segment files of a state log in chronological order.
+ */
+class StateLogReader {
+ public:
+  /**
+   * Opens all segment files in a directory that start with the given prefix.
+   *
+   * @param[in] directory The directory containing the segment files.
+   * @param[in] prefix The file name prefix of the segment files.
+   *
+   * @throw std::runtime_error if the directory cannot be read or contains no segments.
+   */
+  StateLogReader(const std::string& directory, const std::string& prefix);
+
+  /**
+   * Reads the next record.
+   *
+   * @param[out] record The record to fill.
+   *
+   * @return True if a record was read, false if the end of the log has been reached.
+   *
+   * @throw std::runtime_error if a segment file is corrupt.
+   */
+  bool next(StateLogRecord* record);
+
+  /**
+   * Gets the paths of all segment files in reading order.
+   *
+   * @return The segment file paths.
+   */
+  const std::vector<std::string>& segments() const noexcept;
+
+ private:
+  bool openNextSegment();
+
+  std::vector<std::string> segments_;
+  size_t current_segment_{0};
+  std::ifstream stream_;
+  uint64_t remaining_records_{0};
+};
+
+}  // namespace franka_hw
@@ -0,0 +1,83 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <ros/node_handle.h>
+
+namespace franka_hw {
+
+/**
+ * Scheduling of a thread.
+ */
+struct ThreadConfig {
+  /**
+   * Scheduling policy of a thread.
+   */
+  enum class Policy {
+    /** Keep the policy and priority the thread was created with. */
+    kInherit,
+    /** SCHED_OTHER */
+    kOther,
+    /** SCHED_FIFO */
+    kFifo,
+    /** SCHED_RR */
+    kRoundRobin
+  };
+
+  /** CPUs to run the thread on. Empty to keep the CPUs the thread was created with. */
+  std::vector<int> cpus;
+  /** Scheduling policy of the thread. */
+  Policy policy{Policy::kInherit};
+  /** Priority of the thread for the kFifo and kRoundRobin policies. */
+  int priority{0};
+  /** Number of bytes of stack to touch once so it is mapped before it is used [B]. */
+  size_t stack_prefault{0};
+};
+
+/**
+ * Reads the configuration of a thread from the parameters threads/<name>/{cpus, policy, priority,
+ * stack_prefault}. Parameters which are not set keep the values of the given configuration.
+ *
+ * @param[in] node_handle Node handle in the namespace of the threads parameters.
+ * @param[in] name Name of the thread.
+ * @param[in,out] config The configuration to update.
+ *
+ * @return True if all given parameters are valid, false otherwise.
+ */
+bool readThreadConfig(const ros::NodeHandle& node_handle,
+                      const std::string& name,
+                      ThreadConfig* config);
+
+/**
+ * Gets the configuration the calling thread currently runs with.
+ *
+ * @return The current configuration, with kOther as policy for non-realtime policies.
+ */
+ThreadConfig currentThreadConfig();
+
+/**
+ * Applies the given configuration to the calling thread, prefaults its stack and checks that the
+ * configuration is in effect. The resulting scheduling or the error is logged.
+ *
+ * Threads created by the calling thread afterwards inherit its CPUs, policy and priority.
+ *
+ * @param[in] name Name of the thread for logging.
+ * @param[in] config The configuration to apply.
+ *
+ * @return True if the configuration is in effect, false otherwise.
+ */
+bool configureCurrentThread(const std::string& name, const ThreadConfig& config);
+
+/**
+ * Locks all current and future pages of the process into memory, so the realtime threads do not
+ * run into page faults.
+ *
+ * @return True if successful, false otherwise.
+ */
+bool lockMemory();
+
+}  // namespace franka_hw
@@ -2,18 +2,61 @@
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #pragma once
 
+#include <cstdint>
+
+#include <ros/duration.h>
 #include <ros/time.h>
 
 namespace franka_hw {
 
+/**
+ * Triggers at a fixed rate, e.g. to publish at a lower rate than the control loop.
+ *
+ * The trigger is driven either by the period of the control loop or by a time stamp, so it
+ * follows simulated time and does not need to read the clock in realtime code. Triggers keep a
+ * fixed phase, e.g. a 300 Hz trigger in a 1 kHz loop alternately triggers every third and fourth
+ * cycle. If it falls behind by more than one period, the missed triggers are skipped.
+ */
 class TriggerRate {
  public:
+  /**
+   * Creates a trigger that triggers on its first call.
+   *
+   * @param[in] rate Rate to trigger at [Hz]. Never triggers if the rate is not positive.
+   */
   explicit TriggerRate(double rate = 30.0);
+
+  /**
+   * Advances the trigger by the period of the control loop.
+   *
+   * @param[in] period Time since the last call, e.g. the period passed to a controller update.
+   *
+   * @return True if the trigger is due.
+   */
+  bool operator()(const ros::Duration& period);
+
+  /**
+   * Advances the trigger to the given time.
+   *
+   * @param[in] time Current time, e.g. the time passed to a controller update.
+   *
+   * @return True if the trigger is due.
+   */
+  bool operator()(const ros::Time& time);
+
+  /**
+   * Advances the trigger to ros::Time::now(). Prefer the other overloads in realtime code.
+   *
+   * @return True if the trigger is due.
+   */
   bool operator()();
 
  private:
-  ros::Time time_stamp_;
-  double period_;
+  int64_t period_;
+  // Time until the next trigger [ns], used by operator()(const ros::Duration&).
+  int64_t remaining_;
+  // Time of the next trigger [ns], used by operator()(const ros::Time&). 0 before the first call.
+  int64_t next_time_{0};
 };
 
 };  // namespace franka_hw
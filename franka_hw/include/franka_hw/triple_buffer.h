@@ -0,0 +1,76 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace franka_hw {
+
+/**
+ * Wait-free exchange of the latest value between a single writer and a single reader thread.
+ *
+ * The writer fills writeBuffer() and calls publish(), the reader calls update() and then reads
+ * readBuffer(). Neither side ever blocks or copies: the three buffers are only swapped by index.
+ * Values published in between two calls to update() are overwritten, the reader always gets the
+ * latest one.
+ */
+template <typename T>
+class TripleBuffer {
+ public:
+  /**
+   * Creates a triple buffer with all buffers initialized to the given value.
+   *
+   * @param[in] initial The initial value of all buffers.
+   */
+  explicit TripleBuffer(const T& initial = T()) : buffers_{{initial, initial, initial}} {}
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  /**
+   * Gets the buffer to fill with the next value. Only to be used by the writer.
+   *
+   * @return The buffer of the writer.
+   */
+  T& writeBuffer() noexcept { return buffers_[back_]; }
+
+  /**
+   * Makes the filled write buffer available to the reader. Only to be used by the writer.
+   */
+  void publish() noexcept {
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  /**
+   * Fetches the latest published value, if any. Only to be used by the reader.
+   *
+   * @return True if a new value was published since the last call, false otherwise.
+   */
+  bool update() noexcept {
+    if ((middle_.load(std::memory_order_acquire) & kFresh) == 0) {
+      return false;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  /**
+   * Gets the latest value fetched with update(). Only to be used by the reader.
+   *
+   * @return The buffer of the reader.
+   */
+  const T& readBuffer() const noexcept { return buffers_[front_]; }
+
+ private:
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kFresh = 0x4;
+
+  std::array<T, 3> buffers_;
+  alignas(64) uint8_t back_{0};
+  alignas(64) std::atomic<uint8_t> middle_{1};
+  alignas(64) uint8_t front_{2};
+};
+
+}  // namespace franka_hw
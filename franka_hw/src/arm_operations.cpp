@@ -0,0 +1,138 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/arm_operations.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+namespace franka_hw {
+
+ArmOperations::ArmOperations(std::vector<std::string> arm_ids) : arm_ids_(std::move(arm_ids)) {
+  for (size_t arm = 0; arm < arm_ids_.size(); arm++) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+}
+
+ArmOperations::~ArmOperations() {
+  for (auto& worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+std::vector<ArmOperationResult> ArmOperations::run(const std::vector<size_t>& arms,
+                                                   const std::function<void(size_t)>& operation,
+                                                   double timeout) {
+  std::lock_guard<std::mutex> run_lock(run_mutex_);
+  // Timed out operations outlive this call, so their threads own a copy of the operation.
+  auto shared_operation = std::make_shared<std::function<void(size_t)>>(operation);
+  std::vector<ArmOperationResult> results(arms.size());
+  for (size_t i = 0; i < arms.size(); i++) {
+    const size_t arm = arms[i];
+    Worker& worker = *workers_.at(arm);
+    results[i].arm_id = arm_ids_[arm];
+    if (worker.busy) {
+      results[i].busy = true;
+      results[i].error = "Busy with a previous operation.";
+      continue;
+    }
+    // The previous operation finished, so this does not block.
+    if (worker.thread.joinable()) {
+      worker.thread.join();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      worker.finished = false;
+    }
+    worker.busy = true;
+    worker.thread = std::thread([this, &worker, shared_operation, arm]() {
+      const auto start = std::chrono::steady_clock::now();
+      bool success = false;
+      std::string error;
+      try {
+        (*shared_operation)(arm);
+        success = true;
+      } catch (const std::exception& ex) {
+        error = ex.what();
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        worker.finished = true;
+        worker.success = success;
+        worker.error = error;
+        worker.duration =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        worker.busy = false;
+      }
+      finished_condition_.notify_all();
+    });
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_condition_.wait_until(lock, deadline, [&]() {
+    for (size_t i = 0; i < arms.size(); i++) {
+      if (!results[i].busy && !workers_[arms[i]]->finished) {
+        return false;
+      }
+    }
+    return true;
+  });
+  for (size_t i = 0; i < arms.size(); i++) {
+    ArmOperationResult& result = results[i];
+    const Worker& worker = *workers_[arms[i]];
+    if (result.busy) {
+      continue;
+    }
+    if (!worker.finished) {
+      result.timed_out = true;
+      result.duration = timeout;
+      result.error = "Timed out.";
+      continue;
+    }
+    result.success = worker.success;
+    result.error = worker.error;
+    result.duration = worker.duration;
+  }
+  return results;
+}
+
+bool ArmOperations::busy(size_t arm) const noexcept {
+  return workers_[arm]->busy;
+}
+
+bool ArmOperations::anyBusy() const noexcept {
+  return std::any_of(workers_.cbegin(), workers_.cend(),
+                     [](const std::unique_ptr<Worker>& worker) { return worker->busy.load(); });
+}
+
+bool allSucceeded(const std::vector<ArmOperationResult>& results) {
+  return std::all_of(results.cbegin(), results.cend(),
+                     [](const ArmOperationResult& result) { return result.success; });
+}
+
+std::string summarize(const std::vector<ArmOperationResult>& results) {
+  std::ostringstream summary;
+  summary << std::fixed << std::setprecision(2);
+  for (size_t i = 0; i < results.size(); i++) {
+    const ArmOperationResult& result = results[i];
+    summary << (i > 0 ? ", " : "") << result.arm_id << ": ";
+    if (result.success) {
+      summary << "ok (" << result.duration << " s)";
+    } else if (result.timed_out) {
+      summary << "timed out after " << result.duration << " s";
+    } else if (result.busy) {
+      summary << "busy with a previous operation";
+    } else {
+      summary << "failed: " << result.error;
+    }
+  }
+  return summary.str();
+}
+
+}  // namespace franka_hw
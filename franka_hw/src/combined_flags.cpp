@@ -0,0 +1,30 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/combined_flags.h>
+
+namespace franka_hw {
+
+constexpr size_t CombinedFlags::kMaxArms;
+
+void CombinedFlags::set(Flag flag, size_t arm, bool value) noexcept {
+  const uint64_t bit = uint64_t(1) << arm;
+  if (value) {
+    masks_[flag].fetch_or(bit);
+  } else {
+    masks_[flag].fetch_and(~bit);
+  }
+}
+
+bool CombinedFlags::test(Flag flag, size_t arm) const noexcept {
+  return (masks_[flag].load() & (uint64_t(1) << arm)) != 0;
+}
+
+bool CombinedFlags::any(Flag flag) const noexcept {
+  return masks_[flag].load() != 0;
+}
+
+uint64_t CombinedFlags::mask(Flag flag) const noexcept {
+  return masks_[flag].load();
+}
+
+}  // namespace franka_hw
@@ -0,0 +1,266 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/control_deadline.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+namespace franka_hw {
+
+namespace {
+
+// Time between two commands of the libfranka control loop [s].
+constexpr double kCommandPeriod = 0.001;
+
+double toSec(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+// Rotates the rotation part of the column-major homogeneous transformation by the angular
+// velocity for one command period.
+void integrateRotation(const std::array<double, 3>& angular_velocity,
+                       std::array<double, 16>* transformation) {
+  const double speed =
+      std::sqrt(angular_velocity[0] * angular_velocity[0] +
+                angular_velocity[1] * angular_velocity[1] + angular_velocity[2] * angular_velocity[2]);
+  const double angle = speed * kCommandPeriod;
+  if (angle < 1e-12) {
+    return;
+  }
+  const double x = angular_velocity[0] / speed;
+  const double y = angular_velocity[1] / speed;
+  const double z = angular_velocity[2] / speed;
+  const double s = std::sin(angle);
+  const double c = 1.0 - std::cos(angle);
+  // Rodrigues' formula, row-major.
+  const std::array<double, 9> rotation{{1.0 - c * (y * y + z * z), -s * z + c * x * y,
+                                        s * y + c * x * z, s * z + c * x * y,
+                                        1.0 - c * (x * x + z * z), -s * x + c * y * z,
+                                        -s * y + c * x * z, s * x + c * y * z,
+                                        1.0 - c * (x * x + y * y)}};
+  std::array<double, 16> result = *transformation;
+  for (size_t row = 0; row < 3; row++) {
+    for (size_t column = 0; column < 3; column++) {
+      double value = 0.0;
+      for (size_t k = 0; k < 3; k++) {
+        value += rotation[row * 3 + k] * (*transformation)[column * 4 + k];
+      }
+      result[column * 4 + row] = value;
+    }
+  }
+  *transformation = result;
+}
+
+}  // anonymous namespace
+
+ControlDeadline::ControlDeadline(const Config& config) : config_(config) {}
+
+ControlDeadline::~ControlDeadline() {
+  stop();
+}
+
+bool ControlDeadline::start(Update update) {
+  stop();
+  update_ = std::move(update);
+  stopping_ = false;
+  busy_ = false;
+  continue_motion_ = true;
+  first_cycle_ = true;
+  accumulated_period_ = franka::Duration();
+  last_result_ = Result::kUpdated;
+  consecutive_overruns_ = 0;
+  std::promise<bool> configured;
+  std::future<bool> configured_result = configured.get_future();
+  worker_ = std::thread(&ControlDeadline::run, this, std::move(configured));
+  if (!configured_result.get()) {
+    worker_.join();
+    return false;
+  }
+  return true;
+}
+
+void ControlDeadline::stop() {
+  if (!worker_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  update_requested_.notify_one();
+  worker_.join();
+}
+
+bool ControlDeadline::running() const noexcept {
+  return worker_.joinable();
+}
+
+ControlDeadline::Result ControlDeadline::cycle(const franka::RobotState& robot_state,
+                                               franka::Duration time_step) {
+  if (!first_cycle_ && robot_state.time == last_cycle_time_) {
+    return last_result_;
+  }
+  first_cycle_ = false;
+  last_cycle_time_ = robot_state.time;
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(config_.budget));
+  accumulated_period_ += time_step;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  statistics_.cycles++;
+  if (!busy_) {
+    if (!continue_motion_) {
+      last_result_ = Result::kFinished;
+      return last_result_;
+    }
+    robot_state_ = robot_state;
+    update_period_ = accumulated_period_;
+    accumulated_period_ = franka::Duration();
+    busy_ = true;
+    update_requested_.notify_one();
+  }
+
+  if (update_finished_.wait_until(lock, deadline, [this] { return !busy_; })) {
+    consecutive_overruns_ = 0;
+    last_result_ = continue_motion_ ? Result::kUpdated : Result::kFinished;
+    return last_result_;
+  }
+
+  consecutive_overruns_++;
+  statistics_.overruns++;
+  statistics_.max_consecutive_overruns =
+      std::max<uint64_t>(statistics_.max_consecutive_overruns, consecutive_overruns_);
+  last_result_ = consecutive_overruns_ > config_.max_consecutive_overruns ? Result::kAborted
+                                                                          : Result::kOverrun;
+  return last_result_;
+}
+
+const ControlDeadline::Config& ControlDeadline::config() const noexcept {
+  return config_;
+}
+
+ControlDeadline::Statistics ControlDeadline::statistics() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+void ControlDeadline::resetStatistics() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  statistics_ = Statistics();
+}
+
+void ControlDeadline::run(std::promise<bool> configured) {
+  if (!configureCurrentThread("ControlDeadline update", config_.thread)) {
+    configured.set_value(false);
+    return;
+  }
+  configured.set_value(true);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    update_requested_.wait(lock, [this] { return busy_ || stopping_; });
+    if (!busy_) {
+      return;
+    }
+    const franka::RobotState robot_state = robot_state_;
+    const franka::Duration period = update_period_;
+    lock.unlock();
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool continue_motion = update_(robot_state, period);
+    const double duration = toSec(std::chrono::steady_clock::now() - start);
+
+    lock.lock();
+    continue_motion_ = continue_motion;
+    statistics_.max_update_duration = std::max(statistics_.max_update_duration, duration);
+    busy_ = false;
+    update_finished_.notify_one();
+  }
+}
+
+template <>
+franka::Torques commandFromState<franka::Torques>(const franka::RobotState& robot_state) {
+  return franka::Torques(robot_state.tau_J_d);
+}
+
+template <>
+franka::JointPositions commandFromState<franka::JointPositions>(
+    const franka::RobotState& robot_state) {
+  return franka::JointPositions(robot_state.q_d);
+}
+
+template <>
+franka::JointVelocities commandFromState<franka::JointVelocities>(
+    const franka::RobotState& robot_state) {
+  return franka::JointVelocities(robot_state.dq_d);
+}
+
+template <>
+franka::CartesianPose commandFromState<franka::CartesianPose>(
+    const franka::RobotState& robot_state) {
+  return franka::CartesianPose(robot_state.O_T_EE_c);
+}
+
+template <>
+franka::CartesianVelocities commandFromState<franka::CartesianVelocities>(
+    const franka::RobotState& robot_state) {
+  return franka::CartesianVelocities(robot_state.O_dP_EE_c);
+}
+
+franka::Torques overrunCommand(const franka::Torques& last_command,
+                               const franka::RobotState& /*robot_state*/,
+                               ControlDeadline::OverrunPolicy /*policy*/) {
+  return franka::Torques(last_command.tau_J);
+}
+
+franka::JointPositions overrunCommand(const franka::JointPositions& last_command,
+                                      const franka::RobotState& robot_state,
+                                      ControlDeadline::OverrunPolicy policy) {
+  std::array<double, 7> q = last_command.q;
+  if (policy == ControlDeadline::OverrunPolicy::kExtrapolate) {
+    for (size_t i = 0; i < q.size(); i++) {
+      q[i] += robot_state.dq_d[i] * kCommandPeriod;
+    }
+  }
+  return franka::JointPositions(q);
+}
+
+franka::JointVelocities overrunCommand(const franka::JointVelocities& last_command,
+                                       const franka::RobotState& /*robot_state*/,
+                                       ControlDeadline::OverrunPolicy /*policy*/) {
+  return franka::JointVelocities(last_command.dq);
+}
+
+franka::CartesianPose overrunCommand(const franka::CartesianPose& last_command,
+                                     const franka::RobotState& robot_state,
+                                     ControlDeadline::OverrunPolicy policy) {
+  std::array<double, 16> pose = last_command.O_T_EE;
+  std::array<double, 2> elbow = last_command.elbow;
+  if (policy == ControlDeadline::OverrunPolicy::kExtrapolate) {
+    for (size_t i = 0; i < 3; i++) {
+      pose[12 + i] += robot_state.O_dP_EE_c[i] * kCommandPeriod;
+    }
+    integrateRotation({{robot_state.O_dP_EE_c[3], robot_state.O_dP_EE_c[4],
+                        robot_state.O_dP_EE_c[5]}},
+                      &pose);
+    elbow[0] += robot_state.delbow_c[0] * kCommandPeriod;
+  }
+  if (last_command.hasElbow()) {
+    return franka::CartesianPose(pose, elbow);
+  }
+  return franka::CartesianPose(pose);
+}
+
+franka::CartesianVelocities overrunCommand(const franka::CartesianVelocities& last_command,
+                                           const franka::RobotState& /*robot_state*/,
+                                           ControlDeadline::OverrunPolicy /*policy*/) {
+  if (last_command.hasElbow()) {
+    return franka::CartesianVelocities(last_command.O_dP_EE, last_command.elbow);
+  }
+  return franka::CartesianVelocities(last_command.O_dP_EE);
+}
+
+}  // namespace franka_hw
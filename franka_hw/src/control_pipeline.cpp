@@ -0,0 +1,173 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/control_pipeline.h>
+
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace franka_hw {
+
+namespace {
+
+void updateMaximum(std::atomic<uint64_t>* maximum, uint64_t value) {
+  uint64_t current = maximum->load(std::memory_order_relaxed);
+  while (value > current &&
+         !maximum->compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+}
+
+}  // anonymous namespace
+
+ControlPipeline::ControlPipeline(const Config& config, const Commands& initial_commands)
+    : config_(config), commands_(CommandSlot{initial_commands, true}) {
+  sem_init(&wakeup_, 0, 0);
+}
+
+ControlPipeline::~ControlPipeline() {
+  stop();
+  sem_destroy(&wakeup_);
+}
+
+bool ControlPipeline::start(Update update) {
+  stop();
+  update_ = std::move(update);
+  stopping_ = false;
+  // Drop values left over from the last motion. The update thread is not running yet.
+  states_.update();
+  commands_.update();
+  while (sem_trywait(&wakeup_) == 0) {
+  }
+  first_cycle_ = true;
+  finished_ = false;
+  last_result_ = Result::kStalled;
+  consecutive_stalls_ = 0;
+  std::promise<bool> configured;
+  std::future<bool> configured_result = configured.get_future();
+  worker_ = std::thread(&ControlPipeline::run, this, std::move(configured));
+  if (!configured_result.get()) {
+    worker_.join();
+    return false;
+  }
+  return true;
+}
+
+void ControlPipeline::stop() {
+  if (!worker_.joinable()) {
+    return;
+  }
+  stopping_ = true;
+  sem_post(&wakeup_);
+  worker_.join();
+}
+
+bool ControlPipeline::running() const noexcept {
+  return worker_.joinable();
+}
+
+ControlPipeline::Result ControlPipeline::cycle(const franka::RobotState& robot_state,
+                                               const Commands** commands) {
+  *commands = &commands_.readBuffer().commands;
+  if (!first_cycle_ && robot_state.time == last_cycle_time_) {
+    return last_result_;
+  }
+  const bool first_cycle = first_cycle_;
+  first_cycle_ = false;
+  last_cycle_time_ = robot_state.time;
+  cycles_++;
+
+  // Fetch the commands computed from the previous state before publishing the current one.
+  const bool updated = commands_.update();
+  *commands = &commands_.readBuffer().commands;
+  if (!finished_) {
+    states_.writeBuffer() = robot_state;
+    states_.publish();
+    sem_post(&wakeup_);
+  }
+
+  if (updated) {
+    consecutive_stalls_ = 0;
+    finished_ = finished_ || !commands_.readBuffer().continue_motion;
+    last_result_ = finished_ ? Result::kFinished : Result::kUpdated;
+    return last_result_;
+  }
+  if (finished_) {
+    last_result_ = Result::kFinished;
+    return last_result_;
+  }
+  // No commands can exist before the first update, this is not a stall.
+  if (first_cycle) {
+    last_result_ = Result::kStalled;
+    return last_result_;
+  }
+
+  consecutive_stalls_++;
+  stalls_++;
+  updateMaximum(&max_consecutive_stalls_, consecutive_stalls_);
+  last_result_ =
+      consecutive_stalls_ > config_.max_consecutive_stalls ? Result::kAborted : Result::kStalled;
+  return last_result_;
+}
+
+const ControlPipeline::Config& ControlPipeline::config() const noexcept {
+  return config_;
+}
+
+ControlPipeline::Statistics ControlPipeline::statistics() const noexcept {
+  Statistics statistics;
+  statistics.cycles = cycles_;
+  statistics.stalls = stalls_;
+  statistics.max_consecutive_stalls = max_consecutive_stalls_;
+  statistics.max_update_duration = max_update_duration_ns_ * 1e-9;
+  return statistics;
+}
+
+void ControlPipeline::resetStatistics() noexcept {
+  cycles_ = 0;
+  stalls_ = 0;
+  max_consecutive_stalls_ = 0;
+  max_update_duration_ns_ = 0;
+}
+
+void ControlPipeline::run(std::promise<bool> configured) {
+  if (!configureCurrentThread("ControlPipeline update", config_.thread)) {
+    configured.set_value(false);
+    return;
+  }
+  configured.set_value(true);
+  bool first_update = true;
+  franka::Duration last_update_time;
+  while (true) {
+    if (sem_wait(&wakeup_) != 0 && errno == EINTR) {
+      continue;
+    }
+    if (stopping_) {
+      return;
+    }
+    // Several posts may have been coalesced into the latest robot state already.
+    if (!states_.update()) {
+      continue;
+    }
+    const franka::RobotState& robot_state = states_.readBuffer();
+    const franka::Duration period =
+        first_update ? franka::Duration() : robot_state.time - last_update_time;
+    first_update = false;
+    last_update_time = robot_state.time;
+
+    const auto start = std::chrono::steady_clock::now();
+    CommandSlot& slot = commands_.writeBuffer();
+    const bool continue_motion = update_(robot_state, period, &slot.commands);
+    slot.continue_motion = continue_motion;
+    commands_.publish();
+    updateMaximum(&max_update_duration_ns_,
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count());
+    if (!continue_motion) {
+      return;
+    }
+  }
+}
+
+}  // namespace franka_hw
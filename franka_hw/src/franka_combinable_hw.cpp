@@ -2,7 +2,8 @@
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #include <franka_hw/franka_combinable_hw.h>
 
-#include <chrono>
+#include <future>
+#include <stdexcept>
 #include <thread>
 
 #include <hardware_interface/joint_command_interface.h>
@@ -12,14 +13,16 @@
 
 #include <franka_hw/services.h>
 
-using namespace std::chrono_literals;
-
 namespace franka_hw {
 
 FrankaCombinableHW::FrankaCombinableHW() : has_error_(false), error_recovered_(false) {}
 
 bool FrankaCombinableHW::init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) {
   robot_hw_nh_ = robot_hw_nh;
+  // Needed before FrankaHW::init, which starts the control loop thread.
+  if (!readThreadConfig(robot_hw_nh, "control_loop", &control_loop_thread_config_)) {
+    return false;
+  }
   return FrankaHW::init(root_nh, robot_hw_nh);
 }
 
@@ -40,7 +43,21 @@ void FrankaCombinableHW::initROSInterfaces(ros::NodeHandle& robot_hw_nh) {
 
 void FrankaCombinableHW::initRobot() {
   FrankaHW::initRobot();
-  control_loop_thread_ = std::make_unique<std::thread>(&FrankaCombinableHW::controlLoop, this);
+  startControlLoop();
+}
+
+void FrankaCombinableHW::startControlLoop() {
+  // Refuses to start if the control loop cannot run with the configured scheduling, like the
+  // control nodes do for their own threads.
+  std::promise<bool> configured;
+  std::future<bool> configured_result = configured.get_future();
+  control_loop_thread_ = std::make_unique<std::thread>(&FrankaCombinableHW::controlLoop, this,
+                                                       std::move(configured));
+  if (!configured_result.get()) {
+    control_loop_thread_->join();
+    control_loop_thread_.reset();
+    throw std::runtime_error("Failed to configure the " + arm_id_ + " control loop thread.");
+  }
 }
 
 void FrankaCombinableHW::publishErrorState(const bool error) {
@@ -49,11 +66,17 @@ void FrankaCombinableHW::publishErrorState(const bool error) {
   has_error_pub_.publish(msg);
 }
 
-void FrankaCombinableHW::controlLoop() {
+void FrankaCombinableHW::controlLoop(std::promise<bool> configured) {
+  if (!configureCurrentThread(arm_id_ + " control loop", control_loop_thread_config_)) {
+    configured.set_value(false);
+    return;
+  }
+  configured.set_value(true);
   while (ros::ok()) {
     ros::Time last_time = ros::Time::now();
 
     // Wait until controller has been activated or error has been recovered
+    idle_loop_->enter();
     while (!controllerActive() || has_error_) {
       if (!controllerActive()) {
         ROS_DEBUG_THROTTLE(1, "FrankaCombinableHW::%s::control_loop(): controller is not active.",
@@ -70,19 +93,20 @@ void FrankaCombinableHW::controlLoop() {
       {
         std::lock_guard<std::mutex> robot_lock(robot_mutex_);
         if (connected()) {
-          std::lock_guard<std::mutex> ros_state_lock(ros_state_mutex_);
-          std::lock_guard<std::mutex> libfranka_state_lock(libfranka_state_mutex_);
-          robot_state_libfranka_ = robot_->readOnce();
-          robot_state_ros_ = robot_->readOnce();
+          readIdleState();
         }
       }
 
       if (!ros::ok()) {
         return;
       }
-      std::this_thread::sleep_for(1ms);
+      idle_loop_->wait();
     }
-    ROS_INFO("FrankaCombinableHW::%s::control_loop(): controller is active.", arm_id_.c_str());
+    const IdleLoop::Statistics idle_statistics = idle_loop_->leave();
+    ROS_INFO("FrankaCombinableHW::%s::control_loop(): controller is active. Was idle for %.1f s "
+             "with %.1f %% CPU usage and %lu state reads.",
+             arm_id_.c_str(), idle_statistics.duration, idle_statistics.cpu_usage * 100.0,
+             static_cast<unsigned long>(idle_statistics.reads));
 
     // Reset commands
     {
@@ -99,23 +123,18 @@ void FrankaCombinableHW::controlLoop() {
     } catch (const franka::ControlException& e) {
       // Reflex could be caught and it needs to wait for automatic error recovery
       ROS_ERROR("%s: %s", arm_id_.c_str(), e.what());
-      has_error_ = true;
-      publishErrorState(has_error_);
+      setError(true);
     }
   }
 }
 
 void FrankaCombinableHW::setupServicesAndActionServers(ros::NodeHandle& node_handle) {
-  if (!connected()) {
-    ROS_ERROR(
-        "FrankaCombinableHW::setupServicesAndActionServers: Cannot create services without "
-        "connected robot.");
-    return;
+  // The services get the robot when they are called, so they are kept across reconnects.
+  if (!services_) {
+    services_ = std::make_unique<ServiceContainer>();
+    setupRobotServices(node_handle, *services_);
   }
 
-  services_ = std::make_unique<ServiceContainer>();
-  setupServices(*robot_, robot_mutex_, node_handle, *services_);
-
   if (!recovery_action_server_) {
     recovery_action_server_ =
         std::make_unique<actionlib::SimpleActionServer<franka_msgs::ErrorRecoveryAction>>(
@@ -124,13 +143,13 @@ void FrankaCombinableHW::setupServicesAndActionServers(ros::NodeHandle& node_han
               if (connected()) {
                 try {
                   std::lock_guard<std::mutex> lock(robot_mutex_);
-                  robot_->automaticErrorRecovery();
+                  automaticErrorRecovery();
                   // error recovered => reset controller
                   if (has_error_) {
                     error_recovered_ = true;
                   }
-                  has_error_ = false;
-                  publishErrorState(has_error_);
+                  setError(false);
+                  idle_loop_->wakeUp();
                   recovery_action_server_->setSucceeded();
                 } catch (const franka::Exception& ex) {
                   recovery_action_server_->setAborted(franka_msgs::ErrorRecoveryResult(),
@@ -156,47 +175,45 @@ bool FrankaCombinableHW::disconnect() {
     ROS_ERROR("FrankaHW: Rejected attempt to disconnect while controller is still running!");
     return false;
   }
-  recovery_action_server_.reset();
-  services_.reset();
   return FrankaHW::disconnect();
 }
 
 void FrankaCombinableHW::control(  // NOLINT (google-default-arguments)
     const std::function<bool(const ros::Time&, const ros::Duration&)>& /*ros_callback*/) {
-  if (!controller_active_) {
+  if (!controller_active_ || run_function_ == nullptr) {
     return;
   }
+  logSwitchGap();
   auto empty_method = [](const franka::RobotState&, franka::Duration) { return true; };
-  run_function_(*robot_, empty_method);
+  (*run_function_)(*robot_, empty_method, run_parameters_);
 }
 
 bool FrankaCombinableHW::checkForConflict(
     const std::list<hardware_interface::ControllerInfo>& info) const {
-  ResourceWithClaimsMap resource_map = getResourceMap(info);
-
-  if (hasConflictingMultiClaim(resource_map)) {
+  bool valid = resource_registry_.evaluate(info, &claims_);
+  if (claims_.conflicting_multi_claim) {
     return true;
   }
 
-  ArmClaimedMap arm_claim_map;
-  if (!getArmClaimedMap(resource_map, arm_claim_map)) {
+  if (!valid) {
     ROS_ERROR("FrankaCombinableHW: Unknown interface claimed. Conflict!");
     return true;
   }
 
   // check for any claim to trajectory interfaces (non-torque) which are not supported.
-  if (hasTrajectoryClaim(arm_claim_map, arm_id_)) {
+  const auto& arm_claims = ResourceRegistry::armClaims(claims_, arm_index_);
+  if (ResourceRegistry::hasTrajectoryClaim(arm_claims)) {
     ROS_ERROR_STREAM("FrankaCombinableHW: Invalid claim joint position or velocity interface."
                      << "Note: joint position and joint velocity interfaces are not supported"
                      << " in FrankaCombinableHW. Arm:" << arm_id_ << ". Conflict!");
     return true;
   }
 
-  return partiallyClaimsArmJoints(arm_claim_map, arm_id_);
+  return ResourceRegistry::partiallyClaimsArmJoints(arm_claims, arm_id_);
 }
 
 void FrankaCombinableHW::read(const ros::Time& time, const ros::Duration& period) {
-  controller_needs_reset_ = bool(error_recovered_);
+  setControllerNeedsReset(error_recovered_);
   FrankaHW::read(time, period);
 }
 
@@ -205,7 +222,7 @@ void FrankaCombinableHW::write(const ros::Time& time, const ros::Duration& perio
   // reset_controller) must
   // have been executed to reset the controller.
   if (controller_needs_reset_ && error_recovered_) {
-    controller_needs_reset_ = false;
+    setControllerNeedsReset(false);
     error_recovered_ = false;
   }
 
@@ -214,13 +231,21 @@ void FrankaCombinableHW::write(const ros::Time& time, const ros::Duration& perio
   FrankaHW::write(time, period);
 }
 
+void FrankaCombinableHW::update(const franka::RobotState& robot_state) {
+  // A single read serves both the controllers and the libfranka callbacks.
+  std::lock_guard<std::mutex> ros_state_lock(ros_state_mutex_);
+  std::lock_guard<std::mutex> libfranka_state_lock(libfranka_state_mutex_);
+  robot_state_ros_ = robot_state;
+  robot_state_libfranka_ = robot_state;
+  signalState(robot_state);
+}
+
 std::string FrankaCombinableHW::getArmID() const noexcept {
   return arm_id_;
 }
 
 void FrankaCombinableHW::triggerError() {
-  has_error_ = true;
-  publishErrorState(has_error_);
+  setError(true);
 }
 
 bool FrankaCombinableHW::hasError() const noexcept {
@@ -229,43 +254,70 @@ bool FrankaCombinableHW::hasError() const noexcept {
 
 void FrankaCombinableHW::resetError() {
   if (connected()) {
-    robot_->automaticErrorRecovery();
+    // Recovery of the combined arms runs concurrently with the idle loop of this arm.
+    std::lock_guard<std::mutex> lock(robot_mutex_);
+    automaticErrorRecovery();
   }
   // error recovered => reset controller
   if (has_error_) {
     error_recovered_ = true;
   }
-  has_error_ = false;
-  publishErrorState(has_error_);
+  setError(false);
+  idle_loop_->wakeUp();
 }
 
 bool FrankaCombinableHW::controllerNeedsReset() const noexcept {
   return controller_needs_reset_;
 }
 
-bool FrankaCombinableHW::setRunFunction(const ControlMode& requested_control_mode,
-                                        const bool limit_rate,
-                                        const double cutoff_frequency,
-                                        const franka::ControllerMode /*internal_controller*/) {
-  using Callback = std::function<bool(const franka::RobotState&, franka::Duration)>;
+void FrankaCombinableHW::attachCombinedFlags(CombinedFlags* flags, size_t arm) {
+  combined_arm_ = arm;
+  combined_flags_ = flags;
+  if (flags != nullptr) {
+    // The control loop thread may already have changed the flags of this arm.
+    flags->set(CombinedFlags::kError, arm, has_error_);
+    flags->set(CombinedFlags::kNeedsReset, arm, controller_needs_reset_);
+  }
+}
 
-  if (requested_control_mode == ControlMode::None) {
-    return true;
+void FrankaCombinableHW::attachStateBarrier(StateBarrier* barrier, size_t arm) {
+  state_barrier_arm_ = arm;
+  state_barrier_ = barrier;
+}
+
+void FrankaCombinableHW::signalState(const franka::RobotState& robot_state) {
+  StateBarrier* barrier = state_barrier_;
+  if (barrier != nullptr) {
+    barrier->signal(state_barrier_arm_, robot_state.time.toSec());
   }
-  if (requested_control_mode == ControlMode::JointTorque) {
-    run_function_ = [this, limit_rate, cutoff_frequency](franka::Robot& robot,
-                                                         Callback /*callback*/) {
-      std::lock_guard<std::mutex> lock(robot_mutex_);
-      robot.control(std::bind(&FrankaCombinableHW::libfrankaUpdateCallback<franka::Torques>, this,
-                              std::cref(effort_joint_command_libfranka_), std::placeholders::_1,
-                              std::placeholders::_2),
-                    limit_rate, cutoff_frequency);
-    };
-    return true;
+}
+
+void FrankaCombinableHW::setError(bool error) {
+  has_error_ = error;
+  CombinedFlags* flags = combined_flags_;
+  if (flags != nullptr) {
+    flags->set(CombinedFlags::kError, combined_arm_, error);
+  }
+  publishErrorState(error);
+}
+
+void FrankaCombinableHW::setControllerNeedsReset(bool needs_reset) {
+  controller_needs_reset_ = needs_reset;
+  CombinedFlags* flags = combined_flags_;
+  if (flags != nullptr) {
+    flags->set(CombinedFlags::kNeedsReset, combined_arm_, needs_reset);
   }
+}
 
-  ROS_ERROR("FrankaCombinableHW: No valid control mode selected; cannot set run function.");
-  return false;
+void FrankaCombinableHW::initRunFunctions() {
+  run_functions_[ControlMode::JointTorque] = [this](franka::Robot& robot, Callback /*callback*/,
+                                                    const RunParameters& parameters) {
+    std::lock_guard<std::mutex> lock(robot_mutex_);
+    robot.control(std::bind(&FrankaCombinableHW::libfrankaUpdateCallback<franka::Torques>, this,
+                            std::cref(effort_joint_command_libfranka_), std::placeholders::_1,
+                            std::placeholders::_2),
+                  parameters.limit_rate, parameters.cutoff_frequency);
+  };
 }
 
 }  // namespace franka_hw
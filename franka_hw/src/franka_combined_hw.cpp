@@ -3,52 +3,96 @@
 #include <franka_hw/franka_combined_hw.h>
 
 #include <algorithm>
+#include <chrono>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <actionlib/server/simple_action_server.h>
 #include <ros/node_handle.h>
 #include <ros/time.h>
 #include <std_srvs/Trigger.h>
 
+#include <franka_hw/arm_operations.h>
 #include <franka_hw/franka_combinable_hw.h>
 #include <franka_hw/franka_hw.h>
+#include <franka_msgs/ArmSynchronization.h>
 #include <franka_msgs/ErrorRecoveryAction.h>
 
 namespace franka_hw {
 
 FrankaCombinedHW::FrankaCombinedHW() = default;
 
+FrankaCombinedHW::~FrankaCombinedHW() {
+  // Wait for operations that are still running on the arms, e.g. after they timed out.
+  arm_operations_.reset();
+  // The arms are destroyed after this class and must not use its flags and barrier anymore.
+  for (auto* franka_combinable_hw : franka_hws_) {
+    franka_combinable_hw->attachStateBarrier(nullptr, 0);
+    franka_combinable_hw->attachCombinedFlags(nullptr, 0);
+  }
+}
+
 bool FrankaCombinedHW::init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) {
   bool success = CombinedRobotHW::init(root_nh, robot_hw_nh);
+  // Resolve the typed hardware classes once instead of casting them in every control cycle.
+  franka_hws_.clear();
+  arm_ids_.clear();
+  for (const auto& robot_hw : robot_hw_list_) {
+    auto* franka_combinable_hw_ptr = dynamic_cast<franka_hw::FrankaCombinableHW*>(robot_hw.get());
+    if (franka_combinable_hw_ptr == nullptr) {
+      ROS_ERROR("FrankaCombinedHW: dynamic_cast from RobotHW to FrankaCombinableHW failed.");
+      return false;
+    }
+    if (franka_hws_.size() == CombinedFlags::kMaxArms) {
+      ROS_ERROR("FrankaCombinedHW: At most %zu robots can be combined.", CombinedFlags::kMaxArms);
+      return false;
+    }
+    franka_combinable_hw_ptr->attachCombinedFlags(&flags_, franka_hws_.size());
+    all_arms_ |= uint64_t(1) << franka_hws_.size();
+    franka_hws_.push_back(franka_combinable_hw_ptr);
+    arm_ids_.push_back(franka_combinable_hw_ptr->getArmID());
+  }
+  arm_operation_timeout_ = robot_hw_nh.param("arm_operation_timeout", arm_operation_timeout_);
+  arm_operations_ = std::make_unique<ArmOperations>(arm_ids_);
+
+  if (robot_hw_nh.param("synchronize_arms", true)) {
+    const double timeout = robot_hw_nh.param(
+        "synchronization_timeout",
+        std::chrono::duration<double>(synchronization_timeout_).count());
+    if (timeout <= 0.0) {
+      ROS_ERROR("FrankaCombinedHW: Invalid synchronization_timeout provided. Must be positive.");
+      return false;
+    }
+    synchronization_timeout_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(timeout));
+    state_barrier_ = std::make_unique<StateBarrier>(franka_hws_.size());
+    for (size_t arm = 0; arm < franka_hws_.size(); arm++) {
+      franka_hws_[arm]->attachStateBarrier(state_barrier_.get(), arm);
+    }
+    synchronization_publisher_ =
+        robot_hw_nh.advertise<franka_msgs::ArmSynchronization>("arm_synchronization", 1);
+    synchronization_timer_ =
+        robot_hw_nh.createTimer(ros::Duration(1.0), [this](const ros::TimerEvent&) {
+          const StateBarrier::Statistics statistics = synchronizationStatistics();
+          franka_msgs::ArmSynchronization msg;
+          msg.arm_ids = arm_ids_;
+          msg.cycles = statistics.cycles;
+          msg.timeouts = statistics.timeouts;
+          msg.stale_states = statistics.stale_states;
+          msg.skew = statistics.skew;
+          msg.mean_skew = statistics.mean_skew;
+          msg.max_skew = statistics.max_skew;
+          synchronization_publisher_.publish(msg);
+        });
+  }
+
   // Error recovery server for all FrankaHWs
   combined_recovery_action_server_ =
       std::make_unique<actionlib::SimpleActionServer<franka_msgs::ErrorRecoveryAction>>(
           robot_hw_nh, "error_recovery",
-          [&](const franka_msgs::ErrorRecoveryGoalConstPtr&) {
-            try {
-              is_recovering_ = true;
-              for (const auto& robot_hw : robot_hw_list_) {
-                auto* franka_combinable_hw_ptr =
-                    dynamic_cast<franka_hw::FrankaCombinableHW*>(robot_hw.get());
-                if (franka_combinable_hw_ptr != nullptr && franka_combinable_hw_ptr->connected()) {
-                  franka_combinable_hw_ptr->resetError();
-                } else {
-                  ROS_ERROR("FrankaCombinedHW: failed to reset error. Is the robot connected?");
-                  is_recovering_ = false;
-                  combined_recovery_action_server_->setAborted(
-                      franka_msgs::ErrorRecoveryResult(),
-                      "dynamic_cast from RobotHW to FrankaCombinableHW failed");
-                  return;
-                }
-              }
-              is_recovering_ = false;
-              combined_recovery_action_server_->setSucceeded();
-            } catch (const franka::Exception& ex) {
-              is_recovering_ = false;
-              combined_recovery_action_server_->setAborted(franka_msgs::ErrorRecoveryResult(),
-                                                           ex.what());
-            }
-          },
+          [this](const franka_msgs::ErrorRecoveryGoalConstPtr&) { recoverErrors(); },
           false);
   combined_recovery_action_server_->start();
 
@@ -101,80 +145,155 @@ void FrankaCombinedHW::read(const ros::Time& time, const ros::Duration& period)
 
 bool FrankaCombinedHW::controllerNeedsReset() {
   // Check if any of the RobotHW object needs a controller reset
-  bool controller_reset = false;
-  for (const auto& robot_hw : robot_hw_list_) {
-    auto* franka_combinable_hw_ptr = dynamic_cast<franka_hw::FrankaCombinableHW*>(robot_hw.get());
-    if (franka_combinable_hw_ptr != nullptr) {
-      controller_reset = controller_reset || franka_combinable_hw_ptr->controllerNeedsReset();
-    } else {
-      ROS_ERROR("FrankaCombinedHW: dynamic_cast from RobotHW to FrankaCombinableHW failed.");
-      return false;
-    }
-  }
-  return controller_reset;
+  return flags_.any(CombinedFlags::kNeedsReset);
 }
 
 void FrankaCombinedHW::handleError() {
   // Trigger error state of all other RobotHW objects when one of them has a error.
-  if (hasError() && !is_recovering_) {
+  if (hasError() && recovering_arms_ == 0) {
     triggerError();
   }
 }
 
 bool FrankaCombinedHW::hasError() {
-  bool has_error = false;
-  for (const auto& robot_hw : robot_hw_list_) {
-    auto* franka_combinable_hw_ptr = dynamic_cast<franka_hw::FrankaCombinableHW*>(robot_hw.get());
-    if (franka_combinable_hw_ptr != nullptr) {
-      has_error = has_error || franka_combinable_hw_ptr->hasError();
-    } else {
-      ROS_ERROR("FrankaCombinedHW: dynamic_cast from RobotHW to FrankaCombinableHW failed.");
+  return flags_.any(CombinedFlags::kError);
+}
+
+void FrankaCombinedHW::triggerError() {
+  // Trigger error state of the RobotHW objects which are not in error state yet, so nothing is
+  // done in the following cycles until the error is recovered.
+  const uint64_t errors = flags_.mask(CombinedFlags::kError);
+  if (errors == all_arms_) {
+    return;
+  }
+  for (size_t arm = 0; arm < franka_hws_.size(); arm++) {
+    if ((errors & (uint64_t(1) << arm)) == 0) {
+      franka_hws_[arm]->triggerError();
+    }
+  }
+}
+
+bool FrankaCombinedHW::waitForStates(ros::Duration* period) {
+  if (!state_barrier_) {
+    return false;
+  }
+  for (auto* franka_combinable_hw : franka_hws_) {
+    if (!franka_combinable_hw->controllerActive()) {
+      // The idle arms read their states at idle_rate only, so do not wait for them.
+      state_barrier_->reset();
       return false;
     }
   }
-  return has_error;
+  double robot_period = -1.0;
+  state_barrier_->wait(synchronization_timeout_, &robot_period);
+  if (robot_period > 0.0) {
+    *period = ros::Duration(robot_period);
+  }
+  return true;
 }
 
-void FrankaCombinedHW::triggerError() {
-  // Trigger error state of all RobotHW objects.
-  for (const auto& robot_hw : robot_hw_list_) {
-    auto* franka_combinable_hw_ptr = dynamic_cast<franka_hw::FrankaCombinableHW*>(robot_hw.get());
-    if (franka_combinable_hw_ptr != nullptr) {
-      franka_combinable_hw_ptr->triggerError();
-    } else {
-      ROS_ERROR("FrankaCombinedHW: dynamic_cast from RobotHW to FrankaCombinableHW failed.");
+StateBarrier::Statistics FrankaCombinedHW::synchronizationStatistics() const {
+  return state_barrier_ ? state_barrier_->statistics() : StateBarrier::Statistics();
+}
+
+void FrankaCombinedHW::recoverErrors() {
+  for (auto* franka_combinable_hw : franka_hws_) {
+    if (!franka_combinable_hw->connected()) {
+      ROS_ERROR("FrankaCombinedHW: failed to reset error. Is the robot connected?");
+      combined_recovery_action_server_->setAborted(
+          franka_msgs::ErrorRecoveryResult(),
+          "Cannot recover " + franka_combinable_hw->getArmID() + " while disconnected.");
+      return;
+    }
+  }
+
+  // Recover all arms at once, so the recovery takes as long as the slowest arm. Errors are not
+  // triggered on the other arms until the recovery of every arm really finished, even if it
+  // timed out.
+  recovering_arms_ += franka_hws_.size();
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<ArmOperationResult> results = arm_operations_->run(
+      allArms(),
+      [this](size_t arm) {
+        try {
+          franka_hws_[arm]->resetError();
+        } catch (...) {
+          recovering_arms_--;
+          throw;
+        }
+        recovering_arms_--;
+      },
+      arm_operation_timeout_);
+  franka_msgs::ErrorRecoveryResult result;
+  result.duration =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (const ArmOperationResult& arm_result : results) {
+    result.arm_ids.push_back(arm_result.arm_id);
+    result.success.push_back(static_cast<uint8_t>(arm_result.success));
+    result.errors.push_back(arm_result.error);
+    result.durations.push_back(arm_result.duration);
+    // The recovery was not started on arms that are still busy.
+    if (arm_result.busy) {
+      recovering_arms_--;
     }
   }
+
+  if (allSucceeded(results)) {
+    ROS_INFO("FrankaCombinedHW: Recovered %zu robots in %.3f s.", results.size(), result.duration);
+    combined_recovery_action_server_->setSucceeded(result);
+  } else {
+    const std::string summary = summarize(results);
+    ROS_ERROR("FrankaCombinedHW: Error recovery failed: %s", summary.c_str());
+    combined_recovery_action_server_->setAborted(result, summary);
+  }
 }
 
 void FrankaCombinedHW::connect() {
-  for (const auto& robot_hw : robot_hw_list_) {
-    auto* franka_combinable_hw_ptr = dynamic_cast<franka_hw::FrankaCombinableHW*>(robot_hw.get());
-    if (franka_combinable_hw_ptr != nullptr && !franka_combinable_hw_ptr->connected()) {
-      franka_combinable_hw_ptr->connect();
+  std::vector<size_t> disconnected;
+  for (size_t arm = 0; arm < franka_hws_.size(); arm++) {
+    if (!franka_hws_[arm]->connected()) {
+      disconnected.push_back(arm);
     }
   }
+  std::vector<ArmOperationResult> results = arm_operations_->run(
+      disconnected, [this](size_t arm) { franka_hws_[arm]->connect(); }, arm_operation_timeout_);
+  if (!allSucceeded(results)) {
+    throw std::runtime_error(summarize(results));
+  }
+  ROS_INFO_STREAM("FrankaCombinedHW: Connected robots: " << summarize(results));
 }
 
 bool FrankaCombinedHW::disconnect() {
   // Ensure all robots are disconnectable (not running a controller)
-  for (const auto& robot_hw : robot_hw_list_) {
-    auto* franka_combinable_hw_ptr = dynamic_cast<franka_hw::FrankaCombinableHW*>(robot_hw.get());
-    if (franka_combinable_hw_ptr != nullptr && franka_combinable_hw_ptr->controllerActive()) {
+  for (auto* franka_combinable_hw : franka_hws_) {
+    if (franka_combinable_hw->controllerActive()) {
       return false;
     }
   }
 
   // Only if all robots are in fact disconnectable, disconnecting them.
-  // Fail and abort if any robot cannot be disconnected.
-  for (const auto& robot_hw : robot_hw_list_) {
-    auto* franka_combinable_hw_ptr = dynamic_cast<franka_hw::FrankaCombinableHW*>(robot_hw.get());
-    if (franka_combinable_hw_ptr != nullptr && !franka_combinable_hw_ptr->disconnect()) {
-      return false;
-    }
+  // Fail if any robot cannot be disconnected.
+  std::vector<ArmOperationResult> results = arm_operations_->run(
+      allArms(),
+      [this](size_t arm) {
+        if (!franka_hws_[arm]->disconnect()) {
+          throw std::runtime_error("Controller is still running.");
+        }
+      },
+      arm_operation_timeout_);
+  if (!allSucceeded(results)) {
+    ROS_ERROR_STREAM("FrankaCombinedHW: Failed to disconnect robots: " << summarize(results));
+    return false;
   }
-
   return true;
 }
 
+std::vector<size_t> FrankaCombinedHW::allArms() const {
+  std::vector<size_t> arms(franka_hws_.size());
+  for (size_t arm = 0; arm < arms.size(); arm++) {
+    arms[arm] = arm;
+  }
+  return arms;
+}
+
 }  // namespace franka_hw
@@ -2,8 +2,10 @@
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #include <franka_hw/franka_hw.h>
 #include <franka_hw/resource_helpers.h>
+#include <franka_hw/thread_config.h>
 
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <exception>
 #include <functional>
@@ -12,11 +14,13 @@
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <tuple>
 #include <utility>
 
 #include <franka/control_types.h>
 #include <franka/rate_limiting.h>
 #include <franka/robot.h>
+#include <franka_msgs/RobotCommandResult.h>
 #include <joint_limits_interface/joint_limits_urdf.h>
 
 namespace franka_hw {
@@ -33,6 +37,22 @@ std::ostream& operator<<(std::ostream& ostream, franka::ControllerMode mode) {
   return ostream;
 }
 
+bool getOverrunPolicy(const std::string& name,
+                      const ros::NodeHandle& robot_hw_nh,
+                      ControlDeadline::OverrunPolicy* policy) {
+  std::string policy_param = robot_hw_nh.param(name, std::string("extrapolate"));
+  if (policy_param == "hold") {
+    *policy = ControlDeadline::OverrunPolicy::kHold;
+  } else if (policy_param == "extrapolate") {
+    *policy = ControlDeadline::OverrunPolicy::kExtrapolate;
+  } else {
+    ROS_ERROR("Invalid %s parameter provided. Valid values are 'hold', 'extrapolate'.",
+              name.c_str());
+    return false;
+  }
+  return true;
+}
+
 std::string toStringWithPrecision(const double value, const size_t precision = 6) {
   std::ostringstream out;
   out.precision(precision);
@@ -54,7 +74,14 @@ FrankaHW::FrankaHW()
       pose_cartesian_command_libfranka_(
           {1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0}),
       velocity_cartesian_command_ros_({0.0, 0.0, 0.0, 0.0, 0.0, 0.0}),
-      velocity_cartesian_command_libfranka_({0.0, 0.0, 0.0, 0.0, 0.0, 0.0}) {}
+      velocity_cartesian_command_libfranka_({0.0, 0.0, 0.0, 0.0, 0.0, 0.0}),
+      last_commands_(
+          franka::Torques({0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}),
+          franka::JointPositions({0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}),
+          franka::JointVelocities({0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}),
+          franka::CartesianPose(
+              {1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0}),
+          franka::CartesianVelocities({0.0, 0.0, 0.0, 0.0, 0.0, 0.0})) {}
 
 bool FrankaHW::init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) {
   if (initialized_) {
@@ -66,6 +93,57 @@ bool FrankaHW::init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) {
     ROS_ERROR("FrankaHW: Failed to parse all required parameters.");
     return false;
   }
+  idle_loop_ = std::make_unique<IdleLoop>(idle_rate_);
+  initRunFunctions();
+  if (command_queue_enabled_) {
+    command_result_publisher_ =
+        robot_hw_nh.advertise<franka_msgs::RobotCommandResult>("robot_command_results", 10);
+    command_queue_ = std::make_unique<RobotCommandQueue>(
+        command_queue_capacity_,
+        [this](const RobotCommandQueue::Result& result) {
+          franka_msgs::RobotCommandResult msg;
+          msg.request_id = result.request_id;
+          msg.service = result.name;
+          msg.success = result.success;
+          msg.error = result.error;
+          command_result_publisher_.publish(msg);
+        },
+        [this]() { idle_loop_->wakeUp(); });
+  }
+  if (state_log_enabled_) {
+    try {
+      state_log_ = std::make_unique<StateLogWriter>(state_log_config_);
+    } catch (const std::runtime_error& error) {
+      ROS_ERROR("FrankaHW: Failed to initialize state log. %s", error.what());
+      return false;
+    }
+    ROS_INFO("FrankaHW: Logging robot states to %s/%s_*.bin",
+             state_log_config_.directory.c_str(), state_log_config_.prefix.c_str());
+  }
+  // The update threads are started for every motion. Starting them once here refuses to start on
+  // misconfigured scheduling, like the control loop threads, instead of failing every motion.
+  if (control_deadline_enabled_) {
+    control_deadline_ = std::make_unique<ControlDeadline>(control_deadline_config_);
+    if (!control_deadline_->start(
+            [](const franka::RobotState&, franka::Duration) { return false; })) {
+      ROS_ERROR("FrankaHW: Failed to configure the controller update thread.");
+      return false;
+    }
+    control_deadline_->stop();
+    ROS_INFO("FrankaHW: Enforcing a deadline of %.0f us on controller updates",
+             control_deadline_config_.budget * 1e6);
+  }
+  if (control_pipeline_enabled_) {
+    control_pipeline_ =
+        std::make_unique<ControlPipeline>(control_pipeline_config_, last_commands_);
+    if (!control_pipeline_->start([](const franka::RobotState&, franka::Duration,
+                                     ControlPipeline::Commands*) { return false; })) {
+      ROS_ERROR("FrankaHW: Failed to configure the controller update thread.");
+      return false;
+    }
+    control_pipeline_->stop();
+    ROS_INFO("FrankaHW: Running controller updates pipelined one cycle ahead");
+  }
   try {
     initRobot();
   } catch (const std::runtime_error& error) {
@@ -109,6 +187,7 @@ bool FrankaHW::initParameters(ros::NodeHandle& root_nh, ros::NodeHandle& robot_h
     ROS_ERROR("Invalid or no arm_id parameter provided");
     return false;
   }
+  arm_index_ = resource_registry_.addArm(arm_id_, joint_names_);
 
   if (!urdf_model_.initParamWithNodeHandle("robot_description", root_nh)) {
     ROS_ERROR("Could not initialize URDF model from robot_description");
@@ -137,6 +216,90 @@ bool FrankaHW::initParameters(ros::NodeHandle& root_nh, ros::NodeHandle& robot_h
     return false;
   }
 
+  state_log_enabled_ = robot_hw_nh.param("state_log/enabled", false);
+  state_log_config_.prefix = arm_id_;
+  state_log_config_.directory =
+      robot_hw_nh.param("state_log/directory", state_log_config_.directory);
+  int segment_size =
+      robot_hw_nh.param("state_log/segment_size", static_cast<int>(state_log_config_.segment_size));
+  int max_segments =
+      robot_hw_nh.param("state_log/max_segments", static_cast<int>(state_log_config_.max_segments));
+  if (segment_size <= 0 || max_segments < 0) {
+    ROS_ERROR(
+        "Invalid state_log parameters provided. segment_size must be positive and max_segments "
+        "must not be negative.");
+    return false;
+  }
+  state_log_config_.segment_size = static_cast<size_t>(segment_size);
+  state_log_config_.max_segments = static_cast<size_t>(max_segments);
+
+  idle_rate_ = robot_hw_nh.param("idle_rate", idle_rate_);
+  if (idle_rate_ <= 0.0) {
+    ROS_ERROR("Invalid idle_rate parameter provided. Must be positive.");
+    return false;
+  }
+
+  command_queue_enabled_ = robot_hw_nh.param("robot_command_queue/enabled", false);
+  int command_queue_capacity = robot_hw_nh.param("robot_command_queue/capacity",
+                                                 static_cast<int>(command_queue_capacity_));
+  if (command_queue_capacity <= 0) {
+    ROS_ERROR("Invalid robot_command_queue parameters provided. capacity must be positive.");
+    return false;
+  }
+  command_queue_capacity_ = static_cast<size_t>(command_queue_capacity);
+
+  control_deadline_enabled_ = robot_hw_nh.param("control_deadline/enabled", false);
+  control_deadline_config_.budget =
+      robot_hw_nh.param("control_deadline/budget", control_deadline_config_.budget);
+  if (!getOverrunPolicy("control_deadline/overrun_policy", robot_hw_nh,
+                        &control_deadline_config_.overrun_policy)) {
+    return false;
+  }
+  int max_consecutive_overruns =
+      robot_hw_nh.param("control_deadline/max_consecutive_overruns",
+                        static_cast<int>(control_deadline_config_.max_consecutive_overruns));
+  if (control_deadline_config_.budget <= 0.0 || control_deadline_config_.budget >= 0.001 ||
+      max_consecutive_overruns < 0) {
+    ROS_ERROR(
+        "Invalid control_deadline parameters provided. budget must be in (0, 0.001) and "
+        "max_consecutive_overruns must not be negative.");
+    return false;
+  }
+  control_deadline_config_.max_consecutive_overruns =
+      static_cast<size_t>(max_consecutive_overruns);
+
+  control_pipeline_enabled_ = robot_hw_nh.param("control_pipeline/enabled", false);
+  if (!getOverrunPolicy("control_pipeline/stall_policy", robot_hw_nh,
+                        &control_pipeline_config_.stall_policy)) {
+    return false;
+  }
+  int max_consecutive_stalls =
+      robot_hw_nh.param("control_pipeline/max_consecutive_stalls",
+                        static_cast<int>(control_pipeline_config_.max_consecutive_stalls));
+  if (max_consecutive_stalls < 0) {
+    ROS_ERROR(
+        "Invalid control_pipeline parameters provided. max_consecutive_stalls must not be "
+        "negative.");
+    return false;
+  }
+  control_pipeline_config_.max_consecutive_stalls = static_cast<size_t>(max_consecutive_stalls);
+
+  // The update thread of control_deadline and control_pipeline.
+  if (!readThreadConfig(robot_hw_nh, "controller_update", &control_deadline_config_.thread)) {
+    return false;
+  }
+  control_pipeline_config_.thread = control_deadline_config_.thread;
+
+  if (control_deadline_enabled_ && control_pipeline_enabled_) {
+    ROS_ERROR("control_deadline and control_pipeline cannot be enabled at the same time.");
+    return false;
+  }
+  if ((control_deadline_enabled_ || control_pipeline_enabled_) && !rate_limiting) {
+    ROS_WARN(
+        "FrankaHW: control_deadline or control_pipeline is enabled without rate_limiting. Commands "
+        "sent after a missed deadline or a pipeline stall are not smoothed.");
+  }
+
   // Get full collision behavior config from the parameter server.
   std::vector<double> thresholds =
       getCollisionThresholds("lower_torque_thresholds_acceleration", robot_hw_nh,
@@ -179,15 +342,33 @@ bool FrankaHW::initParameters(ros::NodeHandle& root_nh, ros::NodeHandle& robot_h
 void FrankaHW::connect() {
   std::lock_guard<std::mutex> lock(robot_mutex_);
   if (!robot_) {
-    robot_ = std::make_unique<franka::Robot>(robot_ip_, realtime_config_);
-    robot_->setCollisionBehavior(collision_config_.lower_torque_thresholds_acceleration,
-                                 collision_config_.upper_torque_thresholds_acceleration,
-                                 collision_config_.lower_torque_thresholds_nominal,
-                                 collision_config_.upper_torque_thresholds_nominal,
-                                 collision_config_.lower_force_thresholds_acceleration,
-                                 collision_config_.upper_force_thresholds_acceleration,
-                                 collision_config_.lower_force_thresholds_nominal,
-                                 collision_config_.upper_force_thresholds_nominal);
+    const auto start = std::chrono::steady_clock::now();
+    // Only considered connected once all settings are restored.
+    auto robot = std::make_unique<franka::Robot>(robot_ip_, realtime_config_);
+    // The model is kept across reconnects and cannot be replaced while controllers use it, so a
+    // robot updated in the meantime needs a restart to download its model again. The server
+    // version is reported in the connect handshake and costs no extra request.
+    if (model_ && robot->serverVersion() != model_server_version_) {
+      throw franka::InvalidOperationException(
+          "FrankaHW: Robot at " + robot_ip_ + " reports server version " +
+          std::to_string(robot->serverVersion()) + ", but the model was loaded from version " +
+          std::to_string(model_server_version_) + ". Restart to load the new model.");
+    }
+    robot->setCollisionBehavior(collision_config_.lower_torque_thresholds_acceleration,
+                                collision_config_.upper_torque_thresholds_acceleration,
+                                collision_config_.lower_torque_thresholds_nominal,
+                                collision_config_.upper_torque_thresholds_nominal,
+                                collision_config_.lower_force_thresholds_acceleration,
+                                collision_config_.upper_force_thresholds_acceleration,
+                                collision_config_.lower_force_thresholds_nominal,
+                                collision_config_.upper_force_thresholds_nominal);
+    // The robot loses all settings on disconnect, restore the ones applied through the services.
+    const size_t replayed_settings = robot_settings_.replay(*robot);
+    robot_ = std::move(robot);
+    ROS_INFO("FrankaHW: Connected to robot at %s in %.3f s, restored %zu settings",
+             robot_ip_.c_str(),
+             std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+             replayed_settings);
   }
 }
 
@@ -197,6 +378,9 @@ bool FrankaHW::disconnect() {
     return false;
   }
   std::lock_guard<std::mutex> lock(robot_mutex_);
+  if (command_queue_) {
+    command_queue_->clear("Robot was disconnected.");
+  }
   robot_.reset();
   return true;
 }
@@ -210,6 +394,27 @@ void FrankaHW::update(const franka::RobotState& robot_state) {
   robot_state_ros_ = robot_state;
 }
 
+void FrankaHW::automaticErrorRecovery() {
+  robot_->automaticErrorRecovery();
+}
+
+void FrankaHW::setupRobotServices(ros::NodeHandle& node_handle, ServiceContainer& services) {
+  setupServices([this]() { return connected() ? robot_.get() : nullptr; }, robot_mutex_,
+                command_queue_.get(), robot_settings_, node_handle, services);
+}
+
+franka::RobotState FrankaHW::readRobotState() {
+  return robot_->readOnce();
+}
+
+void FrankaHW::readIdleState() {
+  update(readRobotState());
+  if (idle_loop_) {
+    idle_loop_->countRead();
+  }
+  processCommandQueue();
+}
+
 bool FrankaHW::controllerActive() const noexcept {
   return controller_active_;
 }
@@ -218,28 +423,154 @@ std::mutex& FrankaHW::robotMutex() {
   return robot_mutex_;
 }
 
+IdleLoop& FrankaHW::idleLoop() {
+  return *idle_loop_;
+}
+
+RobotSettings& FrankaHW::robotSettings() {
+  return robot_settings_;
+}
+
+RobotCommandQueue* FrankaHW::commandQueue() {
+  return command_queue_.get();
+}
+
+size_t FrankaHW::processCommandQueue() {
+  if (!command_queue_) {
+    return 0;
+  }
+  return command_queue_->process();
+}
+
 void FrankaHW::control(
     const std::function<bool(const ros::Time&, const ros::Duration&)>& ros_callback) {
   if (!initialized_) {
     ROS_ERROR("FrankaHW: Call to control before initialization!");
     return;
   }
-  if (!controller_active_) {
+  if (!controller_active_ || run_function_ == nullptr) {
     return;
   }
 
   franka::Duration last_time = robot_state_ros_.time;
 
   std::lock_guard<std::mutex> lock(robot_mutex_);
-  run_function_(*robot_, [this, ros_callback, &last_time](const franka::RobotState& robot_state,
-                                                          franka::Duration time_step) {
-    if (last_time != robot_state.time) {
-      last_time = robot_state.time;
+  startControlThreads(ros_callback);
+  logSwitchGap();
+  try {
+    (*run_function_)(*robot_,
+                     [this, ros_callback, &last_time](const franka::RobotState& robot_state,
+                                                      franka::Duration time_step) {
+                       if (last_time != robot_state.time) {
+                         last_time = robot_state.time;
+
+                         return ros_callback(ros::Time::now(), ros::Duration(time_step.toSec()));
+                       }
+                       return true;
+                     },
+                     run_parameters_);
+  } catch (...) {
+    stopControlThreads();
+    throw;
+  }
+  stopControlThreads();
+}
+
+void FrankaHW::logSwitchGap() {
+  if (!switch_gap_pending_) {
+    return;
+  }
+  switch_gap_pending_ = false;
+  ROS_INFO("FrankaHW: Restarting the motion %.1f ms after switching controllers",
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                     switch_start_)
+               .count());
+}
+
+void FrankaHW::setLibfrankaCommands(const ControlPipeline::Commands& commands) {
+  std::tie(effort_joint_command_libfranka_, position_joint_command_libfranka_,
+           velocity_joint_command_libfranka_, pose_cartesian_command_libfranka_,
+           velocity_cartesian_command_libfranka_) = commands;
+}
 
-      return ros_callback(ros::Time::now(), ros::Duration(time_step.toSec()));
+void FrankaHW::startControlThreads(
+    const std::function<bool(const ros::Time&, const ros::Duration&)>& ros_callback) {
+  if (control_deadline_) {
+    // The ROS-side update runs on the worker thread of the deadline, see deadlineControlCallback.
+    auto update = [this, &ros_callback](const franka::RobotState& robot_state,
+                                        franka::Duration period) {
+      {
+        std::lock_guard<std::mutex> libfranka_lock(libfranka_state_mutex_);
+        robot_state_libfranka_ = robot_state;
+      }
+      ros::Time now = ros::Time(0);
+      read(now, ros::Duration(period.toSec()));
+      if (!controller_active_ || !ros_callback(ros::Time::now(), ros::Duration(period.toSec()))) {
+        return false;
+      }
+      write(now, ros::Duration(period.toSec()));
+      return true;
+    };
+    if (!control_deadline_->start(update)) {
+      throw franka::ControlException(
+          "FrankaHW: Failed to configure the controller update thread.");
     }
-    return true;
-  });
+  }
+  if (control_pipeline_) {
+    // The ROS-side update runs on the pipeline thread, see pipelineControlCallback.
+    auto update = [this, &ros_callback](const franka::RobotState& robot_state,
+                                        franka::Duration period,
+                                        ControlPipeline::Commands* commands) {
+      {
+        std::lock_guard<std::mutex> libfranka_lock(libfranka_state_mutex_);
+        robot_state_libfranka_ = robot_state;
+      }
+      read(ros::Time(0), ros::Duration(period.toSec()));
+      if (!controller_active_ || !ros_callback(ros::Time::now(), ros::Duration(period.toSec()))) {
+        return false;
+      }
+      std::lock_guard<std::mutex> ros_lock(ros_cmd_mutex_);
+      *commands = std::tie(effort_joint_command_ros_, position_joint_command_ros_,
+                           velocity_joint_command_ros_, pose_cartesian_command_ros_,
+                           velocity_cartesian_command_ros_);
+      return true;
+    };
+    if (!control_pipeline_->start(update)) {
+      throw franka::ControlException(
+          "FrankaHW: Failed to configure the controller update thread.");
+    }
+  }
+}
+
+void FrankaHW::stopControlThreads() {
+  if (control_deadline_) {
+    control_deadline_->stop();
+    ControlDeadline::Statistics statistics = control_deadline_->statistics();
+    control_deadline_->resetStatistics();
+    if (statistics.overruns > 0) {
+      ROS_WARN(
+          "FrankaHW: Controller update missed its deadline in %lu of %lu cycles (at most %lu in a "
+          "row), longest update took %.0f us",
+          static_cast<unsigned long>(statistics.overruns),
+          static_cast<unsigned long>(statistics.cycles),
+          static_cast<unsigned long>(statistics.max_consecutive_overruns),
+          statistics.max_update_duration * 1e6);
+    }
+  }
+  if (control_pipeline_) {
+    control_pipeline_->stop();
+    ControlPipeline::Statistics statistics = control_pipeline_->statistics();
+    control_pipeline_->resetStatistics();
+    if (statistics.stalls > 0) {
+      ROS_WARN(
+          "FrankaHW: Controller update pipeline stalled in %lu of %lu cycles (at most %lu in a "
+          "row), longest update took %.0f us",
+          static_cast<unsigned long>(statistics.stalls),
+          static_cast<unsigned long>(statistics.cycles),
+          static_cast<unsigned long>(statistics.max_consecutive_stalls),
+          statistics.max_update_duration * 1e6);
+    }
+  }
 }
 
 void FrankaHW::enforceLimits(const ros::Duration& period) {
@@ -251,17 +582,17 @@ void FrankaHW::enforceLimits(const ros::Duration& period) {
 }
 
 bool FrankaHW::checkForConflict(const std::list<hardware_interface::ControllerInfo>& info) const {
-  ResourceWithClaimsMap resource_map = getResourceMap(info);
-  if (hasConflictingMultiClaim(resource_map)) {
+  bool valid = resource_registry_.evaluate(info, &claims_);
+  if (claims_.conflicting_multi_claim) {
     return true;
   }
-  ArmClaimedMap arm_claim_map;
-  if (!getArmClaimedMap(resource_map, arm_claim_map)) {
+  if (!valid) {
     ROS_ERROR_STREAM("FrankaHW: Unknown interface claimed. Conflict!");
     return true;
   }
-  return hasConflictingJointAndCartesianClaim(arm_claim_map, arm_id_) ||
-         partiallyClaimsArmJoints(arm_claim_map, arm_id_);
+  const auto& arm_claims = ResourceRegistry::armClaims(claims_, arm_index_);
+  return ResourceRegistry::hasConflictingJointAndCartesianClaim(arm_claims, arm_id_) ||
+         ResourceRegistry::partiallyClaimsArmJoints(arm_claims, arm_id_);
 }
 
 // doSwitch runs on the main realtime thread.
@@ -270,48 +601,60 @@ void FrankaHW::doSwitch(const std::list<hardware_interface::ControllerInfo>& /*
   if (current_control_mode_ != ControlMode::None) {
     reset();
     controller_active_ = true;
+    // Let a sleeping idle loop start the control loop right away.
+    if (idle_loop_) {
+      idle_loop_->wakeUp();
+    }
   }
 }
 
 // prepareSwitch runs on the background message handling thread.
 bool FrankaHW::prepareSwitch(const std::list<hardware_interface::ControllerInfo>& start_list,
                              const std::list<hardware_interface::ControllerInfo>& stop_list) {
-  ResourceWithClaimsMap start_resource_map = getResourceMap(start_list);
-  ArmClaimedMap start_arm_claim_map;
-  if (!getArmClaimedMap(start_resource_map, start_arm_claim_map)) {
+  if (!resource_registry_.evaluate(start_list, &claims_)) {
     ROS_ERROR("FrankaHW: Unknown interface claimed for starting!");
     return false;
   }
+  ControlMode start_control_mode =
+      ResourceRegistry::controlMode(ResourceRegistry::armClaims(claims_, arm_index_));
 
-  ControlMode start_control_mode = getControlMode(arm_id_, start_arm_claim_map);
-
-  ResourceWithClaimsMap stop_resource_map = getResourceMap(stop_list);
-  ArmClaimedMap stop_arm_claim_map;
-  if (!getArmClaimedMap(stop_resource_map, stop_arm_claim_map)) {
+  if (!resource_registry_.evaluate(stop_list, &claims_)) {
     ROS_ERROR("FrankaHW: Unknown interface claimed for stopping!");
     return false;
   }
-  ControlMode stop_control_mode = getControlMode(arm_id_, stop_arm_claim_map);
+  ControlMode stop_control_mode =
+      ResourceRegistry::controlMode(ResourceRegistry::armClaims(claims_, arm_index_));
 
   ControlMode requested_control_mode = current_control_mode_;
   requested_control_mode &= ~stop_control_mode;
   requested_control_mode |= start_control_mode;
 
-  if (!setRunFunction(requested_control_mode, get_limit_rate_(), get_cutoff_frequency_(),
-                      get_internal_controller_())) {
-    return false;
-  }
-
   if (current_control_mode_ != requested_control_mode) {
+    // The running motion, if any, ends with the next libfranka callback and the run function is
+    // only used again to start the next motion.
+    if (!setRunFunction(requested_control_mode, get_limit_rate_(), get_cutoff_frequency_(),
+                        get_internal_controller_())) {
+      return false;
+    }
     ROS_INFO_STREAM("FrankaHW: Prepared switching controllers to "
                     << requested_control_mode << " with parameters "
                     << "limit_rate=" << get_limit_rate_()
                     << ", cutoff_frequency=" << get_cutoff_frequency_()
                     << ", internal_controller=" << get_internal_controller_());
+    switch_gap_pending_ = controller_active_ && requested_control_mode != ControlMode::None;
+    switch_start_ = std::chrono::steady_clock::now();
     current_control_mode_ = requested_control_mode;
     controller_active_ = false;
+  } else if (controller_active_ && !start_list.empty()) {
+    // Controllers using the same control mode take over the running motion in doSwitch.
+    ROS_INFO_STREAM("FrankaHW: Switching controllers within the running " << requested_control_mode
+                                                                         << " motion");
   }
 
+  // controller_manager only switches in its next update, which a sleeping idle loop would delay.
+  if (idle_loop_) {
+    idle_loop_->wakeUp();
+  }
   return true;
 }
 
@@ -432,94 +775,100 @@ void FrankaHW::setupFrankaModelInterface(franka::RobotState& robot_state) {
   }
 }
 
-bool FrankaHW::setRunFunction(const ControlMode& requested_control_mode,
-                              const bool limit_rate,
-                              const double cutoff_frequency,
-                              const franka::ControllerMode internal_controller) {
+void FrankaHW::initRunFunctions() {
   using std::placeholders::_1;
   using std::placeholders::_2;
-  using Callback = std::function<bool(const franka::RobotState&, franka::Duration)>;
 
-  switch (requested_control_mode) {
-    case ControlMode::None:
-      break;
-    case ControlMode::JointTorque:
-      run_function_ = [=](franka::Robot& robot, Callback ros_callback) {
-        robot.control(std::bind(&FrankaHW::controlCallback<franka::Torques>, this,
-                                std::cref(effort_joint_command_libfranka_), ros_callback, _1, _2),
-                      limit_rate, cutoff_frequency);
-      };
-      break;
-    case ControlMode::JointPosition:
-      run_function_ = [=](franka::Robot& robot, Callback ros_callback) {
-        robot.control(std::bind(&FrankaHW::controlCallback<franka::JointPositions>, this,
-                                std::cref(position_joint_command_libfranka_), ros_callback, _1, _2),
-                      internal_controller, limit_rate, cutoff_frequency);
-      };
-      break;
-    case ControlMode::JointVelocity:
-      run_function_ = [=](franka::Robot& robot, Callback ros_callback) {
-        robot.control(std::bind(&FrankaHW::controlCallback<franka::JointVelocities>, this,
-                                std::cref(velocity_joint_command_libfranka_), ros_callback, _1, _2),
-                      internal_controller, limit_rate, cutoff_frequency);
-      };
-      break;
-    case ControlMode::CartesianPose:
-      run_function_ = [=](franka::Robot& robot, Callback ros_callback) {
-        robot.control(std::bind(&FrankaHW::controlCallback<franka::CartesianPose>, this,
-                                std::cref(pose_cartesian_command_libfranka_), ros_callback, _1, _2),
-                      internal_controller, limit_rate, cutoff_frequency);
-      };
-      break;
-    case ControlMode::CartesianVelocity:
-      run_function_ = [=](franka::Robot& robot, Callback ros_callback) {
-        robot.control(
-            std::bind(&FrankaHW::controlCallback<franka::CartesianVelocities>, this,
-                      std::cref(velocity_cartesian_command_libfranka_), ros_callback, _1, _2),
-            internal_controller, limit_rate, cutoff_frequency);
-      };
-      break;
-    case (ControlMode::JointTorque | ControlMode::JointPosition):
-      run_function_ = [=](franka::Robot& robot, Callback ros_callback) {
+  run_functions_[ControlMode::JointTorque] = [this](franka::Robot& robot, Callback ros_callback,
+                                                    const RunParameters& parameters) {
+    robot.control(std::bind(&FrankaHW::controlCallback<franka::Torques>, this,
+                            std::cref(effort_joint_command_libfranka_), ros_callback, _1, _2),
+                  parameters.limit_rate, parameters.cutoff_frequency);
+  };
+  run_functions_[ControlMode::JointPosition] = [this](franka::Robot& robot, Callback ros_callback,
+                                                      const RunParameters& parameters) {
+    robot.control(std::bind(&FrankaHW::controlCallback<franka::JointPositions>, this,
+                            std::cref(position_joint_command_libfranka_), ros_callback, _1, _2),
+                  parameters.internal_controller, parameters.limit_rate,
+                  parameters.cutoff_frequency);
+  };
+  run_functions_[ControlMode::JointVelocity] = [this](franka::Robot& robot, Callback ros_callback,
+                                                      const RunParameters& parameters) {
+    robot.control(std::bind(&FrankaHW::controlCallback<franka::JointVelocities>, this,
+                            std::cref(velocity_joint_command_libfranka_), ros_callback, _1, _2),
+                  parameters.internal_controller, parameters.limit_rate,
+                  parameters.cutoff_frequency);
+  };
+  run_functions_[ControlMode::CartesianPose] = [this](franka::Robot& robot, Callback ros_callback,
+                                                      const RunParameters& parameters) {
+    robot.control(std::bind(&FrankaHW::controlCallback<franka::CartesianPose>, this,
+                            std::cref(pose_cartesian_command_libfranka_), ros_callback, _1, _2),
+                  parameters.internal_controller, parameters.limit_rate,
+                  parameters.cutoff_frequency);
+  };
+  run_functions_[ControlMode::CartesianVelocity] = [this](franka::Robot& robot,
+                                                          Callback ros_callback,
+                                                          const RunParameters& parameters) {
+    robot.control(
+        std::bind(&FrankaHW::controlCallback<franka::CartesianVelocities>, this,
+                  std::cref(velocity_cartesian_command_libfranka_), ros_callback, _1, _2),
+        parameters.internal_controller, parameters.limit_rate, parameters.cutoff_frequency);
+  };
+  run_functions_[ControlMode::JointTorque | ControlMode::JointPosition] =
+      [this](franka::Robot& robot, Callback ros_callback, const RunParameters& parameters) {
         robot.control(std::bind(&FrankaHW::controlCallback<franka::Torques>, this,
                                 std::cref(effort_joint_command_libfranka_), ros_callback, _1, _2),
                       std::bind(&FrankaHW::controlCallback<franka::JointPositions>, this,
                                 std::cref(position_joint_command_libfranka_), ros_callback, _1, _2),
-                      limit_rate, cutoff_frequency);
+                      parameters.limit_rate, parameters.cutoff_frequency);
       };
-      break;
-    case (ControlMode::JointTorque | ControlMode::JointVelocity):
-      run_function_ = [=](franka::Robot& robot, Callback ros_callback) {
+  run_functions_[ControlMode::JointTorque | ControlMode::JointVelocity] =
+      [this](franka::Robot& robot, Callback ros_callback, const RunParameters& parameters) {
         robot.control(std::bind(&FrankaHW::controlCallback<franka::Torques>, this,
                                 std::cref(effort_joint_command_libfranka_), ros_callback, _1, _2),
                       std::bind(&FrankaHW::controlCallback<franka::JointVelocities>, this,
                                 std::cref(velocity_joint_command_libfranka_), ros_callback, _1, _2),
-                      limit_rate, cutoff_frequency);
+                      parameters.limit_rate, parameters.cutoff_frequency);
       };
-      break;
-    case (ControlMode::JointTorque | ControlMode::CartesianPose):
-      run_function_ = [=](franka::Robot& robot, Callback ros_callback) {
+  run_functions_[ControlMode::JointTorque | ControlMode::CartesianPose] =
+      [this](franka::Robot& robot, Callback ros_callback, const RunParameters& parameters) {
         robot.control(std::bind(&FrankaHW::controlCallback<franka::Torques>, this,
                                 std::cref(effort_joint_command_libfranka_), ros_callback, _1, _2),
                       std::bind(&FrankaHW::controlCallback<franka::CartesianPose>, this,
                                 std::cref(pose_cartesian_command_libfranka_), ros_callback, _1, _2),
-                      limit_rate, cutoff_frequency);
+                      parameters.limit_rate, parameters.cutoff_frequency);
       };
-      break;
-    case (ControlMode::JointTorque | ControlMode::CartesianVelocity):
-      run_function_ = [=](franka::Robot& robot, Callback ros_callback) {
+  run_functions_[ControlMode::JointTorque | ControlMode::CartesianVelocity] =
+      [this](franka::Robot& robot, Callback ros_callback, const RunParameters& parameters) {
         robot.control(
             std::bind(&FrankaHW::controlCallback<franka::Torques>, this,
                       std::cref(effort_joint_command_libfranka_), ros_callback, _1, _2),
             std::bind(&FrankaHW::controlCallback<franka::CartesianVelocities>, this,
                       std::cref(velocity_cartesian_command_libfranka_), ros_callback, _1, _2),
-            limit_rate, cutoff_frequency);
+            parameters.limit_rate, parameters.cutoff_frequency);
       };
-      break;
-    default:
-      ROS_WARN("FrankaHW: No valid control mode selected; cannot switch controllers.");
-      return false;
+}
+
+bool FrankaHW::setRunFunction(const ControlMode& requested_control_mode,
+                              const bool limit_rate,
+                              const double cutoff_frequency,
+                              const franka::ControllerMode internal_controller) {
+  if (requested_control_mode == ControlMode::None) {
+    return true;
+  }
+  if (run_functions_.empty()) {
+    // Only happens if prepareSwitch is used without init().
+    initRunFunctions();
+  }
+  auto run_function = run_functions_.find(requested_control_mode);
+  if (run_function == run_functions_.end()) {
+    ROS_WARN("FrankaHW: No valid control mode selected; cannot switch controllers.");
+    return false;
   }
+  run_function_ = &run_function->second;
+  run_parameters_.limit_rate = limit_rate;
+  run_parameters_.cutoff_frequency = cutoff_frequency;
+  run_parameters_.internal_controller = internal_controller;
   return true;
 }
 
@@ -546,6 +895,7 @@ void FrankaHW::initROSInterfaces(ros::NodeHandle& /*robot_hw_nh*/) {
 void FrankaHW::initRobot() {
   connect();
   model_ = std::make_unique<franka_hw::Model>(robot_->loadModel());
+  model_server_version_ = robot_->serverVersion();
   update(robot_->readOnce());
 }
 
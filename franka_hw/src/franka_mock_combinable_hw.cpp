@@ -0,0 +1,90 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/franka_mock_combinable_hw.h>
+
+#include <mutex>
+
+#include <franka/exception.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/console.h>
+
+namespace franka_hw {
+
+bool FrankaMockCombinableHW::initParameters(ros::NodeHandle& root_nh,
+                                            ros::NodeHandle& robot_hw_nh) {
+  if (!FrankaCombinableHW::initParameters(root_nh, robot_hw_nh)) {
+    return false;
+  }
+  return mock_robot_.init(robot_hw_nh, arm_id_);
+}
+
+void FrankaMockCombinableHW::connect() {
+  mock_robot_.connect();
+  setupServicesAndActionServers(robot_hw_nh_);
+}
+
+bool FrankaMockCombinableHW::disconnect() {
+  if (controllerActive()) {
+    ROS_ERROR(
+        "FrankaMockCombinableHW: Rejected attempt to disconnect while controller is still "
+        "running!");
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(robot_mutex_);
+  if (command_queue_) {
+    command_queue_->clear("Robot was disconnected.");
+  }
+  mock_robot_.disconnect();
+  return true;
+}
+
+bool FrankaMockCombinableHW::connected() {
+  return mock_robot_.connected();
+}
+
+void FrankaMockCombinableHW::initRobot() {
+  mock_robot_.connect();
+  update(mock_robot_.readOnce());
+  startControlLoop();
+}
+
+franka::RobotState FrankaMockCombinableHW::readRobotState() {
+  return mock_robot_.readOnce();
+}
+
+void FrankaMockCombinableHW::automaticErrorRecovery() {
+  mock_robot_.automaticErrorRecovery();
+}
+
+void FrankaMockCombinableHW::setupRobotServices(ros::NodeHandle& node_handle,
+                                                ServiceContainer& services) {
+  setupRecordingServices([this]() { return connected(); }, robot_mutex_, command_queue_.get(),
+                         robot_settings_, node_handle, services);
+}
+
+void FrankaMockCombinableHW::control(  // NOLINT (google-default-arguments)
+    const std::function<bool(const ros::Time&, const ros::Duration&)>& /*ros_callback*/) {
+  if (!controller_active_ || run_function_ == nullptr) {
+    return;
+  }
+  logSwitchGap();
+  std::lock_guard<std::mutex> lock(robot_mutex_);
+  try {
+    mock_robot_.control(current_control_mode_, [this](const franka::RobotState& robot_state,
+                                                       franka::Duration time_step,
+                                                       ControlPipeline::Commands* commands) {
+      franka::Torques torques =
+          libfrankaUpdateCallback(effort_joint_command_libfranka_, robot_state, time_step);
+      std::get<franka::Torques>(*commands) = torques;
+      return !torques.motion_finished;
+    });
+  } catch (const franka::ControlException&) {
+    // The reflex is visible to the controllers right away, as after reading the robot state.
+    update(mock_robot_.state());
+    throw;
+  }
+}
+
+}  // namespace franka_hw
+
+PLUGINLIB_EXPORT_CLASS(franka_hw::FrankaMockCombinableHW, hardware_interface::RobotHW)
@@ -0,0 +1,135 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/franka_mock_hw.h>
+
+#include <mutex>
+
+#include <franka/exception.h>
+#include <ros/console.h>
+
+namespace franka_hw {
+
+bool FrankaMockHW::initParameters(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) {
+  if (!FrankaHW::initParameters(root_nh, robot_hw_nh)) {
+    return false;
+  }
+  return mock_robot_.init(robot_hw_nh, arm_id_);
+}
+
+void FrankaMockHW::connect() {
+  mock_robot_.connect();
+}
+
+bool FrankaMockHW::disconnect() {
+  if (controllerActive()) {
+    ROS_ERROR("FrankaMockHW: Rejected attempt to disconnect while controller is still running!");
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(robot_mutex_);
+  if (command_queue_) {
+    command_queue_->clear("Robot was disconnected.");
+  }
+  mock_robot_.disconnect();
+  return true;
+}
+
+bool FrankaMockHW::connected() {
+  return mock_robot_.connected();
+}
+
+void FrankaMockHW::initRobot() {
+  mock_robot_.connect();
+  update(mock_robot_.readOnce());
+}
+
+franka::RobotState FrankaMockHW::readRobotState() {
+  return mock_robot_.readOnce();
+}
+
+void FrankaMockHW::automaticErrorRecovery() {
+  mock_robot_.automaticErrorRecovery();
+}
+
+void FrankaMockHW::setupRobotServices(ros::NodeHandle& node_handle, ServiceContainer& services) {
+  setupRecordingServices([this]() { return connected(); }, robot_mutex_, command_queue_.get(),
+                         robot_settings_, node_handle, services);
+}
+
+MockRobot::LoopStatistics FrankaMockHW::statistics() {
+  return mock_robot_.statistics();
+}
+
+void FrankaMockHW::resetStatistics() {
+  mock_robot_.resetStatistics();
+}
+
+void FrankaMockHW::control(
+    const std::function<bool(const ros::Time&, const ros::Duration&)>& ros_callback) {
+  if (!initialized_) {
+    ROS_ERROR("FrankaMockHW: Call to control before initialization!");
+    return;
+  }
+  if (!controller_active_ || !mock_robot_.connected()) {
+    return;
+  }
+
+  franka::Duration last_time = robot_state_ros_.time;
+  Callback callback = [&ros_callback, &last_time](const franka::RobotState& robot_state,
+                                                  franka::Duration time_step) {
+    if (last_time != robot_state.time) {
+      last_time = robot_state.time;
+      return ros_callback(ros::Time::now(), ros::Duration(time_step.toSec()));
+    }
+    return true;
+  };
+
+  const ControlMode control_mode = current_control_mode_;
+  const ControlMode motion_generator = control_mode & ~ControlMode::JointTorque;
+  const bool torque_control = (control_mode & ControlMode::JointTorque) != ControlMode::None;
+
+  std::lock_guard<std::mutex> robot_lock(robot_mutex_);
+  startControlThreads(ros_callback);
+  logSwitchGap();
+  try {
+    mock_robot_.control(control_mode, [&](const franka::RobotState& robot_state,
+                                          franka::Duration time_step,
+                                          ControlPipeline::Commands* commands) {
+      bool running = true;
+      if (torque_control) {
+        running = callControlCallback(effort_joint_command_libfranka_, callback, robot_state,
+                                      time_step, commands);
+      }
+      switch (motion_generator) {
+        case ControlMode::JointPosition:
+          return callControlCallback(position_joint_command_libfranka_, callback, robot_state,
+                                     time_step, commands) &&
+                 running;
+        case ControlMode::JointVelocity:
+          return callControlCallback(velocity_joint_command_libfranka_, callback, robot_state,
+                                     time_step, commands) &&
+                 running;
+        case ControlMode::CartesianPose:
+          return callControlCallback(pose_cartesian_command_libfranka_, callback, robot_state,
+                                     time_step, commands) &&
+                 running;
+        case ControlMode::CartesianVelocity:
+          return callControlCallback(velocity_cartesian_command_libfranka_, callback, robot_state,
+                                     time_step, commands) &&
+                 running;
+        default:
+          return running;
+      }
+    });
+  } catch (const franka::ControlException&) {
+    stopControlThreads();
+    // The reflex is visible to the controllers right away, as after reading the robot state.
+    update(mock_robot_.state());
+    throw;
+  } catch (...) {
+    stopControlThreads();
+    throw;
+  }
+  stopControlThreads();
+}
+
+}  // namespace franka_hw
@@ -0,0 +1,163 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/franka_replay_hw.h>
+
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <franka/robot.h>
+#include <franka_msgs/FrankaState.h>
+#include <ros/console.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include <franka_hw/model.h>
+#include <franka_hw/state_log.h>
+
+namespace franka_hw {
+
+namespace {
+
+class StateLogSource : public FrankaReplayHW::Source {
+ public:
+  StateLogSource(const std::string& directory, const std::string& prefix)
+      : reader_(directory, prefix) {}
+
+  bool next(franka::RobotState* robot_state) override {
+    if (!reader_.next(&record_)) {
+      return false;
+    }
+    fromStateLogRecord(record_, robot_state);
+    return true;
+  }
+
+ private:
+  StateLogReader reader_;
+  StateLogRecord record_{};
+};
+
+class BagSource : public FrankaReplayHW::Source {
+ public:
+  BagSource(const std::string& path, const std::string& topic) : bag_(path, rosbag::bagmode::Read) {
+    view_ = std::make_unique<rosbag::View>(bag_, rosbag::TopicQuery(topic));
+    if (view_->size() == 0) {
+      throw std::runtime_error("No messages on topic " + topic + " in " + path);
+    }
+    iterator_ = view_->begin();
+  }
+
+  bool next(franka::RobotState* robot_state) override {
+    while (iterator_ != view_->end()) {
+      franka_msgs::FrankaState::ConstPtr message =
+          iterator_->instantiate<franka_msgs::FrankaState>();
+      ++iterator_;
+      if (message) {
+        fromFrankaStateMessage(*message, &record_);
+        fromStateLogRecord(record_, robot_state);
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  rosbag::Bag bag_;
+  std::unique_ptr<rosbag::View> view_;
+  rosbag::View::iterator iterator_;
+  StateLogRecord record_{};
+};
+
+}  // anonymous namespace
+
+FrankaReplayHW::FrankaReplayHW() = default;
+
+FrankaReplayHW::~FrankaReplayHW() = default;
+
+bool FrankaReplayHW::initParameters(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) {
+  if (!FrankaHW::initParameters(root_nh, robot_hw_nh)) {
+    return false;
+  }
+
+  source_type_ = robot_hw_nh.param("replay/source", std::string("state_log"));
+  if (source_type_ != "state_log" && source_type_ != "bag") {
+    ROS_ERROR("Invalid replay/source parameter provided. Valid values are 'state_log', 'bag'.");
+    return false;
+  }
+  if (!robot_hw_nh.getParam("replay/path", source_path_)) {
+    ROS_ERROR("Invalid or no replay/path parameter provided");
+    return false;
+  }
+  source_topic_ = robot_hw_nh.param("replay/topic",
+                                    std::string("/franka_state_controller/franka_states"));
+  if (state_log_enabled_ && source_type_ == "state_log" &&
+      state_log_config_.directory == source_path_) {
+    ROS_ERROR("The state_log/directory must differ from replay/path to not overwrite the replay.");
+    return false;
+  }
+  return true;
+}
+
+void FrankaReplayHW::connect() {}
+
+bool FrankaReplayHW::disconnect() {
+  return true;
+}
+
+bool FrankaReplayHW::connected() {
+  return false;
+}
+
+void FrankaReplayHW::control(
+    const std::function<bool(const ros::Time&, const ros::Duration&)>& /*ros_callback*/) {
+  ROS_ERROR("FrankaReplayHW: control() is not supported when replaying recorded states!");
+}
+
+void FrankaReplayHW::setModel(std::unique_ptr<ModelBase> model) {
+  model_ = std::move(model);
+}
+
+bool FrankaReplayHW::nextState() {
+  franka::RobotState robot_state;
+  if (!source_->next(&robot_state)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(libfranka_state_mutex_);
+  robot_state_libfranka_ = robot_state;
+  return true;
+}
+
+franka::Duration FrankaReplayHW::recordedTime() const noexcept {
+  return robot_state_libfranka_.time;
+}
+
+void FrankaReplayHW::captureCommands() noexcept {
+  logState(robot_state_libfranka_);
+}
+
+void FrankaReplayHW::initRobot() {
+  if (source_type_ == "bag") {
+    source_ = std::make_unique<BagSource>(source_path_, source_topic_);
+  } else {
+    // State logs are written with the arm_id as prefix, the state log of the replay is written
+    // to state_log/directory instead.
+    source_ = std::make_unique<StateLogSource>(source_path_, arm_id_);
+  }
+
+  if (!model_ && !robot_ip_.empty()) {
+    ROS_INFO("FrankaReplayHW: Loading model from robot at %s", robot_ip_.c_str());
+    franka::Robot robot(robot_ip_, realtime_config_);
+    model_ = std::make_unique<franka_hw::Model>(robot.loadModel());
+  }
+  if (!model_) {
+    ROS_WARN("FrankaReplayHW: No model available, the model interface will not be offered.");
+  }
+
+  if (!nextState()) {
+    throw std::runtime_error("FrankaReplayHW: Recording contains no robot states");
+  }
+  update(robot_state_libfranka_);
+}
+
+}  // namespace franka_hw
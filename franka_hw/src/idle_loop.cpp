@@ -0,0 +1,89 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/idle_loop.h>
+
+#include <time.h>
+#include <algorithm>
+
+namespace franka_hw {
+
+namespace {
+
+std::chrono::nanoseconds threadCpuTime() {
+  timespec time{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+}  // anonymous namespace
+
+IdleLoop::IdleLoop(double rate)
+    : rate_(rate),
+      period_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / rate))) {}
+
+void IdleLoop::enter() {
+  if (idle_) {
+    return;
+  }
+  idle_ = true;
+  statistics_ = Statistics();
+  start_time_ = std::chrono::steady_clock::now();
+  start_cpu_time_ = threadCpuTime();
+  next_cycle_ = start_time_;
+}
+
+bool IdleLoop::wait() {
+  statistics_.cycles++;
+  // Skip missed cycles instead of catching up on them.
+  next_cycle_ = std::max(next_cycle_ + period_, std::chrono::steady_clock::now());
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  const bool woken_up =
+      wakeup_.wait_until(lock, next_cycle_, [this] { return wakeup_requested_; });
+  wakeup_requested_ = false;
+  if (woken_up) {
+    statistics_.wakeups++;
+    next_cycle_ = std::chrono::steady_clock::now();
+  }
+  return woken_up;
+}
+
+void IdleLoop::wakeUp() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wakeup_requested_ = true;
+  }
+  wakeup_.notify_all();
+}
+
+void IdleLoop::countRead() noexcept {
+  if (idle_) {
+    statistics_.reads++;
+  }
+}
+
+IdleLoop::Statistics IdleLoop::leave() {
+  if (!idle_) {
+    return Statistics();
+  }
+  idle_ = false;
+  statistics_.duration =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+  if (statistics_.duration > 0.0) {
+    statistics_.cpu_usage =
+        std::chrono::duration<double>(threadCpuTime() - start_cpu_time_).count() /
+        statistics_.duration;
+  }
+  return statistics_;
+}
+
+bool IdleLoop::idle() const noexcept {
+  return idle_;
+}
+
+double IdleLoop::rate() const noexcept {
+  return rate_;
+}
+
+}  // namespace franka_hw
@@ -0,0 +1,292 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/mock_robot.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <franka/exception.h>
+#include <ros/console.h>
+
+#include <franka_hw/state_log.h>
+
+namespace franka_hw {
+
+namespace {
+
+constexpr std::chrono::milliseconds kCycle(1);
+
+// Bits of franka::Errors as packed by errorsToBitmask().
+constexpr uint64_t kJointReflex = uint64_t(1) << 6;
+constexpr uint64_t kCommunicationConstraintsViolation = uint64_t(1) << 31;
+
+double toSec(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+}  // anonymous namespace
+
+MockRobot::MockRobot()
+    : commands_(franka::Torques({0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}),
+                franka::JointPositions({0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}),
+                franka::JointVelocities({0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}),
+                franka::CartesianPose({1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0,
+                                       0.0, 0.0, 0.0, 1.0}),
+                franka::CartesianVelocities({0.0, 0.0, 0.0, 0.0, 0.0, 0.0})) {
+  success_history_.fill(true);
+  simulated_state_.q = {0.0, -M_PI_4, 0.0, -3 * M_PI_4, 0.0, M_PI_2, M_PI_4};
+  simulated_state_.q_d = simulated_state_.q;
+  simulated_state_.theta = simulated_state_.q;
+  simulated_state_.O_T_EE = {1.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0,
+                             0.0, 0.0, -1.0, 0.0, 0.307, 0.0, 0.487, 1.0};
+  simulated_state_.O_T_EE_d = simulated_state_.O_T_EE;
+  simulated_state_.O_T_EE_c = simulated_state_.O_T_EE;
+  simulated_state_.F_T_EE = {1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0,
+                             0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.1034, 1.0};
+  simulated_state_.EE_T_K = {1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0,
+                             0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0};
+  simulated_state_.control_command_success_rate = 1.0;
+  simulated_state_.robot_mode = franka::RobotMode::kIdle;
+}
+
+bool MockRobot::init(ros::NodeHandle& robot_hw_nh, const std::string& name) {
+  config_.latency = robot_hw_nh.param("mock/latency", config_.latency);
+  config_.latency_jitter = robot_hw_nh.param("mock/latency_jitter", config_.latency_jitter);
+  config_.packet_loss = robot_hw_nh.param("mock/packet_loss", config_.packet_loss);
+  config_.reflex_probability =
+      robot_hw_nh.param("mock/reflex_probability", config_.reflex_probability);
+  int max_lost_packets =
+      robot_hw_nh.param("mock/max_lost_packets", static_cast<int>(config_.max_lost_packets));
+  int seed = robot_hw_nh.param("mock/seed", static_cast<int>(config_.seed));
+  double report_period = robot_hw_nh.param("mock/report_period", 5.0);
+  if (config_.latency < 0.0 || config_.latency_jitter < 0.0 || config_.packet_loss < 0.0 ||
+      config_.packet_loss > 1.0 || config_.reflex_probability < 0.0 ||
+      config_.reflex_probability > 1.0 || max_lost_packets <= 0) {
+    ROS_ERROR("Invalid mock parameters provided");
+    return false;
+  }
+  config_.max_lost_packets = static_cast<size_t>(max_lost_packets);
+  config_.seed = static_cast<uint32_t>(seed);
+  random_engine_.seed(config_.seed);
+  name_ = name;
+  if (report_period > 0.0) {
+    report_timer_ = robot_hw_nh.createWallTimer(
+        ros::WallDuration(report_period),
+        [this](const ros::WallTimerEvent&) { reportStatistics(); });
+  }
+  return true;
+}
+
+void MockRobot::connect() {
+  connected_ = true;
+  next_read_ = std::chrono::steady_clock::now();
+}
+
+void MockRobot::disconnect() {
+  connected_ = false;
+}
+
+bool MockRobot::connected() const noexcept {
+  return connected_;
+}
+
+franka::RobotState MockRobot::readOnce() {
+  size_t missed_cycles = waitForNextCycle(&next_read_);
+  simulated_state_.time += franka::Duration(missed_cycles + 1);
+  return simulated_state_;
+}
+
+const franka::RobotState& MockRobot::state() const noexcept {
+  return simulated_state_;
+}
+
+void MockRobot::automaticErrorRecovery() {
+  simulated_state_.current_errors = franka::Errors();
+  simulated_state_.robot_mode = franka::RobotMode::kIdle;
+  consecutive_lost_packets_ = 0;
+}
+
+MockRobot::LoopStatistics MockRobot::statistics() {
+  std::lock_guard<std::mutex> lock(statistics_mutex_);
+  return statistics_;
+}
+
+void MockRobot::resetStatistics() {
+  std::lock_guard<std::mutex> lock(statistics_mutex_);
+  statistics_ = LoopStatistics();
+}
+
+void MockRobot::control(ControlMode control_mode, const Callback& callback) {
+  if (simulated_state_.robot_mode == franka::RobotMode::kReflex) {
+    throw franka::ControlException("MockRobot: Robot is in reflex mode, recover first.");
+  }
+
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  simulated_state_.robot_mode = franka::RobotMode::kMove;
+  std::chrono::steady_clock::time_point next_cycle = std::chrono::steady_clock::now();
+  uint64_t elapsed_cycles = 0;
+  bool first_cycle = true;
+  bool running = true;
+  while (running) {
+    size_t missed_cycles = waitForNextCycle(&next_cycle);
+    for (size_t i = 0; i < missed_cycles; i++) {
+      updateSuccessRate(false);
+    }
+    simulated_state_.time += franka::Duration(missed_cycles + 1);
+    elapsed_cycles += missed_cycles + 1;
+
+    if (consecutive_lost_packets_ >= config_.max_lost_packets) {
+      throwReflex("communication_constraints_violation", true);
+    }
+    if (config_.reflex_probability > 0.0 && uniform(random_engine_) < config_.reflex_probability) {
+      throwReflex("joint_reflex", false);
+    }
+    if (packetLost()) {
+      updateSuccessRate(false);
+      continue;
+    }
+    // As in libfranka, the first callback is called with a time step of zero.
+    const franka::Duration time_step(first_cycle ? 0 : elapsed_cycles);
+    first_cycle = false;
+    elapsed_cycles = 0;
+
+    const auto cycle_start = std::chrono::steady_clock::now();
+    double latency =
+        config_.latency + (2.0 * uniform(random_engine_) - 1.0) * config_.latency_jitter;
+    if (latency > 0.0) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(latency));
+    }
+
+    const auto callback_start = std::chrono::steady_clock::now();
+    running = callback(simulated_state_, time_step, &commands_);
+    const auto callback_end = std::chrono::steady_clock::now();
+
+    // Commands arriving after the end of the cycle are lost, as on the real robot.
+    const bool in_time = callback_end - cycle_start < kCycle;
+    updateSuccessRate(in_time);
+    if (in_time) {
+      simulate(control_mode, commands_, time_step.toSec());
+    }
+
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    const double callback_duration = toSec(callback_end - callback_start);
+    statistics_.cycles++;
+    statistics_.total_callback_duration += callback_duration;
+    statistics_.max_callback_duration =
+        std::max(statistics_.max_callback_duration, callback_duration);
+  }
+
+  simulated_state_.robot_mode = franka::RobotMode::kIdle;
+  next_read_ = std::chrono::steady_clock::now();
+}
+
+size_t MockRobot::waitForNextCycle(std::chrono::steady_clock::time_point* next_cycle) {
+  std::this_thread::sleep_until(*next_cycle);
+  const auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    statistics_.max_cycle_jitter = std::max(statistics_.max_cycle_jitter, toSec(now - *next_cycle));
+  }
+  // The robot keeps sending states while the caller is late, these are lost.
+  size_t missed_cycles = 0;
+  *next_cycle += kCycle;
+  while (*next_cycle <= now) {
+    *next_cycle += kCycle;
+    missed_cycles++;
+  }
+  return missed_cycles;
+}
+
+bool MockRobot::packetLost() {
+  if (config_.packet_loss <= 0.0) {
+    return false;
+  }
+  return std::uniform_real_distribution<double>(0.0, 1.0)(random_engine_) < config_.packet_loss;
+}
+
+void MockRobot::updateSuccessRate(bool success) {
+  success_count_ -= success_history_[success_history_index_] ? 1 : 0;
+  success_history_[success_history_index_] = success;
+  success_count_ += success ? 1 : 0;
+  success_history_index_ = (success_history_index_ + 1) % success_history_.size();
+  consecutive_lost_packets_ = success ? 0 : consecutive_lost_packets_ + 1;
+
+  simulated_state_.control_command_success_rate =
+      static_cast<double>(success_count_) / success_history_.size();
+  std::lock_guard<std::mutex> lock(statistics_mutex_);
+  statistics_.lost_packets += success ? 0 : 1;
+  statistics_.control_command_success_rate = simulated_state_.control_command_success_rate;
+}
+
+void MockRobot::simulate(ControlMode control_mode,
+                         const ControlPipeline::Commands& commands,
+                         double period) {
+  franka::RobotState& state = simulated_state_;
+  const ControlMode motion_generator = control_mode & ~ControlMode::JointTorque;
+  switch (motion_generator) {
+    case ControlMode::JointPosition: {
+      const auto& q_c = std::get<franka::JointPositions>(commands).q;
+      for (size_t i = 0; i < state.q.size(); i++) {
+        state.dq[i] = period > 0.0 ? (q_c[i] - state.q[i]) / period : 0.0;
+        state.q[i] = q_c[i];
+      }
+      break;
+    }
+    case ControlMode::JointVelocity:
+      for (size_t i = 0; i < state.q.size(); i++) {
+        state.dq[i] = std::get<franka::JointVelocities>(commands).dq[i];
+        state.q[i] += state.dq[i] * period;
+      }
+      break;
+    case ControlMode::CartesianPose:
+      state.O_T_EE = std::get<franka::CartesianPose>(commands).O_T_EE;
+      break;
+    case ControlMode::CartesianVelocity:
+      for (size_t i = 0; i < 3; i++) {
+        state.O_T_EE[12 + i] += std::get<franka::CartesianVelocities>(commands).O_dP_EE[i] * period;
+      }
+      break;
+    default:
+      // Pure torque control is not simulated dynamically, the robot holds its position.
+      state.dq.fill(0.0);
+      break;
+  }
+  if ((control_mode & ControlMode::JointTorque) != ControlMode::None) {
+    state.tau_J_d = std::get<franka::Torques>(commands).tau_J;
+    state.tau_J = std::get<franka::Torques>(commands).tau_J;
+  }
+  state.q_d = state.q;
+  state.dq_d = state.dq;
+  state.theta = state.q;
+  state.dtheta = state.dq;
+  state.O_T_EE_d = state.O_T_EE;
+  state.O_T_EE_c = state.O_T_EE;
+}
+
+void MockRobot::throwReflex(const std::string& message, bool communication_error) {
+  const uint64_t errors = communication_error ? kCommunicationConstraintsViolation : kJointReflex;
+  simulated_state_.current_errors = bitmaskToErrors(errors);
+  simulated_state_.last_motion_errors = bitmaskToErrors(errors);
+  simulated_state_.robot_mode = franka::RobotMode::kReflex;
+  next_read_ = std::chrono::steady_clock::now();
+  throw franka::ControlException("libfranka: Move command aborted: motion aborted by reflex! [" +
+                                 message + "]");
+}
+
+void MockRobot::reportStatistics() {
+  const LoopStatistics statistics = this->statistics();
+  resetStatistics();
+  if (statistics.cycles == 0) {
+    return;
+  }
+  ROS_INFO(
+      "MockRobot: %s: %lu cycles, %lu lost packets, control_command_success_rate: %.3f, "
+      "callback duration mean: %.1f us, max: %.1f us, max cycle jitter: %.1f us",
+      name_.c_str(), static_cast<unsigned long>(statistics.cycles),
+      static_cast<unsigned long>(statistics.lost_packets), statistics.control_command_success_rate,
+      statistics.total_callback_duration / statistics.cycles * 1e6,
+      statistics.max_callback_duration * 1e6, statistics.max_cycle_jitter * 1e6);
+}
+
+}  // namespace franka_hw
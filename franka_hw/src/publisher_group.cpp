@@ -0,0 +1,69 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/publisher_group.h>
+
+#include <cerrno>
+#include <utility>
+
+#include <ros/console.h>
+
+using namespace std::chrono_literals;
+
+namespace franka_hw {
+
+PublisherGroup::PublisherGroup() {
+  sem_init(&wakeup_, 0, 0);
+}
+
+PublisherGroup::~PublisherGroup() {
+  running_ = false;
+  if (thread_.joinable()) {
+    sem_post(&wakeup_);
+    thread_.join();
+  }
+  publishQueued();
+  // Publishers may outlive the group.
+  for (auto& topic : topics_) {
+    topic.publisher->setWakeup(nullptr);
+  }
+  sem_destroy(&wakeup_);
+}
+
+void PublisherGroup::addTopic(std::shared_ptr<RingPublisherBase> publisher) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  publisher->setWakeup(&wakeup_);
+  topics_.push_back(Topic{std::move(publisher), 0, std::chrono::steady_clock::time_point()});
+  if (!running_) {
+    running_ = true;
+    thread_ = std::thread(&PublisherGroup::run, this);
+  }
+}
+
+void PublisherGroup::run() {
+  while (running_) {
+    if (sem_wait(&wakeup_) != 0 && errno == EINTR) {
+      continue;
+    }
+    // Messages queued by several posts are published at once, the remaining posts only cause
+    // empty passes.
+    publishQueued();
+  }
+}
+
+void PublisherGroup::publishQueued() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto now = std::chrono::steady_clock::now();
+  for (auto& topic : topics_) {
+    topic.publisher->publishQueued();
+    const uint64_t dropped_messages = topic.publisher->droppedMessages();
+    if (dropped_messages != topic.reported_drops && now - topic.last_report >= 1s) {
+      ROS_WARN("PublisherGroup: Dropped %lu messages on %s, %lu in total",
+               static_cast<unsigned long>(dropped_messages - topic.reported_drops),
+               topic.publisher->topic().c_str(), static_cast<unsigned long>(dropped_messages));
+      topic.reported_drops = dropped_messages;
+      topic.last_report = now;
+    }
+  }
+}
+
+}  // namespace franka_hw
@@ -2,6 +2,8 @@
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #include <franka_hw/resource_helpers.h>
 
+#include <algorithm>
+
 #include <ros/console.h>
 
 namespace franka_hw {
@@ -216,4 +218,166 @@ bool hasTrajectoryClaim(const ArmClaimedMap& arm_claim_map, const std::string& a
   return false;
 }
 
+namespace {
+
+std::array<ControlMode, 1 << ResourceRegistry::kInterfaceCount> makeControlModeTable() {
+  std::array<ControlMode, 1 << ResourceRegistry::kInterfaceCount> table;
+  table.fill(ControlMode::None);
+  constexpr uint8_t kPosition = 1 << ResourceRegistry::kJointPosition;
+  constexpr uint8_t kVelocity = 1 << ResourceRegistry::kJointVelocity;
+  constexpr uint8_t kTorque = 1 << ResourceRegistry::kJointTorque;
+  constexpr uint8_t kPose = 1 << ResourceRegistry::kCartesianPose;
+  constexpr uint8_t kCartesianVelocity = 1 << ResourceRegistry::kCartesianVelocity;
+  table[kPosition] = ControlMode::JointPosition;
+  table[kVelocity] = ControlMode::JointVelocity;
+  table[kTorque] = ControlMode::JointTorque;
+  table[kPose] = ControlMode::CartesianPose;
+  table[kCartesianVelocity] = ControlMode::CartesianVelocity;
+  table[kTorque | kPosition] = ControlMode::JointTorque | ControlMode::JointPosition;
+  table[kTorque | kVelocity] = ControlMode::JointTorque | ControlMode::JointVelocity;
+  table[kTorque | kPose] = ControlMode::JointTorque | ControlMode::CartesianPose;
+  table[kTorque | kCartesianVelocity] = ControlMode::JointTorque | ControlMode::CartesianVelocity;
+  return table;
+}
+
+}  // anonymous namespace
+
+ResourceRegistry::ResourceRegistry()
+    : interfaces_({{"hardware_interface::PositionJointInterface", kJointPosition},
+                   {"hardware_interface::VelocityJointInterface", kJointVelocity},
+                   {"hardware_interface::EffortJointInterface", kJointTorque},
+                   {"franka_hw::FrankaPoseCartesianInterface", kCartesianPose},
+                   {"franka_hw::FrankaVelocityCartesianInterface", kCartesianVelocity}}) {}
+
+size_t ResourceRegistry::addArm(const std::string& arm_id,
+                                const std::array<std::string, 7>& joint_names) {
+  size_t index;
+  for (const auto& joint_name : joint_names) {
+    internResource(joint_name, &index);
+  }
+  internResource(arm_id + "_robot", &index);
+  return internArm(arm_id);
+}
+
+size_t ResourceRegistry::internArm(const std::string& arm_id) {
+  return arms_.emplace(arm_id, arms_.size()).first->second;
+}
+
+bool ResourceRegistry::internResource(const std::string& resource, size_t* index) {
+  auto interned = resources_.find(resource);
+  if (interned != resources_.end()) {
+    *index = interned->second;
+    return true;
+  }
+  std::string arm_id;
+  if (!findArmIdInResourceId(resource, &arm_id)) {
+    ROS_ERROR_STREAM("Resource conflict: Could not find arm_id in resource "
+                     << resource << ". Name joints as '<robot_arm_id>_joint<jointnumber>'");
+    return false;
+  }
+  *index = resource_names_.size();
+  resources_.emplace(resource, *index);
+  resource_names_.push_back(resource);
+  resource_arms_.push_back(internArm(arm_id));
+  resource_claims_.push_back(0);
+  resource_torque_claims_.push_back(0);
+  return true;
+}
+
+bool ResourceRegistry::evaluate(const std::list<hardware_interface::ControllerInfo>& info,
+                                Claims* claims) {
+  std::fill(resource_claims_.begin(), resource_claims_.end(), 0);
+  std::fill(resource_torque_claims_.begin(), resource_torque_claims_.end(), 0);
+  claims->arms.assign(arms_.size(), ArmClaims());
+  claims->conflicting_multi_claim = false;
+
+  bool valid = true;
+  for (const auto& controller : info) {
+    for (const auto& resource_set : controller.claimed_resources) {
+      auto interface = interfaces_.find(resource_set.hardware_interface);
+      const bool known_interface = interface != interfaces_.end();
+      // ros_control lists every interface of a controller, e.g. state and model interfaces
+      // without any resources. Only claims of resources need a known command interface.
+      for (const auto& resource : resource_set.resources) {
+        size_t index;
+        if (!internResource(resource, &index)) {
+          valid = false;
+          continue;
+        }
+        resource_claims_[index]++;
+        if (!known_interface) {
+          valid = false;
+          continue;
+        }
+        if (interface->second == kJointTorque) {
+          resource_torque_claims_[index]++;
+        }
+        const size_t arm = resource_arms_[index];
+        if (arm >= claims->arms.size()) {
+          claims->arms.resize(arms_.size());
+        }
+        claims->arms[arm].claims[interface->second]++;
+        claims->arms[arm].interfaces |= 1 << interface->second;
+      }
+    }
+  }
+
+  for (size_t index = 0; index < resource_claims_.size(); index++) {
+    if (resource_claims_[index] > 2) {
+      ROS_ERROR_STREAM("Resource conflict: " << resource_names_[index]
+                                             << " is claimed with more than two command interfaces "
+                                                "which is not supported.");
+      claims->conflicting_multi_claim = true;
+    } else if (resource_claims_[index] == 2 && resource_torque_claims_[index] != 1) {
+      ROS_ERROR_STREAM("Resource conflict: "
+                       << resource_names_[index]
+                       << " is claimed with a combination of two interfaces that is not "
+                          "supported.");
+      claims->conflicting_multi_claim = true;
+    }
+  }
+  return valid;
+}
+
+const ResourceRegistry::ArmClaims& ResourceRegistry::armClaims(const Claims& claims, size_t arm) {
+  static const ArmClaims kNoClaims;
+  return arm < claims.arms.size() ? claims.arms[arm] : kNoClaims;
+}
+
+ControlMode ResourceRegistry::controlMode(const ArmClaims& arm_claims) {
+  static const auto kControlModes = makeControlModeTable();
+  return kControlModes[arm_claims.interfaces];
+}
+
+bool ResourceRegistry::hasConflictingJointAndCartesianClaim(const ArmClaims& arm_claims,
+                                                            const std::string& arm_id) {
+  constexpr uint8_t kJointTrajectory = (1 << kJointPosition) | (1 << kJointVelocity);
+  constexpr uint8_t kCartesian = (1 << kCartesianPose) | (1 << kCartesianVelocity);
+  if ((arm_claims.interfaces & kJointTrajectory) != 0 &&
+      (arm_claims.interfaces & kCartesian) != 0) {
+    ROS_ERROR_STREAM(
+        "Resource conflict: Invalid combination of claims on joint AND cartesian level on arm "
+        << arm_id << " which is not supported.");
+    return true;
+  }
+  return false;
+}
+
+bool ResourceRegistry::partiallyClaimsArmJoints(const ArmClaims& arm_claims,
+                                                const std::string& arm_id) {
+  for (Interface interface : {kJointPosition, kJointVelocity, kJointTorque}) {
+    if (arm_claims.claims[interface] > 0 && arm_claims.claims[interface] != 7) {
+      ROS_ERROR_STREAM("Resource conflict: Partially claiming joints of arm "
+                       << arm_id
+                       << " is not supported. Make sure to claim all 7 joints of the robot.");
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ResourceRegistry::hasTrajectoryClaim(const ArmClaims& arm_claims) {
+  return (arm_claims.interfaces & ~(1 << kJointTorque)) != 0;
+}
+
 }  // namespace franka_hw
@@ -0,0 +1,97 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/robot_command_queue.h>
+
+#include <exception>
+#include <utility>
+
+#include <ros/console.h>
+
+namespace franka_hw {
+
+RobotCommandQueue::RobotCommandQueue(size_t capacity,
+                                     std::function<void(const Result&)> result_callback,
+                                     std::function<void()> push_callback)
+    : capacity_(capacity),
+      result_callback_(std::move(result_callback)),
+      push_callback_(std::move(push_callback)) {}
+
+uint64_t RobotCommandQueue::push(const std::string& name, Command command) {
+  uint64_t request_id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.size() >= capacity_) {
+      return 0;
+    }
+    request_id = next_request_id_++;
+    pending_.push_back(Entry{request_id, name, std::move(command)});
+  }
+  if (push_callback_) {
+    push_callback_();
+  }
+  return request_id;
+}
+
+size_t RobotCommandQueue::process() {
+  // Commands pushed while processing are left for the next call, so a busy caller cannot keep the
+  // robot thread here.
+  size_t count;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    count = pending_.size();
+  }
+  for (size_t i = 0; i < count; i++) {
+    Entry entry;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      entry = std::move(pending_.front());
+      pending_.pop_front();
+    }
+    Result result;
+    result.request_id = entry.request_id;
+    result.name = entry.name;
+    try {
+      entry.command();
+      result.success = true;
+      ROS_DEBUG_STREAM(entry.name << " (request " << entry.request_id << ") succeeded.");
+    } catch (const std::exception& ex) {
+      // Not only franka::Exception, a failing command must not take down the robot thread.
+      ROS_ERROR_STREAM(entry.name << " (request " << entry.request_id << ") failed: " << ex.what());
+      result.error = ex.what();
+    }
+    if (result_callback_) {
+      result_callback_(result);
+    }
+  }
+  return count;
+}
+
+size_t RobotCommandQueue::clear(const std::string& reason) {
+  std::deque<Entry> dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dropped.swap(pending_);
+  }
+  for (const Entry& entry : dropped) {
+    ROS_WARN_STREAM(entry.name << " (request " << entry.request_id << ") dropped: " << reason);
+    if (result_callback_) {
+      Result result;
+      result.request_id = entry.request_id;
+      result.name = entry.name;
+      result.error = reason;
+      result_callback_(result);
+    }
+  }
+  return dropped.size();
+}
+
+size_t RobotCommandQueue::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_.size();
+}
+
+size_t RobotCommandQueue::capacity() const noexcept {
+  return capacity_;
+}
+
+}  // namespace franka_hw
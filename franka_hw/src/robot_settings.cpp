@@ -0,0 +1,47 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/robot_settings.h>
+
+#include <algorithm>
+
+namespace franka_hw {
+
+void RobotSettings::apply(franka::Robot& robot, const std::string& name, Setter setter) {
+  setter(robot);
+  record(name, std::move(setter));
+}
+
+void RobotSettings::record(const std::string& name, Setter setter) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto setting = std::find_if(settings_.begin(), settings_.end(),
+                              [&name](const auto& setting) { return setting.first == name; });
+  if (setting != settings_.end()) {
+    setting->second = std::move(setter);
+  } else {
+    settings_.emplace_back(name, std::move(setter));
+  }
+}
+
+size_t RobotSettings::replay(franka::Robot& robot) const {
+  std::vector<std::pair<std::string, Setter>> settings;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settings = settings_;
+  }
+  for (const auto& setting : settings) {
+    setting.second(robot);
+  }
+  return settings.size();
+}
+
+void RobotSettings::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  settings_.clear();
+}
+
+size_t RobotSettings::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return settings_.size();
+}
+
+}  // namespace franka_hw
@@ -3,9 +3,71 @@
 #include <franka_hw/services.h>
 
 #include <mutex>
+#include <utility>
 
 namespace franka_hw {
 
+namespace {
+
+// Applies a setting of the given name, e.g. to the connected robot, and records it.
+using ApplySetting = std::function<void(const std::string&, RobotSettings::Setter)>;
+
+template <typename T>
+void advertiseSetting(
+    ServiceContainer& services,
+    ros::NodeHandle& node_handle,
+    const std::string& name,
+    const std::string& setting,
+    void (*set)(franka::Robot&, const typename T::Request&, typename T::Response&),
+    const ApplySetting& apply,
+    std::mutex& robot_mutex,
+    RobotCommandQueue* queue) {
+  auto handler = [set, setting, apply](const typename T::Request& req,
+                                       typename T::Response& /* res */) {
+    apply(setting, [set, req](franka::Robot& target) {
+      typename T::Response res;
+      set(target, req, res);
+    });
+  };
+  if (queue != nullptr) {
+    services.advertiseQueuedService<T>(node_handle, name, *queue, handler);
+  } else {
+    services.advertiseService<T>(node_handle, name,
+                                 [handler, &robot_mutex](auto&& req, auto&& res) {
+                                   std::lock_guard<std::mutex> lock(robot_mutex);
+                                   handler(req, res);
+                                 });
+  }
+}
+
+void advertiseSettings(const ApplySetting& apply,
+                       std::mutex& robot_mutex,
+                       RobotCommandQueue* queue,
+                       ros::NodeHandle& node_handle,
+                       ServiceContainer& services) {
+  advertiseSetting<franka_msgs::SetJointImpedance>(services, node_handle, "set_joint_impedance",
+                                                   "joint_impedance", franka_hw::setJointImpedance,
+                                                   apply, robot_mutex, queue);
+  advertiseSetting<franka_msgs::SetCartesianImpedance>(
+      services, node_handle, "set_cartesian_impedance", "cartesian_impedance",
+      franka_hw::setCartesianImpedance, apply, robot_mutex, queue);
+  advertiseSetting<franka_msgs::SetEEFrame>(services, node_handle, "set_EE_frame", "EE_frame",
+                                            franka_hw::setEEFrame, apply, robot_mutex, queue);
+  advertiseSetting<franka_msgs::SetKFrame>(services, node_handle, "set_K_frame", "K_frame",
+                                           franka_hw::setKFrame, apply, robot_mutex, queue);
+  // Both collision behavior services set the same robot parameters.
+  advertiseSetting<franka_msgs::SetForceTorqueCollisionBehavior>(
+      services, node_handle, "set_force_torque_collision_behavior", "collision_behavior",
+      franka_hw::setForceTorqueCollisionBehavior, apply, robot_mutex, queue);
+  advertiseSetting<franka_msgs::SetFullCollisionBehavior>(
+      services, node_handle, "set_full_collision_behavior", "collision_behavior",
+      franka_hw::setFullCollisionBehavior, apply, robot_mutex, queue);
+  advertiseSetting<franka_msgs::SetLoad>(services, node_handle, "set_load", "load",
+                                         franka_hw::setLoad, apply, robot_mutex, queue);
+}
+
+}  // anonymous namespace
+
 void setupServices(franka::Robot& robot,
                    std::mutex& robot_mutex,
                    ros::NodeHandle& node_handle,
@@ -52,6 +114,39 @@ void setupServices(franka::Robot& robot,
                                               });
 }
 
+void setupServices(const std::function<franka::Robot*()>& robot,
+                   std::mutex& robot_mutex,
+                   RobotCommandQueue* queue,
+                   RobotSettings& settings,
+                   ros::NodeHandle& node_handle,
+                   ServiceContainer& services) {
+  advertiseSettings(
+      [robot, &settings](const std::string& setting, RobotSettings::Setter setter) {
+        franka::Robot* connected_robot = robot();
+        if (connected_robot == nullptr) {
+          throw franka::NetworkException("libfranka: Robot is not connected.");
+        }
+        settings.apply(*connected_robot, setting, std::move(setter));
+      },
+      robot_mutex, queue, node_handle, services);
+}
+
+void setupRecordingServices(const std::function<bool()>& connected,
+                            std::mutex& robot_mutex,
+                            RobotCommandQueue* queue,
+                            RobotSettings& settings,
+                            ros::NodeHandle& node_handle,
+                            ServiceContainer& services) {
+  advertiseSettings(
+      [connected, &settings](const std::string& setting, RobotSettings::Setter setter) {
+        if (!connected()) {
+          throw franka::NetworkException("libfranka: Robot is not connected.");
+        }
+        settings.record(setting, std::move(setter));
+      },
+      robot_mutex, queue, node_handle, services);
+}
+
 void setCartesianImpedance(franka::Robot& robot,
                            const franka_msgs::SetCartesianImpedance::Request& req,
                            franka_msgs::SetCartesianImpedance::Response& /* res */) {
@@ -0,0 +1,78 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/state_barrier.h>
+
+#include <algorithm>
+
+namespace franka_hw {
+
+StateBarrier::StateBarrier(size_t arms)
+    : arrived_(arms, 0), arrival_times_(arms), robot_times_(arms, 0.0) {
+  statistics_.stale_states.resize(arms, 0);
+}
+
+void StateBarrier::signal(size_t arm, double robot_time) {
+  const auto now = std::chrono::steady_clock::now();
+  bool complete = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A second state before the next cycle replaces the first one, so the skew is measured
+    // between the newest states.
+    arrival_times_[arm] = now;
+    robot_times_[arm] = robot_time;
+    if (arrived_[arm] == 0) {
+      arrived_[arm] = 1;
+      arrived_count_++;
+      complete = arrived_count_ == arrived_.size();
+    }
+  }
+  if (complete) {
+    arrived_condition_.notify_one();
+  }
+}
+
+bool StateBarrier::wait(std::chrono::steady_clock::duration timeout, double* period) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const bool complete = arrived_condition_.wait_for(
+      lock, timeout, [this] { return arrived_count_ == arrived_.size(); });
+
+  statistics_.cycles++;
+  if (complete) {
+    const auto first = std::min_element(arrival_times_.cbegin(), arrival_times_.cend());
+    const auto last = std::max_element(arrival_times_.cbegin(), arrival_times_.cend());
+    statistics_.skew = std::chrono::duration<double>(*last - *first).count();
+    statistics_.max_skew = std::max(statistics_.max_skew, statistics_.skew);
+    skew_sum_ += statistics_.skew;
+    complete_cycles_++;
+    statistics_.mean_skew = skew_sum_ / complete_cycles_;
+  } else {
+    statistics_.timeouts++;
+    for (size_t arm = 0; arm < arrived_.size(); arm++) {
+      statistics_.stale_states[arm] += arrived_[arm] == 0 ? 1 : 0;
+    }
+  }
+
+  if (!arrived_.empty() && arrived_[0] != 0) {
+    if (last_robot_time_ >= 0.0) {
+      *period = robot_times_[0] - last_robot_time_;
+    }
+    last_robot_time_ = robot_times_[0];
+  }
+  std::fill(arrived_.begin(), arrived_.end(), 0);
+  arrived_count_ = 0;
+  return complete;
+}
+
+void StateBarrier::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::fill(arrived_.begin(), arrived_.end(), 0);
+  arrived_count_ = 0;
+  last_robot_time_ = -1.0;
+}
+
+StateBarrier::Statistics StateBarrier::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+}  // namespace franka_hw
@@ -0,0 +1,215 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/state_channel.h>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace franka_hw {
+
+namespace {
+
+std::string systemError(const std::string& message, const std::string& name) {
+  return message + " " + name + ": " + std::strerror(errno);
+}
+
+size_t segmentSize(size_t capacity) {
+  return kStateChannelHeaderSize + capacity * sizeof(StateChannelSlot);
+}
+
+const StateChannelSlot* slotsOf(const void* data) {
+  return reinterpret_cast<const StateChannelSlot*>(static_cast<const char*>(data) +
+                                                   kStateChannelHeaderSize);
+}
+
+// Only segments whose writer verifiably died are stale. Segments of a running writer, of an older
+// layout or still being initialized are left alone.
+bool isStale(const std::string& name) {
+  const int file_descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+  if (file_descriptor < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(file_descriptor, &status) != 0 ||
+      static_cast<size_t>(status.st_size) < kStateChannelHeaderSize) {
+    close(file_descriptor);
+    return false;
+  }
+  void* data = mmap(nullptr, kStateChannelHeaderSize, PROT_READ, MAP_SHARED, file_descriptor, 0);
+  close(file_descriptor);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  const auto* header = static_cast<const StateChannelHeader*>(data);
+  const bool stale = header->magic.load(std::memory_order_acquire) == kStateChannelMagic &&
+                     header->version == kStateChannelVersion && header->writer_pid > 0 &&
+                     kill(header->writer_pid, 0) != 0 && errno == ESRCH;
+  munmap(data, kStateChannelHeaderSize);
+  return stale;
+}
+
+}  // anonymous namespace
+
+StateChannelWriter::StateChannelWriter(const std::string& name, size_t capacity)
+    : name_(name), size_(segmentSize(capacity)) {
+  if (capacity == 0 || capacity > UINT32_MAX) {
+    throw std::runtime_error("Invalid capacity of state channel " + name);
+  }
+  int file_descriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (file_descriptor < 0 && errno == EEXIST && isStale(name)) {
+    shm_unlink(name.c_str());
+    file_descriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+  if (file_descriptor < 0) {
+    if (errno == EEXIST) {
+      throw std::runtime_error("State channel " + name +
+                               " is in use by another writer or could not be verified as stale");
+    }
+    throw std::runtime_error(systemError("Could not create state channel", name));
+  }
+  if (ftruncate(file_descriptor, static_cast<off_t>(size_)) != 0) {
+    const std::string error = systemError("Could not resize state channel", name);
+    close(file_descriptor);
+    shm_unlink(name.c_str());
+    throw std::runtime_error(error);
+  }
+  data_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+  close(file_descriptor);
+  if (data_ == MAP_FAILED) {
+    const std::string error = systemError("Could not map state channel", name);
+    shm_unlink(name.c_str());
+    throw std::runtime_error(error);
+  }
+
+  // Touches every page, so writing in the control loop does not page fault. All slots start out
+  // empty. Readers only accept the segment once the magic number is set.
+  std::memset(data_, 0, size_);
+  header_ = static_cast<StateChannelHeader*>(data_);
+  slots_ = const_cast<StateChannelSlot*>(slotsOf(data_));
+  header_->version = kStateChannelVersion;
+  header_->record_size = sizeof(StateLogRecord);
+  header_->capacity = static_cast<uint32_t>(capacity);
+  header_->writer_pid = static_cast<int32_t>(getpid());
+  header_->write_count.store(0, std::memory_order_relaxed);
+  header_->magic.store(kStateChannelMagic, std::memory_order_release);
+}
+
+StateChannelWriter::~StateChannelWriter() {
+  munmap(data_, size_);
+  shm_unlink(name_.c_str());
+}
+
+void StateChannelWriter::write(const franka::RobotState& robot_state) noexcept {
+  StateChannelSlot& slot = slots_[write_count_ % header_->capacity];
+  slot.sequence.store(2 * write_count_ + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  toStateLogRecord(robot_state, &slot.record);
+  slot.record.sequence = write_count_;
+  slot.sequence.store(2 * write_count_ + 2, std::memory_order_release);
+
+  write_count_++;
+  header_->write_count.store(write_count_, std::memory_order_release);
+}
+
+uint64_t StateChannelWriter::writtenStates() const noexcept {
+  return write_count_;
+}
+
+StateChannelReader::StateChannelReader(const std::string& name) {
+  const int file_descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+  if (file_descriptor < 0) {
+    throw std::runtime_error(systemError("Could not open state channel", name));
+  }
+  struct stat status;
+  if (fstat(file_descriptor, &status) != 0) {
+    const std::string error = systemError("Could not get size of state channel", name);
+    close(file_descriptor);
+    throw std::runtime_error(error);
+  }
+  size_ = static_cast<size_t>(status.st_size);
+  if (size_ < kStateChannelHeaderSize) {
+    close(file_descriptor);
+    throw std::runtime_error("State channel " + name + " is not initialized");
+  }
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, file_descriptor, 0);
+  close(file_descriptor);
+  if (data_ == MAP_FAILED) {
+    throw std::runtime_error(systemError("Could not map state channel", name));
+  }
+
+  header_ = static_cast<const StateChannelHeader*>(data_);
+  slots_ = slotsOf(data_);
+  if (header_->magic.load(std::memory_order_acquire) != kStateChannelMagic ||
+      header_->version != kStateChannelVersion ||
+      header_->record_size != sizeof(StateLogRecord) || header_->capacity == 0 ||
+      size_ < segmentSize(header_->capacity)) {
+    munmap(data_, size_);
+    throw std::runtime_error("State channel " + name + " is not initialized or incompatible");
+  }
+  next_index_ = header_->write_count.load(std::memory_order_acquire);
+}
+
+StateChannelReader::~StateChannelReader() {
+  munmap(data_, size_);
+}
+
+bool StateChannelReader::read(uint64_t index, StateLogRecord* record) const noexcept {
+  const StateChannelSlot& slot = slots_[index % header_->capacity];
+  const uint64_t expected_sequence = 2 * index + 2;
+  if (slot.sequence.load(std::memory_order_acquire) != expected_sequence) {
+    return false;
+  }
+  std::memcpy(record, &slot.record, sizeof(StateLogRecord));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.sequence.load(std::memory_order_relaxed) == expected_sequence;
+}
+
+bool StateChannelReader::readLatest(StateLogRecord* record) noexcept {
+  while (true) {
+    const uint64_t write_count = header_->write_count.load(std::memory_order_acquire);
+    if (write_count == 0) {
+      return false;
+    }
+    // Fails only if the writer went around the whole ring while copying, so try again.
+    if (read(write_count - 1, record)) {
+      return true;
+    }
+  }
+}
+
+bool StateChannelReader::readLatest(franka::RobotState* robot_state) {
+  StateLogRecord record;
+  if (!readLatest(&record)) {
+    return false;
+  }
+  fromStateLogRecord(record, robot_state);
+  return true;
+}
+
+bool StateChannelReader::readNext(StateLogRecord* record) noexcept {
+  const uint64_t write_count = header_->write_count.load(std::memory_order_acquire);
+  while (next_index_ < write_count) {
+    if (write_count - next_index_ > header_->capacity) {
+      missed_states_ += write_count - header_->capacity - next_index_;
+      next_index_ = write_count - header_->capacity;
+    }
+    const uint64_t index = next_index_++;
+    if (read(index, record)) {
+      return true;
+    }
+    missed_states_++;
+  }
+  return false;
+}
+
+uint64_t StateChannelReader::missedStates() const noexcept {
+  return missed_states_;
+}
+
+}  // namespace franka_hw
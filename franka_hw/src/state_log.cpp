@@ -0,0 +1,687 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/state_log.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <franka_msgs/Errors.h>
+#include <ros/console.h>
+#include <ros/time.h>
+
+using namespace std::chrono_literals;
+
+namespace franka_hw {
+
+struct StateLogWriter::Segment {
+  std::string path;
+  int file_descriptor{-1};
+  void* data{nullptr};
+  size_t size{0};
+  StateLogSegmentHeader* header{nullptr};
+  StateLogRecord* records{nullptr};
+};
+
+namespace {
+
+#ifdef ENABLE_BASE_ACCELERATION
+constexpr size_t kStateLogErrorCount = 41;
+#else
+constexpr size_t kStateLogErrorCount = 37;
+#endif
+
+// Fields of franka_msgs::Errors in the bit order of errorsToBitmask().
+const std::array<uint8_t franka_msgs::Errors::*, 41> kErrorMessageFields = {{
+    &franka_msgs::Errors::joint_position_limits_violation,
+    &franka_msgs::Errors::cartesian_position_limits_violation,
+    &franka_msgs::Errors::self_collision_avoidance_violation,
+    &franka_msgs::Errors::joint_velocity_violation,
+    &franka_msgs::Errors::cartesian_velocity_violation,
+    &franka_msgs::Errors::force_control_safety_violation,
+    &franka_msgs::Errors::joint_reflex,
+    &franka_msgs::Errors::cartesian_reflex,
+    &franka_msgs::Errors::max_goal_pose_deviation_violation,
+    &franka_msgs::Errors::max_path_pose_deviation_violation,
+    &franka_msgs::Errors::cartesian_velocity_profile_safety_violation,
+    &franka_msgs::Errors::joint_position_motion_generator_start_pose_invalid,
+    &franka_msgs::Errors::joint_motion_generator_position_limits_violation,
+    &franka_msgs::Errors::joint_motion_generator_velocity_limits_violation,
+    &franka_msgs::Errors::joint_motion_generator_velocity_discontinuity,
+    &franka_msgs::Errors::joint_motion_generator_acceleration_discontinuity,
+    &franka_msgs::Errors::cartesian_position_motion_generator_start_pose_invalid,
+    &franka_msgs::Errors::cartesian_motion_generator_elbow_limit_violation,
+    &franka_msgs::Errors::cartesian_motion_generator_velocity_limits_violation,
+    &franka_msgs::Errors::cartesian_motion_generator_velocity_discontinuity,
+    &franka_msgs::Errors::cartesian_motion_generator_acceleration_discontinuity,
+    &franka_msgs::Errors::cartesian_motion_generator_elbow_sign_inconsistent,
+    &franka_msgs::Errors::cartesian_motion_generator_start_elbow_invalid,
+    &franka_msgs::Errors::cartesian_motion_generator_joint_position_limits_violation,
+    &franka_msgs::Errors::cartesian_motion_generator_joint_velocity_limits_violation,
+    &franka_msgs::Errors::cartesian_motion_generator_joint_velocity_discontinuity,
+    &franka_msgs::Errors::cartesian_motion_generator_joint_acceleration_discontinuity,
+    &franka_msgs::Errors::cartesian_position_motion_generator_invalid_frame,
+    &franka_msgs::Errors::force_controller_desired_force_tolerance_violation,
+    &franka_msgs::Errors::controller_torque_discontinuity,
+    &franka_msgs::Errors::start_elbow_sign_inconsistent,
+    &franka_msgs::Errors::communication_constraints_violation,
+    &franka_msgs::Errors::power_limit_violation,
+    &franka_msgs::Errors::joint_p2p_insufficient_torque_for_planning,
+    &franka_msgs::Errors::tau_j_range_violation,
+    &franka_msgs::Errors::instability_detected,
+    &franka_msgs::Errors::joint_move_in_wrong_direction,
+    &franka_msgs::Errors::cartesian_spline_motion_generator_violation,
+    &franka_msgs::Errors::joint_via_motion_generator_planning_joint_limit_violation,
+    &franka_msgs::Errors::base_acceleration_initialization_timeout,
+    &franka_msgs::Errors::base_acceleration_invalid_reading,
+}};
+
+franka_msgs::Errors bitmaskToMessage(uint64_t bitmask) {
+  franka_msgs::Errors message;
+  for (size_t i = 0; i < kErrorMessageFields.size(); i++) {
+    message.*kErrorMessageFields[i] = static_cast<uint8_t>((bitmask >> i) & 1u);
+  }
+  return message;
+}
+
+uint64_t messageToBitmask(const franka_msgs::Errors& message) {
+  uint64_t bitmask = 0;
+  for (size_t i = 0; i < kErrorMessageFields.size(); i++) {
+    if (message.*kErrorMessageFields[i] != 0) {
+      bitmask |= (uint64_t(1) << i);
+    }
+  }
+  return bitmask;
+}
+
+// Calls copy(record_field, message_field) for all array fields of a record and a FrankaState.
+template <typename Record, typename Message, typename Copy>
+void forEachArrayField(Record& record, Message& message, Copy copy) {
+  copy(record.cartesian_collision, message.cartesian_collision);
+  copy(record.cartesian_contact, message.cartesian_contact);
+  copy(record.q, message.q);
+  copy(record.q_d, message.q_d);
+  copy(record.dq, message.dq);
+  copy(record.dq_d, message.dq_d);
+  copy(record.ddq_d, message.ddq_d);
+  copy(record.theta, message.theta);
+  copy(record.dtheta, message.dtheta);
+  copy(record.tau_J, message.tau_J);
+  copy(record.dtau_J, message.dtau_J);
+  copy(record.tau_J_d, message.tau_J_d);
+  copy(record.K_F_ext_hat_K, message.K_F_ext_hat_K);
+  copy(record.elbow, message.elbow);
+  copy(record.elbow_d, message.elbow_d);
+  copy(record.elbow_c, message.elbow_c);
+  copy(record.delbow_c, message.delbow_c);
+  copy(record.ddelbow_c, message.ddelbow_c);
+  copy(record.joint_collision, message.joint_collision);
+  copy(record.joint_contact, message.joint_contact);
+  copy(record.O_F_ext_hat_K, message.O_F_ext_hat_K);
+  copy(record.O_dP_EE_d, message.O_dP_EE_d);
+  copy(record.O_ddP_O, message.O_ddP_O);
+  copy(record.O_dP_EE_c, message.O_dP_EE_c);
+  copy(record.O_ddP_EE_c, message.O_ddP_EE_c);
+  copy(record.tau_ext_hat_filtered, message.tau_ext_hat_filtered);
+  copy(record.F_x_Cee, message.F_x_Cee);
+  copy(record.I_ee, message.I_ee);
+  copy(record.F_x_Cload, message.F_x_Cload);
+  copy(record.I_load, message.I_load);
+  copy(record.F_x_Ctotal, message.F_x_Ctotal);
+  copy(record.I_total, message.I_total);
+  copy(record.O_T_EE, message.O_T_EE);
+  copy(record.O_T_EE_d, message.O_T_EE_d);
+  copy(record.O_T_EE_c, message.O_T_EE_c);
+  copy(record.F_T_EE, message.F_T_EE);
+  copy(record.F_T_NE, message.F_T_NE);
+  copy(record.NE_T_EE, message.NE_T_EE);
+  copy(record.EE_T_K, message.EE_T_K);
+}
+
+std::string systemError(const std::string& message, const std::string& path) {
+  return message + " " + path + ": " + std::strerror(errno);
+}
+
+std::string segmentPath(const StateLogWriter::Config& config, uint64_t index) {
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), "_%06lu.bin", static_cast<unsigned long>(index));
+  return config.directory + "/" + config.prefix + suffix;
+}
+
+// Continues after the highest segment index in the directory, so restarts keep earlier logs.
+uint64_t nextSegmentIndex(const StateLogWriter::Config& config) {
+  uint64_t next_index = 0;
+  DIR* dir = opendir(config.directory.c_str());
+  if (dir == nullptr) {
+    return next_index;
+  }
+  const std::string prefix = config.prefix + "_";
+  while (dirent* entry = readdir(dir)) {
+    const std::string name(entry->d_name);
+    unsigned long index;
+    char end;
+    if (name.compare(0, prefix.size(), prefix) == 0 &&
+        std::sscanf(name.c_str() + prefix.size(), "%lu.bi%c", &index, &end) == 2 && end == 'n') {
+      next_index = std::max<uint64_t>(next_index, index + 1);
+    }
+  }
+  closedir(dir);
+  return next_index;
+}
+
+template <typename T>
+StateLogColumn column(const char* name, size_t offset) {
+  return StateLogColumn{name, offset, std::tuple_size<T>::value};
+}
+
+}  // anonymous namespace
+
+#define FRANKA_HW_STATE_LOG_COLUMN(field) \
+  column<decltype(StateLogRecord::field)>(#field, offsetof(StateLogRecord, field))
+
+const std::vector<StateLogColumn>& stateLogColumns() {
+  static const std::vector<StateLogColumn> kColumns = {
+      StateLogColumn{"time", offsetof(StateLogRecord, time), 1},
+      StateLogColumn{"control_command_success_rate",
+                     offsetof(StateLogRecord, control_command_success_rate), 1},
+      FRANKA_HW_STATE_LOG_COLUMN(O_T_EE),
+      FRANKA_HW_STATE_LOG_COLUMN(O_T_EE_d),
+      FRANKA_HW_STATE_LOG_COLUMN(F_T_EE),
+      FRANKA_HW_STATE_LOG_COLUMN(F_T_NE),
+      FRANKA_HW_STATE_LOG_COLUMN(NE_T_EE),
+      FRANKA_HW_STATE_LOG_COLUMN(EE_T_K),
+      StateLogColumn{"m_ee", offsetof(StateLogRecord, m_ee), 1},
+      FRANKA_HW_STATE_LOG_COLUMN(I_ee),
+      FRANKA_HW_STATE_LOG_COLUMN(F_x_Cee),
+      StateLogColumn{"m_load", offsetof(StateLogRecord, m_load), 1},
+      FRANKA_HW_STATE_LOG_COLUMN(I_load),
+      FRANKA_HW_STATE_LOG_COLUMN(F_x_Cload),
+      StateLogColumn{"m_total", offsetof(StateLogRecord, m_total), 1},
+      FRANKA_HW_STATE_LOG_COLUMN(I_total),
+      FRANKA_HW_STATE_LOG_COLUMN(F_x_Ctotal),
+      FRANKA_HW_STATE_LOG_COLUMN(elbow),
+      FRANKA_HW_STATE_LOG_COLUMN(elbow_d),
+      FRANKA_HW_STATE_LOG_COLUMN(elbow_c),
+      FRANKA_HW_STATE_LOG_COLUMN(delbow_c),
+      FRANKA_HW_STATE_LOG_COLUMN(ddelbow_c),
+      FRANKA_HW_STATE_LOG_COLUMN(tau_J),
+      FRANKA_HW_STATE_LOG_COLUMN(tau_J_d),
+      FRANKA_HW_STATE_LOG_COLUMN(dtau_J),
+      FRANKA_HW_STATE_LOG_COLUMN(q),
+      FRANKA_HW_STATE_LOG_COLUMN(q_d),
+      FRANKA_HW_STATE_LOG_COLUMN(dq),
+      FRANKA_HW_STATE_LOG_COLUMN(dq_d),
+      FRANKA_HW_STATE_LOG_COLUMN(ddq_d),
+      FRANKA_HW_STATE_LOG_COLUMN(joint_contact),
+      FRANKA_HW_STATE_LOG_COLUMN(cartesian_contact),
+      FRANKA_HW_STATE_LOG_COLUMN(joint_collision),
+      FRANKA_HW_STATE_LOG_COLUMN(cartesian_collision),
+      FRANKA_HW_STATE_LOG_COLUMN(tau_ext_hat_filtered),
+      FRANKA_HW_STATE_LOG_COLUMN(O_F_ext_hat_K),
+      FRANKA_HW_STATE_LOG_COLUMN(K_F_ext_hat_K),
+      FRANKA_HW_STATE_LOG_COLUMN(O_dP_EE_d),
+      FRANKA_HW_STATE_LOG_COLUMN(O_ddP_O),
+      FRANKA_HW_STATE_LOG_COLUMN(O_T_EE_c),
+      FRANKA_HW_STATE_LOG_COLUMN(O_dP_EE_c),
+      FRANKA_HW_STATE_LOG_COLUMN(O_ddP_EE_c),
+      FRANKA_HW_STATE_LOG_COLUMN(theta),
+      FRANKA_HW_STATE_LOG_COLUMN(dtheta),
+      FRANKA_HW_STATE_LOG_COLUMN(tau_J_command),
+      FRANKA_HW_STATE_LOG_COLUMN(q_command),
+      FRANKA_HW_STATE_LOG_COLUMN(dq_command),
+      FRANKA_HW_STATE_LOG_COLUMN(O_T_EE_command),
+      FRANKA_HW_STATE_LOG_COLUMN(elbow_pose_command),
+      FRANKA_HW_STATE_LOG_COLUMN(O_dP_EE_command),
+      FRANKA_HW_STATE_LOG_COLUMN(elbow_velocity_command),
+  };
+  return kColumns;
+}
+
+#undef FRANKA_HW_STATE_LOG_COLUMN
+
+uint64_t errorsToBitmask(const franka::Errors& errors) noexcept {
+  const std::array<bool, 41> flags{{
+    errors.joint_position_limits_violation,
+    errors.cartesian_position_limits_violation,
+    errors.self_collision_avoidance_violation,
+    errors.joint_velocity_violation,
+    errors.cartesian_velocity_violation,
+    errors.force_control_safety_violation,
+    errors.joint_reflex,
+    errors.cartesian_reflex,
+    errors.max_goal_pose_deviation_violation,
+    errors.max_path_pose_deviation_violation,
+    errors.cartesian_velocity_profile_safety_violation,
+    errors.joint_position_motion_generator_start_pose_invalid,
+    errors.joint_motion_generator_position_limits_violation,
+    errors.joint_motion_generator_velocity_limits_violation,
+    errors.joint_motion_generator_velocity_discontinuity,
+    errors.joint_motion_generator_acceleration_discontinuity,
+    errors.cartesian_position_motion_generator_start_pose_invalid,
+    errors.cartesian_motion_generator_elbow_limit_violation,
+    errors.cartesian_motion_generator_velocity_limits_violation,
+    errors.cartesian_motion_generator_velocity_discontinuity,
+    errors.cartesian_motion_generator_acceleration_discontinuity,
+    errors.cartesian_motion_generator_elbow_sign_inconsistent,
+    errors.cartesian_motion_generator_start_elbow_invalid,
+    errors.cartesian_motion_generator_joint_position_limits_violation,
+    errors.cartesian_motion_generator_joint_velocity_limits_violation,
+    errors.cartesian_motion_generator_joint_velocity_discontinuity,
+    errors.cartesian_motion_generator_joint_acceleration_discontinuity,
+    errors.cartesian_position_motion_generator_invalid_frame,
+    errors.force_controller_desired_force_tolerance_violation,
+    errors.controller_torque_discontinuity,
+    errors.start_elbow_sign_inconsistent,
+    errors.communication_constraints_violation,
+    errors.power_limit_violation,
+    errors.joint_p2p_insufficient_torque_for_planning,
+    errors.tau_j_range_violation,
+    errors.instability_detected,
+    errors.joint_move_in_wrong_direction,
+#ifdef ENABLE_BASE_ACCELERATION
+    errors.cartesian_spline_motion_generator_violation,
+    errors.joint_via_motion_generator_planning_joint_limit_violation,
+    errors.base_acceleration_initialization_timeout,
+    errors.base_acceleration_invalid_reading,
+#endif
+  }};
+  uint64_t bitmask = 0;
+  for (size_t i = 0; i < flags.size(); i++) {
+    if (flags[i]) {
+      bitmask |= (uint64_t(1) << i);
+    }
+  }
+  return bitmask;
+}
+
+void toStateLogRecord(const franka::RobotState& robot_state, StateLogRecord* record) noexcept {
+  record->time = robot_state.time.toSec();
+  record->control_command_success_rate = robot_state.control_command_success_rate;
+  record->current_errors = errorsToBitmask(robot_state.current_errors);
+  record->last_motion_errors = errorsToBitmask(robot_state.last_motion_errors);
+  record->robot_mode = static_cast<uint32_t>(robot_state.robot_mode);
+  record->O_T_EE = robot_state.O_T_EE;
+  record->O_T_EE_d = robot_state.O_T_EE_d;
+  record->F_T_EE = robot_state.F_T_EE;
+  record->F_T_NE = robot_state.F_T_NE;
+  record->NE_T_EE = robot_state.NE_T_EE;
+  record->EE_T_K = robot_state.EE_T_K;
+  record->m_ee = robot_state.m_ee;
+  record->I_ee = robot_state.I_ee;
+  record->F_x_Cee = robot_state.F_x_Cee;
+  record->m_load = robot_state.m_load;
+  record->I_load = robot_state.I_load;
+  record->F_x_Cload = robot_state.F_x_Cload;
+  record->m_total = robot_state.m_total;
+  record->I_total = robot_state.I_total;
+  record->F_x_Ctotal = robot_state.F_x_Ctotal;
+  record->elbow = robot_state.elbow;
+  record->elbow_d = robot_state.elbow_d;
+  record->elbow_c = robot_state.elbow_c;
+  record->delbow_c = robot_state.delbow_c;
+  record->ddelbow_c = robot_state.ddelbow_c;
+  record->tau_J = robot_state.tau_J;
+  record->tau_J_d = robot_state.tau_J_d;
+  record->dtau_J = robot_state.dtau_J;
+  record->q = robot_state.q;
+  record->q_d = robot_state.q_d;
+  record->dq = robot_state.dq;
+  record->dq_d = robot_state.dq_d;
+  record->ddq_d = robot_state.ddq_d;
+  record->joint_contact = robot_state.joint_contact;
+  record->cartesian_contact = robot_state.cartesian_contact;
+  record->joint_collision = robot_state.joint_collision;
+  record->cartesian_collision = robot_state.cartesian_collision;
+  record->tau_ext_hat_filtered = robot_state.tau_ext_hat_filtered;
+  record->O_F_ext_hat_K = robot_state.O_F_ext_hat_K;
+  record->K_F_ext_hat_K = robot_state.K_F_ext_hat_K;
+  record->O_dP_EE_d = robot_state.O_dP_EE_d;
+#ifdef ENABLE_BASE_ACCELERATION
+  record->O_ddP_O = robot_state.O_ddP_O;
+#else
+  record->O_ddP_O = {0.0, 0.0, -9.81};
+#endif
+  record->O_T_EE_c = robot_state.O_T_EE_c;
+  record->O_dP_EE_c = robot_state.O_dP_EE_c;
+  record->O_ddP_EE_c = robot_state.O_ddP_EE_c;
+  record->theta = robot_state.theta;
+  record->dtheta = robot_state.dtheta;
+}
+
+franka::Errors bitmaskToErrors(uint64_t bitmask) {
+  std::array<bool, kStateLogErrorCount> flags{};
+  for (size_t i = 0; i < flags.size(); i++) {
+    flags[i] = ((bitmask >> i) & 1u) != 0;
+  }
+  return franka::Errors(flags);
+}
+
+void fromStateLogRecord(const StateLogRecord& record, franka::RobotState* robot_state) {
+  robot_state->time = franka::Duration(static_cast<uint64_t>(std::llround(record.time * 1000.0)));
+  robot_state->control_command_success_rate = record.control_command_success_rate;
+  robot_state->current_errors = bitmaskToErrors(record.current_errors);
+  robot_state->last_motion_errors = bitmaskToErrors(record.last_motion_errors);
+  robot_state->robot_mode = static_cast<franka::RobotMode>(record.robot_mode);
+  robot_state->O_T_EE = record.O_T_EE;
+  robot_state->O_T_EE_d = record.O_T_EE_d;
+  robot_state->F_T_EE = record.F_T_EE;
+  robot_state->F_T_NE = record.F_T_NE;
+  robot_state->NE_T_EE = record.NE_T_EE;
+  robot_state->EE_T_K = record.EE_T_K;
+  robot_state->m_ee = record.m_ee;
+  robot_state->I_ee = record.I_ee;
+  robot_state->F_x_Cee = record.F_x_Cee;
+  robot_state->m_load = record.m_load;
+  robot_state->I_load = record.I_load;
+  robot_state->F_x_Cload = record.F_x_Cload;
+  robot_state->m_total = record.m_total;
+  robot_state->I_total = record.I_total;
+  robot_state->F_x_Ctotal = record.F_x_Ctotal;
+  robot_state->elbow = record.elbow;
+  robot_state->elbow_d = record.elbow_d;
+  robot_state->elbow_c = record.elbow_c;
+  robot_state->delbow_c = record.delbow_c;
+  robot_state->ddelbow_c = record.ddelbow_c;
+  robot_state->tau_J = record.tau_J;
+  robot_state->tau_J_d = record.tau_J_d;
+  robot_state->dtau_J = record.dtau_J;
+  robot_state->q = record.q;
+  robot_state->q_d = record.q_d;
+  robot_state->dq = record.dq;
+  robot_state->dq_d = record.dq_d;
+  robot_state->ddq_d = record.ddq_d;
+  robot_state->joint_contact = record.joint_contact;
+  robot_state->cartesian_contact = record.cartesian_contact;
+  robot_state->joint_collision = record.joint_collision;
+  robot_state->cartesian_collision = record.cartesian_collision;
+  robot_state->tau_ext_hat_filtered = record.tau_ext_hat_filtered;
+  robot_state->O_F_ext_hat_K = record.O_F_ext_hat_K;
+  robot_state->K_F_ext_hat_K = record.K_F_ext_hat_K;
+  robot_state->O_dP_EE_d = record.O_dP_EE_d;
+#ifdef ENABLE_BASE_ACCELERATION
+  robot_state->O_ddP_O = record.O_ddP_O;
+#endif
+  robot_state->O_T_EE_c = record.O_T_EE_c;
+  robot_state->O_dP_EE_c = record.O_dP_EE_c;
+  robot_state->O_ddP_EE_c = record.O_ddP_EE_c;
+  robot_state->theta = record.theta;
+  robot_state->dtheta = record.dtheta;
+}
+
+void toFrankaStateMessage(const StateLogRecord& record, franka_msgs::FrankaState* message) {
+  message->header.seq = record.sequence;
+  message->header.stamp = ros::TIME_MIN + ros::Duration(record.time);
+  forEachArrayField(record, *message, [](const auto& source, auto& destination) {
+    std::copy(source.cbegin(), source.cend(), destination.begin());
+  });
+  message->m_ee = record.m_ee;
+  message->m_load = record.m_load;
+  message->m_total = record.m_total;
+  message->time = record.time;
+  message->control_command_success_rate = record.control_command_success_rate;
+  // franka::RobotMode has the same values as the ROBOT_MODE_* constants.
+  message->robot_mode = static_cast<uint8_t>(record.robot_mode);
+  message->current_errors = bitmaskToMessage(record.current_errors);
+  message->last_motion_errors = bitmaskToMessage(record.last_motion_errors);
+}
+
+void fromFrankaStateMessage(const franka_msgs::FrankaState& message, StateLogRecord* record) {
+  *record = StateLogRecord{};
+  record->sequence = message.header.seq;
+  forEachArrayField(*record, message, [](auto& destination, const auto& source) {
+    std::copy(source.cbegin(), source.cend(), destination.begin());
+  });
+  record->m_ee = message.m_ee;
+  record->m_load = message.m_load;
+  record->m_total = message.m_total;
+  record->time = message.time;
+  record->control_command_success_rate = message.control_command_success_rate;
+  record->robot_mode = message.robot_mode;
+  record->current_errors = messageToBitmask(message.current_errors);
+  record->last_motion_errors = messageToBitmask(message.last_motion_errors);
+}
+
+StateLogWriter::StateLogWriter(const Config& config) : config_(config) {
+  if (config_.segment_size == 0) {
+    throw std::runtime_error("StateLogWriter: segment_size must be greater than zero");
+  }
+  if (mkdir(config_.directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    throw std::runtime_error(
+        systemError("StateLogWriter: Could not create directory", config_.directory));
+  }
+  next_segment_index_ = nextSegmentIndex(config_);
+  active_ = createSegment();
+  maintenance_thread_ = std::thread(&StateLogWriter::maintenanceLoop, this);
+}
+
+StateLogWriter::~StateLogWriter() {
+  running_ = false;
+  if (maintenance_thread_.joinable()) {
+    maintenance_thread_.join();
+  }
+  std::unique_ptr<Segment> retired(retired_.exchange(nullptr));
+  if (retired) {
+    retireSegment(std::move(retired));
+  }
+  if (active_) {
+    retireSegment(std::move(active_));
+  }
+  std::unique_ptr<Segment> spare(spare_.exchange(nullptr));
+  if (spare) {
+    retireSegment(std::move(spare));
+  }
+}
+
+bool StateLogWriter::log(const franka::RobotState& robot_state,
+                         ControlMode control_mode,
+                         const franka::Torques& torques,
+                         const franka::JointPositions& joint_positions,
+                         const franka::JointVelocities& joint_velocities,
+                         const franka::CartesianPose& cartesian_pose,
+                         const franka::CartesianVelocities& cartesian_velocities) noexcept {
+  if (active_->header->record_count >= active_->header->capacity && !rotate()) {
+    dropped_records_++;
+    return false;
+  }
+  StateLogRecord& record = active_->records[active_->header->record_count];
+  toStateLogRecord(robot_state, &record);
+  record.sequence = sequence_number_++;
+  record.control_mode = static_cast<uint32_t>(control_mode);
+  record.tau_J_command = torques.tau_J;
+  record.q_command = joint_positions.q;
+  record.dq_command = joint_velocities.dq;
+  record.O_T_EE_command = cartesian_pose.O_T_EE;
+  record.elbow_pose_command = cartesian_pose.elbow;
+  record.O_dP_EE_command = cartesian_velocities.O_dP_EE;
+  record.elbow_velocity_command = cartesian_velocities.elbow;
+
+  // Make the record visible before it is accounted for in the segment header.
+  std::atomic_thread_fence(std::memory_order_release);
+  active_->header->record_count++;
+  written_records_++;
+  return true;
+}
+
+uint64_t StateLogWriter::writtenRecords() const noexcept {
+  return written_records_;
+}
+
+uint64_t StateLogWriter::droppedRecords() const noexcept {
+  return dropped_records_;
+}
+
+bool StateLogWriter::spareSegmentReady() const noexcept {
+  return retired_.load() == nullptr && spare_.load() != nullptr;
+}
+
+bool StateLogWriter::rotate() noexcept {
+  if (retired_.load() != nullptr) {
+    return false;
+  }
+  Segment* spare = spare_.exchange(nullptr);
+  if (spare == nullptr) {
+    return false;
+  }
+  retired_.store(active_.release());
+  active_.reset(spare);
+  return true;
+}
+
+void StateLogWriter::maintenanceLoop() {
+  while (running_) {
+    std::unique_ptr<Segment> retired(retired_.exchange(nullptr));
+    if (retired) {
+      finished_segments_.push_back(retired->path);
+      retireSegment(std::move(retired));
+      while (config_.max_segments > 0 && finished_segments_.size() > config_.max_segments) {
+        if (unlink(finished_segments_.front().c_str()) != 0) {
+          ROS_WARN_STREAM(
+              systemError("StateLogWriter: Could not delete", finished_segments_.front()));
+        }
+        finished_segments_.pop_front();
+      }
+    }
+    if (spare_.load() == nullptr) {
+      try {
+        spare_.store(createSegment().release());
+      } catch (const std::runtime_error& error) {
+        ROS_ERROR_THROTTLE(1, "%s", error.what());
+      }
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+}
+
+std::unique_ptr<StateLogWriter::Segment> StateLogWriter::createSegment() {
+  auto segment = std::make_unique<Segment>();
+  segment->size = kStateLogHeaderSize + config_.segment_size * sizeof(StateLogRecord);
+
+  // Never overwrites a segment, e.g. of another writer with the same prefix.
+  while (true) {
+    segment->path = segmentPath(config_, next_segment_index_);
+    segment->file_descriptor = open(segment->path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (segment->file_descriptor >= 0 || errno != EEXIST) {
+      break;
+    }
+    next_segment_index_++;
+  }
+  if (segment->file_descriptor < 0) {
+    throw std::runtime_error(systemError("StateLogWriter: Could not open", segment->path));
+  }
+  if (ftruncate(segment->file_descriptor, segment->size) != 0) {
+    std::string message = systemError("StateLogWriter: Could not allocate", segment->path);
+    close(segment->file_descriptor);
+    throw std::runtime_error(message);
+  }
+  segment->data = mmap(nullptr, segment->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       segment->file_descriptor, 0);
+  if (segment->data == MAP_FAILED) {
+    std::string message = systemError("StateLogWriter: Could not map", segment->path);
+    close(segment->file_descriptor);
+    throw std::runtime_error(message);
+  }
+
+  segment->header = static_cast<StateLogSegmentHeader*>(segment->data);
+  segment->records = reinterpret_cast<StateLogRecord*>(  // NOLINT
+      static_cast<char*>(segment->data) + kStateLogHeaderSize);
+  segment->header->magic = kStateLogMagic;
+  segment->header->version = kStateLogVersion;
+  segment->header->header_size = kStateLogHeaderSize;
+  segment->header->record_size = sizeof(StateLogRecord);
+  segment->header->capacity = config_.segment_size;
+  segment->header->segment_index = next_segment_index_;
+  segment->header->record_count = 0;
+
+  next_segment_index_++;
+  return segment;
+}
+
+void StateLogWriter::retireSegment(std::unique_ptr<Segment> segment) {
+  uint64_t record_count = segment->header->record_count;
+  munmap(segment->data, segment->size);
+  if (record_count == 0) {
+    close(segment->file_descriptor);
+    unlink(segment->path.c_str());
+    return;
+  }
+  // Release the unused, preallocated part of the segment.
+  if (ftruncate(segment->file_descriptor,
+                kStateLogHeaderSize + record_count * sizeof(StateLogRecord)) != 0) {
+    ROS_WARN_STREAM(systemError("StateLogWriter: Could not truncate", segment->path));
+  }
+  close(segment->file_descriptor);
+}
+
+StateLogReader::StateLogReader(const std::string& directory, const std::string& prefix) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) {
+    throw std::runtime_error(systemError("StateLogReader: Could not open directory", directory));
+  }
+  const std::string suffix = ".bin";
+  while (dirent* entry = readdir(dir)) {
+    std::string name(entry->d_name);
+    if (name.size() > prefix.size() + suffix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+      segments_.push_back(directory + "/" + name);
+    }
+  }
+  closedir(dir);
+  if (segments_.empty()) {
+    throw std::runtime_error("StateLogReader: No segments with prefix " + prefix + " found in " +
+                             directory);
+  }
+  // Segment file names contain the zero-padded segment index.
+  std::sort(segments_.begin(), segments_.end());
+}
+
+bool StateLogReader::next(StateLogRecord* record) {
+  while (remaining_records_ == 0) {
+    if (!openNextSegment()) {
+      return false;
+    }
+  }
+  if (!stream_.read(reinterpret_cast<char*>(record),  // NOLINT
+                    sizeof(StateLogRecord))) {
+    throw std::runtime_error("StateLogReader: Unexpected end of segment " +
+                             segments_[current_segment_ - 1]);
+  }
+  remaining_records_--;
+  return true;
+}
+
+const std::vector<std::string>& StateLogReader::segments() const noexcept {
+  return segments_;
+}
+
+bool StateLogReader::openNextSegment() {
+  if (current_segment_ >= segments_.size()) {
+    return false;
+  }
+  const std::string& path = segments_[current_segment_++];
+  stream_.close();
+  stream_.clear();
+  stream_.open(path, std::ios::binary);
+
+  StateLogSegmentHeader header{};
+  if (!stream_.read(reinterpret_cast<char*>(&header), sizeof(header))) {  // NOLINT
+    throw std::runtime_error("StateLogReader: Could not read header of " + path);
+  }
+  if (header.magic != kStateLogMagic || header.version != kStateLogVersion ||
+      header.record_size != sizeof(StateLogRecord)) {
+    throw std::runtime_error("StateLogReader: Incompatible segment " + path);
+  }
+  stream_.seekg(header.header_size);
+  remaining_records_ = header.record_count;
+  return true;
+}
+
+}  // namespace franka_hw
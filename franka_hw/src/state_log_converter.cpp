@@ -0,0 +1,178 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <sys/stat.h>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <franka_msgs/FrankaState.h>
+#include <ros/time.h>
+#include <rosbag/bag.h>
+
+#include <franka_hw/state_log.h>
+
+using franka_hw::StateLogColumn;
+using franka_hw::StateLogReader;
+using franka_hw::StateLogRecord;
+
+namespace {
+
+const double* columnData(const StateLogRecord& record, const StateLogColumn& column) {
+  return reinterpret_cast<const double*>(  // NOLINT
+      reinterpret_cast<const char*>(&record) + column.offset);
+}
+
+size_t convertToCsv(StateLogReader* reader, const std::string& output) {
+  std::ofstream file(output);
+  if (!file) {
+    throw std::runtime_error("Could not open " + output);
+  }
+  file << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+  file << "sequence,current_errors,last_motion_errors,robot_mode,control_mode";
+  for (const StateLogColumn& column : franka_hw::stateLogColumns()) {
+    if (column.size == 1) {
+      file << ',' << column.name;
+      continue;
+    }
+    for (size_t i = 0; i < column.size; i++) {
+      file << ',' << column.name << '_' << i;
+    }
+  }
+  file << '\n';
+
+  size_t count = 0;
+  StateLogRecord record{};
+  while (reader->next(&record)) {
+    file << record.sequence << ',' << record.current_errors << ',' << record.last_motion_errors
+         << ',' << record.robot_mode << ',' << record.control_mode;
+    for (const StateLogColumn& column : franka_hw::stateLogColumns()) {
+      const double* data = columnData(record, column);
+      for (size_t i = 0; i < column.size; i++) {
+        file << ',' << data[i];  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      }
+    }
+    file << '\n';
+    count++;
+  }
+  return count;
+}
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value) {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));  // NOLINT
+}
+
+size_t convertToColumns(StateLogReader* reader, const std::string& output) {
+  if (mkdir(output.c_str(), 0755) != 0 && errno != EEXIST) {
+    throw std::runtime_error("Could not create directory " + output + ": " + std::strerror(errno));
+  }
+
+  std::ofstream index(output + "/columns.txt");
+  std::ofstream sequence(output + "/sequence.bin", std::ios::binary);
+  std::ofstream current_errors(output + "/current_errors.bin", std::ios::binary);
+  std::ofstream last_motion_errors(output + "/last_motion_errors.bin", std::ios::binary);
+  std::ofstream robot_mode(output + "/robot_mode.bin", std::ios::binary);
+  std::ofstream control_mode(output + "/control_mode.bin", std::ios::binary);
+  index << "sequence uint64 1\n"
+        << "current_errors uint64 1\n"
+        << "last_motion_errors uint64 1\n"
+        << "robot_mode uint32 1\n"
+        << "control_mode uint32 1\n";
+
+  const std::vector<StateLogColumn>& columns = franka_hw::stateLogColumns();
+  std::vector<std::unique_ptr<std::ofstream>> files;
+  files.reserve(columns.size());
+  for (const StateLogColumn& column : columns) {
+    files.push_back(std::make_unique<std::ofstream>(output + "/" + column.name + ".bin",
+                                                    std::ios::binary));
+    index << column.name << " float64 " << column.size << '\n';
+  }
+  if (!index || !sequence || !control_mode) {
+    throw std::runtime_error("Could not create column files in " + output);
+  }
+
+  size_t count = 0;
+  StateLogRecord record{};
+  while (reader->next(&record)) {
+    writeValue(sequence, record.sequence);
+    writeValue(current_errors, record.current_errors);
+    writeValue(last_motion_errors, record.last_motion_errors);
+    writeValue(robot_mode, record.robot_mode);
+    writeValue(control_mode, record.control_mode);
+    for (size_t i = 0; i < columns.size(); i++) {
+      files[i]->write(reinterpret_cast<const char*>(columnData(record, columns[i])),  // NOLINT
+                      columns[i].size * sizeof(double));
+    }
+    count++;
+  }
+  return count;
+}
+
+size_t convertToBag(StateLogReader* reader, const std::string& output, const std::string& topic) {
+  rosbag::Bag bag(output, rosbag::bagmode::Write);
+  size_t count = 0;
+  StateLogRecord record{};
+  franka_msgs::FrankaState message;
+  while (reader->next(&record)) {
+    franka_hw::toFrankaStateMessage(record, &message);
+    bag.write(topic, message.header.stamp, message);
+    count++;
+  }
+  bag.close();
+  return count;
+}
+
+void printUsage(const char* name) {
+  std::cerr << "Usage: " << name << " <directory> <prefix> <csv|columns|bag> <output>" << std::endl
+            << std::endl
+            << "Converts the binary state log segments <directory>/<prefix>_*.bin written by"
+            << std::endl
+            << "franka_hw into a CSV file, a directory with one binary file per column, or a"
+            << std::endl
+            << "rosbag with franka_msgs/FrankaState messages on the topic franka_states." << std::endl;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  if (argc != 5) {
+    printUsage(argv[0]);  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    return 1;
+  }
+  const std::vector<std::string> arguments(argv + 1, argv + argc);  // NOLINT
+  const std::string& directory = arguments[0];
+  const std::string& prefix = arguments[1];
+  const std::string& format = arguments[2];
+  const std::string& output = arguments[3];
+
+  try {
+    ros::Time::init();
+    StateLogReader reader(directory, prefix);
+    size_t count = 0;
+    if (format == "csv") {
+      count = convertToCsv(&reader, output);
+    } else if (format == "columns") {
+      count = convertToColumns(&reader, output);
+    } else if (format == "bag") {
+      count = convertToBag(&reader, output, "franka_states");
+    } else {
+      printUsage(argv[0]);  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      return 1;
+    }
+    std::cout << "Converted " << count << " records from " << reader.segments().size()
+              << " segments to " << output << std::endl;
+  } catch (const std::exception& ex) {
+    std::cerr << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
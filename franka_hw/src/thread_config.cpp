@@ -0,0 +1,220 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <franka_hw/thread_config.h>
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <ros/console.h>
+
+namespace franka_hw {
+
+namespace {
+
+int toSchedPolicy(ThreadConfig::Policy policy) {
+  switch (policy) {
+    case ThreadConfig::Policy::kFifo:
+      return SCHED_FIFO;
+    case ThreadConfig::Policy::kRoundRobin:
+      return SCHED_RR;
+    default:
+      return SCHED_OTHER;
+  }
+}
+
+const char* policyName(ThreadConfig::Policy policy) {
+  switch (policy) {
+    case ThreadConfig::Policy::kInherit:
+      return "inherit";
+    case ThreadConfig::Policy::kOther:
+      return "other";
+    case ThreadConfig::Policy::kFifo:
+      return "fifo";
+    case ThreadConfig::Policy::kRoundRobin:
+      return "rr";
+  }
+  return "unknown";
+}
+
+bool parsePolicy(const std::string& name, ThreadConfig::Policy* policy) {
+  for (ThreadConfig::Policy candidate :
+       {ThreadConfig::Policy::kInherit, ThreadConfig::Policy::kOther, ThreadConfig::Policy::kFifo,
+        ThreadConfig::Policy::kRoundRobin}) {
+    if (name == policyName(candidate)) {
+      *policy = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string describe(const ThreadConfig& config) {
+  std::ostringstream description;
+  description << "CPUs ";
+  for (size_t i = 0; i < config.cpus.size(); i++) {
+    description << (i == 0 ? "" : ",") << config.cpus[i];
+  }
+  description << ", policy " << policyName(config.policy);
+  if (config.policy == ThreadConfig::Policy::kFifo ||
+      config.policy == ThreadConfig::Policy::kRoundRobin) {
+    description << ", priority " << config.priority;
+  }
+  return description.str();
+}
+
+// Not inlined, so the prefaulted stack is released again when returning.
+__attribute__((noinline)) void prefaultStack(size_t size) {
+  const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  volatile char* stack = static_cast<volatile char*>(alloca(size));
+  for (size_t i = 0; i < size; i += page_size) {
+    stack[i] = 0;
+  }
+}
+
+}  // anonymous namespace
+
+bool readThreadConfig(const ros::NodeHandle& node_handle,
+                      const std::string& name,
+                      ThreadConfig* config) {
+  const std::string prefix = "threads/" + name + "/";
+  const int cpu_count = static_cast<int>(sysconf(_SC_NPROCESSORS_CONF));
+
+  std::vector<int> cpus;
+  if (node_handle.getParam(prefix + "cpus", cpus)) {
+    for (int cpu : cpus) {
+      if (cpu < 0 || cpu >= cpu_count || cpu >= CPU_SETSIZE) {
+        ROS_ERROR("Invalid %scpus parameter provided. CPU %d does not exist.", prefix.c_str(), cpu);
+        return false;
+      }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    config->cpus = cpus;
+  }
+
+  std::string policy;
+  if (node_handle.getParam(prefix + "policy", policy) && !parsePolicy(policy, &config->policy)) {
+    ROS_ERROR("Invalid %spolicy parameter provided. Valid values are inherit, other, fifo, rr.",
+              prefix.c_str());
+    return false;
+  }
+
+  node_handle.getParam(prefix + "priority", config->priority);
+  if (config->policy == ThreadConfig::Policy::kFifo ||
+      config->policy == ThreadConfig::Policy::kRoundRobin) {
+    const int sched_policy = toSchedPolicy(config->policy);
+    if (config->priority < sched_get_priority_min(sched_policy) ||
+        config->priority > sched_get_priority_max(sched_policy)) {
+      ROS_ERROR("Invalid %spriority parameter provided. Must be in [%d, %d] for policy %s.",
+                prefix.c_str(), sched_get_priority_min(sched_policy),
+                sched_get_priority_max(sched_policy), policyName(config->policy));
+      return false;
+    }
+  }
+
+  int stack_prefault = static_cast<int>(config->stack_prefault);
+  node_handle.getParam(prefix + "stack_prefault", stack_prefault);
+  if (stack_prefault < 0) {
+    ROS_ERROR("Invalid %sstack_prefault parameter provided. Must not be negative.",
+              prefix.c_str());
+    return false;
+  }
+  config->stack_prefault = static_cast<size_t>(stack_prefault);
+  return true;
+}
+
+ThreadConfig currentThreadConfig() {
+  ThreadConfig config;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &cpu_set)) {
+        config.cpus.push_back(cpu);
+      }
+    }
+  }
+  int sched_policy = SCHED_OTHER;
+  sched_param parameters{};
+  if (pthread_getschedparam(pthread_self(), &sched_policy, &parameters) == 0) {
+    config.priority = parameters.sched_priority;
+  }
+  switch (sched_policy) {
+    case SCHED_FIFO:
+      config.policy = ThreadConfig::Policy::kFifo;
+      break;
+    case SCHED_RR:
+      config.policy = ThreadConfig::Policy::kRoundRobin;
+      break;
+    default:
+      config.policy = ThreadConfig::Policy::kOther;
+      config.priority = 0;
+  }
+  return config;
+}
+
+bool configureCurrentThread(const std::string& name, const ThreadConfig& config) {
+  if (!config.cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : config.cpus) {
+      CPU_SET(cpu, &cpu_set);
+    }
+    const int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (error != 0) {
+      ROS_ERROR("%s thread: Failed to set CPUs: %s", name.c_str(), std::strerror(error));
+      return false;
+    }
+  }
+  if (config.policy != ThreadConfig::Policy::kInherit) {
+    sched_param parameters{};
+    parameters.sched_priority =
+        config.policy == ThreadConfig::Policy::kOther ? 0 : config.priority;
+    const int error =
+        pthread_setschedparam(pthread_self(), toSchedPolicy(config.policy), &parameters);
+    if (error != 0) {
+      ROS_ERROR("%s thread: Failed to set policy %s with priority %d: %s", name.c_str(),
+                policyName(config.policy), parameters.sched_priority, std::strerror(error));
+      return false;
+    }
+  }
+  if (config.stack_prefault > 0) {
+    prefaultStack(config.stack_prefault);
+  }
+
+  // Read the scheduling back, the kernel may restrict the CPUs further, e.g. through cpusets.
+  const ThreadConfig current = currentThreadConfig();
+  std::vector<int> requested_cpus = config.cpus;
+  std::sort(requested_cpus.begin(), requested_cpus.end());
+  requested_cpus.erase(std::unique(requested_cpus.begin(), requested_cpus.end()),
+                       requested_cpus.end());
+  const bool realtime = config.policy == ThreadConfig::Policy::kFifo ||
+                        config.policy == ThreadConfig::Policy::kRoundRobin;
+  if ((!requested_cpus.empty() && current.cpus != requested_cpus) ||
+      (config.policy != ThreadConfig::Policy::kInherit &&
+       (current.policy != config.policy || (realtime && current.priority != config.priority)))) {
+    ROS_ERROR("%s thread: Requested %s, but runs with %s.", name.c_str(), describe(config).c_str(),
+              describe(current).c_str());
+    return false;
+  }
+  ROS_INFO("%s thread: Running with %s.", name.c_str(), describe(current).c_str());
+  return true;
+}
+
+bool lockMemory() {
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    ROS_ERROR("Failed to lock memory: %s", std::strerror(errno));
+    return false;
+  }
+  ROS_INFO("Locked all current and future memory pages.");
+  return true;
+}
+
+}  // namespace franka_hw
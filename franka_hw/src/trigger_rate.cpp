@@ -2,16 +2,54 @@
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #include <franka_hw/trigger_rate.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace franka_hw {
 
-TriggerRate::TriggerRate(double rate) : period_(1.0 / rate), time_stamp_(ros::Time::now()) {}
+TriggerRate::TriggerRate(double rate)
+    : period_(rate > 0.0 ? std::max<int64_t>(std::llround(1e9 / rate), 1) : 0), remaining_(0) {}
 
-bool TriggerRate::operator()() {
-  if ((ros::Time::now() - time_stamp_).toSec() > period_) {
-    time_stamp_ = ros::Time::now();
-    return true;
+bool TriggerRate::operator()(const ros::Duration& period) {
+  if (period_ == 0) {
+    return false;
+  }
+  if (remaining_ > 0) {
+    remaining_ -= period.toNSec();
+    if (remaining_ > 0) {
+      return false;
+    }
+  }
+  remaining_ += period_;
+  if (remaining_ <= 0) {
+    // Skip the triggers missed since the last call but keep the phase.
+    remaining_ = period_ - (-remaining_ % period_);
+  }
+  return true;
+}
+
+bool TriggerRate::operator()(const ros::Time& time) {
+  if (period_ == 0) {
+    return false;
+  }
+  const int64_t now = static_cast<int64_t>(time.toNSec());
+  const bool started = next_time_ != 0;
+  if (started && now < next_time_ && next_time_ - now <= period_) {
+    return false;
+  }
+  if (!started || now < next_time_) {
+    // Start over on the first call or after the time jumped back, e.g. when a simulation is
+    // reset.
+    next_time_ = now + period_;
+  } else {
+    // Skip the triggers missed since the last call but keep the phase.
+    next_time_ += ((now - next_time_) / period_ + 1) * period_;
   }
-  return false;
+  return true;
+}
+
+bool TriggerRate::operator()() {
+  return (*this)(ros::Time::now());
 }
 
 }  // namespace franka_hw
@@ -0,0 +1,160 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <franka_hw/arm_operations.h>
+
+namespace franka_hw {
+
+namespace {
+
+std::vector<std::string> armIds(size_t arms) {
+  std::vector<std::string> arm_ids;
+  for (size_t arm = 0; arm < arms; arm++) {
+    arm_ids.push_back("panda_" + std::to_string(arm + 1));
+  }
+  return arm_ids;
+}
+
+std::vector<size_t> allArms(size_t arms) {
+  std::vector<size_t> indices;
+  for (size_t arm = 0; arm < arms; arm++) {
+    indices.push_back(arm);
+  }
+  return indices;
+}
+
+}  // anonymous namespace
+
+TEST(ArmOperations, RunsOperationsOnArmsConcurrently) {
+  for (size_t arms = 2; arms <= 4; arms++) {
+    ArmOperations arm_operations(armIds(arms));
+
+    // Every operation waits until all of them are running, which only succeeds if they run at
+    // the same time.
+    std::mutex mutex;
+    std::condition_variable all_running;
+    size_t running = 0;
+    std::vector<ArmOperationResult> results = arm_operations.run(
+        allArms(arms),
+        [&](size_t /*arm*/) {
+          std::unique_lock<std::mutex> lock(mutex);
+          running++;
+          all_running.notify_all();
+          if (!all_running.wait_for(lock, std::chrono::seconds(5),
+                                    [&]() { return running == arms; })) {
+            throw std::runtime_error("Not run concurrently.");
+          }
+        },
+        10.0);
+
+    ASSERT_EQ(arms, results.size());
+    EXPECT_TRUE(allSucceeded(results)) << summarize(results);
+    for (size_t arm = 0; arm < arms; arm++) {
+      EXPECT_EQ("panda_" + std::to_string(arm + 1), results[arm].arm_id);
+    }
+  }
+}
+
+TEST(ArmOperations, ReportsFailuresAndTimeoutsPerArm) {
+  ArmOperations arm_operations(armIds(3));
+  std::atomic_bool release(false);
+  std::vector<ArmOperationResult> results = arm_operations.run(
+      {0, 1, 2},
+      [&](size_t arm) {
+        if (arm == 0) {
+          throw std::runtime_error("Reflex not recovered.");
+        }
+        if (arm == 1) {
+          while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          }
+        }
+      },
+      0.1);
+
+  ASSERT_EQ(3u, results.size());
+  EXPECT_FALSE(allSucceeded(results));
+  EXPECT_FALSE(results[0].success);
+  EXPECT_FALSE(results[0].timed_out);
+  EXPECT_EQ("Reflex not recovered.", results[0].error);
+  EXPECT_FALSE(results[1].success);
+  EXPECT_TRUE(results[1].timed_out);
+  EXPECT_TRUE(results[2].success);
+  EXPECT_EQ(
+      "panda_1: failed: Reflex not recovered., panda_2: timed out after 0.10 s, "
+      "panda_3: ok (0.00 s)",
+      summarize(results));
+  release = true;
+}
+
+TEST(ArmOperations, RefusesOperationsOnBusyArms) {
+  ArmOperations arm_operations(armIds(2));
+  std::atomic_bool release(false);
+  std::vector<ArmOperationResult> results = arm_operations.run(
+      {0},
+      [&](size_t /*arm*/) {
+        while (!release) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      },
+      0.01);
+  ASSERT_EQ(1u, results.size());
+  EXPECT_TRUE(results[0].timed_out);
+  EXPECT_TRUE(arm_operations.busy(0));
+  EXPECT_FALSE(arm_operations.busy(1));
+  EXPECT_TRUE(arm_operations.anyBusy());
+
+  std::atomic<size_t> started(0);
+  results = arm_operations.run({0, 1}, [&](size_t /*arm*/) { started++; }, 1.0);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_TRUE(results[0].busy);
+  EXPECT_FALSE(results[0].success);
+  EXPECT_TRUE(results[1].success);
+  EXPECT_EQ(1u, started);
+  EXPECT_EQ("panda_1: busy with a previous operation", summarize({results[0]}));
+
+  release = true;
+  while (arm_operations.anyBusy()) {
+    std::this_thread::yield();
+  }
+  results = arm_operations.run({0}, [&](size_t /*arm*/) { started++; }, 1.0);
+  EXPECT_TRUE(allSucceeded(results));
+  EXPECT_EQ(2u, started);
+}
+
+TEST(ArmOperations, WaitsForTimedOutOperationsOnDestruction) {
+  std::atomic_bool finished(false);
+  {
+    ArmOperations arm_operations(armIds(1));
+    std::vector<ArmOperationResult> results = arm_operations.run(
+        {0},
+        [&](size_t /*arm*/) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(50));
+          finished = true;
+        },
+        0.001);
+    EXPECT_TRUE(results[0].timed_out);
+  }
+  EXPECT_TRUE(finished);
+}
+
+TEST(ArmOperations, SucceedsWithoutArms) {
+  ArmOperations arm_operations({});
+  std::vector<ArmOperationResult> results = arm_operations.run({}, [](size_t /*arm*/) {}, 1.0);
+  EXPECT_TRUE(results.empty());
+  EXPECT_TRUE(allSucceeded(results));
+  EXPECT_EQ("", summarize(results));
+  EXPECT_FALSE(arm_operations.anyBusy());
+}
+
+}  // namespace franka_hw
@@ -0,0 +1,63 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <franka_hw/combined_flags.h>
+
+namespace franka_hw {
+
+TEST(CombinedFlags, SetsAndClearsFlagsPerArm) {
+  CombinedFlags flags;
+  EXPECT_FALSE(flags.any(CombinedFlags::kError));
+  EXPECT_FALSE(flags.any(CombinedFlags::kNeedsReset));
+
+  flags.set(CombinedFlags::kError, 3, true);
+  flags.set(CombinedFlags::kError, CombinedFlags::kMaxArms - 1, true);
+  EXPECT_TRUE(flags.any(CombinedFlags::kError));
+  EXPECT_TRUE(flags.test(CombinedFlags::kError, 3));
+  EXPECT_FALSE(flags.test(CombinedFlags::kError, 2));
+  EXPECT_FALSE(flags.any(CombinedFlags::kNeedsReset));
+  EXPECT_EQ((uint64_t(1) << 3) | (uint64_t(1) << 63), flags.mask(CombinedFlags::kError));
+
+  flags.set(CombinedFlags::kError, 3, false);
+  flags.set(CombinedFlags::kError, CombinedFlags::kMaxArms - 1, false);
+  EXPECT_FALSE(flags.any(CombinedFlags::kError));
+}
+
+TEST(CombinedFlags, KeepsFlagsOfArmsUpdatedConcurrently) {
+  constexpr size_t kArms = 8;
+  CombinedFlags flags;
+  std::vector<std::thread> threads;
+  for (size_t arm = 0; arm < kArms; arm++) {
+    threads.emplace_back([&flags, arm]() {
+      for (size_t i = 0; i < 10000; i++) {
+        flags.set(CombinedFlags::kError, arm, i % 2 == 0);
+        flags.set(CombinedFlags::kNeedsReset, arm, i % 2 == 1);
+      }
+      // Odd arms end in error state.
+      flags.set(CombinedFlags::kError, arm, arm % 2 == 1);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(0xAAu, flags.mask(CombinedFlags::kError));
+  EXPECT_EQ(0xFFu, flags.mask(CombinedFlags::kNeedsReset));
+}
+
+TEST(CombinedFlags, FindsFlagsOfEveryArm) {
+  for (size_t arm = 0; arm < CombinedFlags::kMaxArms; arm++) {
+    CombinedFlags flags;
+    flags.set(CombinedFlags::kError, arm, true);
+    EXPECT_TRUE(flags.any(CombinedFlags::kError));
+    EXPECT_FALSE(flags.any(CombinedFlags::kNeedsReset));
+    EXPECT_TRUE(flags.test(CombinedFlags::kError, arm));
+    EXPECT_EQ(uint64_t(1) << arm, flags.mask(CombinedFlags::kError));
+  }
+}
+
+}  // namespace franka_hw
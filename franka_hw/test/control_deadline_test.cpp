@@ -0,0 +1,146 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <sched.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <franka/control_types.h>
+#include <franka/duration.h>
+#include <franka/robot_state.h>
+
+#include <franka_hw/control_deadline.h>
+
+namespace franka_hw {
+
+namespace {
+franka::RobotState stateAt(uint64_t milliseconds) {
+  franka::RobotState robot_state;
+  robot_state.time = franka::Duration(milliseconds);
+  return robot_state;
+}
+}  // anonymous namespace
+
+TEST(ControlDeadline, UpdatesWithinBudget) {
+  ControlDeadline deadline(ControlDeadline::Config{});
+  std::atomic<uint64_t> last_period_ms(42);
+  deadline.start([&](const franka::RobotState&, franka::Duration period) {
+    last_period_ms = period.toMSec();
+    return true;
+  });
+
+  EXPECT_EQ(ControlDeadline::Result::kUpdated, deadline.cycle(stateAt(0), franka::Duration(0)));
+  EXPECT_EQ(0u, last_period_ms);
+  EXPECT_EQ(ControlDeadline::Result::kUpdated, deadline.cycle(stateAt(1), franka::Duration(1)));
+  EXPECT_EQ(1u, last_period_ms);
+  deadline.stop();
+
+  ControlDeadline::Statistics statistics = deadline.statistics();
+  EXPECT_EQ(2u, statistics.cycles);
+  EXPECT_EQ(0u, statistics.overruns);
+}
+
+TEST(ControlDeadline, LateUpdateIsHeldAndPeriodAccumulated) {
+  ControlDeadline::Config config;
+  config.budget = 0.0009;
+  ControlDeadline deadline(config);
+  std::atomic_bool slow(true);
+  std::atomic<uint64_t> last_period_ms(42);
+  deadline.start([&](const franka::RobotState&, franka::Duration period) {
+    last_period_ms = period.toMSec();
+    if (slow) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+  });
+
+  EXPECT_EQ(ControlDeadline::Result::kOverrun, deadline.cycle(stateAt(0), franka::Duration(0)));
+  // A second callback in the same cycle does not wait again.
+  EXPECT_EQ(ControlDeadline::Result::kOverrun, deadline.cycle(stateAt(0), franka::Duration(0)));
+  slow = false;
+  EXPECT_EQ(ControlDeadline::Result::kOverrun, deadline.cycle(stateAt(1), franka::Duration(1)));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(ControlDeadline::Result::kUpdated, deadline.cycle(stateAt(3), franka::Duration(2)));
+  EXPECT_EQ(3u, last_period_ms);
+  deadline.stop();
+
+  ControlDeadline::Statistics statistics = deadline.statistics();
+  EXPECT_EQ(3u, statistics.cycles);
+  EXPECT_EQ(2u, statistics.overruns);
+  EXPECT_EQ(2u, statistics.max_consecutive_overruns);
+  EXPECT_GT(statistics.max_update_duration, 0.005);
+}
+
+TEST(ControlDeadline, AbortsAfterTooManyOverrunsInARow) {
+  ControlDeadline::Config config;
+  config.budget = 0.0001;
+  config.max_consecutive_overruns = 2;
+  ControlDeadline deadline(config);
+  deadline.start([](const franka::RobotState&, franka::Duration) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return true;
+  });
+
+  EXPECT_EQ(ControlDeadline::Result::kOverrun, deadline.cycle(stateAt(0), franka::Duration(0)));
+  EXPECT_EQ(ControlDeadline::Result::kOverrun, deadline.cycle(stateAt(1), franka::Duration(1)));
+  EXPECT_EQ(ControlDeadline::Result::kAborted, deadline.cycle(stateAt(2), franka::Duration(1)));
+}
+
+TEST(ControlDeadline, FinishesWhenUpdateStopsMotion) {
+  ControlDeadline deadline(ControlDeadline::Config{});
+  deadline.start([](const franka::RobotState& robot_state, franka::Duration) {
+    return robot_state.time.toMSec() < 1;
+  });
+
+  EXPECT_EQ(ControlDeadline::Result::kUpdated, deadline.cycle(stateAt(0), franka::Duration(0)));
+  EXPECT_EQ(ControlDeadline::Result::kFinished, deadline.cycle(stateAt(1), franka::Duration(1)));
+  EXPECT_EQ(ControlDeadline::Result::kFinished, deadline.cycle(stateAt(2), franka::Duration(1)));
+}
+
+TEST(ControlDeadline, ExtrapolatesPositionsWithCommandedVelocity) {
+  franka::RobotState robot_state;
+  robot_state.dq_d = {1.0, -1.0, 0.0, 0.0, 0.0, 0.0, 2.0};
+  franka::JointPositions last_command({0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5});
+
+  franka::JointPositions held =
+      overrunCommand(last_command, robot_state, ControlDeadline::OverrunPolicy::kHold);
+  franka::JointPositions extrapolated =
+      overrunCommand(last_command, robot_state, ControlDeadline::OverrunPolicy::kExtrapolate);
+
+  for (size_t i = 0; i < 7; i++) {
+    EXPECT_DOUBLE_EQ(last_command.q[i], held.q[i]);
+    EXPECT_DOUBLE_EQ(last_command.q[i] + robot_state.dq_d[i] * 0.001, extrapolated.q[i]);
+  }
+}
+
+TEST(ControlDeadline, ExtrapolatesPosesWithCommandedTwist) {
+  franka::RobotState robot_state;
+  robot_state.O_dP_EE_c = {0.1, 0.0, 0.0, 0.0, 0.0, 1.0};
+  franka::CartesianPose last_command(
+      {1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.3, 0.0, 0.5, 1.0});
+
+  franka::CartesianPose extrapolated =
+      overrunCommand(last_command, robot_state, ControlDeadline::OverrunPolicy::kExtrapolate);
+
+  EXPECT_DOUBLE_EQ(0.3 + 0.1 * 0.001, extrapolated.O_T_EE[12]);
+  EXPECT_DOUBLE_EQ(0.5, extrapolated.O_T_EE[14]);
+  // Rotated by 1 mrad around z.
+  EXPECT_NEAR(std::cos(0.001), extrapolated.O_T_EE[0], 1e-12);
+  EXPECT_NEAR(std::sin(0.001), extrapolated.O_T_EE[1], 1e-12);
+  EXPECT_NEAR(-std::sin(0.001), extrapolated.O_T_EE[4], 1e-12);
+  EXPECT_DOUBLE_EQ(1.0, extrapolated.O_T_EE[10]);
+  EXPECT_FALSE(extrapolated.hasElbow());
+}
+
+TEST(ControlDeadline, FailsToStartOnUnavailableCpu) {
+  ControlDeadline::Config config;
+  config.thread.cpus = {CPU_SETSIZE - 1};
+  ControlDeadline deadline(config);
+  EXPECT_FALSE(deadline.start([](const franka::RobotState&, franka::Duration) { return true; }));
+  EXPECT_FALSE(deadline.running());
+}
+
+}  // namespace franka_hw
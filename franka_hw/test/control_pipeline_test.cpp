@@ -0,0 +1,170 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <sched.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <tuple>
+
+#include <gtest/gtest.h>
+
+#include <franka/control_types.h>
+#include <franka/duration.h>
+#include <franka/robot_state.h>
+
+#include <franka_hw/control_pipeline.h>
+#include <franka_hw/triple_buffer.h>
+
+namespace franka_hw {
+
+namespace {
+franka::RobotState stateAt(uint64_t milliseconds) {
+  franka::RobotState robot_state;
+  robot_state.time = franka::Duration(milliseconds);
+  robot_state.q.fill(0.001 * milliseconds);
+  return robot_state;
+}
+
+ControlPipeline::Commands zeroCommands() {
+  return ControlPipeline::Commands(
+      franka::Torques({0, 0, 0, 0, 0, 0, 0}), franka::JointPositions({0, 0, 0, 0, 0, 0, 0}),
+      franka::JointVelocities({0, 0, 0, 0, 0, 0, 0}),
+      franka::CartesianPose({1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}),
+      franka::CartesianVelocities({0, 0, 0, 0, 0, 0}));
+}
+
+// Waits until the pipeline thread published commands for the last state.
+void waitForUpdate(const std::atomic<uint64_t>& updates, uint64_t expected) {
+  while (updates < expected) {
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+}  // anonymous namespace
+
+TEST(TripleBuffer, ReaderGetsLatestPublishedValue) {
+  TripleBuffer<int> buffer(0);
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(0, buffer.readBuffer());
+
+  buffer.writeBuffer() = 1;
+  buffer.publish();
+  buffer.writeBuffer() = 2;
+  buffer.publish();
+  EXPECT_TRUE(buffer.update());
+  EXPECT_EQ(2, buffer.readBuffer());
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(2, buffer.readBuffer());
+
+  buffer.writeBuffer() = 3;
+  buffer.publish();
+  EXPECT_EQ(2, buffer.readBuffer());
+  EXPECT_TRUE(buffer.update());
+  EXPECT_EQ(3, buffer.readBuffer());
+}
+
+TEST(TripleBuffer, ValuesAreNeverTorn) {
+  TripleBuffer<std::array<uint64_t, 64>> buffer;
+  constexpr uint64_t kValues = 100000;
+  std::thread writer([&buffer] {
+    for (uint64_t i = 1; i <= kValues; i++) {
+      buffer.writeBuffer().fill(i);
+      buffer.publish();
+    }
+  });
+  uint64_t last = 0;
+  while (last < kValues) {
+    if (buffer.update()) {
+      const std::array<uint64_t, 64>& value = buffer.readBuffer();
+      for (uint64_t element : value) {
+        ASSERT_EQ(value[0], element);
+      }
+      ASSERT_GT(value[0], last);
+      last = value[0];
+    }
+  }
+  writer.join();
+}
+
+TEST(ControlPipeline, CommandsLagOneCycleBehindStates) {
+  ControlPipeline pipeline(ControlPipeline::Config{}, zeroCommands());
+  std::atomic<uint64_t> updates(0);
+  std::atomic<uint64_t> last_period_ms(42);
+  pipeline.start([&](const franka::RobotState& robot_state, franka::Duration period,
+                     ControlPipeline::Commands* commands) {
+    std::get<franka::JointPositions>(*commands).q = robot_state.q;
+    last_period_ms = period.toMSec();
+    updates++;
+    return true;
+  });
+
+  const ControlPipeline::Commands* commands = nullptr;
+  // No commands exist before the first update.
+  EXPECT_EQ(ControlPipeline::Result::kStalled, pipeline.cycle(stateAt(0), &commands));
+  waitForUpdate(updates, 1);
+  EXPECT_EQ(0u, last_period_ms);
+
+  EXPECT_EQ(ControlPipeline::Result::kUpdated, pipeline.cycle(stateAt(1), &commands));
+  EXPECT_DOUBLE_EQ(0.0, std::get<franka::JointPositions>(*commands).q[0]);
+  // A second callback in the same cycle gets the same commands.
+  EXPECT_EQ(ControlPipeline::Result::kUpdated, pipeline.cycle(stateAt(1), &commands));
+  waitForUpdate(updates, 2);
+  EXPECT_EQ(1u, last_period_ms);
+
+  EXPECT_EQ(ControlPipeline::Result::kUpdated, pipeline.cycle(stateAt(2), &commands));
+  EXPECT_DOUBLE_EQ(0.001, std::get<franka::JointPositions>(*commands).q[0]);
+  pipeline.stop();
+
+  ControlPipeline::Statistics statistics = pipeline.statistics();
+  EXPECT_EQ(3u, statistics.cycles);
+  EXPECT_EQ(0u, statistics.stalls);
+}
+
+TEST(ControlPipeline, CountsStallsAndAborts) {
+  ControlPipeline::Config config;
+  config.max_consecutive_stalls = 2;
+  ControlPipeline pipeline(config, zeroCommands());
+  pipeline.start([](const franka::RobotState&, franka::Duration, ControlPipeline::Commands*) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return true;
+  });
+
+  const ControlPipeline::Commands* commands = nullptr;
+  EXPECT_EQ(ControlPipeline::Result::kStalled, pipeline.cycle(stateAt(0), &commands));
+  EXPECT_EQ(ControlPipeline::Result::kStalled, pipeline.cycle(stateAt(1), &commands));
+  EXPECT_EQ(ControlPipeline::Result::kStalled, pipeline.cycle(stateAt(2), &commands));
+  EXPECT_EQ(ControlPipeline::Result::kAborted, pipeline.cycle(stateAt(3), &commands));
+
+  ControlPipeline::Statistics statistics = pipeline.statistics();
+  EXPECT_EQ(4u, statistics.cycles);
+  EXPECT_EQ(3u, statistics.stalls);
+  EXPECT_EQ(3u, statistics.max_consecutive_stalls);
+}
+
+TEST(ControlPipeline, FinishesWhenUpdateStopsMotion) {
+  ControlPipeline pipeline(ControlPipeline::Config{}, zeroCommands());
+  std::atomic<uint64_t> updates(0);
+  pipeline.start([&](const franka::RobotState&, franka::Duration, ControlPipeline::Commands*) {
+    updates++;
+    return false;
+  });
+
+  const ControlPipeline::Commands* commands = nullptr;
+  EXPECT_EQ(ControlPipeline::Result::kStalled, pipeline.cycle(stateAt(0), &commands));
+  waitForUpdate(updates, 1);
+  EXPECT_EQ(ControlPipeline::Result::kFinished, pipeline.cycle(stateAt(1), &commands));
+  EXPECT_EQ(ControlPipeline::Result::kFinished, pipeline.cycle(stateAt(2), &commands));
+  EXPECT_EQ(1u, updates);
+}
+
+TEST(ControlPipeline, FailsToStartOnUnavailableCpu) {
+  ControlPipeline::Config config;
+  config.thread.cpus = {CPU_SETSIZE - 1};
+  ControlPipeline pipeline(config, zeroCommands());
+  EXPECT_FALSE(pipeline.start(
+      [](const franka::RobotState&, franka::Duration, ControlPipeline::Commands*) { return true; }));
+  EXPECT_FALSE(pipeline.running());
+}
+
+}  // namespace franka_hw
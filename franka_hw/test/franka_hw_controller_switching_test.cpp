@@ -193,4 +193,29 @@ TEST_P(NoControllerConflict, CanPrepareSwitchForCompatibleControllers) {
   EXPECT_TRUE(callPrepareSwitch(GetParam()));
 }
 
+TEST(ControllerSwitch, KeepsMotionRunningForControllersOfSameControlMode) {
+  FrankaHW robot;
+  ros::NodeHandle private_nh("~");
+  ros::NodeHandle root_nh;
+  ASSERT_TRUE(robot.initParameters(root_nh, private_nh));
+  robot.initROSInterfaces(private_nh);
+  robot.setupParameterCallbacks(private_nh);
+
+  ASSERT_TRUE(robot.prepareSwitch({jt_info}, {}));
+  robot.doSwitch({jt_info}, {});
+  EXPECT_TRUE(robot.controllerActive());
+
+  // Replacing a torque controller by another one does not end the motion.
+  ASSERT_TRUE(robot.prepareSwitch({jt_info}, {jt_info}));
+  EXPECT_TRUE(robot.controllerActive());
+  robot.doSwitch({jt_info}, {jt_info});
+  EXPECT_TRUE(robot.controllerActive());
+
+  // Switching to another control mode restarts the motion.
+  ASSERT_TRUE(robot.prepareSwitch({jp_info}, {jt_info}));
+  EXPECT_FALSE(robot.controllerActive());
+  robot.doSwitch({jp_info}, {jt_info});
+  EXPECT_TRUE(robot.controllerActive());
+}
+
 }  // namespace franka_hw
@@ -0,0 +1,149 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <franka/exception.h>
+#include <hardware_interface/controller_info.h>
+#include <ros/ros.h>
+
+#include <franka_hw/franka_mock_hw.h>
+
+extern std::string arm_id;
+extern std::array<std::string, 7> joint_names;
+
+namespace franka_hw {
+
+class FrankaMockHWTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    private_nh_.deleteParam("mock");
+    private_nh_.deleteParam("control_deadline");
+    private_nh_.deleteParam("control_pipeline");
+    private_nh_.deleteParam("threads/controller_update");
+  }
+
+  std::unique_ptr<FrankaMockHW> startTorqueController() {
+    auto mock_hw = std::make_unique<FrankaMockHW>();
+    EXPECT_TRUE(mock_hw->init(root_nh_, private_nh_));
+
+    hardware_interface::ControllerInfo info;
+    info.name = "torque_controller";
+    info.type = "SomeTorqueController";
+    info.claimed_resources.emplace_back(
+        "hardware_interface::EffortJointInterface",
+        std::set<std::string>(joint_names.cbegin(), joint_names.cend()));
+    std::list<hardware_interface::ControllerInfo> start_list{info};
+    EXPECT_TRUE(mock_hw->prepareSwitch(start_list, {}));
+    mock_hw->doSwitch(start_list, {});
+    EXPECT_TRUE(mock_hw->controllerActive());
+    return mock_hw;
+  }
+
+  ros::NodeHandle root_nh_;
+  ros::NodeHandle private_nh_{"~"};
+};
+
+TEST_F(FrankaMockHWTest, RunsControlLoopUntilCallbackStops) {
+  auto mock_hw = startTorqueController();
+
+  size_t callbacks = 0;
+  bool first_period_zero = false;
+  mock_hw->control([&](const ros::Time&, const ros::Duration& period) {
+    if (callbacks == 0) {
+      first_period_zero = period.toSec() == 0.0;
+    }
+    callbacks++;
+    return callbacks < 50;
+  });
+
+  EXPECT_TRUE(first_period_zero);
+  EXPECT_EQ(50u, callbacks);
+  MockRobot::LoopStatistics statistics = mock_hw->statistics();
+  EXPECT_EQ(50u, statistics.cycles);
+  EXPECT_GT(statistics.max_callback_duration, 0.0);
+}
+
+TEST_F(FrankaMockHWTest, LostPacketsAbortMotion) {
+  private_nh_.setParam("mock/packet_loss", 1.0);
+  private_nh_.setParam("mock/max_lost_packets", 10);
+  auto mock_hw = startTorqueController();
+
+  size_t callbacks = 0;
+  EXPECT_THROW(mock_hw->control([&](const ros::Time&, const ros::Duration&) {
+    callbacks++;
+    return true;
+  }),
+               franka::ControlException);
+  EXPECT_EQ(0u, callbacks);
+
+  MockRobot::LoopStatistics statistics = mock_hw->statistics();
+  EXPECT_GE(statistics.lost_packets, 10u);
+  EXPECT_LE(statistics.control_command_success_rate, 0.9);
+
+  const franka::RobotState& robot_state =
+      mock_hw->get<FrankaStateInterface>()->getHandle(arm_id + "_robot").getRobotState();
+  EXPECT_EQ(franka::RobotMode::kReflex, robot_state.robot_mode);
+  EXPECT_TRUE(robot_state.current_errors.communication_constraints_violation);
+}
+
+TEST_F(FrankaMockHWTest, InjectedReflexRequiresRecovery) {
+  private_nh_.setParam("mock/reflex_probability", 1.0);
+  auto mock_hw = startTorqueController();
+
+  auto callback = [](const ros::Time&, const ros::Duration&) { return true; };
+  EXPECT_THROW(mock_hw->control(callback), franka::ControlException);
+  EXPECT_THROW(mock_hw->control(callback), franka::ControlException);
+
+  mock_hw->automaticErrorRecovery();
+  franka::RobotState robot_state = mock_hw->readRobotState();
+  EXPECT_EQ(franka::RobotMode::kIdle, robot_state.robot_mode);
+  EXPECT_FALSE(robot_state.current_errors.joint_reflex);
+}
+
+TEST_F(FrankaMockHWTest, RunsControllerUpdateOnDeadlineThread) {
+  private_nh_.setParam("control_deadline/enabled", true);
+  private_nh_.setParam("threads/controller_update/policy", "inherit");
+  auto mock_hw = startTorqueController();
+
+  const std::thread::id control_thread = std::this_thread::get_id();
+  std::atomic<size_t> callbacks(0);
+  std::atomic<size_t> control_thread_callbacks(0);
+  mock_hw->control([&](const ros::Time&, const ros::Duration&) {
+    if (std::this_thread::get_id() == control_thread) {
+      control_thread_callbacks++;
+    }
+    return ++callbacks < 50;
+  });
+
+  EXPECT_EQ(50u, callbacks);
+  EXPECT_EQ(0u, control_thread_callbacks);
+}
+
+TEST_F(FrankaMockHWTest, RunsControllerUpdateOnPipelineThread) {
+  private_nh_.setParam("control_pipeline/enabled", true);
+  private_nh_.setParam("threads/controller_update/policy", "inherit");
+  auto mock_hw = startTorqueController();
+
+  const std::thread::id control_thread = std::this_thread::get_id();
+  std::atomic<size_t> callbacks(0);
+  std::atomic<size_t> control_thread_callbacks(0);
+  mock_hw->control([&](const ros::Time&, const ros::Duration&) {
+    if (std::this_thread::get_id() == control_thread) {
+      control_thread_callbacks++;
+    }
+    return ++callbacks < 50;
+  });
+
+  EXPECT_EQ(50u, callbacks);
+  EXPECT_EQ(0u, control_thread_callbacks);
+}
+
+}  // namespace franka_hw
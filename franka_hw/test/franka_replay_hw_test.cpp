@@ -0,0 +1,101 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <array>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <franka/control_types.h>
+#include <franka/robot_state.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <ros/ros.h>
+
+#include <franka_hw/franka_model_interface.h>
+#include <franka_hw/franka_replay_hw.h>
+#include <franka_hw/franka_state_interface.h>
+#include <franka_hw/state_log.h>
+
+extern std::string arm_id;
+extern std::array<std::string, 7> joint_names;
+
+namespace franka_hw {
+
+namespace {
+constexpr size_t kRecordedStates = 5;
+}  // anonymous namespace
+
+class FrankaReplayHWTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char directory_template[] = "/tmp/franka_replay_hw_test_XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(directory_template));
+    directory_ = directory_template;
+
+    StateLogWriter::Config config;
+    config.directory = directory_;
+    config.prefix = arm_id;
+    StateLogWriter writer(config);
+    const franka::Torques torques({0, 0, 0, 0, 0, 0, 0});
+    const franka::JointPositions joint_positions({0, 0, 0, 0, 0, 0, 0});
+    const franka::JointVelocities joint_velocities({0, 0, 0, 0, 0, 0, 0});
+    const franka::CartesianPose cartesian_pose({1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1});
+    const franka::CartesianVelocities cartesian_velocities({0, 0, 0, 0, 0, 0});
+    for (size_t i = 0; i < kRecordedStates; i++) {
+      franka::RobotState robot_state;
+      robot_state.time = franka::Duration(i + 1);
+      robot_state.q[0] = 0.1 * i;
+      ASSERT_TRUE(writer.log(robot_state, ControlMode::None, torques, joint_positions,
+                             joint_velocities, cartesian_pose, cartesian_velocities));
+    }
+
+    private_nh_.getParam("robot_ip", robot_ip_);
+    // Do not try to load a model from a robot.
+    private_nh_.setParam("robot_ip", std::string());
+    private_nh_.setParam("replay/source", std::string("state_log"));
+    private_nh_.setParam("replay/path", directory_);
+  }
+
+  void TearDown() override {
+    private_nh_.setParam("robot_ip", robot_ip_);
+    private_nh_.deleteParam("replay");
+  }
+
+  ros::NodeHandle root_nh_;
+  ros::NodeHandle private_nh_{"~"};
+  std::string directory_;
+  std::string robot_ip_;
+};
+
+TEST_F(FrankaReplayHWTest, ReplaysRecordedStatesThroughInterfaces) {
+  FrankaReplayHW replay_hw;
+  ASSERT_TRUE(replay_hw.init(root_nh_, private_nh_));
+
+  auto* state_interface = replay_hw.get<FrankaStateInterface>();
+  auto* joint_state_interface = replay_hw.get<hardware_interface::JointStateInterface>();
+  ASSERT_NE(nullptr, state_interface);
+  ASSERT_NE(nullptr, joint_state_interface);
+  EXPECT_EQ(nullptr, replay_hw.get<FrankaModelInterface>());
+
+  FrankaStateHandle state_handle = state_interface->getHandle(arm_id + "_robot");
+  hardware_interface::JointStateHandle joint_handle =
+      joint_state_interface->getHandle(joint_names[0]);
+
+  size_t count = 0;
+  do {
+    replay_hw.read(ros::Time(0), ros::Duration(0.001));
+    EXPECT_EQ(count + 1, state_handle.getRobotState().time.toMSec());
+    EXPECT_DOUBLE_EQ(0.1 * count, joint_handle.getPosition());
+    count++;
+  } while (replay_hw.nextState());
+  EXPECT_EQ(kRecordedStates, count);
+}
+
+TEST_F(FrankaReplayHWTest, FailsWithoutRecording) {
+  private_nh_.setParam("replay/path", directory_ + "/does_not_exist");
+  FrankaReplayHW replay_hw;
+  EXPECT_FALSE(replay_hw.init(root_nh_, private_nh_));
+}
+
+}  // namespace franka_hw
@@ -0,0 +1,75 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <franka_hw/idle_loop.h>
+
+namespace franka_hw {
+
+namespace {
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+}  // anonymous namespace
+
+TEST(IdleLoop, WaitsForOnePeriod) {
+  IdleLoop idle_loop(50.0);
+  idle_loop.enter();
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(idle_loop.wait());
+  EXPECT_FALSE(idle_loop.wait());
+  EXPECT_GE(secondsSince(start), 0.039);
+}
+
+TEST(IdleLoop, WakeUpEndsWaitEarly) {
+  IdleLoop idle_loop(0.1);
+  idle_loop.enter();
+  std::thread waker([&idle_loop] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    idle_loop.wakeUp();
+  });
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(idle_loop.wait());
+  EXPECT_LT(secondsSince(start), 5.0);
+  waker.join();
+}
+
+TEST(IdleLoop, WakeUpBeforeWaitIsNotLost) {
+  IdleLoop idle_loop(0.1);
+  idle_loop.enter();
+  idle_loop.wakeUp();
+  EXPECT_TRUE(idle_loop.wait());
+}
+
+TEST(IdleLoop, ReportsStatisticsOfIdlePhase) {
+  IdleLoop idle_loop(200.0);
+  EXPECT_FALSE(idle_loop.idle());
+  idle_loop.enter();
+  EXPECT_TRUE(idle_loop.idle());
+  idle_loop.countRead();
+  idle_loop.wait();
+  idle_loop.wakeUp();
+  idle_loop.countRead();
+  idle_loop.wait();
+  idle_loop.countRead();
+  idle_loop.wait();
+  IdleLoop::Statistics statistics = idle_loop.leave();
+
+  EXPECT_FALSE(idle_loop.idle());
+  EXPECT_EQ(3u, statistics.cycles);
+  EXPECT_EQ(1u, statistics.wakeups);
+  EXPECT_EQ(3u, statistics.reads);
+  EXPECT_GE(statistics.duration, 0.009);
+  // Sleeping does not use CPU time.
+  EXPECT_LT(statistics.cpu_usage, 0.5);
+
+  EXPECT_EQ(0u, idle_loop.leave().cycles);
+  idle_loop.countRead();
+  idle_loop.enter();
+  EXPECT_EQ(0u, idle_loop.leave().reads);
+}
+
+}  // namespace franka_hw
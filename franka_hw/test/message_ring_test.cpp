@@ -0,0 +1,95 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <franka_hw/message_ring.h>
+
+namespace franka_hw {
+
+TEST(MessageRing, QueuesMessagesInOrderAndCountsDrops) {
+  MessageRing<std::vector<double>> ring(2, std::vector<double>(7, 0.0));
+  EXPECT_EQ(nullptr, ring.front());
+
+  for (double value : {1.0, 2.0, 3.0}) {
+    std::vector<double>* message = ring.acquire();
+    if (message != nullptr) {
+      message->assign(7, value);
+      ring.commit();
+    }
+  }
+  EXPECT_EQ(2u, ring.size());
+  EXPECT_EQ(1u, ring.droppedMessages());
+
+  ASSERT_NE(nullptr, ring.front());
+  EXPECT_EQ(1.0, ring.front()->at(6));
+  ring.pop();
+  ASSERT_NE(nullptr, ring.front());
+  EXPECT_EQ(2.0, ring.front()->at(6));
+  ring.pop();
+  EXPECT_EQ(nullptr, ring.front());
+  EXPECT_EQ(0u, ring.size());
+}
+
+TEST(MessageRing, ReusesPreallocatedMessages) {
+  MessageRing<std::vector<double>> ring(2, std::vector<double>(7, 0.0));
+  std::vector<const double*> data;
+  for (size_t i = 0; i < 6; i++) {
+    std::vector<double>* message = ring.acquire();
+    ASSERT_NE(nullptr, message);
+    message->assign(7, static_cast<double>(i));
+    data.push_back(message->data());
+    ring.commit();
+    ring.pop();
+  }
+  EXPECT_EQ(data[0], data[2]);
+  EXPECT_EQ(data[1], data[5]);
+  EXPECT_EQ(0u, ring.droppedMessages());
+}
+
+TEST(MessageRing, RejectsEmptyRing) {
+  EXPECT_THROW(MessageRing<int>(0), std::invalid_argument);
+}
+
+TEST(MessageRing, TransfersEveryQueuedMessageBetweenThreads) {
+  constexpr int kMessages = 100000;
+  MessageRing<std::vector<int>> ring(8, std::vector<int>(16, 0));
+
+  std::thread producer([&ring]() {
+    for (int i = 0; i < kMessages; i++) {
+      std::vector<int>* message = ring.acquire();
+      if (message != nullptr) {
+        message->assign(16, i);
+        ring.commit();
+      }
+    }
+  });
+
+  int received = 0;
+  int last = -1;
+  size_t inconsistent = 0;
+  size_t out_of_order = 0;
+  while (received + static_cast<int>(ring.droppedMessages()) < kMessages || ring.front()) {
+    const std::vector<int>* message = ring.front();
+    if (message == nullptr) {
+      continue;
+    }
+    for (int value : *message) {
+      inconsistent += value != message->front();
+    }
+    out_of_order += message->front() <= last;
+    last = message->front();
+    received++;
+    ring.pop();
+  }
+  producer.join();
+
+  EXPECT_EQ(0u, inconsistent);
+  EXPECT_EQ(0u, out_of_order);
+  EXPECT_EQ(static_cast<uint64_t>(kMessages), received + ring.droppedMessages());
+}
+
+}  // namespace franka_hw
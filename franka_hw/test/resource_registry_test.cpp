@@ -0,0 +1,181 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <array>
+#include <list>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <hardware_interface/controller_info.h>
+
+#include <franka_hw/resource_helpers.h>
+
+using hardware_interface::ControllerInfo;
+using hardware_interface::InterfaceResources;
+
+namespace franka_hw {
+
+namespace {
+
+const std::vector<std::string> kArmIds = {"panda_1", "panda_2", "panda_3", "panda_4"};
+const std::vector<std::string> kInterfaces = {
+    "hardware_interface::PositionJointInterface", "hardware_interface::VelocityJointInterface",
+    "hardware_interface::EffortJointInterface", "franka_hw::FrankaPoseCartesianInterface",
+    "franka_hw::FrankaVelocityCartesianInterface"};
+// Interfaces that ros_control lists with an empty resource set, since they claim no resources.
+const std::vector<std::string> kReadOnlyInterfaces = {"franka_hw::FrankaStateInterface",
+                                                      "franka_hw::FrankaModelInterface"};
+
+std::array<std::string, 7> jointNames(const std::string& arm_id) {
+  std::array<std::string, 7> joint_names;
+  for (size_t i = 0; i < joint_names.size(); i++) {
+    joint_names[i] = arm_id + "_joint" + std::to_string(i + 1);
+  }
+  return joint_names;
+}
+
+ControllerInfo makeInfo(const std::string& name,
+                        const std::string& interface,
+                        const std::set<std::string>& resources) {
+  ControllerInfo info;
+  info.name = name;
+  info.type = "type";
+  info.claimed_resources.push_back(InterfaceResources(interface, resources));
+  return info;
+}
+
+// Claims all joints, some joints or the Cartesian resource of a random arm.
+ControllerInfo randomInfo(std::mt19937& generator, size_t index) {
+  const std::string& arm_id = kArmIds[generator() % kArmIds.size()];
+  const std::string& interface = kInterfaces[generator() % kInterfaces.size()];
+  std::set<std::string> resources;
+  if (interface.find("Cartesian") != std::string::npos) {
+    resources.insert(arm_id + "_robot");
+  } else {
+    const auto joint_names = jointNames(arm_id);
+    const size_t count = generator() % 4 == 0 ? 1 + generator() % 6 : joint_names.size();
+    resources.insert(joint_names.begin(), joint_names.begin() + count);
+  }
+  ControllerInfo info = makeInfo("controller" + std::to_string(index), interface, resources);
+  if (generator() % 2 == 0) {
+    info.claimed_resources.push_back(
+        InterfaceResources(kReadOnlyInterfaces[generator() % kReadOnlyInterfaces.size()], {}));
+  }
+  return info;
+}
+
+}  // anonymous namespace
+
+TEST(ResourceRegistry, AgreesWithResourceMaps) {
+  ResourceRegistry registry;
+  std::vector<size_t> arm_indices;
+  for (const auto& arm_id : kArmIds) {
+    arm_indices.push_back(registry.addArm(arm_id, jointNames(arm_id)));
+  }
+
+  std::mt19937 generator(42);
+  ResourceRegistry::Claims claims;
+  for (size_t run = 0; run < 200; run++) {
+    std::list<ControllerInfo> info;
+    const size_t count = 1 + generator() % 6;
+    for (size_t i = 0; i < count; i++) {
+      info.push_back(randomInfo(generator, i));
+    }
+
+    ResourceWithClaimsMap resource_map = getResourceMap(info);
+    ArmClaimedMap arm_claim_map;
+    ASSERT_TRUE(getArmClaimedMap(resource_map, arm_claim_map));
+    ASSERT_TRUE(registry.evaluate(info, &claims));
+    EXPECT_EQ(hasConflictingMultiClaim(resource_map), claims.conflicting_multi_claim);
+
+    for (size_t arm = 0; arm < kArmIds.size(); arm++) {
+      const std::string& arm_id = kArmIds[arm];
+      const auto& arm_claims = ResourceRegistry::armClaims(claims, arm_indices[arm]);
+      EXPECT_EQ(hasConflictingJointAndCartesianClaim(arm_claim_map, arm_id),
+                ResourceRegistry::hasConflictingJointAndCartesianClaim(arm_claims, arm_id));
+      EXPECT_EQ(partiallyClaimsArmJoints(arm_claim_map, arm_id),
+                ResourceRegistry::partiallyClaimsArmJoints(arm_claims, arm_id));
+      EXPECT_EQ(hasTrajectoryClaim(arm_claim_map, arm_id),
+                ResourceRegistry::hasTrajectoryClaim(arm_claims));
+      EXPECT_EQ(getControlMode(arm_id, arm_claim_map), ResourceRegistry::controlMode(arm_claims));
+    }
+  }
+}
+
+TEST(ResourceRegistry, RejectsUnknownInterfacesAndResources) {
+  ResourceRegistry registry;
+  const size_t arm = registry.addArm("panda", jointNames("panda"));
+  ResourceRegistry::Claims claims;
+
+  EXPECT_FALSE(registry.evaluate({makeInfo("unknown", "unknown_interface", {"panda_joint1"})},
+                                 &claims));
+  EXPECT_FALSE(registry.evaluate(
+      {makeInfo("no_arm", "hardware_interface::EffortJointInterface", {"gripper"})}, &claims));
+
+  EXPECT_TRUE(registry.evaluate({}, &claims));
+  EXPECT_EQ(ControlMode::None,
+            ResourceRegistry::controlMode(ResourceRegistry::armClaims(claims, arm)));
+  EXPECT_EQ(ControlMode::None,
+            ResourceRegistry::controlMode(ResourceRegistry::armClaims(claims, arm + 1)));
+}
+
+TEST(ResourceRegistry, AcceptsInterfacesWithoutClaimedResources) {
+  ResourceRegistry registry;
+  const size_t arm = registry.addArm("panda", jointNames("panda"));
+  ResourceRegistry::Claims claims;
+
+  ControllerInfo state_controller;
+  state_controller.name = "franka_state_controller";
+  state_controller.type = "franka_control/FrankaStateController";
+  state_controller.claimed_resources.push_back(InterfaceResources(kReadOnlyInterfaces[0], {}));
+  EXPECT_TRUE(registry.evaluate({state_controller}, &claims));
+  EXPECT_EQ(ControlMode::None,
+            ResourceRegistry::controlMode(ResourceRegistry::armClaims(claims, arm)));
+
+  const auto joint_names = jointNames("panda");
+  ControllerInfo torque_controller =
+      makeInfo("torque", kInterfaces[2], {joint_names.begin(), joint_names.end()});
+  torque_controller.claimed_resources.push_back(InterfaceResources(kReadOnlyInterfaces[0], {}));
+  torque_controller.claimed_resources.push_back(InterfaceResources(kReadOnlyInterfaces[1], {}));
+  EXPECT_TRUE(registry.evaluate({state_controller, torque_controller}, &claims));
+  EXPECT_FALSE(claims.conflicting_multi_claim);
+  EXPECT_EQ(ControlMode::JointTorque,
+            ResourceRegistry::controlMode(ResourceRegistry::armClaims(claims, arm)));
+}
+
+TEST(ResourceRegistry, ChecksManyControllersOnFourArms) {
+  ResourceRegistry registry;
+  std::list<ControllerInfo> info;
+  // One torque and one position controller per joint on four arms, i.e. 56 controllers.
+  for (const auto& arm_id : kArmIds) {
+    const auto joint_names = jointNames(arm_id);
+    registry.addArm(arm_id, joint_names);
+    for (const auto& joint_name : joint_names) {
+      info.push_back(makeInfo(joint_name + "_torque", kInterfaces[2], {joint_name}));
+      info.push_back(makeInfo(joint_name + "_position", kInterfaces[0], {joint_name}));
+    }
+  }
+
+  ResourceWithClaimsMap resource_map = getResourceMap(info);
+  ArmClaimedMap arm_claim_map;
+  EXPECT_FALSE(hasConflictingMultiClaim(resource_map));
+  ASSERT_TRUE(getArmClaimedMap(resource_map, arm_claim_map));
+
+  ResourceRegistry::Claims claims;
+  ASSERT_TRUE(registry.evaluate(info, &claims));
+  EXPECT_FALSE(claims.conflicting_multi_claim);
+  for (size_t arm = 0; arm < kArmIds.size(); arm++) {
+    const auto& arm_claims = ResourceRegistry::armClaims(claims, arm);
+    EXPECT_FALSE(hasConflictingJointAndCartesianClaim(arm_claim_map, kArmIds[arm]));
+    EXPECT_FALSE(ResourceRegistry::hasConflictingJointAndCartesianClaim(arm_claims, kArmIds[arm]));
+    EXPECT_FALSE(partiallyClaimsArmJoints(arm_claim_map, kArmIds[arm]));
+    EXPECT_FALSE(ResourceRegistry::partiallyClaimsArmJoints(arm_claims, kArmIds[arm]));
+    EXPECT_EQ(getControlMode(kArmIds[arm], arm_claim_map),
+              ResourceRegistry::controlMode(arm_claims));
+  }
+}
+
+}  // namespace franka_hw
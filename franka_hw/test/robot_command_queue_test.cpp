@@ -0,0 +1,98 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <franka/exception.h>
+#include <gtest/gtest.h>
+
+#include <franka_hw/robot_command_queue.h>
+
+namespace franka_hw {
+
+TEST(RobotCommandQueue, ExecutesCommandsInOrderAndReportsResults) {
+  std::vector<RobotCommandQueue::Result> results;
+  size_t pushes = 0;
+  RobotCommandQueue queue(
+      4, [&results](const RobotCommandQueue::Result& result) { results.push_back(result); },
+      [&pushes]() { pushes++; });
+
+  std::vector<std::string> executed;
+  const uint64_t first = queue.push("set_load", [&executed]() { executed.push_back("set_load"); });
+  const uint64_t second = queue.push("set_EE_frame", []() {
+    throw franka::CommandException("libfranka: command rejected");
+  });
+  EXPECT_NE(0u, first);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(2u, pushes);
+  EXPECT_EQ(2u, queue.size());
+  EXPECT_TRUE(executed.empty());
+
+  EXPECT_EQ(2u, queue.process());
+  EXPECT_EQ(0u, queue.size());
+  EXPECT_EQ(std::vector<std::string>({"set_load"}), executed);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ(first, results[0].request_id);
+  EXPECT_EQ("set_load", results[0].name);
+  EXPECT_TRUE(results[0].success);
+  EXPECT_EQ(second, results[1].request_id);
+  EXPECT_FALSE(results[1].success);
+  EXPECT_EQ("libfranka: command rejected", results[1].error);
+}
+
+TEST(RobotCommandQueue, ReportsOtherExceptionsAsFailed) {
+  std::vector<RobotCommandQueue::Result> results;
+  RobotCommandQueue queue(
+      4, [&results](const RobotCommandQueue::Result& result) { results.push_back(result); });
+  queue.push("set_load", []() { throw std::invalid_argument("Invalid mass"); });
+  bool executed = false;
+  queue.push("set_EE_frame", [&executed]() { executed = true; });
+
+  EXPECT_EQ(2u, queue.process());
+  EXPECT_TRUE(executed);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_FALSE(results[0].success);
+  EXPECT_EQ("Invalid mass", results[0].error);
+  EXPECT_TRUE(results[1].success);
+}
+
+TEST(RobotCommandQueue, RejectsCommandsWhenFull) {
+  RobotCommandQueue queue(1);
+  EXPECT_NE(0u, queue.push("set_load", []() {}));
+  EXPECT_EQ(0u, queue.push("set_load", []() {}));
+  EXPECT_EQ(1u, queue.size());
+  EXPECT_EQ(1u, queue.capacity());
+}
+
+TEST(RobotCommandQueue, ReportsClearedCommandsAsFailed) {
+  std::vector<RobotCommandQueue::Result> results;
+  RobotCommandQueue queue(
+      4, [&results](const RobotCommandQueue::Result& result) { results.push_back(result); });
+  bool executed = false;
+  const uint64_t request_id = queue.push("set_K_frame", [&executed]() { executed = true; });
+
+  EXPECT_EQ(1u, queue.clear("Robot was disconnected."));
+  EXPECT_EQ(0u, queue.process());
+  EXPECT_FALSE(executed);
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ(request_id, results[0].request_id);
+  EXPECT_FALSE(results[0].success);
+  EXPECT_EQ("Robot was disconnected.", results[0].error);
+}
+
+TEST(RobotCommandQueue, LeavesCommandsPushedWhileProcessingForNextCall) {
+  RobotCommandQueue queue(4);
+  size_t executed = 0;
+  queue.push("set_load", [&]() {
+    executed++;
+    queue.push("set_load", [&executed]() { executed++; });
+  });
+
+  EXPECT_EQ(1u, queue.process());
+  EXPECT_EQ(1u, executed);
+  EXPECT_EQ(1u, queue.process());
+  EXPECT_EQ(2u, executed);
+}
+
+}  // namespace franka_hw
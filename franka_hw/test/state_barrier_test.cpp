@@ -0,0 +1,91 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <franka_hw/state_barrier.h>
+
+namespace franka_hw {
+
+TEST(StateBarrier, CompletesCycleWhenEveryArmDeliveredAState) {
+  StateBarrier barrier(2);
+  double period = -1.0;
+  barrier.signal(0, 1.000);
+  barrier.signal(1, 5.000);
+  EXPECT_TRUE(barrier.wait(std::chrono::milliseconds(10), &period));
+  EXPECT_EQ(-1.0, period);
+
+  barrier.signal(1, 5.001);
+  barrier.signal(0, 1.002);
+  EXPECT_TRUE(barrier.wait(std::chrono::milliseconds(10), &period));
+  EXPECT_NEAR(0.002, period, 1e-9);
+
+  StateBarrier::Statistics statistics = barrier.statistics();
+  EXPECT_EQ(2u, statistics.cycles);
+  EXPECT_EQ(0u, statistics.timeouts);
+  EXPECT_GE(statistics.max_skew, statistics.skew);
+  EXPECT_LT(statistics.max_skew, 0.01);
+}
+
+TEST(StateBarrier, CountsStaleStatesOnTimeout) {
+  StateBarrier barrier(3);
+  double period = -1.0;
+  barrier.signal(0, 1.0);
+  barrier.signal(2, 1.0);
+  EXPECT_FALSE(barrier.wait(std::chrono::milliseconds(1), &period));
+
+  // States from before the reset do not count towards the next cycle.
+  barrier.signal(1, 1.0);
+  barrier.reset();
+  EXPECT_FALSE(barrier.wait(std::chrono::milliseconds(1), &period));
+
+  StateBarrier::Statistics statistics = barrier.statistics();
+  EXPECT_EQ(2u, statistics.cycles);
+  EXPECT_EQ(2u, statistics.timeouts);
+  EXPECT_EQ(std::vector<uint64_t>({1, 2, 1}), statistics.stale_states);
+  EXPECT_EQ(0.0, statistics.max_skew);
+}
+
+TEST(StateBarrier, MeasuresSkewOfArmThreads) {
+  constexpr size_t kArms = 4;
+  constexpr size_t kCycles = 200;
+  StateBarrier barrier(kArms);
+  std::atomic_bool running{true};
+  std::vector<std::thread> arms;
+  for (size_t arm = 0; arm < kArms; arm++) {
+    arms.emplace_back([&barrier, &running, arm]() {
+      // Every arm has its own phase, the last one lags 300 us behind the first one.
+      std::this_thread::sleep_for(std::chrono::microseconds(100 * arm));
+      auto next = std::chrono::steady_clock::now();
+      for (size_t cycle = 0; running; cycle++) {
+        barrier.signal(arm, cycle * 0.001);
+        next += std::chrono::milliseconds(1);
+        std::this_thread::sleep_until(next);
+      }
+    });
+  }
+
+  size_t complete = 0;
+  double period = 0.0;
+  for (size_t cycle = 0; cycle < kCycles; cycle++) {
+    complete += barrier.wait(std::chrono::milliseconds(5), &period) ? 1 : 0;
+  }
+  running = false;
+  for (auto& arm : arms) {
+    arm.join();
+  }
+
+  StateBarrier::Statistics statistics = barrier.statistics();
+  EXPECT_EQ(kCycles, statistics.cycles);
+  EXPECT_GT(complete, kCycles * 9 / 10);
+  // The first arm may deliver more than one state between two cycles.
+  EXPECT_GE(period, 0.001 - 1e-9);
+  EXPECT_GT(statistics.mean_skew, 0.0);
+  EXPECT_LE(statistics.mean_skew, statistics.max_skew);
+}
+
+}  // namespace franka_hw
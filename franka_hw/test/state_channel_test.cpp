@@ -0,0 +1,150 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <franka/robot_state.h>
+
+#include <franka_hw/state_channel.h>
+
+namespace franka_hw {
+
+namespace {
+
+std::string channelName(const std::string& test) {
+  return "/franka_state_channel_test_" + test + "_" + std::to_string(getpid());
+}
+
+franka::RobotState makeRobotState(size_t index) {
+  franka::RobotState robot_state;
+  robot_state.time = franka::Duration(index);
+  robot_state.q.fill(static_cast<double>(index));
+  robot_state.tau_J.fill(-static_cast<double>(index));
+  return robot_state;
+}
+
+}  // anonymous namespace
+
+TEST(StateChannel, ReadsLatestState) {
+  const std::string name = channelName("latest");
+  StateChannelWriter writer(name, 4);
+  StateChannelReader reader(name);
+
+  StateLogRecord record;
+  EXPECT_FALSE(reader.readLatest(&record));
+
+  for (size_t i = 0; i < 10; i++) {
+    writer.write(makeRobotState(i));
+  }
+  EXPECT_EQ(10u, writer.writtenStates());
+  ASSERT_TRUE(reader.readLatest(&record));
+  EXPECT_EQ(9u, record.sequence);
+  EXPECT_EQ(9.0, record.q[3]);
+  EXPECT_EQ(-9.0, record.tau_J[6]);
+
+  franka::RobotState robot_state;
+  ASSERT_TRUE(reader.readLatest(&robot_state));
+  EXPECT_EQ(9u, robot_state.time.toMSec());
+  EXPECT_EQ(9.0, robot_state.q[0]);
+}
+
+TEST(StateChannel, ReadsEveryStateAndCountsOverwrittenStates) {
+  const std::string name = channelName("next");
+  StateChannelWriter writer(name, 4);
+  writer.write(makeRobotState(0));
+  StateChannelReader reader(name);
+
+  StateLogRecord record;
+  EXPECT_FALSE(reader.readNext(&record));
+  for (size_t i = 1; i <= 3; i++) {
+    writer.write(makeRobotState(i));
+  }
+  for (size_t i = 1; i <= 3; i++) {
+    ASSERT_TRUE(reader.readNext(&record));
+    EXPECT_EQ(i, record.sequence);
+  }
+  EXPECT_FALSE(reader.readNext(&record));
+  EXPECT_EQ(0u, reader.missedStates());
+
+  for (size_t i = 4; i < 10; i++) {
+    writer.write(makeRobotState(i));
+  }
+  ASSERT_TRUE(reader.readNext(&record));
+  EXPECT_EQ(6u, record.sequence);
+  EXPECT_EQ(2u, reader.missedStates());
+}
+
+TEST(StateChannel, RejectsMissingChannels) {
+  EXPECT_THROW(StateChannelReader(channelName("missing")), std::runtime_error);
+  EXPECT_THROW(StateChannelWriter(channelName("empty"), 0), std::runtime_error);
+}
+
+TEST(StateChannel, RejectsChannelsInUse) {
+  const std::string name = channelName("in_use");
+  StateChannelWriter writer(name, 4);
+  writer.write(makeRobotState(1));
+  EXPECT_THROW(StateChannelWriter(name, 4), std::runtime_error);
+
+  StateChannelReader reader(name);
+  StateLogRecord record;
+  ASSERT_TRUE(reader.readLatest(&record));
+  EXPECT_EQ(1.0, record.q[0]);
+}
+
+TEST(StateChannel, ReplacesChannelsOfDeadWriters) {
+  const std::string name = channelName("stale");
+  const pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    // Leaves the segment behind like a crashed writer.
+    new StateChannelWriter(name, 4);
+    _exit(0);
+  }
+  int status = 0;
+  ASSERT_EQ(child, waitpid(child, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_NO_THROW(StateChannelReader{name});
+
+  StateChannelWriter writer(name, 4);
+  StateChannelReader reader(name);
+  StateLogRecord record;
+  EXPECT_FALSE(reader.readLatest(&record));
+}
+
+TEST(StateChannel, ReadsConsistentStatesWhileWriting) {
+  const std::string name = channelName("concurrent");
+  StateChannelWriter writer(name, 2);
+  StateChannelReader reader(name);
+
+  std::atomic_bool running{true};
+  std::thread writer_thread([&]() {
+    for (size_t i = 0; running; i++) {
+      writer.write(makeRobotState(i));
+    }
+  });
+
+  size_t reads = 0;
+  size_t torn_reads = 0;
+  StateLogRecord record;
+  while (reads < 10000) {
+    if (!reader.readLatest(&record)) {
+      continue;
+    }
+    reads++;
+    const double index = static_cast<double>(record.sequence);
+    for (size_t joint = 0; joint < record.q.size(); joint++) {
+      torn_reads += record.q[joint] != index || record.tau_J[joint] != -index;
+    }
+  }
+  running = false;
+  writer_thread.join();
+  EXPECT_EQ(0u, torn_reads);
+}
+
+}  // namespace franka_hw
@@ -0,0 +1,197 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <unistd.h>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <franka/control_types.h>
+#include <franka/robot_state.h>
+#include <franka_msgs/FrankaState.h>
+
+#include <franka_hw/state_log.h>
+
+namespace franka_hw {
+
+namespace {
+
+std::string makeTemporaryDirectory() {
+  char directory_template[] = "/tmp/franka_state_log_test_XXXXXX";
+  char* directory = mkdtemp(directory_template);
+  if (directory == nullptr) {
+    return "";
+  }
+  return directory;
+}
+
+franka::RobotState makeRobotState(size_t index) {
+  franka::RobotState robot_state;
+  robot_state.time = franka::Duration(index);
+  robot_state.q[0] = static_cast<double>(index);
+  robot_state.tau_J[6] = -static_cast<double>(index);
+  return robot_state;
+}
+
+bool writeRecords(StateLogWriter* writer, size_t start, size_t count) {
+  const franka::Torques torques({1, 2, 3, 4, 5, 6, 7});
+  const franka::JointPositions joint_positions({0, 0, 0, 0, 0, 0, 0});
+  const franka::JointVelocities joint_velocities({0, 0, 0, 0, 0, 0, 0});
+  const franka::CartesianPose cartesian_pose({1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1});
+  const franka::CartesianVelocities cartesian_velocities({0, 0, 0, 0, 0, 0});
+  for (size_t i = start; i < start + count; i++) {
+    if (!writer->log(makeRobotState(i), ControlMode::JointTorque, torques, joint_positions,
+                     joint_velocities, cartesian_pose, cartesian_velocities)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void waitForSpareSegment(const StateLogWriter& writer) {
+  // The spare segment is prepared by the background thread of the writer.
+  while (!writer.spareSegmentReady()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+}  // anonymous namespace
+
+TEST(StateLogTests, WrittenRecordsCanBeReadAcrossSegments) {
+  std::string directory = makeTemporaryDirectory();
+  ASSERT_FALSE(directory.empty());
+
+  StateLogWriter::Config config;
+  config.directory = directory;
+  config.prefix = "panda";
+  config.segment_size = 10;
+  {
+    StateLogWriter writer(config);
+    waitForSpareSegment(writer);
+    ASSERT_TRUE(writeRecords(&writer, 0, 10));
+    waitForSpareSegment(writer);
+    ASSERT_TRUE(writeRecords(&writer, 10, 5));
+    EXPECT_EQ(15u, writer.writtenRecords());
+    EXPECT_EQ(0u, writer.droppedRecords());
+  }
+
+  StateLogReader reader(directory, "panda");
+  EXPECT_EQ(2u, reader.segments().size());
+  StateLogRecord record{};
+  size_t count = 0;
+  while (reader.next(&record)) {
+    EXPECT_EQ(count, record.sequence);
+    EXPECT_DOUBLE_EQ(count * 0.001, record.time);
+    EXPECT_DOUBLE_EQ(static_cast<double>(count), record.q[0]);
+    EXPECT_DOUBLE_EQ(-static_cast<double>(count), record.tau_J[6]);
+    EXPECT_DOUBLE_EQ(7.0, record.tau_J_command[6]);
+    EXPECT_DOUBLE_EQ(1.0, record.O_T_EE_command[15]);
+    EXPECT_EQ(static_cast<uint32_t>(ControlMode::JointTorque), record.control_mode);
+    count++;
+  }
+  EXPECT_EQ(15u, count);
+}
+
+TEST(StateLogTests, OldSegmentsAreDeleted) {
+  std::string directory = makeTemporaryDirectory();
+  ASSERT_FALSE(directory.empty());
+
+  StateLogWriter::Config config;
+  config.directory = directory;
+  config.prefix = "panda";
+  config.segment_size = 5;
+  config.max_segments = 1;
+  {
+    StateLogWriter writer(config);
+    for (size_t i = 0; i < 4; i++) {
+      waitForSpareSegment(writer);
+      ASSERT_TRUE(writeRecords(&writer, i * 5, 5));
+    }
+    // Trigger the rotation of the last full segment.
+    waitForSpareSegment(writer);
+    ASSERT_TRUE(writeRecords(&writer, 20, 1));
+    waitForSpareSegment(writer);
+  }
+
+  StateLogReader reader(directory, "panda");
+  EXPECT_EQ(2u, reader.segments().size());
+  StateLogRecord record{};
+  ASSERT_TRUE(reader.next(&record));
+  EXPECT_EQ(15u, record.sequence);
+}
+
+TEST(StateLogTests, RestartsKeepEarlierSegments) {
+  std::string directory = makeTemporaryDirectory();
+  ASSERT_FALSE(directory.empty());
+
+  StateLogWriter::Config config;
+  config.directory = directory;
+  config.prefix = "panda";
+  config.segment_size = 10;
+  {
+    StateLogWriter writer(config);
+    ASSERT_TRUE(writeRecords(&writer, 0, 3));
+  }
+  {
+    StateLogWriter writer(config);
+    ASSERT_TRUE(writeRecords(&writer, 3, 2));
+  }
+
+  StateLogReader reader(directory, "panda");
+  EXPECT_EQ(2u, reader.segments().size());
+  StateLogRecord record{};
+  size_t count = 0;
+  while (reader.next(&record)) {
+    EXPECT_DOUBLE_EQ(static_cast<double>(count), record.q[0]);
+    count++;
+  }
+  EXPECT_EQ(5u, count);
+}
+
+TEST(StateLogTests, NoErrorsGiveEmptyBitmask) {
+  franka::RobotState robot_state;
+  EXPECT_EQ(0u, errorsToBitmask(robot_state.current_errors));
+}
+
+TEST(StateLogTests, RecordsSurviveMessageConversion) {
+  StateLogRecord record{};
+  toStateLogRecord(makeRobotState(42), &record);
+  record.current_errors = 0b101;
+  record.robot_mode = 2;
+
+  franka_msgs::FrankaState message;
+  toFrankaStateMessage(record, &message);
+  EXPECT_TRUE(message.current_errors.joint_position_limits_violation);
+  EXPECT_FALSE(message.current_errors.cartesian_position_limits_violation);
+  EXPECT_TRUE(message.current_errors.self_collision_avoidance_violation);
+  EXPECT_EQ(franka_msgs::FrankaState::ROBOT_MODE_MOVE, message.robot_mode);
+
+  StateLogRecord converted{};
+  fromFrankaStateMessage(message, &converted);
+  EXPECT_EQ(record.current_errors, converted.current_errors);
+  EXPECT_EQ(record.robot_mode, converted.robot_mode);
+  EXPECT_DOUBLE_EQ(record.time, converted.time);
+  EXPECT_EQ(record.q, converted.q);
+  EXPECT_EQ(record.tau_J, converted.tau_J);
+  EXPECT_EQ(record.O_T_EE, converted.O_T_EE);
+
+  franka::RobotState robot_state;
+  fromStateLogRecord(converted, &robot_state);
+  EXPECT_EQ(record.current_errors, errorsToBitmask(robot_state.current_errors));
+  EXPECT_EQ(franka::RobotMode::kMove, robot_state.robot_mode);
+  EXPECT_EQ(42u, robot_state.time.toMSec());
+  EXPECT_EQ(record.q, robot_state.q);
+}
+
+TEST(StateLogTests, ColumnsAreInsideRecord) {
+  for (const StateLogColumn& column : stateLogColumns()) {
+    EXPECT_LE(column.offset + column.size * sizeof(double), sizeof(StateLogRecord))
+        << column.name;
+  }
+  EXPECT_EQ(stateLogColumns().back().offset + 2 * sizeof(double), sizeof(StateLogRecord));
+}
+
+}  // namespace franka_hw
@@ -0,0 +1,69 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+
+#include <franka_hw/thread_config.h>
+
+namespace franka_hw {
+
+class ThreadConfigTest : public ::testing::Test {
+ protected:
+  void TearDown() override { node_handle_.deleteParam("threads/test"); }
+
+  ros::NodeHandle node_handle_{"~"};
+};
+
+TEST_F(ThreadConfigTest, ReadsGivenParametersOnly) {
+  node_handle_.setParam("threads/test/cpus", std::vector<int>{0, 0});
+  node_handle_.setParam("threads/test/stack_prefault", 65536);
+
+  ThreadConfig config;
+  config.policy = ThreadConfig::Policy::kFifo;
+  config.priority = 10;
+  ASSERT_TRUE(readThreadConfig(node_handle_, "test", &config));
+  EXPECT_EQ(std::vector<int>({0}), config.cpus);
+  EXPECT_EQ(ThreadConfig::Policy::kFifo, config.policy);
+  EXPECT_EQ(10, config.priority);
+  EXPECT_EQ(65536u, config.stack_prefault);
+}
+
+TEST_F(ThreadConfigTest, RejectsInvalidParameters) {
+  ThreadConfig config;
+  node_handle_.setParam("threads/test/policy", "deadline");
+  EXPECT_FALSE(readThreadConfig(node_handle_, "test", &config));
+
+  node_handle_.setParam("threads/test/policy", "fifo");
+  node_handle_.setParam("threads/test/priority", sched_get_priority_max(SCHED_FIFO) + 1);
+  EXPECT_FALSE(readThreadConfig(node_handle_, "test", &config));
+
+  node_handle_.setParam("threads/test/priority", sched_get_priority_max(SCHED_FIFO));
+  node_handle_.setParam("threads/test/cpus", std::vector<int>{-1});
+  EXPECT_FALSE(readThreadConfig(node_handle_, "test", &config));
+}
+
+TEST_F(ThreadConfigTest, AppliesConfigToCurrentThread) {
+  const int cpu = currentThreadConfig().cpus.back();
+  bool configured = false;
+  ThreadConfig current;
+  // Use a separate thread to leave the scheduling of the test runner untouched.
+  std::thread thread([&] {
+    ThreadConfig config;
+    config.cpus = {cpu};
+    config.policy = ThreadConfig::Policy::kOther;
+    config.stack_prefault = 64 * 1024;
+    configured = configureCurrentThread("test", config);
+    current = currentThreadConfig();
+  });
+  thread.join();
+
+  EXPECT_TRUE(configured);
+  EXPECT_EQ(std::vector<int>({cpu}), current.cpus);
+  EXPECT_EQ(ThreadConfig::Policy::kOther, current.policy);
+}
+
+}  // namespace franka_hw
@@ -0,0 +1,75 @@
+// Copyright (c) 2022 Franka Emika GmbH
+// Use of this source code is governed by the Apache-2.0 license, see LICENSE
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <ros/duration.h>
+#include <ros/time.h>
+
+#include <franka_hw/trigger_rate.h>
+
+namespace franka_hw {
+
+namespace {
+
+// Returns the cycles in which a trigger driven by the period of a 1 kHz loop triggers.
+std::vector<size_t> triggeredCycles(TriggerRate* trigger, size_t cycles) {
+  std::vector<size_t> triggered;
+  for (size_t cycle = 0; cycle < cycles; cycle++) {
+    if ((*trigger)(ros::Duration(0, 1000000))) {
+      triggered.push_back(cycle);
+    }
+  }
+  return triggered;
+}
+
+ros::Time fromMilliseconds(uint64_t milliseconds) {
+  return ros::Time().fromNSec(milliseconds * 1000000);
+}
+
+}  // anonymous namespace
+
+TEST(TriggerRate, TriggersOnFirstCallAndThenAtRate) {
+  TriggerRate trigger(500.0);
+  EXPECT_EQ(std::vector<size_t>({0, 2, 4, 6, 8}), triggeredCycles(&trigger, 10));
+}
+
+TEST(TriggerRate, KeepsPhaseForRatesThatDoNotDivideTheLoopRate) {
+  TriggerRate trigger(300.0);
+  EXPECT_EQ(std::vector<size_t>({0, 4, 7, 10, 14, 17, 20, 24, 27}), triggeredCycles(&trigger, 30));
+
+  TriggerRate slow_trigger(30.0);
+  EXPECT_EQ(300u, triggeredCycles(&slow_trigger, 10000).size());
+}
+
+TEST(TriggerRate, SkipsMissedTriggers) {
+  TriggerRate trigger(100.0);
+  EXPECT_TRUE(trigger(ros::Duration(0, 1000000)));
+  EXPECT_TRUE(trigger(ros::Duration(0, 35000000)));
+  EXPECT_FALSE(trigger(ros::Duration(0, 4000000)));
+  EXPECT_TRUE(trigger(ros::Duration(0, 1000000)));
+}
+
+TEST(TriggerRate, FollowsTime) {
+  TriggerRate trigger(100.0);
+  EXPECT_TRUE(trigger(fromMilliseconds(1000)));
+  EXPECT_FALSE(trigger(fromMilliseconds(1009)));
+  EXPECT_TRUE(trigger(fromMilliseconds(1010)));
+  EXPECT_TRUE(trigger(fromMilliseconds(1025)));
+  EXPECT_FALSE(trigger(fromMilliseconds(1029)));
+  EXPECT_TRUE(trigger(fromMilliseconds(1030)));
+
+  // Starts over if the time jumps back, e.g. when a simulation is reset.
+  EXPECT_TRUE(trigger(fromMilliseconds(0)));
+  EXPECT_FALSE(trigger(fromMilliseconds(5)));
+  EXPECT_TRUE(trigger(fromMilliseconds(10)));
+}
+
+TEST(TriggerRate, NeverTriggersWithoutRate) {
+  TriggerRate trigger(0.0);
+  EXPECT_TRUE(triggeredCycles(&trigger, 100).empty());
+  EXPECT_FALSE(trigger(fromMilliseconds(1000)));
+}
+
+}  // namespace franka_hw